@@ -43,6 +43,7 @@
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <time.h>
 #include "firmware/apple2-fw.h"
@@ -51,12 +52,15 @@
 #include "floppydrive.h"
 #include "harddrive.h"
 #include "log.h"
+#include "machine.h"
 #include "mmu.h"
 #include "mockingboard.h"
 #include "settings.h"
 #include "sound.h"
 #include "timing.h"
+#include "trace.h"
 #include "video.h"
+#include "watch.h"
 #include "gui/diskselector.h"
 #include "gui/config.h"
 #include "gui/gui.h"
@@ -70,14 +74,11 @@
 //#define THREAD_DEBUGGING
 #define SOFT_SWITCH_DEBUGGING
 
+#define WARP_FRAMES		4			// # of frames the CPU runs at a go when warping
+
 // Global variables
 
-uint8_t ram[0x10000], rom[0x10000];			// RAM & ROM spaces
-uint8_t ram2[0x10000];						// Auxillary RAM
-V65C02REGS mainCPU;							// v65C02 execution context
-uint8_t appleType = APPLE_TYPE_IIE;
 bool powerStateChangeRequested = false;
-uint64_t frameCycleStart;
 
 uint64_t frameTicks = 0;
 uint64_t frameTime[60];
@@ -85,29 +86,14 @@ uint32_t frameTimePtr = 0;
 
 // Exported variables
 
-uint8_t lastKeyPressed = 0;
-bool keyDown = false;
-bool openAppleDown = false;
-bool closedAppleDown = false;
-bool store80Mode = false;
-bool vbl = false;
-bool intCXROM = false;
-bool slotC3ROM = false;
-bool intC8ROM = false;
-bool ramrd = false;
-bool ramwrt = false;
-bool altzp = false;
-bool ioudis = true;
-bool dhires = false;
-// Language card state (ROM read, no write)
-uint8_t lcState = 0x02;
 uint8_t blinkTimer = 0;
 
 static bool running = true;					// Machine running state flag...
 static uint64_t startTicks;
 static bool pauseMode = false;
+static bool warpMode = false;				// Run as fast as the host can go
+static bool diskWarp = false;				// Same, but only while loading
 static bool fullscreenDebounce = false;
-static bool resetKeyDown = false;
 static int8_t hideMouseTimeout = 60;
 
 // Vars to handle the //e's 2-key rollover
@@ -116,24 +102,32 @@ static uint8_t keysHeldAppleCode[2];
 static uint8_t keyDownCount = 0;
 static uint8_t keyDelay = 0;
 
-// Local functions
-
-static void SaveApple2State(const char * filename);
-static bool LoadApple2State(const char * filename);
-static void ResetApple2State(void);
-static void AppleTimer(uint16_t);
-
 // Local timer callback functions
 
-static void FrameCallback(void);
-static void BlinkTimer(void);
+static void FrameCallback(void *);
+static void BlinkTimer(void *);
+static void SetWarpMode(bool);
+static void SetPauseMode(bool);
+static void UpdateDiskWarp(void);
 
 #ifdef THREADED_65C02
+static void WakeCPU(void);
+
 // Test of threaded execution of 6502
 static SDL_Thread * cpuThread = NULL;
+static SDL_mutex * cpuMutex = NULL;
 static SDL_cond * cpuCond = NULL;
 static SDL_sem * mainSem = NULL;
 static bool cpuFinished = false;
+static bool frameRequested = false;		// cpuCond's predicate
+
+// The CPU thread puts the screen in snapshot[fillSnapshot] at the end of each
+// frame, then swaps it with the ready one & goes right on to the next frame,
+// while the main thread draws snapshot[drawSnapshot], the newest one that was
+// ready when it started. The indices are only swapped while holding cpuMutex.
+static VideoSnapshot snapshot[3];
+static int fillSnapshot = 0, readySnapshot = 1, drawSnapshot = 2;
+static bool snapshotReady = false;
 
 // NB: Apple //e Manual sez 6502 is running @ 1,022,727 Hz
 //     This is a lie. At the end of each 65 cycle line, there is an elongated
@@ -149,10 +143,6 @@ static uint32_t sampleCount;
 static uint64_t sampleClock, lastSampleClock;
 int CPUThreadFunc(void * data)
 {
-	// Mutex must be locked for conditional to work...
-	// Also, must be created in the thread that uses it...
-	SDL_mutex * cpuMutex = SDL_CreateMutex();
-
 #ifdef CPU_THREAD_OVERFLOW_COMPENSATION
 //	float overflow = 0.0;
 #endif
@@ -169,33 +159,26 @@ WriteLog("CPU: SDL_SemWait(mainSem);\n");
 #endif
 		SDL_SemWait(mainSem);
 
-		// There are exactly 800 slices of 21.333 cycles per frame, so it works
-		// out evenly.
-		// [Actually, seems it's 786 slices of 21.666 cycles per frame]
-
-		// Set our frame cycle counter to the correct # of cycles at the start
-		// of this frame
-		frameCycleStart = mainCPU.clock - mainCPU.overflow;
 #ifdef THREAD_DEBUGGING
-WriteLog("CPU: Execute65C02(&mainCPU, cycles);\n");
+WriteLog("CPU: RunApple2Frame();\n");
 #endif
-		for(int i=0; i<262; i++)
+		RunApple2Frame(warpMode || diskWarp ? WARP_FRAMES : 1);
+		UpdateDiskWarp();
+
+		// A watch went off, so stop right where we are
+		WatchHit hit;
+
+		if (GetWatchHit(&hit))
 		{
-			// If the CTRL+Reset key combo is being held, make sure the RESET
-			// line stays asserted:
-			if (resetKeyDown)
-				mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
-
-			Execute65C02(&mainCPU, 65);
-
-			// According to "Understanding The Apple IIe", VBL asserted after
-			// the last byte of the screen is read and let go on the first read
-			// of the first byte of the screen. We now know that the screen
-			// starts on line #6 and ends on line #197 (of the vertical
-			// counter--actual VBLANK proper happens on lines 230 thru 233).
-			vbl = ((i >= 6) && (i <= 197) ? true : false);
+			char buf[256];
+			SetPauseMode(true);
+			SoundPause();
+			SpawnMessage("%s", DescribeWatchHit(hit, buf));
 		}
 
+		// Hand the frame over to the main thread to draw
+		TakeVideoSnapshot(&snapshot[fillSnapshot]);
+
 //WriteLog("*** Frame ran for %d cycles (%.3lf µs, %d samples).\n", mainCPU.clock - oldClock, ((double)(SDL_GetPerformanceCounter() - cpuFrameTickStart) * 1000000.0) / (double)SDL_GetPerformanceFrequency(), sampleCount);
 //	frameTicks = ((SDL_GetPerformanceCounter() - startTicks) * 1000) / SDL_GetPerformanceFrequency();
 /*
@@ -255,15 +238,30 @@ VC, from line 0-5 and 198-261 is the VBL interval, with vertical retrace occurin
 WriteLog("CPU: SDL_mutexP(cpuMutex);\n");
 #endif
 		SDL_mutexP(cpuMutex);
+		int temp = readySnapshot;
+		readySnapshot = fillSnapshot;
+		fillSnapshot = temp;
+		snapshotReady = true;
+
 		// increment mainSem...
 #ifdef THREAD_DEBUGGING
 WriteLog("CPU: SDL_SemPost(mainSem);\n");
 #endif
 		SDL_SemPost(mainSem);
+		// In warp mode, we don't wait around for the frame callback; we just
+		// keep going (unless paused). The main thread keeps rendering at the
+		// host's refresh rate, so only the frames that happen to be current
+		// when it looks get shown.
+		if (!(warpMode || diskWarp) || pauseMode)
+		{
 #ifdef THREAD_DEBUGGING
 WriteLog("CPU: SDL_CondWait(cpuCond, cpuMutex);\n");
 #endif
-		SDL_CondWait(cpuCond, cpuMutex);
+			while ((!frameRequested || pauseMode) && !cpuFinished)
+				SDL_CondWait(cpuCond, cpuMutex);
+		}
+
+		frameRequested = false;
 
 #ifdef THREAD_DEBUGGING
 WriteLog("CPU: SDL_mutexV(cpuMutex);\n");
@@ -272,10 +270,20 @@ WriteLog("CPU: SDL_mutexV(cpuMutex);\n");
 	}
 	while (!cpuFinished);
 
-	SDL_DestroyMutex(cpuMutex);
-
 	return 0;
 }
+
+
+//
+// Let the CPU thread go on to its next frame, if it's waiting to
+//
+static void WakeCPU(void)
+{
+	SDL_mutexP(cpuMutex);
+	frameRequested = true;
+	SDL_CondSignal(cpuCond);
+	SDL_mutexV(cpuMutex);
+}
 #endif
 
 
@@ -305,183 +313,6 @@ bool LoadImg(char * filename, uint8_t * ram, int size)
 }
 
 
-const uint8_t stateHeader[19] = "APPLE2SAVESTATE1.2";
-static void SaveApple2State(const char * filename)
-{
-	WriteLog("Main: Saving Apple2 state...\n");
-	FILE * file = fopen(filename, "wb");
-
-	if (!file)
-	{
-		WriteLog("Could not open file \"%s\" for writing!\n", filename);
-		return;
-	}
-
-	// Write out header
-	fwrite(stateHeader, 1, 18, file);
-
-	// Write out CPU state
-	fwrite(&mainCPU, 1, sizeof(mainCPU), file);
-
-	// Write out main memory
-	fwrite(ram, 1, 0x10000, file);
-	fwrite(ram2, 1, 0x10000, file);
-
-	// Write out state variables
-	fputc((uint8_t)keyDown, file);
-	fputc((uint8_t)openAppleDown, file);
-	fputc((uint8_t)closedAppleDown, file);
-	fputc((uint8_t)store80Mode, file);
-	fputc((uint8_t)vbl, file);
-	fputc((uint8_t)intCXROM, file);
-	fputc((uint8_t)slotC3ROM, file);
-	fputc((uint8_t)intC8ROM, file);
-	fputc((uint8_t)ramrd, file);
-	fputc((uint8_t)ramwrt, file);
-	fputc((uint8_t)altzp, file);
-	fputc((uint8_t)ioudis, file);
-	fputc((uint8_t)dhires, file);
-	fputc((uint8_t)flash, file);
-	fputc((uint8_t)textMode, file);
-	fputc((uint8_t)mixedMode, file);
-	fputc((uint8_t)displayPage2, file);
-	fputc((uint8_t)hiRes, file);
-	fputc((uint8_t)alternateCharset, file);
-	fputc((uint8_t)col80Mode, file);
-	fputc(lcState, file);
-
-	// Write out floppy state
-	floppyDrive[0].SaveState(file);
-
-	// Write out Mockingboard state
-	MBSaveState(file);
-	fclose(file);
-}
-
-
-static bool LoadApple2State(const char * filename)
-{
-	WriteLog("Main: Loading Apple2 state...\n");
-	FILE * file = fopen(filename, "rb");
-
-	if (!file)
-	{
-		WriteLog("Could not open file \"%s\" for reading!\n", filename);
-		return false;
-	}
-
-	uint8_t buffer[18];
-	fread(buffer, 1, 18, file);
-
-	// Sanity check...
-	if (memcmp(buffer, stateHeader, 18) != 0)
-	{
-		fclose(file);
-		WriteLog("File \"%s\" is not a valid Apple2 save state file!\n", filename);
-		return false;
-	}
-
-	// Read CPU state
-	fread(&mainCPU, 1, sizeof(mainCPU), file);
-
-	// Read main memory
-	fread(ram, 1, 0x10000, file);
-	fread(ram2, 1, 0x10000, file);
-
-	// Read in state variables
-	keyDown = (bool)fgetc(file);
-	openAppleDown = (bool)fgetc(file);
-	closedAppleDown = (bool)fgetc(file);
-	store80Mode = (bool)fgetc(file);
-	vbl = (bool)fgetc(file);
-	intCXROM = (bool)fgetc(file);
-	slotC3ROM = (bool)fgetc(file);
-	intC8ROM = (bool)fgetc(file);
-	ramrd = (bool)fgetc(file);
-	ramwrt = (bool)fgetc(file);
-	altzp = (bool)fgetc(file);
-	ioudis = (bool)fgetc(file);
-	dhires = (bool)fgetc(file);
-	flash = (bool)fgetc(file);
-	textMode = (bool)fgetc(file);
-	mixedMode = (bool)fgetc(file);
-	displayPage2 = (bool)fgetc(file);
-	hiRes = (bool)fgetc(file);
-	alternateCharset = (bool)fgetc(file);
-	col80Mode = (bool)fgetc(file);
-	lcState = fgetc(file);
-
-	// Read in floppy state
-	floppyDrive[0].LoadState(file);
-
-	// Read in Mockingboard state
-	MBLoadState(file);
-	fclose(file);
-
-	// Make sure things are in a sane state before execution :-P
-	mainCPU.RdMem = AppleReadMem;
-	mainCPU.WrMem = AppleWriteMem;
-	mainCPU.Timer = AppleTimer;
-	ResetMMUPointers();
-
-	return true;
-}
-
-
-static void ResetApple2State(void)
-{
-	keyDown = false;
-	openAppleDown = false;
-	closedAppleDown = false;
-	store80Mode = false;
-	vbl = false;
-	intCXROM = false;
-	slotC3ROM = false;
-	intC8ROM = false;
-	ramrd = false;
-	ramwrt = false;
-	altzp = false;
-	ioudis = true;
-	dhires = false;
-	lcState = 0x02;
-	ResetMMUPointers();
-	MBReset();
-
-	// Without this, you can wedge the system :-/
-	memset(ram, 0, 0x10000);
-	memset(ram2, 0, 0x10000);
-	mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
-}
-
-
-static double cyclesForSample = 0;
-static void AppleTimer(uint16_t cycles)
-{
-	// Handle PHI2 clocked stuff here...
-	MBRun(cycles);
-	floppyDrive[0].RunSequencer(cycles);
-
-#if 1
-	// Handle sound
-	// 21.26009 cycles per sample @ 48000 (running @ 1,020,484.32 Hz)
-	// 16.688154500083 ms = 1 frame
-	cyclesForSample += (double)cycles;
-
-	if (cyclesForSample >= 21.26009)
-	{
-#if 0
-sampleClock = mainCPU.clock;
-WriteLog("    cyclesForSample = %lf (%d samples, cycles=%d)\n", cyclesForSample, sampleClock - lastSampleClock, cycles);
-sampleCount++;
-lastSampleClock = sampleClock;
-#endif
-		WriteSampleToBuffer();
-		cyclesForSample -= 21.26009;
-	}
-#endif
-}
-
-
 #ifdef CPU_CLOCK_CHECKING
 uint8_t counter = 0;
 uint32_t totalCPU = 0;
@@ -490,12 +321,25 @@ uint64_t lastClock = 0;
 //
 // Main loop
 //
-int main(int /*argc*/, char * /*argv*/[])
+int main(int argc, char * argv[])
 {
+	bool warp = false;
+
 	InitLog("./apple2.log");
 	LoadSettings();
 	srand(time(NULL));			// Initialize RNG
 
+	for(int i=1; i<argc; i++)
+	{
+		if ((strcmp(argv[i], "-w") == 0) || (strcmp(argv[i], "--warp") == 0))
+			warp = true;
+		else
+		{
+			printf("Usage: %s [-w|--warp]\n", argv[0]);
+			return -1;
+		}
+	}
+
 #if 0
 // Make some timing/address tables
 
@@ -538,26 +382,8 @@ int main(int /*argc*/, char * /*argv*/[])
 
 #endif
 
-	// Zero out memory
-	memset(ram, 0, 0x10000);
-	memset(rom, 0, 0x10000);
-	memset(ram2, 0, 0x10000);
-
-	// Set up MMU
-	SetupAddressMap();
-	ResetMMUPointers();
-
-	// Install devices in slots
-	InstallFloppy(SLOT6);
-	InstallMockingboard(SLOT4);
-	InstallHardDrive(SLOT7);
-
-	// Set up V65C02 execution context
-	memset(&mainCPU, 0, sizeof(V65C02REGS));
-	mainCPU.RdMem = AppleReadMem;
-	mainCPU.WrMem = AppleWriteMem;
-	mainCPU.Timer = AppleTimer;
-	mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
+	// Set up memory, MMU, slots & CPU
+	InitApple2();
 
 #if 0
 	if (!LoadImg(settings.BIOSPath, rom + 0xC000, 0x4000))
@@ -565,8 +391,6 @@ int main(int /*argc*/, char * /*argv*/[])
 		WriteLog("Could not open file '%s'!\n", settings.BIOSPath);
 		return -1;
 	}
-#else
-	memcpy(rom + 0xC000, apple2eEnhROM, 0x4000);
 #endif
 
 	WriteLog("About to initialize video...\n");
@@ -582,9 +406,13 @@ int main(int /*argc*/, char * /*argv*/[])
 	WriteLog("About to initialize audio...\n");
 	SoundInit();
 
+	if (warp)
+		SetWarpMode(true);
+
 	if (settings.autoStateSaving)
 	{
-		// Load last state from file...
+		// Load last state from file... (one that doesn't fit this machine
+		// doesn't change anything, so we just go on from power up)
 		if (!LoadApple2State(settings.autoStatePath))
 			WriteLog("Unable to use Apple2 state file \"%s\"!\n", settings.autoStatePath);
 	}
@@ -604,15 +432,18 @@ So we need to decouple the CPU thread from the host video thread, and have the C
 */
 
 	running = true;
-	InitializeEventList();
+#ifndef THREADED_65C02
 	// Set frame to fire at 1/60 s interval
-	SetCallbackTime(FrameCallback, 16666.66666667);
+	ScheduleEvent(mainCPU.clock + CYCLES_PER_FRAME, FrameCallback, NULL, CYCLES_PER_FRAME);
+#endif
 	// Set up blinking at 1/4 s intervals
-//	SetCallbackTime(BlinkTimer, 250000);
+//	ScheduleEvent(mainCPU.clock + USEC_TO_M6502_CYCLES(250000), BlinkTimer);
 	startTicks = SDL_GetTicks();
 
 #ifdef THREADED_65C02
 	// Kick off the CPU...
+	TakeVideoSnapshot(&snapshot[drawSnapshot]);
+	cpuMutex = SDL_CreateMutex();
 	cpuCond = SDL_CreateCond();
 	mainSem = SDL_CreateSemaphore(1);
 	cpuThread = SDL_CreateThread(CPUThreadFunc, NULL, NULL);
@@ -624,17 +455,21 @@ So we need to decouple the CPU thread from the host video thread, and have the C
 
 	while (running)
 	{
-#ifdef CPU_CLOCK_CHECKING
-		double timeToNextEvent = GetTimeToNextEvent();
-#endif
 #ifndef THREADED_65C02
-		Execute65C02(&mainCPU, USEC_TO_M6502_CYCLES(timeToNextEvent));
+		uint64_t nextEvent = GetNextEventTime();
+		uint32_t cycles = (nextEvent > mainCPU.clock ? (uint32_t)(nextEvent - mainCPU.clock) : 0);
+		Execute65C02(&mainCPU, cycles);
 
 	#ifdef CPU_CLOCK_CHECKING
-totalCPU += USEC_TO_M6502_CYCLES(timeToNextEvent);
+totalCPU += cycles;
 	#endif
+		// The CPU runs whatever comes due while it's executing (see
+		// SyncDevices() in machine.cpp), but make sure nothing's left behind
+		HandleEvents(mainCPU.clock);
+#else
+		// The CPU thread keeps its own time, so just put up frames
+		FrameCallback(NULL);
 #endif
-		HandleNextEvent();
 	}
 
 #ifdef THREADED_65C02
@@ -648,12 +483,16 @@ WriteLog("Main: SDL_SemWait(mainSem);\n");
 		SDL_SemWait(mainSem);
 #endif
 
-WriteLog("Main: SDL_CondSignal(cpuCond);\n");
-	SDL_CondSignal(cpuCond);//thread is probably asleep, so wake it up
+WriteLog("Main: WakeCPU();\n");
+	WakeCPU();//thread is probably asleep, so wake it up
+	// In warp mode, it could be waiting on mainSem instead, so let it have it
+	// (it'll run one more frame & then quit)
+	SDL_SemPost(mainSem);
 WriteLog("Main: SDL_WaitThread(cpuThread, NULL);\n");
 	SDL_WaitThread(cpuThread, NULL);
 WriteLog("Main: SDL_DestroyCond(cpuCond);\n");
 	SDL_DestroyCond(cpuCond);
+	SDL_DestroyMutex(cpuMutex);
 	SDL_DestroySemaphore(mainSem);
 
 	// Autosave state here, if requested...
@@ -736,7 +575,7 @@ uint8_t apple2e_keycode[4][56] = {
 };
 
 static uint32_t frameCount = 0;
-static void FrameCallback(void)
+static void FrameCallback(void *)
 {
 	SDL_Event event;
 	uint8_t keyIndex;
@@ -888,7 +727,7 @@ static void FrameCallback(void)
 
 			if (event.key.keysym.sym == SDLK_PAUSE)
 			{
-				pauseMode = !pauseMode;
+				SetPauseMode(!pauseMode);
 
 				if (pauseMode)
 				{
@@ -906,6 +745,8 @@ static void FrameCallback(void)
 				openAppleDown = true;
 			else if (event.key.keysym.sym == SDLK_RALT)
 				closedAppleDown = true;
+			else if (event.key.keysym.sym == SDLK_F1)
+				SetWarpMode(!warpMode);
 			else if (event.key.keysym.sym == SDLK_F2)
 				TogglePalette();
 			else if (event.key.keysym.sym == SDLK_F3)
@@ -954,11 +795,20 @@ else if (event.key.keysym.sym == SDLK_F9)
 	floppyDrive[0].SwapImages();
 //	SpawnMessage("Image swapped...");
 }//*/
-			// Toggle the disassembly process
+			// Toggle the execution trace (it gets saved when turned off)
 			else if (event.key.keysym.sym == SDLK_F11)
 			{
 				dumpDis = !dumpDis;
-				SpawnMessage("Trace: %s", (dumpDis ? "ON" : "off"));
+
+				if (dumpDis)
+				{
+					ClearTrace();
+					SpawnMessage("Trace: ON");
+				}
+				else if (SaveTrace("./apple2.trace"))
+					SpawnMessage("Trace: off (saved to apple2.trace)");
+				else
+					SpawnMessage("Trace: off (could not save it!)");
 			}
 			else if (event.key.keysym.sym == SDLK_F12)
 			{
@@ -1067,13 +917,13 @@ else if (event.key.keysym.sym == SDLK_F9)
 	{
 		if (GUI::powerOnState)
 		{
-			pauseMode = false;
+			SetPauseMode(false);
 			// Unlock the CPU thread...
 			SDL_SemPost(mainSem);
 		}
 		else
 		{
-			pauseMode = true;
+			SetPauseMode(true);
 			// Should lock until CPU thread is waiting...
 			SDL_SemWait(mainSem);
 			ResetApple2State();
@@ -1087,11 +937,35 @@ else if (event.key.keysym.sym == SDLK_F9)
 	if (blinkTimer == 0)
 		flash = !flash;
 
+#ifdef THREADED_65C02
+	// Pick up the newest frame the CPU has finished, & let it get going on
+	// the next one while this one's drawn
+	SDL_mutexP(cpuMutex);
+
+	if (snapshotReady)
+	{
+		int temp = drawSnapshot;
+		drawSnapshot = readySnapshot;
+		readySnapshot = temp;
+		snapshotReady = false;
+	}
+
+	if (!pauseMode)
+	{
+		frameRequested = true;
+		SDL_CondSignal(cpuCond);
+	}
+
+	SDL_mutexV(cpuMutex);
+
+	// Render the Apple screen + GUI overlay
+	RenderAppleScreen(sdlRenderer, &snapshot[drawSnapshot]);
+#else
 	// Render the Apple screen + GUI overlay
 	RenderAppleScreen(sdlRenderer);
+#endif
 	GUI::Render(sdlRenderer);
 	SDL_RenderPresent(sdlRenderer);
-	SetCallbackTime(FrameCallback, 16666.66666667);
 
 #ifdef CPU_CLOCK_CHECKING
 //We know it's stopped, so we can get away with this...
@@ -1138,21 +1012,89 @@ if (counter == 60)
 	WriteLog("FrameCallback: used %i cycles\n", cyclesBurned);
 	lastCPUCycles = cpuCycles
 #endif
+}
+
+
+//
+// Turn warp mode on or off. Sound is muted while warping, since there's no
+// way to play it back at the speed it's coming out.
+//
+static void SetWarpMode(bool state)
+{
+	warpMode = state;
+	SoundMute(warpMode || diskWarp);
+	SpawnMessage("Warp: %s", (warpMode ? "ON" : "off"));
 
-//let's wait, then signal...
-//works longer, but then still falls behind... [FIXED, see above]
 #ifdef THREADED_65C02
-	if (!pauseMode)
-		SDL_CondSignal(cpuCond);//OK, let the CPU go another frame...
+	// Kick the CPU thread, in case it's waiting on the frame callback
+	if (cpuMutex && warpMode && !pauseMode)
+		WakeCPU();
+#endif
+}
+
+
+//
+// The CPU thread checks pauseMode while holding cpuMutex (see CPUThreadFunc()),
+// so it only gets changed while holding it too
+//
+static void SetPauseMode(bool state)
+{
+#ifdef THREADED_65C02
+	SDL_mutexP(cpuMutex);
+#endif
+	pauseMode = state;
+#ifdef THREADED_65C02
+	SDL_mutexV(cpuMutex);
 #endif
 }
 
 
-static void BlinkTimer(void)
+//
+// Called by the CPU thread after every frame: if a floppy is being read (or
+// written) and nothing else seems to be going on--no clicks from the speaker
+// and no changes to the display mode--let it run flat out until that
+// changes.
+//
+static void UpdateDiskWarp(void)
+{
+	static uint32_t lastToggles = 0;
+	static uint8_t lastVideoMode = 0;
+
+	uint32_t toggles = SpeakerToggleCount();
+	uint8_t videoMode = (textMode ? 0x01 : 0) | (mixedMode ? 0x02 : 0)
+		| (hiRes ? 0x04 : 0) | (displayPage2 ? 0x08 : 0)
+		| (col80Mode ? 0x10 : 0) | (dhires ? 0x20 : 0);
+
+	// Every Disk II has to be asked, since asking is what clears its flag
+	bool busy = false;
+
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		SlotCard * card = GetSlotCard(slot);
+
+		if (card && (card->type == CARD_DISK2))
+			busy = ((FloppyDrive *)card)->IsBusy() || busy;
+	}
+
+	busy = busy && settings.fastDisk
+		&& (toggles == lastToggles) && (videoMode == lastVideoMode);
+
+	lastToggles = toggles;
+	lastVideoMode = videoMode;
+
+	if (busy == diskWarp)
+		return;
+
+	diskWarp = busy;
+	SoundMute(warpMode || diskWarp);
+}
+
+
+static void BlinkTimer(void *)
 {
 	// Set up blinking at 1/4 sec intervals
 	flash = !flash;
-	SetCallbackTime(BlinkTimer, 250000);
+	ScheduleEvent(mainCPU.clock + USEC_TO_M6502_CYCLES(250000), BlinkTimer);
 }
 
 
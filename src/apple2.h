@@ -2,6 +2,9 @@
 // Apple 2 SDL Portable Apple Emulator
 //
 
+#ifndef __APPLE2_H__
+#define __APPLE2_H__
+
 #include <stdint.h>
 #include "v65c02.h"
 
@@ -22,8 +25,8 @@ extern uint8_t lastKeyPressed;
 extern bool keyDown;
 extern bool openAppleDown;
 extern bool closedAppleDown;
+extern bool resetKeyDown;
 extern bool store80Mode;
-extern bool vbl;
 extern bool intCXROM;
 extern bool slotC3ROM;
 extern bool intC8ROM;
@@ -33,6 +36,13 @@ extern bool altzp;
 extern bool ioudis;
 extern bool dhires;
 extern uint8_t lcState;
+extern bool flash;
+extern bool textMode;
+extern bool mixedMode;
+extern bool displayPage2;
+extern bool hiRes;
+extern bool alternateCharset;
+extern bool col80Mode;
 extern uint64_t frameCycleStart;
 #if 0
 extern uint32_t frameTicks;
@@ -43,3 +53,4 @@ extern uint64_t frameTime[];
 #endif
 extern uint32_t frameTimePtr;
 
+#endif	// __APPLE2_H__
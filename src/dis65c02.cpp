@@ -175,3 +175,93 @@ int Decode65C02(V65C02REGS * regs, char * outbuf, uint16_t pc)
 	return addr - pc;
 }
 
+
+//
+// Decode an instruction from the bytes passed in instead of from memory (for
+// looking at code that ran sometime in the past)
+//
+static const uint8_t * decodeBytes;
+static uint16_t decodePC;
+
+static uint8_t ReadDecodeBytes(uint16_t address)
+{
+	return decodeBytes[(uint16_t)(address - decodePC) % 3];
+}
+
+
+int Decode65C02(const uint8_t * bytes, char * outbuf, uint16_t pc)
+{
+	V65C02REGS regs;
+
+	memset(&regs, 0, sizeof(regs));
+	regs.RdMem = ReadDecodeBytes;
+	decodeBytes = bytes;
+	decodePC = pc;
+
+	return Decode65C02(&regs, outbuf, pc);
+}
+
+
+//
+// Work out the effective address of an instruction from the registers as they
+// are *before* it runs; the indirect modes read their pointers through RdMem.
+// Returns false for the modes that don't have one (implied, immediate and
+// relative).
+//
+bool EffectiveAddress65C02(V65C02REGS * regs, uint8_t opcode, uint16_t operand, uint16_t * ea)
+{
+	uint8_t zp = operand & 0xFF;
+
+	switch (op_mat[opcode])
+	{
+	case 2:									// Zero page
+		*ea = zp;
+		break;
+	case 3:									// Zero page, X
+		*ea = (uint8_t)(zp + regs->x);
+		break;
+	case 4:									// Zero page, Y
+		*ea = (uint8_t)(zp + regs->y);
+		break;
+	case 5:									// Zero page indirect
+		*ea = regs->RdMem(zp) | (regs->RdMem((uint8_t)(zp + 1)) << 8);
+		break;
+	case 6:									// Zero page, X indirect
+		zp += regs->x;
+		*ea = regs->RdMem(zp) | (regs->RdMem((uint8_t)(zp + 1)) << 8);
+		break;
+	case 7:									// Zero page, Y indirect
+		*ea = (regs->RdMem(zp) | (regs->RdMem((uint8_t)(zp + 1)) << 8)) + regs->y;
+		break;
+	case 8:									// Absolute
+		*ea = operand;
+		break;
+	case 9:									// Absolute, X
+		*ea = operand + regs->x;
+		break;
+	case 10:								// Absolute, Y
+		*ea = operand + regs->y;
+		break;
+	case 11:								// Indirect
+		*ea = regs->RdMem(operand) | (regs->RdMem(operand + 1) << 8);
+		break;
+	case 12:								// Indirect, X
+		operand += regs->x;
+		*ea = regs->RdMem(operand) | (regs->RdMem(operand + 1) << 8);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+
+//
+// Return the mnemonic for an opcode (padded with spaces to 4 characters)
+//
+const char * Mnemonic65C02(uint8_t opcode)
+{
+	return (const char *)mnemonics[opcode];
+}
+
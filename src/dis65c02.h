@@ -12,6 +12,9 @@
 #include "v65c02.h"
 
 int Decode65C02(V65C02REGS *, char * outbuf, uint16_t pc);
+int Decode65C02(const uint8_t * bytes, char * outbuf, uint16_t pc);
+bool EffectiveAddress65C02(V65C02REGS *, uint8_t opcode, uint16_t operand, uint16_t * ea);
+const char * Mnemonic65C02(uint8_t opcode);
 
 #endif	// __DIS65C02_H__
 
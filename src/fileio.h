@@ -1,7 +1,6 @@
 #ifndef __FILEIO_H__
 #define __FILEIO_H__
 
-#include <SDL.h>
 #include <stdio.h>
 #include <stdint.h>
 
@@ -111,7 +110,7 @@ bool SaveWOZ(const char * filename, WOZ2 * woz, uint32_t size);
 // of the WOZ struct, which stores its data in LE; some for swapping variables
 static inline uint16_t Uint16LE(uint16_t v)
 {
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 	return ((v & 0xFF) << 8) | ((v & 0xFF00) >> 8);
 #else
 	return v;
@@ -121,7 +120,7 @@ static inline uint16_t Uint16LE(uint16_t v)
 
 static inline uint32_t Uint32LE(uint32_t v)
 {
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 	return ((v & 0xFF) << 24) | ((v & 0xFF00) << 8)
 		| ((v & 0xFF0000) >> 8) | ((v & 0xFF000000) >> 24);
 #else
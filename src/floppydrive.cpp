@@ -16,6 +16,7 @@
 #include "floppydrive.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "apple2.h"
 #include "crc32.h"
@@ -23,6 +24,7 @@
 #include "firmware/firmware.h"
 #include "log.h"
 #include "mmu.h"
+#include "trace.h"
 #include "video.h"		// For message spawning... Though there's probably a
 						// better approach than this!
 
@@ -90,7 +92,8 @@ static inline void Swap(uint8_t * & a, uint8_t * & b)
 
 // FloppyDrive class implementation...
 
-FloppyDrive::FloppyDrive(): motorOn(0), activeDrive(0), ioMode(IO_MODE_READ),  ioHappened(false), diskImageReady(false)
+FloppyDrive::FloppyDrive(): SlotCard(CARD_DISK2), motorOn(0), activeDrive(0), ioMode(IO_MODE_READ),  ioHappened(false), dataAccessed(false), diskImageReady(false),
+	sequencerClock(0)
 {
 	phase[0] = phase[1] = 0;
 	headPos[0] = headPos[1] = 0;
@@ -570,6 +573,20 @@ int FloppyDrive::DriveLightStatus(uint8_t driveNum/*= 0*/)
 }
 
 
+//
+// Returns true if the motor is on and the data register has been read or
+// written since the last time this was called (i.e., something is actually
+// reading from or writing to the disk, as opposed to the motor just being
+// left on)
+//
+bool FloppyDrive::IsBusy(void)
+{
+	bool busy = motorOn && dataAccessed;
+	dataAccessed = false;
+	return busy;
+}
+
+
 void FloppyDrive::SaveState(FILE * file)
 {
 	// Internal state vars
@@ -651,6 +668,8 @@ void FloppyDrive::LoadState(FILE * file)
 		fread(disk[1], 1, diskSize[1], file);
 		fread(imageName[1], 1, MAX_PATH, file);
 	}
+
+	sequencerClock = mainCPU.clock;
 }
 
 
@@ -796,7 +815,8 @@ void FloppyDrive::ControlMotor(uint8_t addr)
 	if (motorOn)
 		readPulse = 0;
 	else
-		driveOffTimeout = 2000000;
+		// The disk keeps spinning for a second after it's turned off
+		driveOffTimeout = 1020484;
 
 WriteLog("FLOPPY: Turning drive motor %s\n", (motorOn ? "ON" : "off"));
 }
@@ -854,6 +874,7 @@ uint8_t FloppyDrive::DataRegister(void)
 			activeDrive, dataRegister, headPos[activeDrive] >> 2, (uint32_t)(((float)currentPos[activeDrive] / (float)bitLen) * 16.0f));
 		ioMode = IO_MODE_READ;
 		ioHappened = true;
+		dataAccessed = true;
 
 if ((seenReadSinceStep == false) && (slSwitch == false) && (rwSwitch == false) && ((iorAddr & 0x0F) == 0x0C))
 {
@@ -873,6 +894,7 @@ void FloppyDrive::DataRegister(uint8_t data)
 	cpuDataBus = data;
 	ioMode = IO_MODE_WRITE;
 	ioHappened = true;
+	dataAccessed = true;
 }
 
 
@@ -950,7 +972,21 @@ $5A:    File structure damaged
 //       seems to run OK, for the most part.)
 
 
-static bool logSeq = false;
+//
+// Run the sequencer up to clock. Nothing outside of the drive can see what
+// it's been doing except through the slot's I/O, so this only has to happen
+// when that gets touched.
+//
+void FloppyDrive::Run(uint64_t clock)
+{
+	uint32_t cycles = (uint32_t)(clock - sequencerClock);
+	sequencerClock = clock;
+
+	if (cycles)
+		RunSequencer(cycles);
+}
+
+
 //
 // Logic State Sequencer & Data Register
 //
@@ -968,7 +1004,10 @@ void FloppyDrive::RunSequencer(uint32_t cyclesToRun)
 		if (driveOffTimeout == 0)
 			return;
 
-		driveOffTimeout--;
+		if (cyclesToRun > driveOffTimeout)
+			cyclesToRun = driveOffTimeout;
+
+		driveOffTimeout -= cyclesToRun;
 	}
 
 	WOZ2 & woz = *((WOZ2 *)disk[activeDrive]);
@@ -980,12 +1019,21 @@ void FloppyDrive::RunSequencer(uint32_t cyclesToRun)
 
 //extern bool dumpDis;
 //static bool tripwire = false;
-uint8_t chop = 0;
 //static uint32_t lastPos = 0;
-if (logSeq)
-{
-	WriteLog("DISKSEQ: Running for %d cycles [rw=%hhd, sl=%hhd, reg=%02X, bus=%02X]\n", cyclesToRun, rwSwitch, slSwitch, dataRegister, cpuDataBus);
-}
+	TraceRecord * record = 0;
+
+	if (dumpDis)
+	{
+		record = TraceAlloc(TRACE_DISK, mainCPU.clock, mainCPU.pc);
+		record->disk.drive = activeDrive;
+		record->disk.head = headPos[activeDrive];
+		record->disk.state[0] = sequencerState;
+		record->disk.data[0] = dataRegister;
+		record->disk.bus = cpuDataBus;
+		record->disk.switches = slSwitch | (rwSwitch << 1) | (motorOn ? 0x04 : 0);
+		record->disk.cycles = cyclesToRun;
+		record->disk.position = currentPos[activeDrive];
+	}
 
 	while (cyclesToRun-- > 0)
 	{
@@ -1039,9 +1087,6 @@ N.B.: Had to up this to 3 because Up N' Down had some weird sync bytes (FE10).
 		uint8_t nextState = (sequencerState & 0xF0) | (rwSwitch << 3)
 			| (slSwitch << 2) | (readPulse ? 0x02 : 0)
 			| ((dataRegister & 0x80) >> 7);
-if (logSeq)
-	WriteLog("[%02X:%02X]%s", sequencerState, nextState, (chop == 15 ? "\n" : ""));
-chop = (chop + 1) % 20;
 		sequencerState = sequencerROM[nextState];
 
 		switch (sequencerState & 0x0F)
@@ -1139,16 +1184,22 @@ lastPos = currentPos[activeDrive];
 			readPulse--;
 	}
 
-if (logSeq)
-	WriteLog("\n");
+	if (record)
+	{
+		record->disk.state[1] = sequencerState;
+		record->disk.data[1] = dataRegister;
+		TraceCommit();
+	}
 }
 
 
 FloppyDrive floppyDrive[2];
 
-static uint8_t SlotIOR(uint16_t address)
+
+uint8_t FloppyDrive::ReadIO(uint16_t address)
 {
 	uint8_t state = address & 0x0F;
+	Run(mainCPU.clock);
 
 	switch (state)
 	{
@@ -1160,23 +1211,23 @@ static uint8_t SlotIOR(uint16_t address)
 	case 0x05:
 	case 0x06:
 	case 0x07:
-		floppyDrive[0].ControlStepper(state);
+		ControlStepper(state);
 		break;
 	case 0x08:
 	case 0x09:
-		floppyDrive[0].ControlMotor(state & 0x01);
+		ControlMotor(state & 0x01);
 		break;
 	case 0x0A:
 	case 0x0B:
-		floppyDrive[0].DriveEnable(state & 0x01);
+		DriveEnable(state & 0x01);
 		break;
 	case 0x0C:
 	case 0x0D:
-		floppyDrive[0].SetShiftLoadSwitch(state & 0x01);
+		SetShiftLoadSwitch(state & 0x01);
 		break;
 	case 0x0E:
 	case 0x0F:
-		floppyDrive[0].SetReadWriteSwitch(state & 0x01);
+		SetReadWriteSwitch(state & 0x01);
 		break;
 	}
 
@@ -1184,13 +1235,14 @@ static uint8_t SlotIOR(uint16_t address)
 iorAddr = address;
 	// Even addresses return the data register, odd (we suppose) returns a
 	// floating bus read...
-	return (address & 0x01 ? ReadFloatingBus(0) : floppyDrive[0].DataRegister());
+	return (address & 0x01 ? ReadFloatingBus(0) : DataRegister());
 }
 
 
-static void SlotIOW(uint16_t address, uint8_t byte)
+void FloppyDrive::WriteIO(uint16_t address, uint8_t byte)
 {
 	uint8_t state = address & 0x0F;
+	Run(mainCPU.clock);
 
 	switch (state)
 	{
@@ -1202,44 +1254,36 @@ static void SlotIOW(uint16_t address, uint8_t byte)
 	case 0x05:
 	case 0x06:
 	case 0x07:
-		floppyDrive[0].ControlStepper(state);
+		ControlStepper(state);
 		break;
 	case 0x08:
 	case 0x09:
-		floppyDrive[0].ControlMotor(state & 0x01);
+		ControlMotor(state & 0x01);
 		break;
 	case 0x0A:
 	case 0x0B:
-		floppyDrive[0].DriveEnable(state & 0x01);
+		DriveEnable(state & 0x01);
 		break;
 	case 0x0C:
 	case 0x0D:
-		floppyDrive[0].SetShiftLoadSwitch(state & 0x01);
+		SetShiftLoadSwitch(state & 0x01);
 		break;
 	case 0x0E:
 	case 0x0F:
-		floppyDrive[0].SetReadWriteSwitch(state & 0x01);
+		SetReadWriteSwitch(state & 0x01);
 		break;
 	}
 
 	// Odd addresses write to the Data register, even addresses (we assume) go
 	// into the ether
 	if (state & 0x01)
-		floppyDrive[0].DataRegister(byte);
+		DataRegister(byte);
 }
 
 
-// This slot function doesn't need to differentiate between separate instances
-// of FloppyDrive
-static uint8_t SlotROM(uint16_t address)
+// Every controller has the same boot ROM
+uint8_t FloppyDrive::ReadROM(uint16_t address)
 {
 	return diskROM[address];
 }
 
-
-void InstallFloppy(uint8_t slot)
-{
-	SlotData disk = { SlotIOR, SlotIOW, SlotROM, 0, 0, 0 };
-	InstallSlotHandler(slot, &disk);
-}
-
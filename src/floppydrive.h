@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include "slotcard.h"
 
 enum { DT_EMPTY = 0, DT_WOZ, DT_DOS33, DT_DOS33_HDR, DT_PRODOS, DT_NYBBLE,
 	DFT_UNKNOWN };
@@ -26,7 +27,7 @@ enum { DLS_OFF, DLS_READ, DLS_WRITE };
 
 class WOZ2;
 
-class FloppyDrive
+class FloppyDrive : public SlotCard
 {
 	public:
 		FloppyDrive();
@@ -43,9 +44,16 @@ class FloppyDrive
 		bool IsWriteProtected(uint8_t driveNum = 0);
 		void SetWriteProtect(bool, uint8_t driveNum = 0);
 		int DriveLightStatus(uint8_t driveNum = 0);
+		bool IsBusy(void);
 		void SaveState(FILE *);
 		void LoadState(FILE *);
 
+		// Slot card interface ($C0n0-$C0nF & the boot ROM)
+		uint8_t ReadIO(uint16_t address);
+		void WriteIO(uint16_t address, uint8_t byte);
+		uint8_t ReadROM(uint16_t address);
+		void Run(uint64_t clock);
+
 	private:
 		uint32_t ReadLong(FILE *);
 		void WriteLong(FILE *, uint32_t);
@@ -80,6 +88,7 @@ class FloppyDrive
 		uint8_t phase[2];
 		uint8_t headPos[2];
 		bool ioHappened;
+		bool dataAccessed;			// Data register used since IsBusy()
 		bool diskImageReady;
 
 		uint32_t currentPos[2];
@@ -93,10 +102,10 @@ class FloppyDrive
 		uint32_t driveOffTimeout;
 		uint8_t zeroBitCount;
 		uint16_t trackLength[2];
+		uint64_t sequencerClock;	// Sequencer has been run up to here
 };
 
-// Exported functions/variables
-void InstallFloppy(uint8_t slot);
+// Exported variables
 extern FloppyDrive floppyDrive[];
 
 #endif	// __FLOPPY_H__
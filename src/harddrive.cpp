@@ -14,6 +14,10 @@
 //
 
 #include "harddrive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "apple2.h"
 #include "dis65c02.h"
 #include "fileio.h"
@@ -21,49 +25,40 @@
 #include "log.h"
 #include "mmu.h"
 #include "settings.h"
+#include "trace.h"
 #include "v65c02.h"		// For dumpDis...
 
 
-static uint8_t romBank = 0;
-static uint8_t ramBank = 0;
-static uint8_t deviceID = 7;
-static bool dmaSwitch = false;
-static uint8_t staticRAM[0x2000] = { 0 };
-static uint8_t reg[16];
-
-// Stuff that will have to GTFO of here
-static uint8_t * hdData = NULL;
-
 enum {
 	DVM_DATA_OUT = 0, DVM_DATA_IN = 1, DVM_COMMAND = 2, DVM_STATUS = 3,
 	DVM_MESSAGE_OUT = 6, DVM_MESSAGE_IN = 7, DVM_BUS_FREE = 8,
 	DVM_ARBITRATE = 16, DVM_SELECT = 32
 };
 
-static bool DATA_BUS = false;
-static bool DMA_MODE = false;
-static bool BSY = false;
-static bool ATN = false;
-static bool SEL = false;
-static bool ACK = false;
-static bool RST = false;
-static bool MSG = false;
-static bool C_D = false;
-static bool I_O = false;
-static bool REQ = false;
-static bool DEV_BSY = false;
-static bool DRQ = false;
-static bool DACK = false;
-static uint8_t devMode = DVM_BUS_FREE;
-static uint8_t cmdLength;
-static uint8_t cmd[256];
-static uint32_t bytesToSend;
-static uint8_t * buf;
-static uint32_t bufPtr;
-static uint8_t response;
-
-
-static inline void SetNextState(uint8_t state)
+
+HardDrive hardDrive[2];
+
+
+HardDrive::HardDrive(): SlotCard(CARD_SCSI), romBank(0), ramBank(0),
+	deviceID(7), dmaSwitch(false), hdData(NULL), DATA_BUS(false),
+	DMA_MODE(false), BSY(false), ATN(false), SEL(false), ACK(false),
+	RST(false), MSG(false), C_D(false), I_O(false), REQ(false),
+	DEV_BSY(false), DRQ(false), DACK(false), devMode(DVM_BUS_FREE),
+	cmdLength(0), bytesToSend(0), buf(NULL), bufPtr(0), response(0)
+{
+	memset(staticRAM, 0, sizeof(staticRAM));
+	memset(reg, 0, sizeof(reg));
+}
+
+
+HardDrive::~HardDrive()
+{
+	if (hdData)
+		free(hdData);
+}
+
+
+void HardDrive::SetNextState(uint8_t state)
 {
 	devMode = state;
 	MSG = (state & 0x04 ? true : false);
@@ -73,7 +68,7 @@ static inline void SetNextState(uint8_t state)
 }
 
 
-static void RunDevice(void)
+void HardDrive::RunDevice(void)
 {
 	// Let's see where it's really going...
 /*	if (mainCPU.pc == 0xCE7E)
@@ -359,7 +354,29 @@ static void RunDevice(void)
 }
 
 
-static uint8_t SlotIOR(uint16_t address)
+//
+// Current SCSI Bus Status (5380 register 4)
+//
+uint8_t HardDrive::BusStatus(void)
+{
+	return (RST ? 0x80 : 0) | (BSY | DEV_BSY ? 0x40 : 0) | (REQ ? 0x20 : 0) | (MSG ? 0x10 : 0) | (C_D ? 0x08 : 0) | (I_O ? 0x04 : 0) | (SEL ? 0x02 : 0);
+}
+
+
+void HardDrive::TraceAccess(uint16_t address, uint8_t byte, bool write)
+{
+	TraceRecord * record = TraceAlloc(TRACE_SCSI, mainCPU.clock, mainCPU.pc);
+	record->flags = (write ? TRACE_WRITE : 0);
+	record->scsi.reg = address & 0x0F;
+	record->scsi.value = byte;
+	record->scsi.phase = devMode;
+	record->scsi.signals = BusStatus();
+	record->scsi.romBank = romBank;
+	TraceCommit();
+}
+
+
+uint8_t HardDrive::ReadIO(uint16_t address)
 {
 	// This should prolly go somewhere else...
 	RunDevice();
@@ -392,7 +409,7 @@ static uint8_t SlotIOR(uint16_t address)
 /*if (((mainCPU.pc != 0xCD7C) && (mainCPU.pc != 0xCD5F)) || (romBank != 16))
 	WriteLog("  [%02X %02X %02X %02X %02X %02X %02X %02X] [$C81F=$%02X $C80D=$%02X $C80A=$%02X $C887=$%02X $C806=$%02X $C88F=$%02X $C8EC=$%02X $4F=$%02X]\n", reg[0], reg[1], reg[2], reg[3], reg[4], reg[5], reg[6], reg[7], staticRAM[0x1F], staticRAM[0x0D], staticRAM[0x0A], staticRAM[0x87], staticRAM[0x06], staticRAM[0x8F], staticRAM[0xEC], ram[0x4F]);//*/
 
-			response = (RST ? 0x80 : 0) | (BSY | DEV_BSY ? 0x40 : 0) | (REQ ? 0x20 : 0) | (MSG ? 0x10 : 0) | (C_D ? 0x08 : 0) | (I_O ? 0x04 : 0) | (SEL ? 0x02 : 0);
+			response = BusStatus();
 			break;
 		case 0x05:
 		{
@@ -448,11 +465,14 @@ static uint8_t SlotIOR(uint16_t address)
 		WriteLog("HD Slot I/O read %s ($%02X <- $%X, PC=%04X:%u)\n", SCSIName[address & 0x0F], response, address & 0x0F, mainCPU.pc, romBank);
 #endif
 
+	if (dumpDis)
+		TraceAccess(address, response, false);
+
 	return response;
 }
 
 
-static void SlotIOW(uint16_t address, uint8_t byte)
+void HardDrive::WriteIO(uint16_t address, uint8_t byte)
 {
 	switch (address & 0x0F)
 	{
@@ -582,16 +602,19 @@ static void SlotIOW(uint16_t address, uint8_t byte)
 
 	// This should prolly go somewhere else...
 	RunDevice();
+
+	if (dumpDis)
+		TraceAccess(address, byte, true);
 }
 
 
-static uint8_t SlotROM(uint16_t address)
+uint8_t HardDrive::ReadROM(uint16_t address)
 {
 	return a2hsScsiROM[address];
 }
 
 
-static uint8_t SlotIOExtraR(uint16_t address)
+uint8_t HardDrive::ReadExpansion(uint16_t address)
 {
 	if (address < 0x400)
 		return staticRAM[(ramBank * 0x400) + address];
@@ -600,7 +623,7 @@ static uint8_t SlotIOExtraR(uint16_t address)
 }
 
 
-static void SlotIOExtraW(uint16_t address, uint8_t byte)
+void HardDrive::WriteExpansion(uint16_t address, uint8_t byte)
 {
 	if (address < 0x400)
 		staticRAM[(ramBank * 0x400) + address] = byte;
@@ -614,18 +637,24 @@ static void SlotIOExtraW(uint16_t address, uint8_t byte)
 }
 
 
-void InstallHardDrive(uint8_t slot)
+//
+// Load the image in filename (in settings.disksPath) as the drive's contents;
+// .2mg & .hdv images are what we know how to read
+//
+bool HardDrive::LoadImage(const char * filename)
 {
-	SlotData hd = { SlotIOR, SlotIOW, SlotROM, 0, SlotIOExtraR, SlotIOExtraW };
-	InstallSlotHandler(slot, &hd);
 	char fnBuf[MAX_PATH + 1];
 
+	if (hdData)
+		free(hdData);
+
 	// If this fails to read the file, the pointer is set to NULL
 	uint32_t size = 0, skip = (uint32_t)-1;
-	sprintf(fnBuf, "%s%s", settings.disksPath, settings.hd[0]);
+	hdData = NULL;
+	sprintf(fnBuf, "%s%s", settings.disksPath, filename);
 
 	// Check to see which type of HD image we have...
-	char * ext = strrchr(settings.hd[0], '.');
+	const char * ext = strrchr(filename, '.');
 
 	if (ext != NULL)
 	{
@@ -637,15 +666,17 @@ void InstallHardDrive(uint8_t slot)
 
 	if (skip == (uint32_t)-1)
 	{
-		hdData = NULL;
-		WriteLog("HD: Unknown HD image file: %s\n", settings.hd[0]);
-		return;
+		WriteLog("HD: Unknown HD image file: %s\n", filename);
+		return false;
 	}
 
 	hdData = ReadFile(fnBuf, &size, skip);
 
 	if (hdData)
-		WriteLog("HD: Read Hard Drive image file '%s', %u bytes ($%X)\n", settings.hd[0], size, size);
+		WriteLog("HD: Read Hard Drive image file '%s', %u bytes ($%X)\n", filename, size, size);
 	else
 		WriteLog("HD: Could not read Hard Drive image file!\n");
+
+	return (hdData != NULL);
 }
+
@@ -2,8 +2,65 @@
 #define __HARDDRIVE_H__
 
 #include <stdint.h>
+#include "slotcard.h"
 
-void InstallHardDrive(uint8_t slot);
+//
+// Apple II High-Speed SCSI card, with one drive on it
+//
+class HardDrive : public SlotCard
+{
+	public:
+		HardDrive();
+		~HardDrive();
 
-#endif	// __HARDDRIVE_H__
+		bool LoadImage(const char * filename);
+
+		// Slot card interface
+		uint8_t ReadIO(uint16_t address);
+		void WriteIO(uint16_t address, uint8_t byte);
+		uint8_t ReadROM(uint16_t address);
+		uint8_t ReadExpansion(uint16_t address);
+		void WriteExpansion(uint16_t address, uint8_t byte);
+
+	private:
+		void SetNextState(uint8_t state);
+		void RunDevice(void);
+		uint8_t BusStatus(void);
+		void TraceAccess(uint16_t address, uint8_t byte, bool write);
+
+		uint8_t romBank;
+		uint8_t ramBank;
+		uint8_t deviceID;
+		bool dmaSwitch;
+		uint8_t staticRAM[0x2000];
+		uint8_t reg[16];
+		uint8_t * hdData;
 
+		// SCSI bus & 5380 state
+		bool DATA_BUS;
+		bool DMA_MODE;
+		bool BSY;
+		bool ATN;
+		bool SEL;
+		bool ACK;
+		bool RST;
+		bool MSG;
+		bool C_D;
+		bool I_O;
+		bool REQ;
+		bool DEV_BSY;
+		bool DRQ;
+		bool DACK;
+		uint8_t devMode;
+		uint8_t cmdLength;
+		uint8_t cmd[256];
+		uint32_t bytesToSend;
+		uint8_t * buf;
+		uint32_t bufPtr;
+		uint8_t response;
+};
+
+// Exported variables
+extern HardDrive hardDrive[];
+
+#endif	// __HARDDRIVE_H__
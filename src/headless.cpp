@@ -0,0 +1,660 @@
+//
+// Apple 2 headless batch runner
+//
+// Boots a disk image or a saved state, runs it for a fixed number of frames
+// (or cycles) as fast as the host will go, then dumps RAM, the text screen
+// and a rendered framebuffer to files. No window, no audio, no throttling--
+// this is for unattended regression & throughput runs.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "apple2.h"
+#include "floppydrive.h"
+#include "log.h"
+#include "machine.h"
+#include "mmu.h"
+#include "profile.h"
+#include "settings.h"
+#include "trace.h"
+#include "video.h"
+#include "watch.h"
+
+
+// Global variables (exported)
+
+Settings settings;				// No config file; see the command line below
+
+// Local variables
+
+static uint32_t frameBuffer[VIRTUAL_SCREEN_WIDTH * VIRTUAL_SCREEN_HEIGHT];
+static uint16_t textLineAddr[24] = {
+	0x0400, 0x0480, 0x0500, 0x0580, 0x0600, 0x0680, 0x0700, 0x0780,
+	0x0428, 0x04A8, 0x0528, 0x05A8, 0x0628, 0x06A8, 0x0728, 0x07A8,
+	0x0450, 0x04D0, 0x0550, 0x05D0, 0x0650, 0x06D0, 0x0750, 0x07D0 };
+
+// Local functions
+
+static bool DumpRAM(const char * filename);
+static bool DumpScreenText(const char * filename);
+static bool DumpFrameBuffer(const char * filename);
+static bool ParseWatch(const char * spec, uint8_t action);
+static void BenchmarkVideo(uint32_t frames);
+static void BenchmarkSwitches(uint32_t flips);
+static double Now(void);
+
+
+//
+// Host functions the core expects the front end to supply. With no host to
+// talk to, these don't do much.
+//
+void ToggleSpeaker(void)
+{
+}
+
+
+void WriteSampleToBuffer(void)
+{
+}
+
+
+void SpawnMessage(const char * text, ...)
+{
+	static char message[4096];
+	va_list arg;
+
+	va_start(arg, text);
+	vsprintf(message, text, arg);
+	va_end(arg);
+
+	WriteLog("Message: %s\n", message);
+}
+
+
+static void Usage(const char * name)
+{
+	printf("Usage: %s [options] [disk image [disk image]]\n\n", name);
+	printf("  -f <frames>  Number of frames to run (default: 600)\n");
+	printf("  -c <cycles>  Number of cycles to run (overrides -f)\n");
+	printf("  -s <file>    Load a saved state before running\n");
+	printf("  -h <file>    Hard drive image for the SCSI card in slot 7\n");
+	printf("  -m <mode>    CPU core: interp, cached (default), jit or diff (jit checked\n");
+	printf("               against interp)\n");
+	printf("  -i <0|1>     Fast-forward idle loops (default: 1)\n");
+	printf("  -r <banks>   64K banks of aux memory, up to 128 (default: 1)\n");
+	printf("  -p <0|1>     Profile the code that runs (default: 0)\n");
+	printf("  -t <0|1>     Trace execution (default: 0)\n");
+	printf("  -a <0|1>     Check the CPU's ALU & flags against the reference, then quit\n");
+	printf("  -b <0|1>     Check the floating bus' scanner tables against the display\n");
+	printf("               memory layout, then quit\n");
+	printf("  -v <frames>  Time the renderer in each video mode, then quit\n");
+	printf("  -x <flips>   Time the memory soft switches, then quit\n");
+	printf("  -w <watch>   Stop when memory is accessed (can be used more than once)\n");
+	printf("  -W <watch>   Trace memory accesses (can be used more than once)\n");
+	printf("  -o <prefix>  Prefix for output files (default: apple2)\n\n");
+	printf("A watch is [rwx]+:<start>[-<end>][@<bank>], e.g. w:$400-$7FF@aux or\n");
+	printf("x:0xFDED; the bank is one of main, aux, lc1, lc2, rom, slot or io\n");
+	printf("(default: any of them).\n\n");
+	printf("Writes <prefix>.ram (main + aux RAM), <prefix>.txt (text screen)\n");
+	printf("and <prefix>.ppm (rendered frame) when done. With profiling on, it\n");
+	printf("also writes <prefix>.prof (flat profile), <prefix>.csv (by address),\n");
+	printf("<prefix>-ops.csv (by opcode) and <prefix>.json (all of the above).\n");
+	printf("With tracing on, the last %u records of the trace go in <prefix>.trace\n", TRACE_SIZE);
+	printf("(see apple2-tracedump); so do the accesses -W watches see, with or\n");
+	printf("without tracing.\n");
+}
+
+
+int main(int argc, char * argv[])
+{
+	uint64_t frames = 600, cycles = 0;
+	const char * stateFile = NULL;
+	const char * outPrefix = "apple2";
+	const char * diskImage[2] = { NULL, NULL };
+	int numImages = 0;
+	bool profile = false;
+	bool trace = false;
+	bool checkALU = false;
+	bool checkBus = false;
+	uint32_t videoFrames = 0;
+	uint32_t switchFlips = 0;
+	bool traceWatches = false;
+	const char * watchSpec[WATCH_MAX];
+	uint8_t watchAction[WATCH_MAX];
+	int numWatches = 0;
+
+	memset(&settings, 0, sizeof(settings));
+	settings.cpuMode = V65C02_MODE_CACHED;
+	settings.skipIdleLoops = true;
+	settings.auxBanks = 1;
+
+	for(int i=1; i<argc; i++)
+	{
+		if ((argv[i][0] == '-') && (argv[i][1] != 0) && (argv[i][2] == 0)
+			&& (i + 1 < argc))
+		{
+			switch (argv[i][1])
+			{
+			case 'f': frames = strtoull(argv[++i], NULL, 0); break;
+			case 'c': cycles = strtoull(argv[++i], NULL, 0); break;
+			case 's': stateFile = argv[++i]; break;
+			case 'h': strncpy(settings.hd[0], argv[++i], MAX_PATH); break;
+			case 'o': outPrefix = argv[++i]; break;
+			case 'i': settings.skipIdleLoops = (atoi(argv[++i]) != 0); break;
+			case 'r': settings.auxBanks = strtoul(argv[++i], NULL, 0); break;
+			case 'p': profile = (atoi(argv[++i]) != 0); break;
+			case 't': trace = (atoi(argv[++i]) != 0); break;
+			case 'a': checkALU = (atoi(argv[++i]) != 0); break;
+			case 'b': checkBus = (atoi(argv[++i]) != 0); break;
+			case 'v': videoFrames = strtoul(argv[++i], NULL, 0); break;
+			case 'x': switchFlips = strtoul(argv[++i], NULL, 0); break;
+			case 'w':
+			case 'W':
+				if (numWatches == WATCH_MAX)
+				{
+					printf("Too many watches (max is %u)!\n", WATCH_MAX);
+					return -1;
+				}
+
+				watchAction[numWatches] = (argv[i][1] == 'w' ? WATCH_BREAK : WATCH_TRACE);
+				watchSpec[numWatches++] = argv[++i];
+				traceWatches |= (argv[i - 1][1] == 'W');
+				break;
+			case 'm':
+				i++;
+
+				if (strcmp(argv[i], "interp") == 0)
+					settings.cpuMode = V65C02_MODE_INTERPRET;
+				else if (strcmp(argv[i], "cached") == 0)
+					settings.cpuMode = V65C02_MODE_CACHED;
+				else if (strcmp(argv[i], "jit") == 0)
+					settings.cpuMode = V65C02_MODE_JIT;
+				else if (strcmp(argv[i], "diff") == 0)
+					settings.cpuMode = V65C02_MODE_DIFF;
+				else
+				{
+					Usage(argv[0]);
+					return -1;
+				}
+
+				break;
+			default:
+				Usage(argv[0]);
+				return -1;
+			}
+		}
+		else if ((argv[i][0] != '-') && (numImages < 2))
+			diskImage[numImages++] = argv[i];
+		else
+		{
+			Usage(argv[0]);
+			return -1;
+		}
+	}
+
+	InitLog("./apple2-headless.log");
+
+	if (checkALU)
+	{
+		uint32_t mismatches = Check65C02ALU();
+		printf("ALU check: %u mismatches\n", mismatches);
+		LogDone();
+
+		return (mismatches == 0 ? 0 : -1);
+	}
+
+	InitApple2();
+	SetupBlurTable();
+
+	if (checkBus)
+	{
+		uint32_t mismatches = CheckFloatingBus();
+		printf("Floating bus check: %u mismatches\n", mismatches);
+		LogDone();
+
+		return (mismatches == 0 ? 0 : -1);
+	}
+
+	for(int i=0; i<numImages; i++)
+	{
+		if (!floppyDrive[0].LoadImage(diskImage[i], i))
+		{
+			printf("Could not load disk image \"%s\"!\n", diskImage[i]);
+			return -1;
+		}
+	}
+
+	if (stateFile && !LoadApple2State(stateFile))
+	{
+		printf("Could not load state file \"%s\"!\n", stateFile);
+		return -1;
+	}
+
+	if (videoFrames)
+	{
+		BenchmarkVideo(videoFrames);
+		LogDone();
+
+		return 0;
+	}
+
+	if (switchFlips)
+	{
+		BenchmarkSwitches(switchFlips);
+		LogDone();
+
+		return 0;
+	}
+
+	if (cycles == 0)
+		cycles = frames * CYCLES_PER_FRAME;
+
+	if (profile && !StartProfile())
+	{
+		printf("Could not allocate memory for the profile!\n");
+		return -1;
+	}
+
+	for(int i=0; i<numWatches; i++)
+	{
+		if (!ParseWatch(watchSpec[i], watchAction[i]))
+		{
+			printf("Bad watch \"%s\"!\n\n", watchSpec[i]);
+			Usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (trace || traceWatches)
+		ClearTrace();
+
+	dumpDis = trace;
+
+	// Run whole frames for as long as we can, then finish up with whatever's
+	// left over (a watch going off cuts it short)
+	uint64_t startClock = mainCPU.clock;
+	clock_t startTime = clock();
+	WatchHit hit;
+	bool stopped = false;
+
+	while ((cycles >= CYCLES_PER_FRAME) && !stopped)
+	{
+		// (As many as will fit in the 32-bit cycle count Execute65C02 takes)
+		uint64_t run = cycles / CYCLES_PER_FRAME;
+
+		if (run > 0x10000)
+			run = 0x10000;
+
+		RunApple2Frame((uint32_t)run);
+		cycles -= run * CYCLES_PER_FRAME;
+		stopped = GetWatchHit(&hit);
+	}
+
+	if ((cycles > 0) && !stopped)
+	{
+		Execute65C02(&mainCPU, (uint32_t)cycles);
+		stopped = GetWatchHit(&hit);
+	}
+
+	double seconds = (double)(clock() - startTime) / (double)CLOCKS_PER_SEC;
+	dumpDis = false;
+	uint64_t ran = mainCPU.clock - startClock;
+
+	printf("Ran %llu cycles in %.3lf s", (unsigned long long)ran, seconds);
+
+	if (seconds > 0)
+		printf(" (%.2lf MHz, %.1lfx)", (double)ran / seconds / 1000000.0,
+			(double)ran / seconds / 1020484.32);
+
+	printf("\n");
+
+	if (stopped)
+	{
+		char buf[256];
+		printf("Stopped by %s\n", DescribeWatchHit(hit, buf));
+	}
+
+	if (codeCache.idle.skipped > 0)
+		printf("Skipped %llu cycles of idle loops (%.1lf%%)\n",
+			(unsigned long long)codeCache.idle.skipped,
+			(double)codeCache.idle.skipped * 100.0 / (double)ran);
+
+	if (codeCache.mode == V65C02_MODE_DIFF)
+		printf("Translated blocks checked: %llu, mismatches: %u\n",
+			(unsigned long long)codeCache.checked, codeCache.mismatches);
+
+	char filename[MAX_PATH + 1];
+	bool ok = (codeCache.mismatches == 0);
+
+	snprintf(filename, MAX_PATH, "%s.ram", outPrefix);
+	ok &= DumpRAM(filename);
+	snprintf(filename, MAX_PATH, "%s.txt", outPrefix);
+	ok &= DumpScreenText(filename);
+	snprintf(filename, MAX_PATH, "%s.ppm", outPrefix);
+	ok &= DumpFrameBuffer(filename);
+
+	if (profile)
+	{
+		snprintf(filename, MAX_PATH, "%s.prof", outPrefix);
+		ok &= SaveFlatProfile(filename);
+		snprintf(filename, MAX_PATH, "%s.csv", outPrefix);
+		ok &= SaveProfileCSV(filename);
+		snprintf(filename, MAX_PATH, "%s-ops.csv", outPrefix);
+		ok &= SaveOpcodeCSV(filename);
+		snprintf(filename, MAX_PATH, "%s.json", outPrefix);
+		ok &= SaveProfileJSON(filename);
+		StopProfile();
+	}
+
+	if (trace || traceWatches)
+	{
+		snprintf(filename, MAX_PATH, "%s.trace", outPrefix);
+		ok &= SaveTrace(filename);
+	}
+
+	LogDone();
+
+	return (ok ? 0 : -1);
+}
+
+
+//
+// Write out main RAM followed by auxillary RAM (128K total)
+//
+static bool DumpRAM(const char * filename)
+{
+	FILE * file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		printf("Could not open \"%s\" for writing!\n", filename);
+		return false;
+	}
+
+	fwrite(ram, 1, 0x10000, file);
+	fwrite(ram2, 1, 0x10000, file);
+	fclose(file);
+
+	return true;
+}
+
+
+//
+// Convert an Apple screen code into printable ASCII (inverse & flashing
+// characters come out as their normal counterparts)
+//
+static char ScreenCodeToASCII(uint8_t code)
+{
+	uint8_t c = code & 0x7F;
+
+	// $00-$7F are inverse/flashing (or MouseText & inverse lowercase with
+	// ALTCHARSET on), $80-$FF are normal
+	if ((code < 0x80) && !(alternateCharset && (code >= 0x60)))
+		c &= 0x3F;
+
+	if (c < 0x20)
+		c += 0x40;
+
+	return (char)c;
+}
+
+
+//
+// Write out the text page as 24 lines of 40 (or 80) characters
+//
+static bool DumpScreenText(const char * filename)
+{
+	FILE * file = fopen(filename, "w");
+
+	if (!file)
+	{
+		printf("Could not open \"%s\" for writing!\n", filename);
+		return false;
+	}
+
+	uint16_t page = (displayPage2 && !store80Mode ? 0x0400 : 0x0000);
+
+	for(int line=0; line<24; line++)
+	{
+		uint16_t address = textLineAddr[line] + page;
+
+		for(int x=0; x<40; x++)
+		{
+			if (col80Mode)
+				fputc(ScreenCodeToASCII(ram2[address + x]), file);
+
+			fputc(ScreenCodeToASCII(ram[address + x]), file);
+		}
+
+		fputc('\n', file);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+
+//
+// Time how long the renderer takes to draw a whole frame (not just the lines
+// that changed) in each video mode, on each kind of screen. Without a saved
+// state to show, display memory gets filled with junk so there's something
+// to draw.
+//
+static void BenchmarkVideo(uint32_t frames)
+{
+	struct { const char * name; bool text, mixed, hires, dhires, col80; } mode[] = {
+		{ "40 column text", true, false, false, false, false },
+		{ "80 column text", true, false, false, false, true },
+		{ "Lo-res", false, false, false, false, false },
+		{ "Double lo-res", false, false, false, true, true },
+		{ "Hi-res", false, false, true, false, false },
+		{ "Double hi-res", false, false, true, true, true },
+		{ "Hi-res + text", false, true, true, false, false }
+	};
+	const char * screen[3] = { "Color TV", "White mono", "Green mono" };
+
+	if (!ram[0x2000] && !ram[0x0400])
+	{
+		srand(1);
+
+		for(uint32_t i=0x0400; i<0x6000; i++)
+		{
+			ram[i] = rand();
+			ram2[i] = rand();
+		}
+
+		MarkVideoDirty();
+	}
+
+	printf("Nanoseconds per frame (%u frames each):\n\n%-16s", frames, "");
+
+	for(int i=0; i<3; i++)
+		printf("%12s", screen[i]);
+
+	printf("\n");
+
+	for(uint32_t i=0; i<sizeof(mode)/sizeof(mode[0]); i++)
+	{
+		textMode = mode[i].text;
+		mixedMode = mode[i].mixed;
+		hiRes = mode[i].hires;
+		dhires = mode[i].dhires;
+		col80Mode = mode[i].col80;
+		printf("%-16s", mode[i].name);
+
+		// Goes thru all the screen types, & ends up back where it started
+		for(int j=0; j<3; j++)
+		{
+			double startTime = Now();
+
+			for(uint32_t k=0; k<frames; k++)
+			{
+				InvalidateVideo();
+				RenderVideoFrame(frameBuffer);
+			}
+
+			double seconds = Now() - startTime;
+			printf("%12.0lf", seconds * 1.0e9 / (double)frames);
+			CycleScreenTypes();
+		}
+
+		printf("\n");
+	}
+}
+
+
+//
+// Time flipping each of the soft switches that remap memory, on & off again
+// through AppleWriteMem() like the CPU does, with aux bank 0 selected and
+// (if the card has more than one) with bank 1.
+//
+static void BenchmarkSwitches(uint32_t flips)
+{
+	struct { const char * name; uint16_t on, off; } flip[] = {
+		{ "RAMRD", 0xC003, 0xC002 },
+		{ "RAMWRT", 0xC005, 0xC004 },
+		{ "ALTZP", 0xC009, 0xC008 },
+		{ "80STORE", 0xC001, 0xC000 },
+		{ "PAGE2", 0xC055, 0xC054 },			// (With 80STORE on)
+		{ "HIRES", 0xC057, 0xC056 },			// (Likewise)
+		{ "LC bank", 0xC08B, 0xC081 }
+	};
+	uint32_t banks = (settings.auxBanks > 1 ? 2 : 1);
+
+	printf("Millions of switch flips per second (%u flips each):\n\n%-16s", flips, "");
+
+	for(uint32_t bank=0; bank<banks; bank++)
+		printf("      Bank %u", bank);
+
+	printf("\n");
+
+	for(uint32_t i=0; i<sizeof(flip)/sizeof(flip[0]); i++)
+	{
+		printf("%-16s", flip[i].name);
+
+		for(uint32_t bank=0; bank<banks; bank++)
+		{
+			AppleWriteMem(0xC073, bank);
+			AppleWriteMem(0xC001, 0);
+			double startTime = Now();
+
+			// Each pass is two flips
+			for(uint32_t j=0; j<flips; j+=2)
+			{
+				AppleWriteMem(flip[i].on, 0);
+				AppleWriteMem(flip[i].off, 0);
+			}
+
+			double seconds = Now() - startTime;
+			printf("%12.1lf", (seconds > 0 ? (double)flips / seconds / 1.0e6 : 0.0));
+		}
+
+		printf("\n");
+	}
+
+	AppleWriteMem(0xC073, 0);
+	AppleWriteMem(0xC000, 0);
+}
+
+
+//
+// Seconds on the monotonic clock (for timing things, so only differences
+// mean anything)
+//
+static double Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec * 1.0e-9;
+}
+
+
+//
+// Write out the rendered screen as a binary PPM
+//
+static bool DumpFrameBuffer(const char * filename)
+{
+	FILE * file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		printf("Could not open \"%s\" for writing!\n", filename);
+		return false;
+	}
+
+	RenderVideoFrame(frameBuffer);
+	fprintf(file, "P6\n%d %d\n255\n", VIRTUAL_SCREEN_WIDTH, VIRTUAL_SCREEN_HEIGHT);
+
+	// Pixels are stored as RGBA bytes (see the palettes in video.cpp)
+	uint8_t * pixel = (uint8_t *)frameBuffer;
+
+	for(int i=0; i<VIRTUAL_SCREEN_WIDTH * VIRTUAL_SCREEN_HEIGHT; i++, pixel+=4)
+		fwrite(pixel, 1, 3, file);
+
+	fclose(file);
+
+	return true;
+}
+
+
+//
+// Turn [rwx]+:<start>[-<end>][@<bank>] into a watch (see Usage())
+//
+static bool ParseWatch(const char * spec, uint8_t action)
+{
+	uint8_t type = 0;
+	uint8_t bank = WATCH_ANY_BANK;
+
+	for(; *spec && (*spec != ':'); spec++)
+	{
+		switch (*spec)
+		{
+		case 'r': type |= WATCH_READ; break;
+		case 'w': type |= WATCH_WRITE; break;
+		case 'x': type |= WATCH_EXEC; break;
+		default:  return false;
+		}
+	}
+
+	if ((type == 0) || (*spec++ != ':'))
+		return false;
+
+	// Take $xxxx as hex too, since that's how everything else writes it
+	char * end;
+	uint32_t start = strtoul((*spec == '$' ? spec + 1 : spec), &end, (*spec == '$' ? 16 : 0));
+	uint32_t last = start;
+
+	if (*end == '-')
+	{
+		spec = end + 1;
+		last = strtoul((*spec == '$' ? spec + 1 : spec), &end, (*spec == '$' ? 16 : 0));
+	}
+
+	if (*end == '@')
+	{
+		for(bank=0; bank<NUM_BANKS; bank++)
+		{
+			if (strcmp(end + 1, bankName[bank]) == 0)
+				break;
+		}
+
+		if (bank == NUM_BANKS)
+			return false;
+	}
+	else if (*end != 0)
+		return false;
+
+	if ((start > 0xFFFF) || (last > 0xFFFF))
+		return false;
+
+	return (AddWatch(start, last, type, bank, action) >= 0);
+}
+
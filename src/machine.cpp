@@ -0,0 +1,547 @@
+//
+// machine.cpp: Apple //e machine core
+//
+// This is everything needed to run the machine proper (CPU, memory, soft
+// switches, slot cards) without a host window, audio device or event loop
+// attached to it; the SDL front end (apple2.cpp) and the headless runner
+// (headless.cpp) are both built on top of it.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "machine.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "apple2.h"
+#include "firmware/apple2e-enh.h"
+#include "floppydrive.h"
+#include "harddrive.h"
+#include "log.h"
+#include "mmu.h"
+#include "mockingboard.h"
+#include "profile.h"
+#include "settings.h"
+#include "slotcard.h"
+#include "sound.h"
+#include "timing.h"
+#include "v65c02core.h"
+
+
+// Global variables (exported)
+
+uint8_t ram[0x10000], rom[0x10000];			// RAM & ROM spaces
+uint8_t ram2[0x10000];						// Auxillary RAM
+V65C02REGS mainCPU;							// v65C02 execution context
+uint8_t appleType = APPLE_TYPE_IIE;
+uint64_t frameCycleStart;
+
+uint8_t lastKeyPressed = 0;
+bool keyDown = false;
+bool openAppleDown = false;
+bool closedAppleDown = false;
+bool resetKeyDown = false;
+bool store80Mode = false;
+bool intCXROM = false;
+bool slotC3ROM = false;
+bool intC8ROM = false;
+bool ramrd = false;
+bool ramwrt = false;
+bool altzp = false;
+bool ioudis = true;
+bool dhires = false;
+// Language card state (ROM read, no write)
+uint8_t lcState = 0x02;
+
+// Video soft switches
+bool flash = false;
+bool textMode = true;
+bool mixedMode = false;
+bool displayPage2 = false;
+bool hiRes = false;
+bool alternateCharset = false;
+bool col80Mode = false;
+
+// Local variables
+
+// Devices that have to do something at a certain cycle (an interrupt, say)
+// get the CPU to stop & run them at the earliest of those; everything else
+// only gets run when the CPU touches it (see SyncDevices()).
+static uint64_t busDeadline = 0;
+
+// 21.26009 cycles per sample @ 48000 (running @ 1,020,484.32 Hz), as 16.16
+// fixed point; sampleTime is when the next one is due, in the same units
+#define SAMPLE_PERIOD		1393301
+static uint64_t sampleTime = SAMPLE_PERIOD;
+
+// Local functions
+
+static void AppleTimer(uint16_t);
+static void VBLEdge(void *);
+
+
+//
+// Bus policy for the 65C02 core. Going through the page table here (instead
+// of through AppleReadMem/AppleWriteMem) lets RAM & ROM accesses get inlined
+// into the opcode handlers. Anything that goes to an I/O handler could flip
+// a bank switch, so it ends the current pre-decoded block (unless it's a read
+// of one of the $C0xx locations that can't; see ReadIO()).
+//
+struct AppleBus
+{
+	static inline uint8_t Read(V65C02REGS *, uint16_t address)
+	{
+		MemoryPage * page = &memPage[address >> 8];
+
+		if (page->read)
+			return page->read[address & 0xFF];
+
+		codeCache.stop = true;
+		return (*(page->readFunc))(address);
+	}
+
+	static inline void Write(V65C02REGS *, uint16_t address, uint8_t byte)
+	{
+		MemoryPage * page = &memPage[address >> 8];
+
+		if (page->write)
+		{
+			VideoWrite(&page->write[address & 0xFF], byte);
+			page->write[address & 0xFF] = byte;
+			codeCache.Written(&page->write[address & 0xFF]);
+		}
+		else
+		{
+			codeCache.stop = true;
+			(*(page->writeFunc))(address, byte);
+		}
+	}
+
+	static inline uint64_t Deadline(V65C02REGS *)
+	{
+		return busDeadline;
+	}
+
+	static inline void Tick(V65C02REGS *, uint32_t)
+	{
+		SyncDevices();
+	}
+
+	static inline const uint8_t * Code(V65C02REGS *, uint16_t address)
+	{
+		uint8_t * page = memPage[address >> 8].read;
+		return (page ? page + (address & 0xFF) : 0);
+	}
+
+	static inline bool Polled(V65C02REGS *, uint16_t address)
+	{
+		return PolledAddress(address);
+	}
+
+	static inline V65C02BlockCache * Cache(V65C02REGS *)
+	{
+		return &codeCache;
+	}
+
+	static inline V65C02Profile * Profile(V65C02REGS *)
+	{
+		return cpuProfile;
+	}
+
+	static inline uint8_t Bank(V65C02REGS *, uint16_t address)
+	{
+		return MemoryBank(address);
+	}
+
+	static inline uint16_t Banks(V65C02REGS *)
+	{
+		return MMUState();
+	}
+
+	static inline const V65C02PageMap * PageMap(V65C02REGS *)
+	{
+		static const V65C02PageMap map = { (void * const *)&memPage,
+			sizeof(MemoryPage), offsetof(MemoryPage, read) };
+
+		return &map;
+	}
+};
+
+
+//
+// Set up memory, slots & CPU for a cold start
+//
+void InitApple2(void)
+{
+	// Zero out memory
+	memset(ram, 0, 0x10000);
+	memset(rom, 0, 0x10000);
+	memset(ram2, 0, 0x10000);
+
+	// Set up MMU
+	SetupAddressMap();
+	SetAuxBanks(settings.auxBanks);
+	ResetMMUPointers();
+	codeCache.mode = (settings.cpuMode <= V65C02_MODE_DIFF ? settings.cpuMode
+		: V65C02_MODE_CACHED);
+
+	if ((codeCache.mode >= V65C02_MODE_JIT) && !V65C02JitInit(&codeCache))
+	{
+		WriteLog("Apple2: Can't translate 65C02 code here, using the block cache instead.\n");
+		codeCache.mode = V65C02_MODE_CACHED;
+	}
+
+	codeCache.skipIdle = settings.skipIdleLoops;
+	codeCache.Flush();
+	MarkVideoDirty();
+
+	// Set up V65C02 execution context
+	memset(&mainCPU, 0, sizeof(V65C02REGS));
+	mainCPU.RdMem = AppleReadMem;
+	mainCPU.WrMem = AppleWriteMem;
+	mainCPU.Timer = AppleTimer;
+	mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
+	sampleTime = SAMPLE_PERIOD;
+	busDeadline = 0;
+	InitializeEventList();
+	ScheduleEvent(VBL_START, VBLEdge);
+
+	// Install devices in slots
+	InstallSlotCard(SLOT4, &mb[0]);
+	InstallSlotCard(SLOT6, &floppyDrive[0]);
+	hardDrive[0].LoadImage(settings.hd[0]);
+	InstallSlotCard(SLOT7, &hardDrive[0]);
+
+	memcpy(rom + 0xC000, apple2eEnhROM, 0x4000);
+}
+
+
+const uint8_t stateHeader[19] = "APPLE2SAVESTATE1.6";
+void SaveApple2State(const char * filename)
+{
+	WriteLog("Main: Saving Apple2 state...\n");
+	FILE * file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		WriteLog("Could not open file \"%s\" for writing!\n", filename);
+		return;
+	}
+
+	// Write out header, how much aux memory there is, and what's in each slot
+	fwrite(stateHeader, 1, 18, file);
+	fputc(AuxBanks(), file);
+
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		SlotCard * card = GetSlotCard(slot);
+		fputc((card ? card->type : CARD_NONE), file);
+	}
+
+	// Write out CPU state
+	fwrite(&mainCPU, 1, sizeof(mainCPU), file);
+
+	// Write out main memory
+	fwrite(ram, 1, 0x10000, file);
+	fwrite(ram2, 1, 0x10000, file);
+	SaveAuxMemory(file);
+
+	// Write out state variables
+	fputc((uint8_t)keyDown, file);
+	fputc((uint8_t)openAppleDown, file);
+	fputc((uint8_t)closedAppleDown, file);
+	fputc((uint8_t)store80Mode, file);
+	fputc((uint8_t)VBL(), file);
+	fputc((uint8_t)intCXROM, file);
+	fputc((uint8_t)slotC3ROM, file);
+	fputc((uint8_t)intC8ROM, file);
+	fputc((uint8_t)ramrd, file);
+	fputc((uint8_t)ramwrt, file);
+	fputc((uint8_t)altzp, file);
+	fputc((uint8_t)ioudis, file);
+	fputc((uint8_t)dhires, file);
+	fputc((uint8_t)flash, file);
+	fputc((uint8_t)textMode, file);
+	fputc((uint8_t)mixedMode, file);
+	fputc((uint8_t)displayPage2, file);
+	fputc((uint8_t)hiRes, file);
+	fputc((uint8_t)alternateCharset, file);
+	fputc((uint8_t)col80Mode, file);
+	fputc(lcState, file);
+
+	// Write out the slot cards' state
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		if (GetSlotCard(slot))
+			GetSlotCard(slot)->SaveState(file);
+	}
+
+	fclose(file);
+}
+
+
+bool LoadApple2State(const char * filename)
+{
+	WriteLog("Main: Loading Apple2 state...\n");
+	FILE * file = fopen(filename, "rb");
+
+	if (!file)
+	{
+		WriteLog("Could not open file \"%s\" for reading!\n", filename);
+		return false;
+	}
+
+	uint8_t buffer[18];
+	fread(buffer, 1, 18, file);
+
+	// Sanity check...
+	if (memcmp(buffer, stateHeader, 18) != 0)
+	{
+		fclose(file);
+		WriteLog("File \"%s\" is not a valid Apple2 save state file!\n", filename);
+		return false;
+	}
+
+	// It has to be the same amount of aux memory, and the same cards in the
+	// same slots, as when the state was saved; this gets checked before
+	// anything is touched, so a state that doesn't fit leaves the machine as
+	// it was
+	if ((uint32_t)fgetc(file) != AuxBanks())
+	{
+		fclose(file);
+		WriteLog("File \"%s\" has a different amount of aux memory!\n", filename);
+		return false;
+	}
+
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		SlotCard * card = GetSlotCard(slot);
+		uint8_t type = fgetc(file);
+
+		if (type != (card ? card->type : CARD_NONE))
+		{
+			fclose(file);
+			WriteLog("File \"%s\" has a different card in slot #%u!\n", filename, slot);
+			return false;
+		}
+	}
+
+	// Read CPU state
+	uint64_t oldClock = mainCPU.clock;
+	fread(&mainCPU, 1, sizeof(mainCPU), file);
+
+	// Read main memory
+	fread(ram, 1, 0x10000, file);
+	fread(ram2, 1, 0x10000, file);
+	codeCache.Flush();
+	MarkVideoDirty();
+
+	LoadAuxMemory(file);
+
+	// Read in state variables
+	keyDown = (bool)fgetc(file);
+	openAppleDown = (bool)fgetc(file);
+	closedAppleDown = (bool)fgetc(file);
+	store80Mode = (bool)fgetc(file);
+	fgetc(file);				// VBL (goes by the clock now)
+	intCXROM = (bool)fgetc(file);
+	slotC3ROM = (bool)fgetc(file);
+	intC8ROM = (bool)fgetc(file);
+	ramrd = (bool)fgetc(file);
+	ramwrt = (bool)fgetc(file);
+	altzp = (bool)fgetc(file);
+	ioudis = (bool)fgetc(file);
+	dhires = (bool)fgetc(file);
+	flash = (bool)fgetc(file);
+	textMode = (bool)fgetc(file);
+	mixedMode = (bool)fgetc(file);
+	displayPage2 = (bool)fgetc(file);
+	hiRes = (bool)fgetc(file);
+	alternateCharset = (bool)fgetc(file);
+	col80Mode = (bool)fgetc(file);
+	lcState = fgetc(file);
+
+	// Read in the slot cards' state
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		if (GetSlotCard(slot))
+			GetSlotCard(slot)->LoadState(file);
+	}
+
+	fclose(file);
+
+	// Make sure things are in a sane state before execution :-P
+	mainCPU.RdMem = AppleReadMem;
+	mainCPU.WrMem = AppleWriteMem;
+	mainCPU.Timer = AppleTimer;
+	ResetMMUPointers();
+	sampleTime = (mainCPU.clock << 16) + SAMPLE_PERIOD;
+	busDeadline = 0;
+	OffsetEvents((int64_t)(mainCPU.clock - oldClock));
+
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		if (GetSlotCard(slot))
+			GetSlotCard(slot)->Schedule();
+	}
+
+	return true;
+}
+
+
+void ResetApple2State(void)
+{
+	keyDown = false;
+	openAppleDown = false;
+	closedAppleDown = false;
+	store80Mode = false;
+	intCXROM = false;
+	slotC3ROM = false;
+	intC8ROM = false;
+	ramrd = false;
+	ramwrt = false;
+	altzp = false;
+	ioudis = true;
+	dhires = false;
+	lcState = 0x02;
+	ResetAuxMemory();
+	ResetMMUPointers();
+
+	for(uint8_t slot=SLOT1; slot<=SLOT7; slot++)
+	{
+		if (GetSlotCard(slot))
+			GetSlotCard(slot)->Reset();
+	}
+
+	// Without this, you can wedge the system :-/
+	memset(ram, 0, 0x10000);
+	memset(ram2, 0, 0x10000);
+	codeCache.Flush();
+	MarkVideoDirty();
+	mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
+}
+
+
+//
+// Run one or more NTSC frames' worth of cycles (262 lines of 65 cycles each)
+// in one go. Nothing has to happen at the line boundaries: where the beam is
+// (and so VBL & the floating bus) follows from the CPU's clock; see
+// FrameCycle().
+//
+void RunApple2Frame(uint32_t frames/*= 1*/)
+{
+	// There are exactly 800 slices of 21.333 cycles per frame, so it works
+	// out evenly.
+	// [Actually, seems it's 786 slices of 21.666 cycles per frame]
+
+	// Set our frame cycle counter to the correct # of cycles at the start
+	// of this frame
+	frameCycleStart = mainCPU.clock - mainCPU.overflow;
+
+	// If the CTRL+Reset key combo is being held, make sure the RESET line
+	// stays asserted:
+	if (resetKeyDown)
+		mainCPU.cpuFlags |= V65C02_ASSERT_LINE_RESET;
+
+	Execute65C02<AppleBus>(&mainCPU, CYCLES_PER_FRAME * frames);
+}
+
+
+//
+// # of cycles since the start of the current frame; the 65th cycle of each
+// line is a long one (14 + 2 ticks of the 14.318 MHz clock), but it's still
+// only one CPU cycle, so there are always 65 to a line.
+//
+uint32_t FrameCycle(void)
+{
+	return (uint32_t)((mainCPU.clock - frameCycleStart) % CYCLES_PER_FRAME);
+}
+
+
+//
+// According to "Understanding The Apple IIe", VBL is asserted after the last
+// byte of the screen is read and let go on the first read of the first byte
+// of the screen. We now know that the screen starts on line #6 and ends on
+// line #197 (of the vertical counter--actual VBLANK proper happens on lines
+// 230 thru 233). N.B.: This returns true when *not* in VBL, which is what
+// $C019 reads as.
+//
+bool VBL(void)
+{
+	uint32_t cycle = FrameCycle();
+
+	return ((cycle >= VBL_START) && (cycle < VBL_END));
+}
+
+
+//
+// Nothing has to be done when VBL changes, but a loop polling it looks just
+// like one waiting on something that can't change while the CPU's running,
+// so the CPU has to be made to stop there (see IdleSkip() in v65c02core.h).
+//
+static void VBLEdge(void *)
+{
+	uint32_t cycle = FrameCycle();
+	uint32_t next = (cycle < VBL_START ? VBL_START
+		: (cycle < VBL_END ? VBL_END : CYCLES_PER_FRAME + VBL_START));
+
+	ScheduleEvent(mainCPU.clock - cycle + next, VBLEdge);
+}
+
+
+//
+// Catch the samples up to the CPU's clock and run any events that have come
+// due (see timing.h); slot cards that have something to do by a certain
+// cycle get an event for it (see SlotCard::Schedule()), and the rest only
+// get run when the CPU touches them.
+//
+void SyncDevices(void)
+{
+	SyncSamples();
+	HandleEvents(mainCPU.clock);
+	busDeadline = GetNextEventTime();
+}
+
+
+//
+// Make sure the CPU comes back to run the devices by clock. Translated code
+// only checks the deadline before it starts a block, so an access that moves
+// it up ends the block too.
+//
+void SetDeadline(uint64_t clock)
+{
+	if (clock < busDeadline)
+	{
+		busDeadline = clock;
+		codeCache.stop = true;
+	}
+}
+
+
+//
+// Write out every sample that's come due up to the CPU's clock; anything that
+// changes what the samples sound like (the speaker, the AYs) has to call this
+// first.
+//
+void SyncSamples(void)
+{
+	uint64_t now = mainCPU.clock << 16;
+
+	while (sampleTime <= now)
+	{
+		WriteSampleToBuffer();
+		sampleTime += SAMPLE_PERIOD;
+	}
+}
+
+
+//
+// For running through the RdMem/WrMem/Timer pointers (see v65c02.cpp), which
+// calls this after every instruction
+//
+static void AppleTimer(uint16_t)
+{
+	SyncDevices();
+}
@@ -0,0 +1,47 @@
+//
+// machine.h: Apple //e machine core
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __MACHINE_H__
+#define __MACHINE_H__
+
+#include <stdint.h>
+
+// NTSC frame timing (see the notes in apple2.cpp)
+#define CYCLES_PER_LINE		65
+#define LINES_PER_FRAME		262
+#define CYCLES_PER_FRAME	(CYCLES_PER_LINE * LINES_PER_FRAME)
+
+// The lines of the frame the screen is drawn on (see VBL()); the first 25
+// cycles of each line are horizontal blanking, and the 40 after that are the
+// 40 bytes of the line.
+#define VBL_START			(6 * CYCLES_PER_LINE)
+#define VBL_END				(198 * CYCLES_PER_LINE)
+#define HBL_CYCLES			25
+
+// Exported functions
+
+void InitApple2(void);
+void ResetApple2State(void);
+void SaveApple2State(const char * filename);
+bool LoadApple2State(const char * filename);
+void RunApple2Frame(uint32_t frames = 1);
+uint32_t FrameCycle(void);
+bool VBL(void);
+void SyncDevices(void);
+void SetDeadline(uint64_t clock);
+void SyncSamples(void);
+
+// N.B.: The core doesn't talk to the host directly; whoever links against it
+//       (the SDL front end or the headless runner) has to supply these:
+//
+//       void ToggleSpeaker(void);                   [sound.h]
+//       void WriteSampleToBuffer(void);             [sound.h]
+//       void SpawnMessage(const char * text, ...);  [video.h]
+//
+//       and define the "settings" struct [settings.h].
+
+#endif	// __MACHINE_H__
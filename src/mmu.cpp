@@ -12,48 +12,83 @@
 
 
 #include "mmu.h"
+
+#include <stdlib.h>
+#include <string.h>
 #include "apple2.h"
 #include "firmware/firmware.h"
 #include "log.h"
+#include "machine.h"
 #include "mockingboard.h"
+#include "slotcard.h"
 #include "sound.h"
-#include "video.h"
+#include "watch.h"
 
 
 // Debug defines
 //#define LC_DEBUG
+//#define SWITCH_DEBUG
 
 // Address Map enumeration
-enum { AM_RAM, AM_ROM, AM_BANKED, AM_READ, AM_WRITE, AM_READ_WRITE, AM_END_OF_LIST };
+enum { AM_READ, AM_WRITE, AM_READ_WRITE, AM_END_OF_LIST };
+
+// Every way the bank switches can map memory, worked out ahead of time (see
+// ConfigIndex()); flipping one just picks a different one
+#define MMU_CONFIGS		320
+static MemoryPage mmuConfig[MMU_CONFIGS][0x100];
+
+// Pages with a watch on them go through TrapR()/TrapW() instead (see
+// TrapPages()); this is what they'd have been mapped to otherwise, in each
+// configuration (only allocated for the pages that are trapped)
+static uint8_t trapMask[0x100];
+static MemoryPage * mmuTrapped[0x100];
+static uint32_t curConfig;				// Which one is in use
+
+// RamWorks style aux memory: up to 128 banks of 64K, picked by writing to
+// $C073. Bank 0 is ram2 (which is what the display always shows); the rest
+// only get allocated when they're first selected. The configurations above
+// all point at ram2, so the first time one's used with another bank selected,
+// it gets copied with its aux pages pointed at that bank instead, and that
+// copy is kept for next time (see MapMemory()).
+#define AUX_BANKS_MAX	128
+static uint8_t * auxBank[AUX_BANKS_MAX] = { ram2 };
+static uint32_t auxBanks = 1;			// # of banks on the card (power of 2)
+static uint8_t auxSelected = 0;
+static uint8_t * auxMem = ram2;			// = auxBank[auxSelected]
+static MemoryPage * bankedConfig[AUX_BANKS_MAX][MMU_CONFIGS];	// NULL = not yet
+static MemoryPage bankedPage[0x100];	// For when one can't be allocated
+
+// Exported variables
+MemoryPage * memPage = mmuConfig[0];	// The one in use (see MapMemory())
+V65C02BlockCache codeCache;				// Pre-decoded 65C02 code
+VideoChange videoLog[VIDEO_LOG_SIZE];	// What the screen was before each change
+uint64_t videoLogged = 0;
+uint64_t videoLogCleared = 0;
 
 // Internal vars
-uint8_t ** addrPtrRead[0x10000];
-uint8_t ** addrPtrWrite[0x10000];
-uint16_t addrOffset[0x10000];
-
-READFUNC(funcMapRead[0x10000]);
-WRITEFUNC(funcMapWrite[0x10000]);
+READFUNC(ioRead[0x100]);				// $C000-$C0FF
+WRITEFUNC(ioWrite[0x100]);
+bool ioPolled[0x100];					// Reads have no side effects
+static bool ioKeepsMap[0x100];			// Reads don't switch banks
 
-READFUNC(slotHandlerR[8]);
-WRITEFUNC(slotHandlerW[8]);
+static SlotCard * slotCard[8];			// What's in each slot (NULL = empty)
+uint8_t enabledSlot;					// Has $C800-$CFFF (see Slot2KR())
 
-READFUNC(slotHandler2KR[8]);
-WRITEFUNC(slotHandler2KW[8]);
-
-uint8_t enabledSlot;
+// What the video scanner is reading at each cycle of the frame, minus the
+// page select bits (see ReadFloatingBus())
+static uint16_t scanText[CYCLES_PER_FRAME];
+static uint16_t scanHiRes[CYCLES_PER_FRAME];
 
 struct AddressMap
 {
 	uint16_t start;
 	uint16_t end;
 	int type;
-	uint8_t ** memory;
-	uint8_t ** altMemory;
 	READFUNC(read);
 	WRITEFUNC(write);
 };
 
-#define ADDRESS_MAP_END		{ 0x0000, 0x0000, AM_END_OF_LIST, 0, 0, 0, 0 }
+#define ADDRESS_MAP_END		{ 0x0000, 0x0000, AM_END_OF_LIST, 0, 0 }
 
 // Dunno if I like this approach or not...
 //ADDRESS_MAP_START()
@@ -61,37 +96,18 @@ struct AddressMap
 //	AM_RANGE(0xC000, 0xC001) AM_READWRITE(readFunc, writeFunc)
 //ADDRESS_MAP_END
 
-// Would need a pointer for 80STORE as well...
-
-uint8_t * pageZeroMemory  = &ram[0x0000];	// $0000 - $01FF
-uint8_t * mainMemoryR     = &ram[0x0200];	// $0200 - $BFFF (read)
-uint8_t * mainMemoryW     = &ram[0x0200];	// $0200 - $BFFF (write)
-
-uint8_t * mainMemoryTextR = &ram[0x0400];	// $0400 - $07FF (read)
-uint8_t * mainMemoryTextW = &ram[0x0400];	// $0400 - $07FF (write)
-uint8_t * mainMemoryHGRR  = &ram[0x2000];	// $2000 - $3FFF (read)
-uint8_t * mainMemoryHGRW  = &ram[0x2000];	// $2000 - $3FFF (write)
-
-uint8_t * slotMemory      = &rom[0xC100];	// $C100 - $C7FF
-uint8_t * peripheralMemory= &rom[0xC800];	// $C800 - $CFFF
-uint8_t * slot3Memory     = &rom[0xC300];	// $C300 - $C3FF
-uint8_t * slot4Memory     = &rom[0xC400];	// $C400 - $C4FF
-uint8_t * slot6Memory     = &diskROM[0];	// $C600 - $C6FF
-uint8_t * lcBankMemoryR   = &ram[0xD000];	// $D000 - $DFFF (read)
-uint8_t * lcBankMemoryW   = &ram[0xD000];	// $D000 - $DFFF (write)
-uint8_t * upperMemoryR    = &ram[0xE000];	// $E000 - $FFFF (read)
-uint8_t * upperMemoryW    = &ram[0xE000];	// $E000 - $FFFF (write)
-
 
 // Function prototypes
 uint8_t ReadNOP(uint16_t);
 void WriteNOP(uint16_t, uint8_t);
-uint8_t ReadMemory(uint16_t);
-void WriteMemory(uint16_t, uint8_t);
+uint8_t ReadIO(uint16_t);
+void WriteIO(uint16_t, uint8_t);
 uint8_t SlotR(uint16_t address);
 void SlotW(uint16_t address, uint8_t byte);
 uint8_t Slot2KR(uint16_t address);
 void Slot2KW(uint16_t address, uint8_t byte);
+static uint8_t CardIOR(uint16_t address);
+static void CardIOW(uint16_t address, uint8_t byte);
 uint8_t ReadKeyboard(uint16_t);
 void Switch80STORE(uint16_t, uint8_t);
 void SwitchRAMRD(uint16_t, uint8_t);
@@ -124,7 +140,6 @@ uint8_t ReadSpeaker(uint16_t);
 void WriteSpeaker(uint16_t, uint8_t);
 uint8_t SwitchLCR(uint16_t);
 void SwitchLCW(uint16_t, uint8_t);
-void SwitchLC(void);
 uint8_t SwitchTEXTR(uint16_t);
 void SwitchTEXTW(uint16_t, uint8_t);
 uint8_t SwitchMIXEDR(uint16_t);
@@ -136,75 +151,94 @@ void SwitchHIRESW(uint16_t, uint8_t);
 uint8_t SwitchDHIRESR(uint16_t);
 void SwitchDHIRESW(uint16_t, uint8_t);
 void SwitchIOUDIS(uint16_t, uint8_t);
+void SwitchAuxBank(uint16_t, uint8_t);
 uint8_t ReadButton0(uint16_t);
 uint8_t ReadButton1(uint16_t);
 uint8_t ReadPaddle0(uint16_t);
 uint8_t ReadIOUDIS(uint16_t);
 uint8_t ReadDHIRES(uint16_t);
-
-
-// The main Apple //e memory map
-AddressMap memoryMap[] = {
-	{ 0x0000, 0x01FF, AM_RAM, &pageZeroMemory, 0, 0, 0 },
-	{ 0x0200, 0xBFFF, AM_BANKED, &mainMemoryR, &mainMemoryW, 0, 0 },
-
-	// These will overlay over the previously written memory accessors
-	{ 0x0400, 0x07FF, AM_BANKED, &mainMemoryTextR, &mainMemoryTextW, 0, 0 },
-	{ 0x2000, 0x3FFF, AM_BANKED, &mainMemoryHGRR, &mainMemoryHGRW, 0, 0 },
-
-	{ 0xC000, 0xC001, AM_READ_WRITE, 0, 0, ReadKeyboard, Switch80STORE },
-	{ 0xC002, 0xC003, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchRAMRD },
-	{ 0xC004, 0xC005, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchRAMWRT },
-	{ 0xC006, 0xC007, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchSLOTCXROM },
-	{ 0xC008, 0xC009, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchALTZP },
-	{ 0xC00A, 0xC00B, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchSLOTC3ROM },
-	{ 0xC00C, 0xC00D, AM_READ_WRITE, 0, 0, ReadKeyboard, Switch80COL },
-	{ 0xC00E, 0xC00F, AM_READ_WRITE, 0, 0, ReadKeyboard, SwitchALTCHARSET },
-	{ 0xC010, 0xC010, AM_READ_WRITE, 0, 0, ReadKeyStrobe, WriteKeyStrobe },
-	{ 0xC011, 0xC011, AM_READ_WRITE, 0, 0, ReadBANK2, WriteKeyStrobe },
-	{ 0xC012, 0xC012, AM_READ_WRITE, 0, 0, ReadLCRAM, WriteKeyStrobe },
-	{ 0xC013, 0xC013, AM_READ_WRITE, 0, 0, ReadRAMRD, WriteKeyStrobe },
-	{ 0xC014, 0xC014, AM_READ_WRITE, 0, 0, ReadRAMWRT, WriteKeyStrobe },
-	{ 0xC015, 0xC015, AM_READ_WRITE, 0, 0, ReadSLOTCXROM, WriteKeyStrobe },
-	{ 0xC016, 0xC016, AM_READ_WRITE, 0, 0, ReadALTZP, WriteKeyStrobe },
-	{ 0xC017, 0xC017, AM_READ_WRITE, 0, 0, ReadSLOTC3ROM, WriteKeyStrobe },
-	{ 0xC018, 0xC018, AM_READ_WRITE, 0, 0, Read80STORE, WriteKeyStrobe },
-	{ 0xC019, 0xC019, AM_READ_WRITE, 0, 0, ReadVBL, WriteKeyStrobe },
-	{ 0xC01A, 0xC01A, AM_READ_WRITE, 0, 0, ReadTEXT, WriteKeyStrobe },
-	{ 0xC01B, 0xC01B, AM_READ_WRITE, 0, 0, ReadMIXED, WriteKeyStrobe },
-	{ 0xC01C, 0xC01C, AM_READ_WRITE, 0, 0, ReadPAGE2, WriteKeyStrobe },
-	{ 0xC01D, 0xC01D, AM_READ_WRITE, 0, 0, ReadHIRES, WriteKeyStrobe },
-	{ 0xC01E, 0xC01E, AM_READ_WRITE, 0, 0, ReadALTCHARSET, WriteKeyStrobe },
-	{ 0xC01F, 0xC01F, AM_READ_WRITE, 0, 0, Read80COL, WriteKeyStrobe },
+static void MapPages(MemoryPage * table, uint8_t first, uint8_t last, uint8_t * readMem, uint8_t * writeMem);
+static void SetupScanner(void);
+static inline uint16_t ScannerAddress(uint32_t frameCycles);
+static uint16_t BeamAddress(uint32_t frameCycles, bool hires);
+static uint16_t LayoutAddress(uint32_t frameCycles, bool hires, bool page2);
+static void MapPages(MemoryPage * table, uint8_t first, uint8_t last, READFUNC(readFunc), WRITEFUNC(writeFunc));
+static inline uint32_t ConfigIndex(uint16_t state);
+static void MapMemory(void);
+static void FlushBankedConfigs(void);
+static void MapConfigs(void);
+static void MapConfig(MemoryPage * table, uint16_t state);
+static void TrapConfig(uint32_t config);
+static uint8_t TrapR(uint16_t address);
+static void TrapW(uint16_t address, uint8_t byte);
+static inline uint8_t * BankedAux(uint8_t * p);
+static uint8_t PageBank(uint16_t address, const uint8_t * p);
+static void MapMainMemory(MemoryPage * table, uint16_t state);
+static void MapZeroPage(MemoryPage * table, uint16_t state);
+static void MapLC(MemoryPage * table, uint16_t state);
+
+
+// The Apple //e I/O map ($C000-$C0FF); RAM, ROM & the slot spaces are set up
+// page by page in SetupAddressMap() & the bank switching functions
+AddressMap ioMap[] = {
+	{ 0xC000, 0xC001, AM_READ_WRITE, ReadKeyboard, Switch80STORE },
+	{ 0xC002, 0xC003, AM_READ_WRITE, ReadKeyboard, SwitchRAMRD },
+	{ 0xC004, 0xC005, AM_READ_WRITE, ReadKeyboard, SwitchRAMWRT },
+	{ 0xC006, 0xC007, AM_READ_WRITE, ReadKeyboard, SwitchSLOTCXROM },
+	{ 0xC008, 0xC009, AM_READ_WRITE, ReadKeyboard, SwitchALTZP },
+	{ 0xC00A, 0xC00B, AM_READ_WRITE, ReadKeyboard, SwitchSLOTC3ROM },
+	{ 0xC00C, 0xC00D, AM_READ_WRITE, ReadKeyboard, Switch80COL },
+	{ 0xC00E, 0xC00F, AM_READ_WRITE, ReadKeyboard, SwitchALTCHARSET },
+	{ 0xC010, 0xC010, AM_READ_WRITE, ReadKeyStrobe, WriteKeyStrobe },
+	{ 0xC011, 0xC011, AM_READ_WRITE, ReadBANK2, WriteKeyStrobe },
+	{ 0xC012, 0xC012, AM_READ_WRITE, ReadLCRAM, WriteKeyStrobe },
+	{ 0xC013, 0xC013, AM_READ_WRITE, ReadRAMRD, WriteKeyStrobe },
+	{ 0xC014, 0xC014, AM_READ_WRITE, ReadRAMWRT, WriteKeyStrobe },
+	{ 0xC015, 0xC015, AM_READ_WRITE, ReadSLOTCXROM, WriteKeyStrobe },
+	{ 0xC016, 0xC016, AM_READ_WRITE, ReadALTZP, WriteKeyStrobe },
+	{ 0xC017, 0xC017, AM_READ_WRITE, ReadSLOTC3ROM, WriteKeyStrobe },
+	{ 0xC018, 0xC018, AM_READ_WRITE, Read80STORE, WriteKeyStrobe },
+	{ 0xC019, 0xC019, AM_READ_WRITE, ReadVBL, WriteKeyStrobe },
+	{ 0xC01A, 0xC01A, AM_READ_WRITE, ReadTEXT, WriteKeyStrobe },
+	{ 0xC01B, 0xC01B, AM_READ_WRITE, ReadMIXED, WriteKeyStrobe },
+	{ 0xC01C, 0xC01C, AM_READ_WRITE, ReadPAGE2, WriteKeyStrobe },
+	{ 0xC01D, 0xC01D, AM_READ_WRITE, ReadHIRES, WriteKeyStrobe },
+	{ 0xC01E, 0xC01E, AM_READ_WRITE, ReadALTCHARSET, WriteKeyStrobe },
+	{ 0xC01F, 0xC01F, AM_READ_WRITE, Read80COL, WriteKeyStrobe },
 	// $C020 is "Cassette Out (RO)"
-	{ 0xC020, 0xC02F, AM_READ, 0, 0, ReadFloatingBus, 0 },
+	{ 0xC020, 0xC02F, AM_READ, ReadFloatingBus, 0 },
 	// May have to put a "floating bus" read there... :-/
 	// Apparently, video RAM is put on 'non-responding address'. So will
 	// need to time those out.
 	// So... $C020-$C08F, when read, return video data.
 	// $C090-$C7FF do also, as long as the slot the range refers to is empty
 	// and last and least is $CFFF, which is the Expansion ROM disable.
-	{ 0xC030, 0xC03F, AM_READ_WRITE, 0, 0, ReadSpeaker, WriteSpeaker },
-	{ 0xC050, 0xC051, AM_READ_WRITE, 0, 0, SwitchTEXTR, SwitchTEXTW },
-	{ 0xC052, 0xC053, AM_READ_WRITE, 0, 0, SwitchMIXEDR, SwitchMIXEDW },
-	{ 0xC054, 0xC055, AM_READ_WRITE, 0, 0, SwitchPAGE2R, SwitchPAGE2W },
-	{ 0xC056, 0xC057, AM_READ_WRITE, 0, 0, SwitchHIRESR, SwitchHIRESW },
-	{ 0xC05E, 0xC05F, AM_READ_WRITE, 0, 0, SwitchDHIRESR, SwitchDHIRESW },
-	{ 0xC061, 0xC061, AM_READ, 0, 0, ReadButton0, 0 },
-	{ 0xC062, 0xC062, AM_READ, 0, 0, ReadButton1, 0 },
-	{ 0xC064, 0xC067, AM_READ, 0, 0, ReadPaddle0, 0 },
-	{ 0xC07E, 0xC07E, AM_READ_WRITE, 0, 0, ReadIOUDIS, SwitchIOUDIS },
-	{ 0xC07F, 0xC07F, AM_READ_WRITE, 0, 0, ReadDHIRES, SwitchIOUDIS },
-	{ 0xC080, 0xC08F, AM_READ_WRITE, 0, 0, SwitchLCR, SwitchLCW },
-
-	{ 0xC100, 0xC7FF, AM_READ_WRITE, 0, 0, SlotR, SlotW },
-	{ 0xC800, 0xCFFE, AM_READ_WRITE, 0, 0, Slot2KR, Slot2KW },
-	{ 0xCFFF, 0xCFFF, AM_READ_WRITE, 0, 0, SwitchINTC8ROMR, SwitchINTC8ROMW },
-
-	{ 0xD000, 0xDFFF, AM_BANKED, &lcBankMemoryR, &lcBankMemoryW, 0, 0 },
-	{ 0xE000, 0xFFFF, AM_BANKED, &upperMemoryR, &upperMemoryW, 0, 0 },
+	{ 0xC030, 0xC03F, AM_READ_WRITE, ReadSpeaker, WriteSpeaker },
+	{ 0xC050, 0xC051, AM_READ_WRITE, SwitchTEXTR, SwitchTEXTW },
+	{ 0xC052, 0xC053, AM_READ_WRITE, SwitchMIXEDR, SwitchMIXEDW },
+	{ 0xC054, 0xC055, AM_READ_WRITE, SwitchPAGE2R, SwitchPAGE2W },
+	{ 0xC056, 0xC057, AM_READ_WRITE, SwitchHIRESR, SwitchHIRESW },
+	{ 0xC05E, 0xC05F, AM_READ_WRITE, SwitchDHIRESR, SwitchDHIRESW },
+	{ 0xC061, 0xC061, AM_READ, ReadButton0, 0 },
+	{ 0xC062, 0xC062, AM_READ, ReadButton1, 0 },
+	{ 0xC064, 0xC067, AM_READ, ReadPaddle0, 0 },
+	{ 0xC073, 0xC073, AM_WRITE, 0, SwitchAuxBank },
+	{ 0xC07E, 0xC07E, AM_READ_WRITE, ReadIOUDIS, SwitchIOUDIS },
+	{ 0xC07F, 0xC07F, AM_READ_WRITE, ReadDHIRES, SwitchIOUDIS },
+	{ 0xC080, 0xC08F, AM_READ_WRITE, SwitchLCR, SwitchLCW },
 	ADDRESS_MAP_END
 };
+
+// Reads from these only report state that can't change while the CPU is
+// running without the CPU writing to something, so a loop that polls them
+// can be fast-forwarded (see PolledAddress())
+uint16_t pollMap[][2] = {
+	{ 0xC000, 0xC00F },		// Keyboard
+	{ 0xC011, 0xC01F },		// Soft switch status & VBL
+	{ 0xC061, 0xC067 },		// Buttons & paddles
+	{ 0xC07E, 0xC07F },		// IOUDIS & DHIRES status
+	{ 0x0000, 0x0000 }
+};
 /*
 Some stuff that may be useful:
 
@@ -233,117 +267,199 @@ Read from $C800-$CFFF causes I/O STROBE to go low (and INTCXROM and INTC8ROM are
 
 void SetupAddressMap(void)
 {
-	for(uint32_t i=0; i<0x10000; i++)
-	{
-		funcMapRead[i] = ReadNOP;
-		funcMapWrite[i] = WriteNOP;
-		addrPtrRead[i] = 0;
-		addrPtrWrite[i] = 0;
-		addrOffset[i] = 0;
-	}
-
-	for(uint32_t i=0; i<8; i++)
+	for(uint32_t i=0; i<0x100; i++)
 	{
-		slotHandlerR[i] = ReadNOP;
-		slotHandlerW[i] = WriteNOP;
-		slotHandler2KR[i] = ReadNOP;
-		slotHandler2KW[i] = WriteNOP;
+		ioRead[i] = ReadNOP;
+		ioWrite[i] = WriteNOP;
 	}
 
 	uint32_t i=0;
 
-	while (memoryMap[i].type != AM_END_OF_LIST)
+	while (ioMap[i].type != AM_END_OF_LIST)
 	{
-		switch (memoryMap[i].type)
+		for(uint32_t j=ioMap[i].start; j<=ioMap[i].end; j++)
 		{
-		case AM_RAM:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-			{
-				funcMapRead[j] = ReadMemory;
-				funcMapWrite[j] = WriteMemory;
-				addrPtrRead[j] = memoryMap[i].memory;
-				addrPtrWrite[j] = memoryMap[i].memory;
-				addrOffset[j] = j - memoryMap[i].start;
-//WriteLog("SetupAddressMap: j=$%04X, addrOffset[j]=$%04X\n", j, addrOffset[j]);
-			}
-
-			break;
-		case AM_ROM:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-			{
-				funcMapRead[j] = ReadMemory;
-				addrPtrRead[j] = memoryMap[i].memory;
-				addrOffset[j] = j - memoryMap[i].start;
-			}
-
-			break;
-		case AM_BANKED:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-			{
-				funcMapRead[j] = ReadMemory;
-				funcMapWrite[j] = WriteMemory;
-				addrPtrRead[j] = memoryMap[i].memory;
-				addrPtrWrite[j] = memoryMap[i].altMemory;
-				addrOffset[j] = j - memoryMap[i].start;
-			}
-
-			break;
-		case AM_READ:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-				funcMapRead[j] = memoryMap[i].read;
-
-			break;
-		case AM_WRITE:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-				funcMapWrite[j] = memoryMap[i].write;
-
-			break;
-		case AM_READ_WRITE:
-			for(uint32_t j=memoryMap[i].start; j<=memoryMap[i].end; j++)
-			{
-				funcMapRead[j] = memoryMap[i].read;
-				funcMapWrite[j] = memoryMap[i].write;
-			}
-
-			break;
+			if (ioMap[i].type != AM_WRITE)
+				ioRead[j & 0xFF] = ioMap[i].read;
+
+			if (ioMap[i].type != AM_READ)
+				ioWrite[j & 0xFF] = ioMap[i].write;
 		}
 
 		i++;
 	};
 
-	// This should correctly set up the LC pointers, but it doesn't
-	// for some reason... :-/
-	// It's because we were storing pointers directly, instead of pointers
-	// to the pointer... It's complicated. :-)
-	SwitchLC();
+	for(i=0; pollMap[i][0] != 0; i++)
+	{
+		for(uint32_t j=pollMap[i][0]; j<=pollMap[i][1]; j++)
+			ioPolled[j & 0xFF] = ioKeepsMap[j & 0xFF] = true;
+	}
+
+	// Reading the slot devices ($C090-$C0FF) doesn't switch anything either
+	// (the SCSI card's banks only change on writes), so the CPU can keep
+	// going through a pre-decoded block past those too
+	for(i=0x90; i<0x100; i++)
+		ioKeepsMap[i] = true;
+
+	SetupScanner();
+	MapConfigs();
 }
 
 
 //
-// Reset the MMU state after a power down event
+// Send accesses to the pages flagged in mask (WATCH_* bits, one byte per page)
+// through TrapR()/TrapW(), which hand them to WatchAccess(); a mask of all
+// zeroes puts everything back the way it was. Only call this while the CPU
+// isn't running.
 //
-void ResetMMUPointers(void)
+void TrapPages(const uint8_t * mask)
 {
-	if (store80Mode)
+	for(uint32_t i=0; i<0x100; i++)
+	{
+		trapMask[i] = mask[i];
+
+		if (!trapMask[i])
+		{
+			free(mmuTrapped[i]);
+			mmuTrapped[i] = NULL;
+			continue;
+		}
+
+		if (!mmuTrapped[i])
+			mmuTrapped[i] = (MemoryPage *)malloc(sizeof(MemoryPage) * MMU_CONFIGS);
+
+		if (!mmuTrapped[i])
+		{
+			WriteLog("MMU: Could not allocate trap for page $%02X!\n", i);
+			trapMask[i] = 0;
+		}
+	}
+
+	MapConfigs();
+}
+
+
+//
+// Make the renderer redraw everything; anything that changes display memory
+// without going through the page table (loading a state, say) has to call
+// this. Nothing from before then can be wound back, so the log starts over;
+// it skips an entry, so that's past anything that's been drawn already.
+//
+void MarkVideoDirty(void)
+{
+	videoLogCleared = ++videoLogged;
+}
+
+
+//
+// The display switches as they are right now, packed into one byte (VS_*)
+//
+uint8_t VideoSwitches(void)
+{
+	return (textMode ? VS_TEXT : 0) | (mixedMode ? VS_MIXED : 0)
+		| (hiRes ? VS_HIRES : 0) | (dhires ? VS_DHIRES : 0)
+		| (col80Mode ? VS_80COL : 0) | (displayPage2 ? VS_PAGE2 : 0)
+		| (alternateCharset ? VS_ALTCHAR : 0);
+}
+
+
+//
+// Flip one of the display switches, logging what they all were before if it
+// actually changes (see VideoChange in mmu.h)
+//
+static inline void SetDisplaySwitch(bool & flag, bool value)
+{
+	if (flag == value)
+		return;
+
+	LogVideoChange(VIDEO_SWITCHES, 0, VideoSwitches());
+	flag = value;
+}
+
+
+//
+// Copy what the renderer needs out of the machine (see VideoSnapshot in
+// mmu.h). Display memory only gets copied in full the first time; after
+// that, only the blocks that the log says have changed since the snapshot
+// was last taken are, unless the log doesn't go back that far.
+//
+void TakeVideoSnapshot(VideoSnapshot * snapshot)
+{
+	static uint64_t lastLogged = 0;		// videoLogged at the last snapshot
+	uint64_t oldest = (videoLogged > VIDEO_LOG_SIZE ? videoLogged - VIDEO_LOG_SIZE : 0);
+
+	if (oldest < videoLogCleared)
+		oldest = videoLogCleared;
+
+	if (!snapshot->taken || (snapshot->logged < oldest)
+		|| (snapshot->logged > videoLogged))
 	{
-		mainMemoryTextR = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
+		for(int aux=0; aux<2; aux++)
+		{
+			uint8_t * mem = (aux ? ram2 : ram);
+			memcpy(&snapshot->mem[aux][0x0400], &mem[0x0400], 0x0800);
+			memcpy(&snapshot->mem[aux][0x2000], &mem[0x2000], 0x4000);
+		}
 	}
 	else
 	{
-		mainMemoryTextR = (ramwrt ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (ramwrt ? &ram2[0x0400] : &ram[0x0400]);
+		uint8_t copied[2][VIDEO_BLOCKS];
+		memset(copied, 0, sizeof(copied));
+
+		for(uint64_t i=snapshot->logged; i<videoLogged; i++)
+		{
+			const VideoChange * change = &videoLog[i & (VIDEO_LOG_SIZE - 1)];
+			uint16_t block = change->address >> 7;
+
+			if ((change->address == VIDEO_SWITCHES) || copied[change->aux][block])
+				continue;
+
+			memcpy(&snapshot->mem[change->aux][block << 7],
+				(change->aux ? &ram2[block << 7] : &ram[block << 7]), 0x80);
+			copied[change->aux][block] = 1;
+		}
 	}
 
-	mainMemoryR = (ramrd ? &ram2[0x0200] : &ram[0x0200]);
-	mainMemoryHGRR = (ramrd ? &ram2[0x2000] : &ram[0x2000]);
-	mainMemoryW = (ramwrt ?  &ram2[0x0200] : &ram[0x0200]);
-	mainMemoryHGRW = (ramwrt ? &ram2[0x2000] : &ram[0x2000]);
+	// The changes since the last snapshot, and since the beam started on the
+	// last frame it got all the way thru (or the one before that, if the
+	// beam's still drawing this one)
+	uint32_t cycle = FrameCycle();
+	uint64_t rasterStart = mainCPU.clock - cycle + VBL_START;
+
+	if (cycle < VBL_END)
+		rasterStart -= CYCLES_PER_FRAME;
+
+	uint64_t first = videoLogged;
+
+	while ((first > oldest)
+		&& (videoLog[(first - 1) & (VIDEO_LOG_SIZE - 1)].clock >= rasterStart))
+		first--;
 
+	if (first > lastLogged)
+		first = (lastLogged > oldest ? lastLogged : oldest);
+
+	for(uint64_t i=first; i<videoLogged; i++)
+		snapshot->log[i - first] = videoLog[i & (VIDEO_LOG_SIZE - 1)];
+
+	snapshot->taken = true;
+	snapshot->clock = mainCPU.clock;
+	snapshot->frameCycle = cycle;
+	snapshot->switches = VideoSwitches();
+	snapshot->first = first;
+	snapshot->logged = videoLogged;
+	snapshot->cleared = videoLogCleared;
+	lastLogged = videoLogged;
+}
+
+
+//
+// Reset the MMU state after a power down event
+//
+void ResetMMUPointers(void)
+{
 //	slot6Memory = (intCXROM ? &rom[0xC600] : &diskROM[0]);
 //	slot3Memory = (slotC3ROM ? &rom[0] : &rom[0xC300]);
-	pageZeroMemory = (altzp ? &ram2[0x0000] : &ram[0x0000]);
-	SwitchLC();
+	MapMemory();
 #if 1
 WriteLog("RAMWRT = %s\n", (ramwrt ? "ON" : "off"));
 WriteLog("RAMRD = %s\n", (ramrd ? "ON" : "off"));
@@ -355,64 +471,414 @@ WriteLog("ALTZP = %s\n", (altzp ? "ON" : "off"));
 
 
 //
-// Set up slot access
+// Set how many 64K banks of aux memory there are (1 = a plain 80 column card;
+// anything else gets rounded down to a power of 2, so bank numbers past the
+// end wrap around like they do on the real thing). Throws away what was in
+// the banks past the first.
 //
-void InstallSlotHandler(uint8_t slot, SlotData * slotData)
+void SetAuxBanks(uint32_t banks)
 {
-	// Sanity check
-	if (slot > 7)
+	auxBanks = 1;
+
+	while ((auxBanks < AUX_BANKS_MAX) && (auxBanks * 2 <= banks))
+		auxBanks *= 2;
+
+	ResetAuxMemory();
+	WriteLog("MMU: %u banks of aux memory\n", auxBanks);
+}
+
+
+//
+// Free up everything but bank 0, and select it
+//
+void ResetAuxMemory(void)
+{
+	FlushBankedConfigs();
+
+	for(uint32_t i=1; i<AUX_BANKS_MAX; i++)
+	{
+		free(auxBank[i]);
+		auxBank[i] = NULL;
+	}
+
+	SelectAuxBank(0);
+}
+
+
+//
+// Point aux memory at another bank. Nothing but the page table in use has to
+// change, no matter how many banks there are.
+//
+void SelectAuxBank(uint8_t bank)
+{
+	bank &= auxBanks - 1;
+
+	if (!auxBank[bank])
+	{
+		auxBank[bank] = (uint8_t *)calloc(1, 0x10000);
+
+		if (!auxBank[bank])
+		{
+			WriteLog("MMU: Could not allocate aux bank $%02X!\n", bank);
+			bank = 0;
+		}
+	}
+
+	auxSelected = bank;
+	auxMem = auxBank[bank];
+	MapMemory();
+}
+
+
+uint32_t AuxBanks(void)
+{
+	return auxBanks;
+}
+
+
+//
+// Bank 0 goes in the save state along with main memory; this is the rest.
+// Banks that were never selected don't take up any room. The # of banks
+// isn't in here; the save state checks it up front (see LoadApple2State()).
+//
+void SaveAuxMemory(FILE * file)
+{
+	fputc(auxSelected, file);
+
+	for(uint32_t i=1; i<auxBanks; i++)
+	{
+		fputc(auxBank[i] ? 1 : 0, file);
+
+		if (auxBank[i])
+			fwrite(auxBank[i], 1, 0x10000, file);
+	}
+}
+
+
+void LoadAuxMemory(FILE * file)
+{
+	uint8_t selected = fgetc(file);
+	ResetAuxMemory();
+
+	for(uint32_t i=1; i<auxBanks; i++)
+	{
+		if (!fgetc(file))
+			continue;
+
+		auxBank[i] = (uint8_t *)malloc(0x10000);
+
+		if (auxBank[i])
+			fread(auxBank[i], 1, 0x10000, file);
+		else
+			fseek(file, 0x10000, SEEK_CUR);
+	}
+
+	SelectAuxBank(selected);
+}
+
+
+//
+// Which of mmuConfig[] goes with the bank switch state (as packed by
+// MMUState()): RAMRD, RAMWRT & ALTZP in the low 3 bits, then the language
+// card state, then one of the 5 ways 80STORE, PAGE2 & HIRES can map the
+// display pages (80STORE off is all the same).
+//
+static inline uint32_t ConfigIndex(uint16_t state)
+{
+	uint32_t lc = (state & 0x03) | ((state & 0x08) >> 1);
+	uint32_t display = (state & MMU_80STORE ? 1 + (state & MMU_PAGE2 ? 1 : 0)
+		+ (state & MMU_HIRES ? 2 : 0) : 0);
+
+	return ((state & (MMU_RAMRD | MMU_RAMWRT | MMU_ALTZP)) >> 4) | (lc << 3)
+		| (display << 6);
+}
+
+
+//
+// Switch to the configuration that goes with the soft switches (and aux bank)
+// as they are now; anything that changes one of the MMU_* bits has to call
+// this.
+//
+static void MapMemory(void)
+{
+	curConfig = ConfigIndex(MMUState());
+	memPage = mmuConfig[curConfig];
+
+	if (auxMem == ram2)
+		return;
+
+	MemoryPage * table = bankedConfig[auxSelected][curConfig];
+
+	if (table)
 	{
-		WriteLog("InstallSlotHandler: Caller attempted to put device into slot #%u...\n", slot);
+		memPage = table;
 		return;
 	}
 
-	// Set up I/O read & write functions
-	for(uint32_t i=0; i<16; i++)
+	table = (MemoryPage *)malloc(sizeof(MemoryPage) * 0x100);
+
+	if (!table)
+		table = bankedPage;
+	else
+		bankedConfig[auxSelected][curConfig] = table;
+
+	for(uint32_t i=0; i<0x100; i++)
 	{
-		if (slotData->ioR)
-			funcMapRead[0xC080 + (slot * 16) + i] = slotData->ioR;
+		table[i] = memPage[i];
+		table[i].read = BankedAux(memPage[i].read);
+		table[i].write = BankedAux(memPage[i].write);
+	}
+
+	memPage = table;
+}
 
-		if (slotData->ioW)
-			funcMapWrite[0xC080 + (slot * 16) + i] = slotData->ioW;
+
+//
+// Throw away the configurations kept for the aux banks past the first; they
+// have to go whenever the configurations or the banks themselves change.
+//
+static void FlushBankedConfigs(void)
+{
+	for(uint32_t i=1; i<AUX_BANKS_MAX; i++)
+	{
+		for(uint32_t j=0; j<MMU_CONFIGS; j++)
+		{
+			free(bankedConfig[i][j]);
+			bankedConfig[i][j] = NULL;
+		}
 	}
+}
 
-	// Set up memory access read/write functions
-	if (slotData->pageR)
-		slotHandlerR[slot] = slotData->pageR;
 
-	if (slotData->pageW)
-		slotHandlerW[slot] = slotData->pageW;
+//
+// Where a pointer into ram2 really goes, with the aux bank that's selected
+//
+static inline uint8_t * BankedAux(uint8_t * p)
+{
+	return ((p >= ram2) && (p < ram2 + 0x10000) ? auxMem + (p - ram2) : p);
+}
 
-	if (slotData->extraR)
-		slotHandler2KR[slot] = slotData->extraR;
 
-	if (slotData->extraW)
-		slotHandler2KW[slot] = slotData->extraW;
-/*
-Was thinking about how to make these things more self-contained, so that the management overhead would be less.  IOW, you should be able to make an object (struct) that holds everything needed to interface the MMU with itself--InstallSlotHandler *almost* does this, but not quite.  A consequence of this approach is that we would have to add generic slot I/O handlers into the mix, but that shouldn't be too horrible.  So it could be something like so:
+//
+// Work out every configuration memory can be in. Only the bits that
+// ConfigIndex() looks at count, so some of them get done more than once.
+//
+static void MapConfigs(void)
+{
+	for(uint16_t flags=0; flags<0x40; flags++)
+	{
+		for(uint16_t lc=0; lc<8; lc++)
+		{
+			uint16_t state = (flags << 4) | (lc & 0x03) | ((lc & 0x04) << 1);
+			uint32_t config = ConfigIndex(state);
+			MapConfig(mmuConfig[config], state);
+			TrapConfig(config);
+		}
+	}
+
+	FlushBankedConfigs();
+	MapMemory();
+}
+
 
-struct Card
+//
+// Fill in one configuration's page table
+//
+static void MapConfig(MemoryPage * table, uint16_t state)
 {
-	void * object;
-	uint16_t type;	// Probably an enum so we can figure out what 'object' is
-	READFUNC(slotIOR);
-	WRITEFUNC(slotIOW);
-	READFUNC(slotPageR);
-	WRITEFUNC(slotPageW);
-	READFUNC(slot2KR);
-	WRITEFUNC(slot2KW);
+	// These pages always go through a handler...
+	MapPages(table, 0xC0, 0xC0, ReadIO, WriteIO);
+	MapPages(table, 0xC1, 0xC7, SlotR, SlotW);
+	MapPages(table, 0xC8, 0xCF, Slot2KR, Slot2KW);
+
+	// ...and these point at whatever RAM/ROM the soft switches select
+	MapZeroPage(table, state);
+	MapMainMemory(table, state);
+	MapLC(table, state);
 }
 
-So instead of a bunch of crappy shit that sucks in here, we would have a simple thing like:
 
-Card * slots[8];
+//
+// Stash what the trapped pages of a configuration really map to, and point
+// them at the trap handlers instead
+//
+static void TrapConfig(uint32_t config)
+{
+	for(uint32_t i=0; i<0x100; i++)
+	{
+		if (!trapMask[i])
+			continue;
+
+		MemoryPage * page = &mmuConfig[config][i];
+		mmuTrapped[i][config] = *page;
 
-to encapsulate slots.  This also makes it easier to move them around and makes things less error prone.
+		if (trapMask[i] & (WATCH_READ | WATCH_EXEC))
+		{
+			page->read = 0;
+			page->readFunc = TrapR;
+		}
 
-So maybe...
+		if (trapMask[i] & WATCH_WRITE)
+		{
+			page->write = 0;
+			page->writeFunc = TrapW;
+		}
+	}
+}
 
 
-*/
+//
+// What a trapped page in the configuration in use really maps to
+//
+static inline MemoryPage * TrappedPage(uint16_t address)
+{
+	return &mmuTrapped[address >> 8][curConfig];
+}
+
+
+//
+// Do the access the page would have done if it weren't trapped, then tell
+// the watches about it
+//
+static uint8_t TrapR(uint16_t address)
+{
+	MemoryPage * page = TrappedPage(address);
+	uint8_t * read = BankedAux(page->read);
+	uint8_t byte = (read ? read[address & 0xFF] : (*(page->readFunc))(address));
+	WatchAccess(address, WATCH_READ, PageBank(address, read), byte);
+
+	// The watch could want the CPU stopped right here
+	codeCache.stop = true;
+
+	return byte;
+}
+
+
+static void TrapW(uint16_t address, uint8_t byte)
+{
+	MemoryPage * page = TrappedPage(address);
+	uint8_t * write = BankedAux(page->write);
+
+	if (write)
+	{
+		VideoWrite(&write[address & 0xFF], byte);
+		write[address & 0xFF] = byte;
+		codeCache.Written(&write[address & 0xFF]);
+	}
+	else
+		(*(page->writeFunc))(address, byte);
+
+	WatchAccess(address, WATCH_WRITE, PageBank(address, write), byte);
+}
+
+
+//
+// Point a run of pages directly at host memory. A NULL pointer sends that
+// side of the access to ReadNOP/WriteNOP instead.
+//
+static void MapPages(MemoryPage * table, uint8_t first, uint8_t last, uint8_t * readMem, uint8_t * writeMem)
+{
+	for(uint32_t i=first; i<=last; i++)
+	{
+		uint32_t offset = (i - first) * 0x100;
+		table[i].read = (readMem ? readMem + offset : 0);
+		table[i].write = (writeMem ? writeMem + offset : 0);
+		table[i].readFunc = ReadNOP;
+		table[i].writeFunc = WriteNOP;
+	}
+}
+
+
+//
+// Point a run of pages at a pair of handlers
+//
+static void MapPages(MemoryPage * table, uint8_t first, uint8_t last, READFUNC(readFunc), WRITEFUNC(writeFunc))
+{
+	for(uint32_t i=first; i<=last; i++)
+	{
+		table[i].read = 0;
+		table[i].write = 0;
+		table[i].readFunc = readFunc;
+		table[i].writeFunc = writeFunc;
+	}
+}
+
+
+//
+// $0200-$BFFF follows RAMRD/RAMWRT, except that the text page (and the first
+// hi-res page, if HIRES is on) follows PAGE2 for both reads & writes when
+// 80STORE is on
+//
+static void MapMainMemory(MemoryPage * table, uint16_t state)
+{
+	MapPages(table, 0x02, 0xBF, (state & MMU_RAMRD ? &ram2[0x0200] : &ram[0x0200]),
+		(state & MMU_RAMWRT ? &ram2[0x0200] : &ram[0x0200]));
+
+	if (state & MMU_80STORE)
+	{
+		uint8_t * page = (state & MMU_PAGE2 ? ram2 : ram);
+		MapPages(table, 0x04, 0x07, &page[0x0400], &page[0x0400]);
+
+		if (state & MMU_HIRES)
+			MapPages(table, 0x20, 0x3F, &page[0x2000], &page[0x2000]);
+	}
+}
+
+
+//
+// $0000-$01FF follows ALTZP
+//
+static void MapZeroPage(MemoryPage * table, uint16_t state)
+{
+	MapPages(table, 0x00, 0x01, (state & MMU_ALTZP ? &ram2[0x0000] : &ram[0x0000]),
+		(state & MMU_ALTZP ? &ram2[0x0000] : &ram[0x0000]));
+}
+
+
+//
+// Put a card in a slot (1 thru 7), or take out whatever's there if card is
+// NULL. A card can only be in one slot at a time.
+//
+void InstallSlotCard(uint8_t slot, SlotCard * card)
+{
+	// Sanity check
+	if ((slot < SLOT1) || (slot > SLOT7))
+	{
+		WriteLog("InstallSlotCard: Caller attempted to put device into slot #%u...\n", slot);
+		return;
+	}
+
+	if (slotCard[slot])
+	{
+		slotCard[slot]->slot = 0;
+		slotCard[slot]->Schedule();
+	}
+
+	if (card)
+	{
+		if (card->slot)
+			InstallSlotCard(card->slot, NULL);
+
+		card->slot = slot;
+		WriteLog("InstallSlotCard: %s in slot #%u\n", card->Name(), slot);
+	}
+
+	slotCard[slot] = card;
+
+	for(uint32_t i=0; i<16; i++)
+	{
+		ioRead[0x80 + (slot * 16) + i] = (card ? CardIOR : ReadNOP);
+		ioWrite[0x80 + (slot * 16) + i] = (card ? CardIOW : WriteNOP);
+	}
+
+	if (card)
+		card->Schedule();
+}
+
+
+SlotCard * GetSlotCard(uint8_t slot)
+{
+	return (slot < 8 ? slotCard[slot] : NULL);
 }
 
 
@@ -436,29 +902,114 @@ void WriteNOP(uint16_t, uint8_t)
 }
 
 
-uint8_t ReadMemory(uint16_t address)
+uint8_t ReadIO(uint16_t address)
+{
+	// The CPU ends its pre-decoded block on any access that goes to a handler
+	// (see AppleBus in machine.cpp), but reads of these can't switch banks, so
+	// it can keep going; that keeps loops that spin on the disk's data latch
+	// in their blocks. (Nothing earlier in the same instruction can have set
+	// the flag; no 65C02 instruction reads I/O after it's written something.)
+	if (ioKeepsMap[address & 0xFF])
+		codeCache.stop = false;
+
+	return (*(ioRead[address & 0xFF]))(address);
+}
+
+
+void WriteIO(uint16_t address, uint8_t byte)
 {
-//WriteLog("ReadMemory: addr=$%04X, addrPtrRead[addr]=$%X, addrOffset[addr]=$%X, val=$%02X\n", address, addrPtrRead[address], addrOffset[address], addrPtrRead[address][addrOffset[address]]);
-	// We are guaranteed a valid address here by the setup function, so there's
-	// no need to do any checking here.
-	return (*addrPtrRead[address])[addrOffset[address]];
+	(*(ioWrite[address & 0xFF]))(address, byte);
 }
 
 
-void WriteMemory(uint16_t address, uint8_t byte)
+//
+// Can address (which has to be in one of the handler pages) be read without
+// anything happening, and without it changing until the CPU stops running?
+// That's the polled I/O locations above, plus $C100-$C7FF when it has the
+// internal ROM banked in. A page with a watch on it doesn't count, since
+// every access to it has to be seen (see TrapR()).
+//
+bool PolledAddress(uint16_t address)
 {
-	// We can write protect memory this way, but it adds a branch to the mix.
-	// :-/ (this can be avoided by setting up another bank of memory which we
-	//  ignore... hmm...)
-	if ((*addrPtrWrite[address]) == 0)
-		return;
+	if (trapMask[address >> 8])
+		return false;
 
-	(*addrPtrWrite[address])[addrOffset[address]] = byte;
+	if ((address & 0xFF00) == 0xC000)
+		return ioPolled[address & 0xFF];
+
+	if ((address >= 0xC100) && (address <= 0xC7FF))
+		return intCXROM;
+
+	return false;
+}
+
+
+//
+// Which bank reads of address currently come from. Language card RAM is split
+// out from the rest of main & aux RAM (bank 1 lives at $C000 in either, since
+// nothing else can get at it), with $E000-$FFFF counting as part of bank 2.
+// $C000-$C0FF is the I/O page, and $C100-$CFFF is either the internal ROM or
+// whatever card has it (this follows SlotR() & Slot2KR() above).
+//
+uint8_t MemoryBank(uint16_t address)
+{
+	uint8_t page = address >> 8;
+
+	return PageBank(address, (trapMask[page] ? TrappedPage(address)->read
+		: memPage[page].read));
+}
+
+
+//
+// Which bank an access to address through host pointer p (NULL for a
+// handler) goes to
+//
+static uint8_t PageBank(uint16_t address, const uint8_t * p)
+{
+	if ((address & 0xFF00) == 0xC000)
+		return BANK_IO;
+
+	if ((address >= 0xC100) && (address <= 0xCFFF))
+	{
+		bool internal = intCXROM || (address >= 0xC800 ? intC8ROM
+			: ((address & 0xFF00) == 0xC300) && !slotC3ROM);
+
+		return (internal ? BANK_ROM : BANK_SLOT);
+	}
+
+	if (!p || ((p >= rom) && (p < rom + 0x10000)))
+		return BANK_ROM;
+
+	const uint8_t * base = ram;
+
+	if ((p >= ram2) && (p < ram2 + 0x10000))
+		base = ram2;
+	else if ((p >= auxMem) && (p < auxMem + 0x10000))
+		base = auxMem;
+
+	if (address < 0xD000)
+		return (base == ram ? BANK_MAIN : BANK_AUX);
+
+	return (p - base < 0xD000 ? BANK_LC1 : BANK_LC2);
+}
+
+
+//
+// All the switches that decide what's mapped where, packed into one word
+//
+uint16_t MMUState(void)
+{
+	return (lcState & MMU_LCSTATE) | (ramrd ? MMU_RAMRD : 0)
+		| (ramwrt ? MMU_RAMWRT : 0) | (altzp ? MMU_ALTZP : 0)
+		| (store80Mode ? MMU_80STORE : 0) | (displayPage2 ? MMU_PAGE2 : 0)
+		| (hiRes ? MMU_HIRES : 0) | (intCXROM ? MMU_INTCXROM : 0)
+		| (slotC3ROM ? MMU_SLOTC3ROM : 0) | (intC8ROM ? MMU_INTC8ROM : 0);
 }
 
 
 //
-// The main memory access functions used by V65C02
+// The main memory access functions used by V65C02. RAM & ROM come straight
+// out of the page table; only the I/O & slot pages need a handler call.
 //
 uint8_t AppleReadMem(uint16_t address)
 {
@@ -467,7 +1018,7 @@ if (address == 0xD4 || address == 0xAC20)
 	WriteLog("Reading $%X...\n", address);
 #endif
 #if 0
-	uint8_t memRead = (*(funcMapRead[address]))(address);
+	uint8_t memRead = (memPage[address >> 8].read ? memPage[address >> 8].read[address & 0xFF] : (*(memPage[address >> 8].readFunc))(address));
 static uint16_t lastAddr = 0;
 static uint32_t lastCount = 0;
 if ((address > 0xC000 && address < 0xC100) || address == 0xC601)
@@ -486,7 +1037,12 @@ if ((address > 0xC000 && address < 0xC100) || address == 0xC601)
 }
 	return memRead;
 #else
-	return (*(funcMapRead[address]))(address);
+	MemoryPage * page = &memPage[address >> 8];
+
+	if (page->read)
+		return page->read[address & 0xFF];
+
+	return (*(page->readFunc))(address);
 #endif
 }
 
@@ -520,7 +1076,16 @@ if (address == 0xD4 || address == 0xAC20)
 if (address == 0x000D)
 	WriteLog("Writing $%02X @ $%X (PC=$%04X)...\n", byte, address, mainCPU.pc);
 #endif
-	(*(funcMapWrite[address]))(address, byte);
+	MemoryPage * page = &memPage[address >> 8];
+
+	if (page->write)
+	{
+		VideoWrite(&page->write[address & 0xFF], byte);
+		page->write[address & 0xFF] = byte;
+		codeCache.Written(&page->write[address & 0xFF]);
+	}
+	else
+		(*(page->writeFunc))(address, byte);
 }
 
 
@@ -543,7 +1108,8 @@ uint8_t SlotR(uint16_t address)
 		return rom[address];
 	}
 
-	return (*(slotHandlerR[slot]))(address & 0xFF);
+	return (slotCard[slot] ? slotCard[slot]->ReadROM(address & 0xFF)
+		: ReadNOP(address));
 }
 
 
@@ -561,7 +1127,8 @@ void SlotW(uint16_t address, uint8_t byte)
 		return;
 	}
 
-	(*(slotHandlerW[slot]))(address & 0xFF, byte);
+	if (slotCard[slot])
+		slotCard[slot]->WriteROM(address & 0xFF, byte);
 }
 
 
@@ -570,19 +1137,45 @@ void SlotW(uint16_t address, uint8_t byte)
 //
 uint8_t Slot2KR(uint16_t address)
 {
+	if (address == 0xCFFF)
+		return SwitchINTC8ROMR(address);
+
 	if (intCXROM || intC8ROM)
 		return rom[address];
 
-	return (*(slotHandler2KR[enabledSlot]))(address & 0x7FF);
+	return (slotCard[enabledSlot] ? slotCard[enabledSlot]->ReadExpansion(address & 0x7FF)
+		: ReadNOP(address));
 }
 
 
 void Slot2KW(uint16_t address, uint8_t byte)
 {
+	if (address == 0xCFFF)
+	{
+		SwitchINTC8ROMW(address, byte);
+		return;
+	}
+
 	if (intCXROM || intC8ROM)
 		return;
 
-	(*(slotHandler2KW[enabledSlot]))(address & 0x7FF, byte);
+	if (slotCard[enabledSlot])
+		slotCard[enabledSlot]->WriteExpansion(address & 0x7FF, byte);
+}
+
+
+//
+// $C090-$C0FF go to the card in the slot they belong to
+//
+static uint8_t CardIOR(uint16_t address)
+{
+	return slotCard[(address & 0x70) >> 4]->ReadIO(address);
+}
+
+
+static void CardIOW(uint16_t address, uint8_t byte)
+{
+	slotCard[(address & 0x70) >> 4]->WriteIO(address, byte);
 }
 
 
@@ -598,44 +1191,24 @@ uint8_t ReadKeyboard(uint16_t /*addr*/)
 void Switch80STORE(uint16_t address, uint8_t)
 {
 	store80Mode = (bool)(address & 0x01);
+#ifdef SWITCH_DEBUG
 WriteLog("Setting 80STORE to %s...\n", (store80Mode ? "ON" : "off"));
-
-	if (store80Mode)
-	{
-		mainMemoryTextR = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-	}
-	else
-	{
-		mainMemoryTextR = (ramwrt ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (ramwrt ? &ram2[0x0400] : &ram[0x0400]);
-	}
+#endif
+	MapMemory();
 }
 
 
 void SwitchRAMRD(uint16_t address, uint8_t)
 {
 	ramrd = (bool)(address & 0x01);
-	mainMemoryR = (ramrd ? &ram2[0x0200] : &ram[0x0200]);
-	mainMemoryHGRR = (ramrd ? &ram2[0x2000] : &ram[0x2000]);
-
-	if (store80Mode)
-		return;
-
-	mainMemoryTextR = (ramrd ? &ram2[0x0400] : &ram[0x0400]);
+	MapMemory();
 }
 
 
 void SwitchRAMWRT(uint16_t address, uint8_t)
 {
 	ramwrt = (bool)(address & 0x01);
-	mainMemoryW = (ramwrt ?  &ram2[0x0200] : &ram[0x0200]);
-	mainMemoryHGRW = (ramwrt ? &ram2[0x2000] : &ram[0x2000]);
-
-	if (store80Mode)
-		return;
-
-	mainMemoryTextW = (ramwrt ? &ram2[0x0400] : &ram[0x0400]);
+	MapMemory();
 }
 
 
@@ -649,7 +1222,9 @@ void SwitchRAMWRT(uint16_t address, uint8_t)
 //
 void SwitchSLOTCXROM(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting SLOTCXROM to %s...\n", (address & 0x01 ? "ON" : "off"));
+#endif
 	intCXROM = (bool)(address & 0x01);
 
 	// INTC8ROM trumps all (only in the $C800--$CFFF range... which we don't account for yet...  :-/)
@@ -678,8 +1253,7 @@ WriteLog("Setting SLOTCXROM to %s...\n", (address & 0x01 ? "ON" : "off"));
 void SwitchALTZP(uint16_t address, uint8_t)
 {
 	altzp = (bool)(address & 0x01);
-	pageZeroMemory = (altzp ? &ram2[0x0000] : &ram[0x0000]);
-	SwitchLC();
+	MapMemory();
 }
 
 //extern bool dumpDis;
@@ -692,17 +1266,6 @@ void SwitchSLOTC3ROM(uint16_t address, uint8_t)
 //dumpDis = true;
 //WriteLog("Setting SLOTC3ROM to %s...\n", (address & 0x01 ? "ON" : "off"));
 	slotC3ROM = (bool)(address & 0x01);
-#if 1
-	if (intCXROM)
-		slot3Memory = &rom[0xC300];
-	else
-		slot3Memory = (slotC3ROM ? &rom[0] : &rom[0xC300]);
-#else
-//	slotC3ROM = false;
-// Seems the h/w forces this with an 80 column card in slot 3...
-	slot3Memory = (slotC3ROM ? &rom[0] : &rom[0xC300]);
-//	slot3Memory = &rom[0xC300];
-#endif
 }
 
 
@@ -718,7 +1281,9 @@ We need to see where this is being switched from; if we know that, we can switch
 //
 uint8_t SwitchINTC8ROMR(uint16_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Hitting INTC8ROM (read)...\n");
+#endif
 	intC8ROM = false;
 	return rom[0xCFFF];
 }
@@ -729,21 +1294,25 @@ WriteLog("Hitting INTC8ROM (read)...\n");
 //
 void SwitchINTC8ROMW(uint16_t, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Hitting INTC8ROM (write)...\n");
+#endif
 	intC8ROM = false;
 }
 
 
 void Switch80COL(uint16_t address, uint8_t)
 {
-	col80Mode = (bool)(address & 0x01);
+	SetDisplaySwitch(col80Mode, address & 0x01);
 }
 
 
 void SwitchALTCHARSET(uint16_t address, uint8_t)
 {
-	alternateCharset = (bool)(address & 0x01);
+	SetDisplaySwitch(alternateCharset, address & 0x01);
+#ifdef SWITCH_DEBUG
 WriteLog("Setting ALTCHARSET to %s...\n", (alternateCharset ? "ON" : "off"));
+#endif
 }
 
 
@@ -809,7 +1378,7 @@ uint8_t Read80STORE(uint16_t)
 
 uint8_t ReadVBL(uint16_t)
 {
-	return (uint8_t)vbl << 7;
+	return (uint8_t)VBL() << 7;
 }
 
 
@@ -857,6 +1426,7 @@ void WriteKeyStrobe(uint16_t, uint8_t)
 
 uint8_t ReadSpeaker(uint16_t)
 {
+	SyncSamples();
 	ToggleSpeaker();
 	return 0;
 }
@@ -864,6 +1434,7 @@ uint8_t ReadSpeaker(uint16_t)
 
 void WriteSpeaker(uint16_t, uint8_t)
 {
+	SyncSamples();
 	ToggleSpeaker();
 }
 
@@ -871,7 +1442,10 @@ void WriteSpeaker(uint16_t, uint8_t)
 uint8_t SwitchLCR(uint16_t address)
 {
 	lcState = address & 0x0B;
-	SwitchLC();
+#ifdef LC_DEBUG
+WriteLog("SwitchLC: lcState = $%X\n", lcState);
+#endif
+	MapMemory();
 	return 0;
 }
 
@@ -879,126 +1453,133 @@ uint8_t SwitchLCR(uint16_t address)
 void SwitchLCW(uint16_t address, uint8_t)
 {
 	lcState = address & 0x0B;
-	SwitchLC();
+#ifdef LC_DEBUG
+WriteLog("SwitchLC: lcState = $%X\n", lcState);
+#endif
+	MapMemory();
 }
 
 
-void SwitchLC(void)
+//
+// $D000-$FFFF follows the language card state (and ALTZP)
+//
+static void MapLC(MemoryPage * table, uint16_t state)
 {
-	switch (lcState)
+	uint8_t * bank = (state & MMU_ALTZP ? ram2 : ram);
+	uint8_t * lcBankR = 0, * lcBankW = 0, * upperR = 0, * upperW = 0;
+
+	switch (state & MMU_LCSTATE)
 	{
 	case 0x00:
-#ifdef LC_DEBUG
-WriteLog("SwitchLC: Read RAM bank 2, no write\n");
-#endif
 		// [R ] Read RAM bank 2; no write
-		lcBankMemoryR = (altzp ? &ram2[0xD000] : &ram[0xD000]);
-		lcBankMemoryW = 0;
-		upperMemoryR = (altzp ? &ram2[0xE000] : &ram[0xE000]);
-		upperMemoryW = 0;
+		lcBankR = &bank[0xD000];
+		lcBankW = 0;
+		upperR = &bank[0xE000];
+		upperW = 0;
 		break;
 	case 0x01:
-#ifdef LC_DEBUG
-WriteLog("SwitchLC: Read ROM, write bank 2\n");
-#endif
 		// [RR] Read ROM; write RAM bank 2
-		lcBankMemoryR = &rom[0xD000];
-		lcBankMemoryW = (altzp ? &ram2[0xD000] : &ram[0xD000]);
-		upperMemoryR = &rom[0xE000];
-		upperMemoryW = (altzp ? &ram2[0xE000] : &ram[0xE000]);
+		lcBankR = &rom[0xD000];
+		lcBankW = &bank[0xD000];
+		upperR = &rom[0xE000];
+		upperW = &bank[0xE000];
 		break;
 	case 0x02:
-#ifdef LC_DEBUG
-WriteLog("SwitchLC: Read ROM, no write\n");
-#endif
 		// [R ] Read ROM; no write
-		lcBankMemoryR = &rom[0xD000];
-		lcBankMemoryW = 0;
-		upperMemoryR = &rom[0xE000];
-		upperMemoryW = 0;
+		lcBankR = &rom[0xD000];
+		lcBankW = 0;
+		upperR = &rom[0xE000];
+		upperW = 0;
 		break;
 	case 0x03:
-#ifdef LC_DEBUG
-WriteLog("SwitchLC: Read/write bank 2\n");
-#endif
 		// [RR] Read RAM bank 2; write RAM bank 2
-		lcBankMemoryR = (altzp ? &ram2[0xD000] : &ram[0xD000]);
-		lcBankMemoryW = (altzp ? &ram2[0xD000] : &ram[0xD000]);
-		upperMemoryR = (altzp ? &ram2[0xE000] : &ram[0xE000]);
-		upperMemoryW = (altzp ? &ram2[0xE000] : &ram[0xE000]);
+		lcBankR = &bank[0xD000];
+		lcBankW = &bank[0xD000];
+		upperR = &bank[0xE000];
+		upperW = &bank[0xE000];
 		break;
 	case 0x08:
 		// [R ] Read RAM bank 1; no write
-		lcBankMemoryR = (altzp ? &ram2[0xC000] : &ram[0xC000]);
-		lcBankMemoryW = 0;
-		upperMemoryR = (altzp ? &ram2[0xE000] : &ram[0xE000]);
-		upperMemoryW = 0;
+		lcBankR = &bank[0xC000];
+		lcBankW = 0;
+		upperR = &bank[0xE000];
+		upperW = 0;
 		break;
 	case 0x09:
 		// [RR] Read ROM; write RAM bank 1
-		lcBankMemoryR = &rom[0xD000];
-		lcBankMemoryW = (altzp ? &ram2[0xC000] : &ram[0xC000]);
-		upperMemoryR = &rom[0xE000];
-		upperMemoryW = (altzp ? &ram2[0xE000] : &ram[0xE000]);
+		lcBankR = &rom[0xD000];
+		lcBankW = &bank[0xC000];
+		upperR = &rom[0xE000];
+		upperW = &bank[0xE000];
 		break;
 	case 0x0A:
 		// [R ] Read ROM; no write
-		lcBankMemoryR = &rom[0xD000];
-		lcBankMemoryW = 0;
-		upperMemoryR = &rom[0xE000];
-		upperMemoryW = 0;
+		lcBankR = &rom[0xD000];
+		lcBankW = 0;
+		upperR = &rom[0xE000];
+		upperW = 0;
 		break;
 	case 0x0B:
 		// [RR] Read RAM bank 1; write RAM bank 1
-		lcBankMemoryR = (altzp ? &ram2[0xC000] : &ram[0xC000]);
-		lcBankMemoryW = (altzp ? &ram2[0xC000] : &ram[0xC000]);
-		upperMemoryR = (altzp ? &ram2[0xE000] : &ram[0xE000]);
-		upperMemoryW = (altzp ? &ram2[0xE000] : &ram[0xE000]);
+		lcBankR = &bank[0xC000];
+		lcBankW = &bank[0xC000];
+		upperR = &bank[0xE000];
+		upperW = &bank[0xE000];
 		break;
 	}
+	// A NULL write pointer makes the page read only
+	MapPages(table, 0xD0, 0xDF, lcBankR, lcBankW);
+	MapPages(table, 0xE0, 0xFF, upperR, upperW);
 }
 
 
 uint8_t SwitchTEXTR(uint16_t address)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting TEXT to %s...\n", (address & 0x01 ? "ON" : "off"));
-	textMode = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(textMode, address & 0x01);
 	return 0;
 }
 
 
 void SwitchTEXTW(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting TEXT to %s...\n", (address & 0x01 ? "ON" : "off"));
-	textMode = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(textMode, address & 0x01);
 }
 
 
 uint8_t SwitchMIXEDR(uint16_t address)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting MIXED to %s...\n", (address & 0x01 ? "ON" : "off"));
-	mixedMode = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(mixedMode, address & 0x01);
 	return 0;
 }
 
 
 void SwitchMIXEDW(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting MIXED to %s...\n", (address & 0x01 ? "ON" : "off"));
-	mixedMode = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(mixedMode, address & 0x01);
 }
 
 
 uint8_t SwitchPAGE2R(uint16_t address)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting PAGE2 to %s...\n", (address & 0x01 ? "ON" : "off"));
-	displayPage2 = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(displayPage2, address & 0x01);
 
 	if (store80Mode)
-	{
-		mainMemoryTextR = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-	}
+		MapMemory();
 
 	return 0;
 }
@@ -1006,38 +1587,50 @@ WriteLog("Setting PAGE2 to %s...\n", (address & 0x01 ? "ON" : "off"));
 
 void SwitchPAGE2W(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting PAGE2 to %s...\n", (address & 0x01 ? "ON" : "off"));
-	displayPage2 = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(displayPage2, address & 0x01);
 
 	if (store80Mode)
-	{
-		mainMemoryTextR = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-		mainMemoryTextW = (displayPage2 ? &ram2[0x0400] : &ram[0x0400]);
-	}
+		MapMemory();
 }
 
 
 uint8_t SwitchHIRESR(uint16_t address)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting HIRES to %s...\n", (address & 0x01 ? "ON" : "off"));
-	hiRes = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(hiRes, address & 0x01);
+
+	if (store80Mode)
+		MapMemory();
+
 	return 0;
 }
 
 
 void SwitchHIRESW(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting HIRES to %s...\n", (address & 0x01 ? "ON" : "off"));
-	hiRes = (bool)(address & 0x01);
+#endif
+	SetDisplaySwitch(hiRes, address & 0x01);
+
+	if (store80Mode)
+		MapMemory();
 }
 
 
 uint8_t SwitchDHIRESR(uint16_t address)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting DHIRES to %s (ioudis = %s)...\n", ((address & 0x01) ^ 0x01 ? "ON" : "off"), (ioudis ? "ON" : "off"));
+#endif
 	// Hmm, this breaks convention too, like SLOTCXROM
 	if (ioudis)
-		dhires = !((bool)(address & 0x01));
+		SetDisplaySwitch(dhires, !(address & 0x01));
 
 	return 0;
 }
@@ -1045,9 +1638,11 @@ WriteLog("Setting DHIRES to %s (ioudis = %s)...\n", ((address & 0x01) ^ 0x01 ? "
 
 void SwitchDHIRESW(uint16_t address, uint8_t)
 {
+#ifdef SWITCH_DEBUG
 WriteLog("Setting DHIRES to %s (ioudis = %s)...\n", ((address & 0x01) ^ 0x01 ? "ON" : "off"), (ioudis ? "ON" : "off"));
+#endif
 	if (ioudis)
-		dhires = !((bool)(address & 0x01));
+		SetDisplaySwitch(dhires, !(address & 0x01));
 }
 
 
@@ -1057,6 +1652,12 @@ void SwitchIOUDIS(uint16_t address, uint8_t)
 }
 
 
+void SwitchAuxBank(uint16_t, uint8_t byte)
+{
+	SelectAuxBank(byte);
+}
+
+
 uint8_t ReadButton0(uint16_t)
 {
 	return (uint8_t)openAppleDown << 7;
@@ -1095,15 +1696,49 @@ uint8_t ReadDHIRES(uint16_t)
 // Whenever a read is done to a MMIO location that is unconnected to anything,
 // it actually sees the RAM access done by the video generation hardware. Some
 // programs exploit this, so we emulate it here.
-
-// N.B.: frameCycles will be off by the true amount because this only
-//       increments by the amount of a speaker cycle, not the cycle count when
-//       the access happens... !!! FIX !!!
 uint8_t ReadFloatingBus(uint16_t)
 {
-	// Get the currently elapsed cycle count for this frame
-	uint32_t frameCycles = mainCPU.clock - frameCycleStart;
+	// The address so read is *always* in main RAM, not alt RAM
+	return ram[ScannerAddress(FrameCycle())];
+}
+
+
+//
+// What the video scanner is reading at frameCycles into the frame, in the
+// current video mode. Where the beam is says everything but the page; see
+// SetupScanner().
+//
+static inline uint16_t ScannerAddress(uint32_t frameCycles)
+{
+	bool page2 = !store80Mode && displayPage2;
+
+	if (textMode || !hiRes)
+		return scanText[frameCycles] | (page2 ? 0x800 : 0x400);
+
+	return scanHiRes[frameCycles] | (page2 ? 0x4000 : 0x2000);
+}
+
+
+//
+// Work out the video scanner's address for every cycle of the frame, for
+// TEXT/LORES & HIRES
+//
+static void SetupScanner(void)
+{
+	for(uint32_t frameCycles=0; frameCycles<CYCLES_PER_FRAME; frameCycles++)
+	{
+		scanText[frameCycles] = BeamAddress(frameCycles, false);
+		scanHiRes[frameCycles] = BeamAddress(frameCycles, true);
+	}
+}
 
+
+//
+// The scanner's address at frameCycles into the frame, worked out from the
+// H & V counters the way the hardware does it (less the page select bits)
+//
+static uint16_t BeamAddress(uint32_t frameCycles, bool hires)
+{
 	// Make counters out of the cycle count. There are 65 cycles per line.
 	uint32_t numLines = frameCycles / 65;
 	uint32_t numHTicks = frameCycles - (numLines * 65);
@@ -1122,16 +1757,107 @@ uint8_t ReadFloatingBus(uint16_t)
 		+ (((vcount & 0xC0) >> 6) | ((vcount & 0xC0) >> 4));
 	uint32_t address = ((vcount & 0x38) << 4) | ((sum & 0x0F) << 3) | (hcount & 0x07);
 
-	// Add in particulars for the gfx mode we're in...
-	if (textMode || (!textMode && !hiRes))
-		address |= (!(!store80Mode && displayPage2) ? 0x400 : 0)
-			| (!store80Mode && displayPage2 ? 0x800 : 0);
+	if (hires)
+		address |= (vcount & 0x07) << 10;
+
+	return address;
+}
+
+
+//
+// What the scanner should be reading at frameCycles into the frame, going by
+// how the display pages are laid out in memory instead of by the counters
+// (see "Understanding the Apple IIe", ch. 5): the V counter runs from $FA to
+// $1FF, & $100-$1BF are the 192 lines shown. Each line's 40 bytes start 25
+// cycles in (the H counter sees $00, then $40-$7F; the first 24 of those are
+// horizontal blanking), & the blanking reads the 24 bytes before them,
+// wrapping around inside the line's 128 byte block. The lines in vertical
+// blanking go on from the bottom of the screen as if it had 64 more, which
+// lands them in the "screen holes".
+//
+static uint16_t LayoutAddress(uint32_t frameCycles, bool hires, bool page2)
+{
+	uint32_t line = ((frameCycles / 65) + 0xFA) & 0xFF;
+	uint32_t tick = frameCycles % 65;
+	int32_t column = (int32_t)(tick == 0 ? 0 : tick - 1) - 24;
+	uint32_t base = ((line / 8) % 8) * 0x80 + (line / 64) * 0x28;
+
+	if (hires)
+		base += (line % 8) * 0x400 + (page2 ? 0x4000 : 0x2000);
 	else
-		address |= (!(!store80Mode && displayPage2) ? 0x2000: 0)
-			| (!store80Mode && displayPage2 ? 0x4000 : 0)
-			| ((vcount & 0x07) << 10);
+		base += (page2 ? 0x800 : 0x400);
 
-	// The address so read is *always* in main RAM, not alt RAM
-	return ram[address];
+	return (base & ~0x7F) | ((base + column) & 0x7F);
+}
+
+
+//
+// Check the address the floating bus reads against LayoutAddress() for every
+// cycle of the frame, under every combination of TEXT, HIRES, PAGE2 &
+// 80STORE, and against a few addresses everybody knows. SetupAddressMap() has
+// to have been called. Returns the # of mismatches found (which had better be
+// zero).
+//
+uint32_t CheckFloatingBus(void)
+{
+	// Start of line 0; end of the last line shown, which is the last byte
+	// of the page; & the first thing read in vertical blanking, which is
+	// the first screen hole
+	static const struct { uint32_t cycle; bool text, hires, page2; uint16_t address; } known[] = {
+		{ (6 * 65) + 25, true, false, false, 0x0400 },
+		{ (6 * 65) + 25, false, true, true, 0x4000 },
+		{ (197 * 65) + 64, true, false, false, 0x07F7 },
+		{ (197 * 65) + 64, false, true, false, 0x3FF7 },
+		{ (198 * 65) + 25, true, false, false, 0x0478 },
+		{ (198 * 65) + 25, false, true, false, 0x2078 }
+	};
+	bool textSave = textMode, hiResSave = hiRes;
+	bool page2Save = displayPage2, store80Save = store80Mode;
+	uint32_t mismatches = 0;
+
+	for(uint32_t mode=0; mode<16; mode++)
+	{
+		textMode = mode & 0x01;
+		hiRes = mode & 0x02;
+		displayPage2 = mode & 0x04;
+		store80Mode = mode & 0x08;
+		bool hires = !textMode && hiRes;
+		bool page2 = !store80Mode && displayPage2;
+
+		for(uint32_t frameCycles=0; frameCycles<CYCLES_PER_FRAME; frameCycles++)
+		{
+			uint16_t address = ScannerAddress(frameCycles);
+			uint16_t layout = LayoutAddress(frameCycles, hires, page2);
+
+			if ((address != layout) && (mismatches++ < 16))
+				WriteLog("MMU: Floating bus mismatch: TEXT=%u HIRES=%u PAGE2=%u 80STORE=%u cycle=%u: $%04X/$%04X\n",
+					textMode, hiRes, displayPage2, store80Mode, frameCycles,
+					address, layout);
+		}
+	}
+
+	for(uint32_t i=0; i<sizeof(known)/sizeof(known[0]); i++)
+	{
+		textMode = known[i].text;
+		hiRes = known[i].hires;
+		displayPage2 = known[i].page2;
+		store80Mode = false;
+		uint16_t address = ScannerAddress(known[i].cycle);
+
+		if (address != known[i].address)
+		{
+			mismatches++;
+			WriteLog("MMU: Floating bus mismatch: cycle=%u: $%04X, should be $%04X\n",
+				known[i].cycle, address, known[i].address);
+		}
+	}
+
+	textMode = textSave;
+	hiRes = hiResSave;
+	displayPage2 = page2Save;
+	store80Mode = store80Save;
+	WriteLog("MMU: Floating bus check done, %u mismatches.\n", mismatches);
+
+	return mismatches;
 }
 
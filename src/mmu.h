@@ -2,30 +2,160 @@
 #define __MMU_H__
 
 #include <stdint.h>
+#include <stdio.h>
+#include "apple2.h"
+#include "v65c02.h"
 
 // Macros for function pointers
 #define READFUNC(x) uint8_t (* x)(uint16_t)
 #define WRITEFUNC(x) void (* x)(uint16_t, uint8_t)
 
 enum { SLOT0 = 0, SLOT1, SLOT2, SLOT3, SLOT4, SLOT5, SLOT6, SLOT7 };
+enum { BANK_MAIN = 0, BANK_AUX, BANK_LC1, BANK_LC2, BANK_ROM, BANK_SLOT, BANK_IO,
+	NUM_BANKS };
 
-struct SlotData
+// Bank switch state, as packed by MMUState() (the low nybble is lcState)
+#define MMU_LCSTATE		0x000F
+#define MMU_RAMRD		0x0010
+#define MMU_RAMWRT		0x0020
+#define MMU_ALTZP		0x0040
+#define MMU_80STORE		0x0080
+#define MMU_PAGE2		0x0100
+#define MMU_HIRES		0x0200
+#define MMU_INTCXROM	0x0400
+#define MMU_SLOTC3ROM	0x0800
+#define MMU_INTC8ROM	0x1000
+
+class SlotCard;
+
+// One entry per 256 byte page of the 6502's address space. If read or write
+// is non-NULL, the access goes straight to host memory; otherwise, it goes
+// through readFunc or writeFunc.
+struct MemoryPage
+{
+	uint8_t * read;
+	uint8_t * write;
+	READFUNC(readFunc);
+	WRITEFUNC(writeFunc);
+};
+
+// Display memory ($0000-$5FFF of main & aux RAM) in 128 byte blocks; every
+// line of the text, lo-res & hi-res screens fits in one. The renderer only
+// redraws lines whose blocks were changed (see RenderVideoFrame() in
+// video.cpp), which it finds in the log below.
+#define VIDEO_BLOCKS	(0x6000 >> 7)
+
+// The display soft switches, packed (see VideoSwitches())
+#define VS_TEXT			0x01
+#define VS_MIXED		0x02
+#define VS_HIRES		0x04
+#define VS_DHIRES		0x08
+#define VS_80COL		0x10
+#define VS_PAGE2		0x20
+#define VS_ALTCHAR		0x40
+
+// Everything that changes what's on the screen (a write to one of the pages
+// the display shows, or a flip of one of its switches) gets logged with what
+// it was before, so the renderer can wind the screen back to what it was when
+// the beam drew each line. The log is a ring, so only the last
+// VIDEO_LOG_SIZE changes are in it; videoLogged counts all of them, and
+// nothing before videoLogCleared (see MarkVideoDirty()) counts.
+#define VIDEO_LOG_SIZE	0x8000			// Has to be a power of 2
+#define VIDEO_SWITCHES	0xFFFF			// Address of a switch flip
+
+struct VideoChange
+{
+	uint64_t clock;
+	uint16_t address;			// $0400-$0BFF, $2000-$5FFF or VIDEO_SWITCHES
+	uint8_t aux;				// In aux memory?
+	uint8_t old;				// Byte (or VideoSwitches()) before the change
+};
+
+//
+// Everything about the machine that the renderer looks at, copied out of it
+// (see TakeVideoSnapshot()) so a frame can be drawn while the CPU goes on
+// with the next one. Only the display pages of mem[] are kept up to date, and
+// log[] has the changes logged since the last snapshot, or since the beam
+// started on the last frame it finished, whichever are more (as far as the
+// log goes back).
+//
+struct VideoSnapshot
 {
-	READFUNC(ioR);		// I/O read function
-	WRITEFUNC(ioW);		// I/O write function
-	READFUNC(pageR);	// Driver page read function
-	WRITEFUNC(pageW);	// Driver page write function
-	READFUNC(extraR);	// Driver 2K read function
-	WRITEFUNC(extraW);	// Driver 2K write function
+	bool taken;						// Has anything been put in here yet?
+	uint64_t clock;					// When it was taken...
+	uint32_t frameCycle;			// ...and how far into the frame that was
+	uint8_t switches;				// VideoSwitches()
+	uint8_t mem[2][0x6000];			// Main & aux display memory
+	uint64_t first;					// # of the change in log[0]
+	uint64_t logged;				// videoLogged (so log[] ends before this)
+	uint64_t cleared;				// videoLogCleared
+	VideoChange log[VIDEO_LOG_SIZE];
 };
 
+extern MemoryPage * memPage;
+extern V65C02BlockCache codeCache;
+extern VideoChange videoLog[VIDEO_LOG_SIZE];
+extern uint64_t videoLogged;
+extern uint64_t videoLogCleared;
+
+
+//
+// Note what was there before address (or the switches) changed, as of now
+//
+static inline void LogVideoChange(uint16_t address, uint8_t aux, uint8_t old)
+{
+	VideoChange * change = &videoLog[videoLogged++ & (VIDEO_LOG_SIZE - 1)];
+	change->clock = mainCPU.clock;
+	change->address = address;
+	change->aux = aux;
+	change->old = old;
+}
+
+
+//
+// Has to be called for every write to plain memory, along with
+// codeCache.Written(), but *before* byte gets stored at p
+//
+static inline void VideoWrite(const uint8_t * p, uint8_t byte)
+{
+	uintptr_t offset = (uintptr_t)p - (uintptr_t)ram;
+	uint8_t aux = 0;
+
+	if (offset >= 0x6000)
+	{
+		offset = (uintptr_t)p - (uintptr_t)ram2;
+		aux = 1;
+	}
+
+	// Text & lo-res pages 1 & 2, and hi-res pages 1 & 2
+	if (((offset - 0x0400) >= 0x0800) && ((offset - 0x2000) >= 0x4000))
+		return;
+
+	if (*p != byte)
+		LogVideoChange(offset, aux, *p);
+}
+
 void SetupAddressMap(void);
 void ResetMMUPointers(void);
-void InstallSlotHandler(uint8_t slot, SlotData *);
+void InstallSlotCard(uint8_t slot, SlotCard * card);
+SlotCard * GetSlotCard(uint8_t slot);
 uint8_t AppleReadMem(uint16_t);
 void AppleWriteMem(uint16_t, uint8_t);
-void SwitchLC(void);
 uint8_t ReadFloatingBus(uint16_t);
+uint32_t CheckFloatingBus(void);
+bool PolledAddress(uint16_t);
+uint8_t MemoryBank(uint16_t);
+uint16_t MMUState(void);
+void TrapPages(const uint8_t * mask);
+void MarkVideoDirty(void);
+uint8_t VideoSwitches(void);
+void TakeVideoSnapshot(VideoSnapshot * snapshot);
+void SetAuxBanks(uint32_t banks);
+uint32_t AuxBanks(void);
+void ResetAuxMemory(void);
+void SelectAuxBank(uint8_t bank);
+void SaveAuxMemory(FILE * file);
+void LoadAuxMemory(FILE * file);
 
 #endif	// __MMU_H__
 
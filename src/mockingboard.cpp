@@ -16,85 +16,114 @@
 
 
 #include "mockingboard.h"
+
 #include "apple2.h"
-#include "mmu.h"
+#include "machine.h"
 
 
-MOCKINGBOARD mb[2];
+Mockingboard mb[2];
 
 
-void MBReset(void)
+Mockingboard::Mockingboard(): SlotCard(CARD_MOCKINGBOARD), viaClock(0)
 {
-	mb[0].via[0].Reset();
-	mb[0].via[1].Reset();
-	mb[0].ay[0].Reset();
-	mb[0].ay[1].Reset();
 }
 
 
-void MBWrite(int chipNum, uint8_t reg, uint8_t byte)
+//
+// $Cn00-$Cn0F is the left VIA, $Cn80-$Cn8F the right one
+//
+uint8_t Mockingboard::ReadROM(uint16_t address)
 {
-	V6522VIA * chip1 = &mb[0].via[chipNum];
-	chip1->Write(reg, byte);
+	uint8_t reg = address & 0x0F;
+	uint8_t chipNum = (address & 0x80) >> 7;
+	Run(mainCPU.clock);
 
-	if (reg == 0)
-		mb[0].ay[chipNum].WriteControl(chip1->orb & chip1->ddrb);
-	else if (reg == 1)
-		mb[0].ay[chipNum].WriteData(chip1->ora & chip1->ddra);
+	return via[chipNum].Read(reg);
 }
 
 
-uint8_t MBRead(int chipNum, uint8_t reg)
+void Mockingboard::WriteROM(uint16_t address, uint8_t byte)
 {
-	return mb[0].via[chipNum].Read(reg);
-}
+	uint8_t reg = address & 0x0F;
+	uint8_t chipNum = (address & 0x80) >> 7;
 
+	// Samples taken before now have to come from the AYs as they were, and
+	// the timers have to be caught up before they get changed
+	SyncSamples();
+	Run(mainCPU.clock);
 
-void MBRun(uint16_t cycles)
-{
-	if (mb[0].via[0].Run(cycles))
-		mainCPU.cpuFlags |= V65C02_ASSERT_LINE_IRQ;
+	V6522VIA * chip = &via[chipNum];
+	chip->Write(reg, byte);
 
-	if (mb[0].via[1].Run(cycles))
-		mainCPU.cpuFlags |= V65C02_ASSERT_LINE_NMI;
+	if (reg == 0)
+		ay[chipNum].WriteControl(chip->orb & chip->ddrb);
+	else if (reg == 1)
+		ay[chipNum].WriteData(chip->ora & chip->ddra);
+
+	Schedule();
 }
 
 
-void MBSaveState(FILE * file)
+void Mockingboard::Reset(void)
 {
-	fwrite(&mb[0], 1, sizeof(struct MOCKINGBOARD), file);
-	fwrite(&mb[1], 1, sizeof(struct MOCKINGBOARD), file);
+	via[0].Reset();
+	via[1].Reset();
+	ay[0].Reset();
+	ay[1].Reset();
+	viaClock = mainCPU.clock;
+	Schedule();
 }
 
 
-void MBLoadState(FILE * file)
+void Mockingboard::SaveState(FILE * file)
 {
-	fread(&mb[0], 1, sizeof(struct MOCKINGBOARD), file);
-	fread(&mb[1], 1, sizeof(struct MOCKINGBOARD), file);
+	fwrite(via, 1, sizeof(via), file);
+	fwrite(ay, 1, sizeof(ay), file);
 }
 
 
-static uint8_t SlotPageR(uint16_t address)
+void Mockingboard::LoadState(FILE * file)
 {
-	uint8_t regNum = address & 0x0F;
-	uint8_t chipNum = (address & 0x80) >> 7;
-
-	return MBRead(chipNum, regNum);
+	fread(via, 1, sizeof(via), file);
+	fread(ay, 1, sizeof(ay), file);
+	viaClock = mainCPU.clock;
 }
 
 
-static void SlotPageW(uint16_t address, uint8_t byte)
+//
+// Run the VIAs up to clock. This happens whenever they get touched, and
+// whenever the CPU gets to Deadline().
+//
+void Mockingboard::Run(uint64_t clock)
 {
-	uint8_t regNum = address & 0x0F;
-	uint8_t chipNum = (address & 0x80) >> 7;
+	uint32_t cycles = (uint32_t)(clock - viaClock);
+	viaClock = clock;
+
+	if (cycles == 0)
+		return;
 
-	MBWrite(chipNum, regNum, byte);
+	if (via[0].Run(cycles))
+		mainCPU.cpuFlags |= V65C02_ASSERT_LINE_IRQ;
+
+	if (via[1].Run(cycles))
+		mainCPU.cpuFlags |= V65C02_ASSERT_LINE_NMI;
 }
 
 
-void InstallMockingboard(uint8_t slot)
+//
+// The cycle by which the VIAs have to be run to get their interrupts in on
+// time. (A timer that's already at zero goes off the next time it's run for
+// any time at all.)
+//
+uint64_t Mockingboard::Deadline(void)
 {
-	SlotData mbDevice = { 0, 0, SlotPageR, SlotPageW, 0, 0 };
-	InstallSlotHandler(slot, &mbDevice);
+	uint32_t cycles0 = via[0].CyclesToIRQ();
+	uint32_t cycles1 = via[1].CyclesToIRQ();
+	uint32_t cycles = (cycles0 < cycles1 ? cycles0 : cycles1);
+
+	if (cycles == 0xFFFFFFFF)
+		return EVENT_NEVER;
+
+	return viaClock + (cycles ? cycles : 1);
 }
 
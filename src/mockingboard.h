@@ -10,26 +10,33 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include "slotcard.h"
 #include "v6522via.h"
 #include "vay8910.h"
 
-struct MOCKINGBOARD
+class Mockingboard : public SlotCard
 {
-	V6522VIA via[2];
-	VAY_3_8910 ay[2];
+	public:
+		Mockingboard();
+
+		uint8_t ReadROM(uint16_t address);
+		void WriteROM(uint16_t address, uint8_t byte);
+		void Reset(void);
+		void SaveState(FILE *);
+		void LoadState(FILE *);
+		void Run(uint64_t clock);
+		uint64_t Deadline(void);
+
+	public:
+		V6522VIA via[2];
+		VAY_3_8910 ay[2];
+
+	private:
+		uint64_t viaClock;			// The VIAs have been run up to here
 };
 
 // Exported variables
-extern MOCKINGBOARD mb[];
-
-// Exported functions
-void MBReset(void);
-void MBWrite(int chipNum, uint8_t reg, uint8_t byte);
-uint8_t MBRead(int chipNum, uint8_t reg);
-void MBRun(uint16_t cycles);
-void MBSaveState(FILE *);
-void MBLoadState(FILE *);
-void InstallMockingboard(uint8_t slot);
+extern Mockingboard mb[];
 
 #endif	// __MOCKINGBOARD_H__
 
@@ -0,0 +1,388 @@
+//
+// 65C02 execution profiler
+//
+// The core does the counting (see ProfileInst() in v65c02core.h); this holds
+// the profile for the main CPU and writes it out. Code is kept apart by the
+// bank it ran from (see MemoryBank() in mmu.cpp), and gets disassembled from
+// the bytes that were actually run there instead of from what happens to be
+// in memory when the profile is saved.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dis65c02.h"
+#include "log.h"
+#include "mmu.h"
+
+
+// Global variables (exported)
+
+V65C02Profile * cpuProfile = NULL;
+const char * bankName[NUM_BANKS] = { "main", "aux", "lc1", "lc2", "rom", "slot", "io" };
+
+// Local variables
+
+struct ProfileLine
+{
+	uint8_t bank;
+	uint16_t address;
+	uint64_t cycles;
+};
+
+// Local functions
+
+static void Totals(uint64_t & count, uint64_t & cycles);
+static const char * Disassemble(uint8_t bank, uint16_t address, char * buf);
+static const char * Instruction(uint8_t bank, uint16_t address, char * buf);
+static const char * Mnemonic(uint8_t opcode, char * buf);
+
+
+//
+// Start a fresh profile (throwing out the old one, if any)
+//
+bool StartProfile(void)
+{
+	if (!cpuProfile)
+		cpuProfile = (V65C02Profile *)malloc(sizeof(V65C02Profile));
+
+	if (!cpuProfile)
+	{
+		WriteLog("Profile: Could not allocate %u bytes for the profile!\n", (uint32_t)sizeof(V65C02Profile));
+		return false;
+	}
+
+	memset(cpuProfile, 0, sizeof(V65C02Profile));
+
+	return true;
+}
+
+
+void StopProfile(void)
+{
+	free(cpuProfile);
+	cpuProfile = NULL;
+}
+
+
+//
+// Write out one line per address that ran anything, in bank & address order
+//
+bool SaveProfileCSV(const char * filename)
+{
+	FILE * file = fopen(filename, "w");
+
+	if (!cpuProfile || !file)
+	{
+		WriteLog("Profile: Could not write \"%s\"!\n", filename);
+
+		if (file)
+			fclose(file);
+
+		return false;
+	}
+
+	char buf[80];
+	fprintf(file, "bank,address,count,cycles,instruction,changed\n");
+
+	for(int bank=0; bank<NUM_BANKS; bank++)
+	{
+		for(uint32_t address=0; address<0x10000; address++)
+		{
+			if (cpuProfile->count[bank][address] == 0)
+				continue;
+
+			fprintf(file, "%s,$%04X,%llu,%llu,\"%s\",%d\n", bankName[bank], address,
+				(unsigned long long)cpuProfile->count[bank][address],
+				(unsigned long long)cpuProfile->cycles[bank][address],
+				Instruction(bank, address, buf), cpuProfile->changed[bank][address]);
+		}
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+
+//
+// Write out the opcode histogram, one line per opcode
+//
+bool SaveOpcodeCSV(const char * filename)
+{
+	FILE * file = fopen(filename, "w");
+
+	if (!cpuProfile || !file)
+	{
+		WriteLog("Profile: Could not write \"%s\"!\n", filename);
+
+		if (file)
+			fclose(file);
+
+		return false;
+	}
+
+	char buf[8];
+	fprintf(file, "opcode,mnemonic,count,cycles\n");
+
+	for(int op=0; op<256; op++)
+		fprintf(file, "$%02X,%s,%llu,%llu\n", op, Mnemonic(op, buf),
+			(unsigned long long)cpuProfile->opCount[op],
+			(unsigned long long)cpuProfile->opCycles[op]);
+
+	fclose(file);
+
+	return true;
+}
+
+
+//
+// Write out the whole thing (totals, penalties, addresses & opcodes) as JSON
+//
+bool SaveProfileJSON(const char * filename)
+{
+	FILE * file = fopen(filename, "w");
+
+	if (!cpuProfile || !file)
+	{
+		WriteLog("Profile: Could not write \"%s\"!\n", filename);
+
+		if (file)
+			fclose(file);
+
+		return false;
+	}
+
+	char buf[80];
+	uint64_t count, cycles;
+	Totals(count, cycles);
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"instructions\": %llu,\n", (unsigned long long)count);
+	fprintf(file, "  \"cycles\": %llu,\n", (unsigned long long)cycles);
+	fprintf(file, "  \"branchesTaken\": %llu,\n", (unsigned long long)cpuProfile->branchesTaken);
+	fprintf(file, "  \"pageCrossingCycles\": %llu,\n", (unsigned long long)cpuProfile->pageCycles);
+	fprintf(file, "  \"decimalModeCycles\": %llu,\n", (unsigned long long)cpuProfile->bcdCycles);
+	fprintf(file, "  \"addresses\": [");
+
+	const char * sep = "\n";
+
+	for(int bank=0; bank<NUM_BANKS; bank++)
+	{
+		for(uint32_t address=0; address<0x10000; address++)
+		{
+			if (cpuProfile->count[bank][address] == 0)
+				continue;
+
+			fprintf(file, "%s    { \"bank\": \"%s\", \"address\": %u, \"count\": %llu, \"cycles\": %llu, \"instruction\": \"%s\", \"changed\": %s }",
+				sep, bankName[bank], address,
+				(unsigned long long)cpuProfile->count[bank][address],
+				(unsigned long long)cpuProfile->cycles[bank][address],
+				Instruction(bank, address, buf),
+				(cpuProfile->changed[bank][address] ? "true" : "false"));
+			sep = ",\n";
+		}
+	}
+
+	fprintf(file, "\n  ],\n");
+	fprintf(file, "  \"opcodes\": [");
+	sep = "\n";
+
+	for(int op=0; op<256; op++)
+	{
+		if (cpuProfile->opCount[op] == 0)
+			continue;
+
+		fprintf(file, "%s    { \"opcode\": %u, \"mnemonic\": \"%s\", \"count\": %llu, \"cycles\": %llu }",
+			sep, op, Mnemonic(op, buf),
+			(unsigned long long)cpuProfile->opCount[op],
+			(unsigned long long)cpuProfile->opCycles[op]);
+		sep = ",\n";
+	}
+
+	fprintf(file, "\n  ]\n}\n");
+	fclose(file);
+
+	return true;
+}
+
+
+static int CompareLines(const void * a, const void * b)
+{
+	uint64_t cyclesA = ((const ProfileLine *)a)->cycles;
+	uint64_t cyclesB = ((const ProfileLine *)b)->cycles;
+
+	return (cyclesA < cyclesB ? 1 : (cyclesA > cyclesB ? -1 : 0));
+}
+
+
+//
+// Write out a gprof style flat profile: every address that ran anything,
+// busiest first, with its disassembly; then the same for the opcodes
+//
+bool SaveFlatProfile(const char * filename)
+{
+	FILE * file = fopen(filename, "w");
+
+	if (!cpuProfile || !file)
+	{
+		WriteLog("Profile: Could not write \"%s\"!\n", filename);
+
+		if (file)
+			fclose(file);
+
+		return false;
+	}
+
+	ProfileLine * line = (ProfileLine *)malloc(sizeof(ProfileLine) * NUM_BANKS * 0x10000);
+	uint32_t numLines = 0;
+
+	if (!line)
+	{
+		fclose(file);
+		return false;
+	}
+
+	for(int bank=0; bank<NUM_BANKS; bank++)
+	{
+		for(uint32_t address=0; address<0x10000; address++)
+		{
+			if (cpuProfile->count[bank][address] == 0)
+				continue;
+
+			line[numLines].bank = bank;
+			line[numLines].address = address;
+			line[numLines].cycles = cpuProfile->cycles[bank][address];
+			numLines++;
+		}
+	}
+
+	qsort(line, numLines, sizeof(ProfileLine), CompareLines);
+
+	char buf[80];
+	uint64_t count, cycles;
+	Totals(count, cycles);
+	double total = (cycles > 0 ? (double)cycles : 1.0);
+
+	fprintf(file, "Flat profile: %llu instructions, %llu cycles\n",
+		(unsigned long long)count, (unsigned long long)cycles);
+	fprintf(file, "Branches taken: %llu, page crossing penalties: %llu cycles, decimal mode penalties: %llu cycles\n\n",
+		(unsigned long long)cpuProfile->branchesTaken,
+		(unsigned long long)cpuProfile->pageCycles,
+		(unsigned long long)cpuProfile->bcdCycles);
+	fprintf(file, "  %% cycles   cumulative       cycles        count  bank  instruction\n");
+
+	uint64_t cumulative = 0;
+
+	for(uint32_t i=0; i<numLines; i++)
+	{
+		uint8_t bank = line[i].bank;
+		uint16_t address = line[i].address;
+		cumulative += line[i].cycles;
+
+		fprintf(file, "%9.2lf %12.2lf %12llu %12llu  %-4s %c%s\n",
+			(double)line[i].cycles * 100.0 / total,
+			(double)cumulative * 100.0 / total,
+			(unsigned long long)line[i].cycles,
+			(unsigned long long)cpuProfile->count[bank][address],
+			bankName[bank], (cpuProfile->changed[bank][address] ? '*' : ' '),
+			Disassemble(bank, address, buf));
+	}
+
+	fprintf(file, "\n* More than one instruction ran at this address; this is the last one.\n");
+
+	// Reuse the sort for the opcodes (the address is the opcode here)
+	numLines = 0;
+
+	for(int op=0; op<256; op++)
+	{
+		if (cpuProfile->opCount[op] == 0)
+			continue;
+
+		line[numLines].address = op;
+		line[numLines].cycles = cpuProfile->opCycles[op];
+		numLines++;
+	}
+
+	qsort(line, numLines, sizeof(ProfileLine), CompareLines);
+
+	fprintf(file, "\nOpcode histogram:\n\n");
+	fprintf(file, "  %% cycles       cycles        count  opcode\n");
+
+	for(uint32_t i=0; i<numLines; i++)
+	{
+		uint8_t op = (uint8_t)line[i].address;
+
+		fprintf(file, "%9.2lf %12llu %12llu  $%02X %s\n",
+			(double)line[i].cycles * 100.0 / total,
+			(unsigned long long)line[i].cycles,
+			(unsigned long long)cpuProfile->opCount[op], op, Mnemonic(op, buf));
+	}
+
+	free(line);
+	fclose(file);
+
+	return true;
+}
+
+
+static void Totals(uint64_t & count, uint64_t & cycles)
+{
+	count = cycles = 0;
+
+	for(int op=0; op<256; op++)
+	{
+		count += cpuProfile->opCount[op];
+		cycles += cpuProfile->opCycles[op];
+	}
+}
+
+
+//
+// Disassemble what last ran at address in bank (bytes & all), as a full line
+// from Decode65C02()
+//
+static const char * Disassemble(uint8_t bank, uint16_t address, char * buf)
+{
+	uint8_t bytes[3];
+
+	bytes[0] = cpuProfile->opcode[bank][address];
+	bytes[1] = cpuProfile->operand[bank][address] & 0xFF;
+	bytes[2] = cpuProfile->operand[bank][address] >> 8;
+	Decode65C02(bytes, buf, address);
+
+	// Lose the padding at the end
+	for(int i=strlen(buf)-1; (i>=0) && (buf[i]==' '); i--)
+		buf[i] = 0;
+
+	return buf;
+}
+
+
+//
+// Same as above, but just the instruction (no address or bytes)
+//
+static const char * Instruction(uint8_t bank, uint16_t address, char * buf)
+{
+	// Decode65C02() puts the instruction after "XXXX: XX XX XX "
+	Disassemble(bank, address, buf);
+
+	return buf + 16;
+}
+
+
+static const char * Mnemonic(uint8_t opcode, char * buf)
+{
+	strcpy(buf, Mnemonic65C02(opcode));
+
+	for(int i=strlen(buf)-1; (i>=0) && (buf[i]==' '); i--)
+		buf[i] = 0;
+
+	return buf;
+}
+
@@ -0,0 +1,30 @@
+//
+// profile.h: 65C02 execution profiler
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+#include "mmu.h"
+#include "v65c02.h"
+
+// Global variables (exported)
+
+extern V65C02Profile * cpuProfile;		// NULL when not profiling
+extern const char * bankName[NUM_BANKS];	// What BANK_* are called (see mmu.h)
+
+// Exported functions
+
+bool StartProfile(void);
+void StopProfile(void);
+bool SaveProfileCSV(const char * filename);
+bool SaveOpcodeCSV(const char * filename);
+bool SaveProfileJSON(const char * filename);
+bool SaveFlatProfile(const char * filename);
+
+#endif	// __PROFILE_H__
+
@@ -0,0 +1,341 @@
+//
+// SDL host video support
+//
+// Window, renderer & on-screen message handling for the SDL front end; the
+// Apple video modes themselves are rendered in video.cpp
+//
+// by James Hammons
+// (c) 2005-2018 Underground Software
+//
+
+#include "video.h"
+
+#include <string.h>					// for memset()
+#include <stdio.h>
+#include <stdarg.h>					// for va_* stuff
+#include <SDL2/SDL.h>
+#include "apple2.h"
+#include "apple2-icon-64x64.h"
+#include "log.h"
+#include "settings.h"
+#include "gui/font14pt.h"
+#include "gui/gui.h"
+
+// Global variables
+
+SDL_Renderer * sdlRenderer = NULL;
+SDL_Window * sdlWindow = NULL;
+
+// Local variables
+
+static SDL_Texture * sdlTexture = NULL;
+static uint32_t * scrBuffer;
+static bool showFrameTicks = false;
+
+// The Apple screen, as of the last frame; only the lines that change get
+// redrawn & sent to the texture. Messages get drawn over a copy of it.
+static uint32_t appleScreen[VIRTUAL_SCREEN_WIDTH * VIRTUAL_SCREEN_HEIGHT];
+static uint32_t overlayScreen[VIRTUAL_SCREEN_WIDTH * VIRTUAL_SCREEN_HEIGHT];
+static bool overlaid = false;			// Texture has more than appleScreen
+
+
+void ToggleTickDisplay(void)
+{
+	showFrameTicks = !showFrameTicks;
+}
+
+
+static uint32_t msgTicks = 0;
+static char message[4096];
+
+void SpawnMessage(const char * text, ...)
+{
+	va_list arg;
+
+	va_start(arg, text);
+	vsprintf(message, text, arg);
+	va_end(arg);
+
+	msgTicks = 120;
+//WriteLog("\n%s\n", message);
+}
+
+
+static void DrawString2(uint32_t x, uint32_t y, uint32_t color, char * msg);
+static void DrawString(void)
+{
+//This approach works, and seems to be fast enough... Though it probably would
+//be better to make the oversized font to match this one...
+	for(uint32_t x=7; x<=9; x++)
+		for(uint32_t y=7; y<=9; y++)
+			DrawString2(x, y, 0x00000000, message);
+
+	DrawString2(8, 8, 0x0020FF20, message);
+}
+
+
+static void DrawString(uint32_t x, uint32_t y, uint32_t color, char * msg)
+{
+//This approach works, and seems to be fast enough... Though it probably would
+//be better to make the oversized font to match this one...
+	for(uint32_t xx=x-1; xx<=x+1; xx++)
+		for(uint32_t yy=y-1; yy<=y+1; yy++)
+			DrawString2(xx, yy, 0x00000000, msg);
+
+	DrawString2(x, y, color, msg);
+}
+
+
+static void DrawString2(uint32_t x, uint32_t y, uint32_t color, char * msg)
+{
+	uint32_t length = strlen(msg), address = x + (y * VIRTUAL_SCREEN_WIDTH);
+	uint8_t nBlue = (color >> 16) & 0xFF, nGreen = (color >> 8) & 0xFF, nRed = color & 0xFF;
+
+	for(uint32_t i=0; i<length; i++)
+	{
+		uint8_t c = msg[i];
+		c = (c < 32 ? 0 : c - 32);
+		uint32_t fontAddr = (uint32_t)c * FONT_WIDTH * FONT_HEIGHT;
+
+		for(uint32_t yy=0; yy<FONT_HEIGHT; yy++)
+		{
+			for(uint32_t xx=0; xx<FONT_WIDTH; xx++)
+			{
+				uint8_t trans = font2[fontAddr++];
+
+				if (trans)
+				{
+					uint32_t existingColor = *(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH));
+
+					uint8_t eBlue = (existingColor >> 16) & 0xFF,
+						eGreen = (existingColor >> 8) & 0xFF,
+						eRed = existingColor & 0xFF;
+
+//This could be sped up by using a table of 5 + 5 + 5 bits (32 levels transparency -> 32768 entries)
+//Here we've modified it to have 33 levels of transparency (could have any # we want!)
+//because dividing by 32 is faster than dividing by 31...!
+					uint8_t invTrans = 255 - trans;
+
+					uint32_t bRed   = (eRed   * invTrans + nRed   * trans) / 255;
+					uint32_t bGreen = (eGreen * invTrans + nGreen * trans) / 255;
+					uint32_t bBlue  = (eBlue  * invTrans + nBlue  * trans) / 255;
+
+//THIS IS NOT ENDIAN SAFE
+//NB: Setting the alpha channel here does nothing.
+					*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = 0x7F000000 | (bBlue << 16) | (bGreen << 8) | bRed;
+				}
+			}
+		}
+
+		address += FONT_WIDTH;
+	}
+}
+
+
+static void DrawFrameTicks(void)
+{
+	uint32_t color = 0x00FF2020;
+	uint32_t address = 8 + (24 * VIRTUAL_SCREEN_WIDTH);
+
+	for(uint32_t i=0; i<17; i++)
+	{
+		for(uint32_t yy=0; yy<5; yy++)
+		{
+			for(uint32_t xx=0; xx<9; xx++)
+			{
+//THIS IS NOT ENDIAN SAFE
+//NB: Setting the alpha channel here does nothing.
+				*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = 0x7F000000;
+			}
+		}
+
+		address += (5 * VIRTUAL_SCREEN_WIDTH);
+	}
+
+	address = 8 + (24 * VIRTUAL_SCREEN_WIDTH);
+
+	// frameTicks is the amount of time remaining; so to show the amount
+	// consumed, we subtract it from 17.
+	uint32_t bars = 17 - frameTicks;
+
+	if (bars & 0x80000000)
+		bars = 0;
+
+	for(uint32_t i=0; i<17; i++)
+	{
+		for(uint32_t yy=1; yy<4; yy++)
+		{
+			for(uint32_t xx=1; xx<8; xx++)
+			{
+//THIS IS NOT ENDIAN SAFE
+//NB: Setting the alpha channel here does nothing.
+				*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = (i < bars ? color : 0x003F0000);
+			}
+		}
+
+		address += (5 * VIRTUAL_SCREEN_WIDTH);
+	}
+
+	static char msg[32];
+
+	if ((frameTimePtr % 15) == 0)
+	{
+//		uint32_t prevClock = (frameTimePtr + 1) % 60;
+		uint64_t prevClock = (frameTimePtr + 1) % 60;
+//		float fps = 59.0f / (((float)frameTime[frameTimePtr] - (float)frameTime[prevClock]) / 1000.0f);
+		double fps = 59.0 / ((double)(frameTime[frameTimePtr] - frameTime[prevClock]) / (double)SDL_GetPerformanceFrequency());
+		sprintf(msg, "%.1lf FPS", fps);
+	}
+
+	DrawString(20, 24, color, msg);
+}
+
+
+//
+// Prime SDL and create surfaces
+//
+bool InitVideo(void)
+{
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_NOPARACHUTE) != 0)
+	{
+		WriteLog("Video: Could not initialize the SDL library: %s\n", SDL_GetError());
+		return false;
+	}
+
+	sdlWindow = SDL_CreateWindow("Apple2", settings.winX, settings.winY, VIRTUAL_SCREEN_WIDTH * 2, VIRTUAL_SCREEN_HEIGHT * 2, 0);
+
+	if (sdlWindow == NULL)
+	{
+		WriteLog("Video: Could not create window: %s\n", SDL_GetError());
+		return false;
+	}
+
+	sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+
+	if (sdlRenderer == NULL)
+	{
+		WriteLog("Video: Could not create renderer: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Make sure what we put there is what we get:
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+	SDL_RenderSetLogicalSize(sdlRenderer, VIRTUAL_SCREEN_WIDTH, VIRTUAL_SCREEN_HEIGHT);
+
+	// Set the application's icon & title...
+	SDL_Surface * iconSurface = SDL_CreateRGBSurfaceFrom(icon, 64, 64, 32, 64*4, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000);
+	SDL_SetWindowIcon(sdlWindow, iconSurface);
+	SDL_FreeSurface(iconSurface);
+	SDL_SetWindowTitle(sdlWindow, "Apple2 Emulator");
+
+	sdlTexture = SDL_CreateTexture(sdlRenderer,
+		SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
+		VIRTUAL_SCREEN_WIDTH, VIRTUAL_SCREEN_HEIGHT);
+
+	// Start in fullscreen, if user requested it via config file
+	int response = SDL_SetWindowFullscreen(sdlWindow, (settings.fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
+
+	if (response != 0)
+		WriteLog("Video::FullScreen: SDL error = %s\n", SDL_GetError());
+
+	SetupBlurTable();
+
+	WriteLog("Video: Successfully initialized.\n");
+	return true;
+}
+
+
+//
+// Free various SDL components
+//
+void VideoDone(void)
+{
+	WriteLog("Video: Shutting down SDL...\n");
+	SDL_DestroyTexture(sdlTexture);
+	SDL_DestroyRenderer(sdlRenderer);
+	SDL_DestroyWindow(sdlWindow);
+	SDL_Quit();
+	WriteLog("Video: Done.\n");
+}
+
+
+//
+// Render the Apple video screen to the primary texture, from the snapshot if
+// there is one (see TakeVideoSnapshot() in mmu.cpp), else from the machine as
+// it is. Only the lines that changed get uploaded, unless there's a message
+// (or the frame ticks) to put over it, in which case the whole thing goes.
+//
+void RenderAppleScreen(SDL_Renderer * renderer, const VideoSnapshot * snapshot/*= NULL*/)
+{
+	const int pitch = VIRTUAL_SCREEN_WIDTH * sizeof(uint32_t);
+	uint8_t redrawn[VIRTUAL_SCREEN_HEIGHT / 2];
+
+	if ((GUI::powerOnState == true) && snapshot)
+		RenderVideoSnapshot(snapshot, appleScreen, redrawn);
+	else if (GUI::powerOnState == true)
+		RenderVideoFrame(appleScreen, redrawn);
+	else
+	{
+		memset(appleScreen, 0, sizeof(appleScreen));
+		memset(redrawn, 1, sizeof(redrawn));
+		InvalidateVideo();
+	}
+
+	if (msgTicks || showFrameTicks)
+	{
+		memcpy(overlayScreen, appleScreen, sizeof(overlayScreen));
+		scrBuffer = overlayScreen;
+
+		if (msgTicks)
+		{
+			DrawString();
+			msgTicks--;
+		}
+
+		if (showFrameTicks)
+			DrawFrameTicks();
+
+		SDL_UpdateTexture(sdlTexture, NULL, overlayScreen, pitch);
+		overlaid = true;
+	}
+	else if (overlaid)
+	{
+		SDL_UpdateTexture(sdlTexture, NULL, appleScreen, pitch);
+		overlaid = false;
+	}
+	else
+	{
+		// Send each run of redrawn lines up in one go
+		for(int line=0; line<VIRTUAL_SCREEN_HEIGHT/2; line++)
+		{
+			if (!redrawn[line])
+				continue;
+
+			int first = line;
+
+			while ((line < VIRTUAL_SCREEN_HEIGHT/2) && redrawn[line])
+				line++;
+
+			SDL_Rect rect = { 0, first * 2, VIRTUAL_SCREEN_WIDTH, (line - first) * 2 };
+			SDL_UpdateTexture(sdlTexture, &rect, &appleScreen[rect.y * VIRTUAL_SCREEN_WIDTH], pitch);
+		}
+	}
+
+	SDL_RenderClear(renderer);		// Without this, full screen has trash on the sides
+	SDL_RenderCopy(renderer, sdlTexture, NULL, NULL);
+}
+
+
+//
+// Fullscreen <-> window switching
+//
+void ToggleFullScreen(void)
+{
+	settings.fullscreen = !settings.fullscreen;
+
+	int retVal = SDL_SetWindowFullscreen(sdlWindow, (settings.fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
+
+	if (retVal != 0)
+		WriteLog("Video::ToggleFullScreen: SDL error = %s\n", SDL_GetError());
+}
+
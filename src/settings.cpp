@@ -62,6 +62,10 @@ void LoadSettings(void)
 	settings.glFilter = GetValue("glFilterType", 0);
 	settings.renderType = GetValue("renderType", 0);
 	settings.autoStateSaving = GetValue("autoSaveState", true);
+	settings.cpuMode = GetValue("cpuMode", 1);
+	settings.skipIdleLoops = GetValue("skipIdleLoops", true);
+	settings.fastDisk = GetValue("fastDisk", true);
+	settings.auxBanks = GetValue("auxBanks", 1);
 
 	settings.winX = GetValue("windowX", 250);
 	settings.winY = GetValue("windowY", 100);
@@ -103,6 +107,10 @@ void SaveSettings(void)
 	SetValue("useOpenGL", settings.useOpenGL);
 	SetValue("glFilterType", settings.glFilter);
 	SetValue("renderType", settings.renderType);
+	SetValue("cpuMode", settings.cpuMode);
+	SetValue("skipIdleLoops", settings.skipIdleLoops);
+	SetValue("fastDisk", settings.fastDisk);
+	SetValue("auxBanks", settings.auxBanks);
 	SetValue("windowX", settings.winX);
 	SetValue("windowY", settings.winY);
 	SetValue("disks", settings.disksPath);
@@ -30,6 +30,10 @@ struct Settings
 	uint32_t glFilter;
 	uint32_t renderType;
 	bool autoStateSaving;		// Auto-state loading/saving on entry/exit
+	uint32_t cpuMode;			// 0 = interpreter, 1 = block cache, 2 = JIT, 3 = JIT checked against the interpreter
+	bool skipIdleLoops;			// Fast-forward loops that just poll I/O
+	bool fastDisk;				// Run flat out while the floppy is in use
+	uint32_t auxBanks;			// 64K banks on the aux card (RamWorks style)
 
 	// Window settings
 
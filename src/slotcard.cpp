@@ -0,0 +1,134 @@
+//
+// Peripheral card base class
+//
+// By default, a card doesn't answer to anything (reads come back like they
+// do from an empty slot, see ReadNOP() in mmu.cpp), has no state to save, and
+// never has to be run; cards override whatever they actually do.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "slotcard.h"
+
+#include "apple2.h"
+#include "log.h"
+#include "machine.h"
+
+// Local variables
+
+static const char * cardName[NUM_CARDS] = {
+	"(empty)", "Disk II", "Mockingboard", "High-Speed SCSI" };
+
+// Local functions
+
+static void CardDeadline(void * data);
+
+
+SlotCard::SlotCard(uint8_t t): type(t), slot(0), event(EVENT_NONE)
+{
+}
+
+
+SlotCard::~SlotCard()
+{
+	CancelEvent(event);
+}
+
+
+uint8_t SlotCard::ReadIO(uint16_t)
+{
+	return 0xFF;
+}
+
+
+void SlotCard::WriteIO(uint16_t, uint8_t)
+{
+}
+
+
+uint8_t SlotCard::ReadROM(uint16_t)
+{
+	return 0xFF;
+}
+
+
+void SlotCard::WriteROM(uint16_t, uint8_t)
+{
+}
+
+
+uint8_t SlotCard::ReadExpansion(uint16_t)
+{
+	return 0xFF;
+}
+
+
+void SlotCard::WriteExpansion(uint16_t, uint8_t)
+{
+}
+
+
+void SlotCard::Reset(void)
+{
+}
+
+
+void SlotCard::SaveState(FILE *)
+{
+}
+
+
+void SlotCard::LoadState(FILE *)
+{
+}
+
+
+void SlotCard::Run(uint64_t)
+{
+}
+
+
+uint64_t SlotCard::Deadline(void)
+{
+	return EVENT_NEVER;
+}
+
+
+//
+// Make sure the card gets run when its deadline comes up (and not before).
+// A card that isn't in a slot never gets run.
+//
+void SlotCard::Schedule(void)
+{
+	uint64_t deadline = (slot ? Deadline() : EVENT_NEVER);
+
+	if (deadline == EVENT_NEVER)
+	{
+		CancelEvent(event);
+		event = EVENT_NONE;
+		return;
+	}
+
+	if (!RescheduleEvent(event, deadline))
+		event = ScheduleEvent(deadline, CardDeadline, this);
+
+	SetDeadline(deadline);
+}
+
+
+const char * SlotCard::Name(void)
+{
+	return (type < NUM_CARDS ? cardName[type] : "???");
+}
+
+
+//
+// A card's deadline came up: run it, and see when it's due next
+//
+static void CardDeadline(void * data)
+{
+	SlotCard * card = (SlotCard *)data;
+	card->Run(mainCPU.clock);
+	card->Schedule();
+}
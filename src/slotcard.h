@@ -0,0 +1,67 @@
+//
+// slotcard.h: Peripheral cards that plug into slots 1 thru 7
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __SLOTCARD_H__
+#define __SLOTCARD_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include "timing.h"
+
+// What kind of card it is (goes in save states, so don't reorder these)
+enum { CARD_NONE = 0, CARD_DISK2, CARD_MOCKINGBOARD, CARD_SCSI, NUM_CARDS };
+
+//
+// Everything the MMU & the machine need to talk to a card. Each instance is
+// one card, so there can be as many of a kind as there are slots to put them
+// in (see InstallSlotCard() in mmu.cpp).
+//
+// Cards are lazy: they only do their work when they're touched (they have to
+// call Run() themselves before doing anything that depends on time), or when
+// the clock gets to their Deadline(). Anything that can move the deadline
+// (a write to a timer, say) has to be followed by a call to Schedule().
+//
+class SlotCard
+{
+	public:
+		SlotCard(uint8_t type);
+		virtual ~SlotCard();
+
+		// $C0n0-$C0nF (n = slot + 8); address is the full address
+		virtual uint8_t ReadIO(uint16_t address);
+		virtual void WriteIO(uint16_t address, uint8_t byte);
+
+		// $Cn00-$CnFF; address is $00-$FF
+		virtual uint8_t ReadROM(uint16_t address);
+		virtual void WriteROM(uint16_t address, uint8_t byte);
+
+		// $C800-$CFFF, after the card's been selected by an access to its
+		// $Cnxx page; address is $000-$7FF
+		virtual uint8_t ReadExpansion(uint16_t address);
+		virtual void WriteExpansion(uint16_t address, uint8_t byte);
+
+		virtual void Reset(void);
+		virtual void SaveState(FILE *);
+		virtual void LoadState(FILE *);
+
+		// Run the card up to clock, and say when it next has to be run
+		// (EVENT_NEVER if it doesn't have anything coming up)
+		virtual void Run(uint64_t clock);
+		virtual uint64_t Deadline(void);
+
+		void Schedule(void);
+		const char * Name(void);
+
+	public:
+		uint8_t type;				// CARD_*
+		uint8_t slot;				// 0 = not in one
+
+	private:
+		EventID event;				// When Deadline() is (see Schedule())
+};
+
+#endif	// __SLOTCARD_H__
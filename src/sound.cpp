@@ -45,6 +45,8 @@
 static SDL_AudioSpec desired, obtained;
 static SDL_AudioDeviceID device;
 static bool soundInitialized = false;
+static bool muted = false;
+static uint32_t speakerToggles = 0;
 static bool speakerState = false;
 static uint16_t soundBuffer[SOUND_BUFFER_SIZE];
 static uint32_t soundBufferPos;
@@ -120,6 +122,25 @@ void SoundResume(void)
 }
 
 
+//
+// Stop (or start) taking samples from the emulation. While muted, the sound
+// card callback gets nothing but silence, and WriteSampleToBuffer() never
+// blocks--which is what lets warp mode run unthrottled.
+//
+void SoundMute(bool state)
+{
+	muted = state;
+
+	if (!soundInitialized)
+		return;
+
+	// Throw away what's buffered, so it doesn't play when we come back
+	SDL_LockAudioDevice(device);
+	soundBufferPos = 0;
+	SDL_UnlockAudioDevice(device);
+}
+
+
 //
 // Sound card callback handler
 //
@@ -173,10 +194,22 @@ lastStarve = sndFrmCnt;
 //
 void WriteSampleToBuffer(void)
 {
+	if (muted)
+		return;
+
 //	uint16_t s1 = AYGetSample(0);
 //	uint16_t s2 = AYGetSample(1);
-	uint16_t s1 = mb[0].ay[0].GetSample();
-	uint16_t s2 = mb[0].ay[1].GetSample();
+	uint16_t s1 = 0, s2 = 0;
+
+	// Mix in every Mockingboard that's plugged in
+	for(int i=0; i<2; i++)
+	{
+		if (mb[i].slot)
+		{
+			s1 += mb[i].ay[0].GetSample();
+			s2 += mb[i].ay[1].GetSample();
+		}
+	}
 
 	// This should almost never happen, but, if it does...
 	while (soundBufferPos >= (SOUND_BUFFER_SIZE - 1))
@@ -193,6 +226,8 @@ void WriteSampleToBuffer(void)
 
 void ToggleSpeaker(void)
 {
+	speakerToggles++;
+
 	if (!soundInitialized)
 		return;
 
@@ -201,6 +236,16 @@ void ToggleSpeaker(void)
 }
 
 
+//
+// # of times the speaker's been toggled (wraps around); this is for telling
+// if a program is making noise
+//
+uint32_t SpeakerToggleCount(void)
+{
+	return speakerToggles;
+}
+
+
 void VolumeUp(void)
 {
 	// Currently set for 16-bit samples
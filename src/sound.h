@@ -21,7 +21,9 @@ void SoundInit(void);
 void SoundDone(void);
 void SoundPause(void);
 void SoundResume(void);
+void SoundMute(bool state);
 void ToggleSpeaker(void);
+uint32_t SpeakerToggleCount(void);
 void WriteSampleToBuffer(void);
 void VolumeUp(void);
 void VolumeDown(void);
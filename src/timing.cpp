@@ -11,138 +11,371 @@
 // JLH  01/04/2006  Cosmetic changes (like this one ;-)
 //
 
-// STILL TO DO:
-//
-// - Handling for an event that occurs NOW
-//
-
 #include "timing.h"
 
+#include <stdlib.h>
 #include "log.h"
 
-#define EVENT_LIST_SIZE       512
+#define EVENT_LIST_START	32			// # of events there's room for at first
+#define EVENT_LIST_MAX		0xFFFF		// # of events there can ever be
 
 // NOTE ABOUT TIMING SYSTEM DATA STRUCTURES:
 
-// A queue won't work for this system because we can't guarantee that an event
-// will go in with a time that is later than the ones already queued up. So we
-// just use a simple list.
+// Events live in a pool of slots that grows as needed, and the slots that are
+// in use are kept in a binary heap, earliest first; so finding the next event
+// is free, and adding or taking one out is O(log n). Each slot knows where it
+// is in the heap, so an event can be moved or cancelled without looking for
+// it. Times are absolute, so nothing has to be touched as time goes by.
 
-// Although if we used an insertion sort we could, but it wouldn't work for
-// adjusting times...
+// An event's ID is its slot # (+ 1) in the low 16 bits & the slot's
+// generation in the high 16; the generation is bumped every time the slot is
+// freed, so IDs of events that are gone don't match anything.
 
 struct Event
 {
-    bool valid;
-    double eventTime;
-    void (* timerCallback)(void);
+	uint64_t time;				// When it's due
+	uint64_t period;			// 0 = one shot
+	uint64_t order;				// Breaks ties: same time, first come first served
+	EventCallback callback;
+	void * data;
+	uint32_t heapPos;			// Where it is in heap[] (or next free slot)
+	uint16_t generation;
+	bool valid;
 };
 
-//let's try +1... nope.
-static Event eventList[EVENT_LIST_SIZE];
-static uint32_t nextEvent;
+static Event * event = NULL;
+static uint32_t * heap = NULL;
+static uint32_t numEvents = 0;			// # of events in the heap
+static uint32_t numSlots = 0;			// # of slots in the pool
+static uint32_t freeSlot = 0;			// First free slot (numSlots = none)
+static uint64_t nextOrder = 0;
+static uint64_t nextTime = EVENT_NEVER;
+static bool lock = false;
+
+// Local functions
 
+static inline void Lock(void);
+static inline void Unlock(void);
+static bool Grow(void);
+static Event * Find(EventID id);
+static void Remove(uint32_t slot);
+static void SiftUp(uint32_t pos);
+static void SiftDown(uint32_t pos);
+
+
+//
+// Throw out every event there is
+//
 void InitializeEventList(void)
 {
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-        eventList[i].valid = false;
+	Lock();
+
+	for(uint32_t i=0; i<numSlots; i++)
+	{
+		if (event[i].valid)
+			event[i].generation++;
+
+		event[i].valid = false;
+		event[i].heapPos = i + 1;
+	}
+
+	numEvents = 0;
+	freeSlot = 0;
+	Unlock();
+}
+
+
+//
+// Run callback (with data) at time, and every period cycles after that if
+// period isn't zero. Returns the event's ID, or EVENT_NONE if there's no room
+// for it.
+//
+EventID ScheduleEvent(uint64_t time, EventCallback callback, void * data/*= 0*/, uint64_t period/*= 0*/)
+{
+	Lock();
+
+	if ((freeSlot == numSlots) && !Grow())
+	{
+		Unlock();
+		WriteLog("TIMING: ScheduleEvent() has no room for any more events!\n");
+		return EVENT_NONE;
+	}
+
+	uint32_t slot = freeSlot;
+	Event * e = &event[slot];
+	freeSlot = e->heapPos;
+
+	e->time = time;
+	e->period = period;
+	e->order = nextOrder++;
+	e->callback = callback;
+	e->data = data;
+	e->valid = true;
+	e->heapPos = numEvents;
+	heap[numEvents++] = slot;
+	SiftUp(e->heapPos);
+
+	EventID id = ((uint32_t)e->generation << 16) | (slot + 1);
+	Unlock();
+
+	return id;
+}
+
+
+//
+// Move an event to a new time (a periodic event keeps its period, counting
+// from there). Returns false if the event is gone.
+//
+bool RescheduleEvent(EventID id, uint64_t time)
+{
+	Lock();
+	Event * e = Find(id);
+
+	if (e)
+	{
+		e->time = time;
+		e->order = nextOrder++;
+		SiftUp(e->heapPos);
+		SiftDown(e->heapPos);
+	}
+
+	Unlock();
+
+	return (e != NULL);
+}
+
+
+//
+// Returns false if the event is already gone (it fired, or was cancelled)
+//
+bool CancelEvent(EventID id)
+{
+	Lock();
+	Event * e = Find(id);
+
+	if (e)
+		Remove(e - event);
+
+	Unlock();
+
+	return (e != NULL);
+}
+
+
+//
+// Move every event by the same amount; for when the clock gets changed out
+// from under them (loading a saved state, say)
+//
+void OffsetEvents(int64_t cycles)
+{
+	Lock();
+
+	for(uint32_t i=0; i<numEvents; i++)
+		event[heap[i]].time += cycles;
+
+	Unlock();
+}
+
+
+//
+// When the next event is due (EVENT_NEVER if there isn't one)
+//
+uint64_t GetNextEventTime(void)
+{
+	return __atomic_load_n(&nextTime, __ATOMIC_ACQUIRE);
+}
+
+
+//
+// Run everything that's due by time, in order, and return how many ran.
+// Callbacks are free to schedule, move & cancel events (themselves included);
+// anything they schedule that's due by time runs too.
+//
+uint32_t HandleEvents(uint64_t time)
+{
+	uint32_t count = 0;
+	Lock();
+
+	while (numEvents && (event[heap[0]].time <= time))
+	{
+		uint32_t slot = heap[0];
+		Event * e = &event[slot];
+		EventCallback callback = e->callback;
+		void * data = e->data;
+
+		if (e->period)
+		{
+			e->time += e->period;
+			e->order = nextOrder++;
+			SiftDown(0);
+		}
+		else
+			Remove(slot);
+
+		Unlock();
+		callback(data);
+		count++;
+		Lock();
+	}
+
+	Unlock();
+
+	return count;
 }
 
-//We just slap the next event into the list, no checking, no nada...
-void SetCallbackTime(void (* callback)(void), double time)
+
+//
+// Nobody holds the lock for more than a few heap operations, so just spin
+//
+static inline void Lock(void)
 {
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-    {
-        if (!eventList[i].valid)
-        {
-//WriteLog("SCT: Found callback slot #%u...\n", i);
-            eventList[i].timerCallback = callback;
-            eventList[i].eventTime = time;
-            eventList[i].valid = true;
+	while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+		;
+}
 
-            return;
-        }
-    }
 
-    WriteLog("TIMING: SetCallbackTime() failed to find an empty slot in the list!\n");
+//
+// Letting go of the lock publishes the time of the next event for
+// GetNextEventTime()
+//
+static inline void Unlock(void)
+{
+	__atomic_store_n(&nextTime, (numEvents ? event[heap[0]].time : EVENT_NEVER), __ATOMIC_RELEASE);
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
 }
 
-void RemoveCallback(void (* callback)(void))
+
+//
+// Everything below here has to be called with the lock held
+//
+
+//
+// Make room for more events (doubling what there is)
+//
+static bool Grow(void)
 {
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-    {
-        if (eventList[i].valid && eventList[i].timerCallback == callback)
-        {
-            eventList[i].valid = false;
+	uint32_t size = (numSlots ? numSlots * 2 : EVENT_LIST_START);
+
+	if (size > EVENT_LIST_MAX)
+		size = EVENT_LIST_MAX;
+
+	if (size == numSlots)
+		return false;
+
+	Event * newEvent = (Event *)realloc(event, size * sizeof(Event));
+
+	if (!newEvent)
+		return false;
+
+	event = newEvent;
+	uint32_t * newHeap = (uint32_t *)realloc(heap, size * sizeof(uint32_t));
 
-            return;
-        }
-    }
+	if (!newHeap)
+		return false;
+
+	heap = newHeap;
+
+	for(uint32_t i=numSlots; i<size; i++)
+	{
+		event[i].generation = 0;
+		event[i].valid = false;
+		event[i].heapPos = i + 1;
+	}
+
+	// There were no free slots (or we wouldn't be here), so the new ones are
+	// all there is
+	freeSlot = numSlots;
+	numSlots = size;
+
+	return true;
 }
 
-void AdjustCallbackTime(void (* callback)(void), double time)
+
+static Event * Find(EventID id)
 {
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-    {
-        if (eventList[i].valid && eventList[i].timerCallback == callback)
-        {
-            eventList[i].eventTime = time;
+	uint32_t slot = (id & 0xFFFF) - 1;
+
+	if ((id == EVENT_NONE) || (slot >= numSlots) || !event[slot].valid
+		|| (event[slot].generation != (id >> 16)))
+		return NULL;
 
-            return;
-        }
-    }
+	return &event[slot];
 }
 
-double GetTimeToNextEvent(void)
-{
-	// Find the next event. Since the events are not necessarily in order of
-	// increasing time, we have to search through the list for the lowest one.
-
-//ALSO: There's a bug here--nextEvent is getting a bogus value/getting clobbered...
-//      Seems like it's getting clobbered somewhere other than here...
-    double time = 0;
-    bool firstTime = true;
-
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-    {
-        if (eventList[i].valid)
-        {
-            if (firstTime)
-			{
-                time = eventList[i].eventTime;
-				nextEvent = i;
-				firstTime = false;
-			}
-            else
-            {
-                if (eventList[i].eventTime < time)
-				{
-                    time = eventList[i].eventTime;
-					nextEvent = i;
-				}
-            }
-        }
-    }
-
-	if (time == 0)
-		WriteLog("TIMING: GetTimeToNextEvent() failed to find next event!\n");
-
-	if (nextEvent >= EVENT_LIST_SIZE)
-		WriteLog("TIMING: GetTimeToNextEvent() has bad nextEvent (=%u)!\n", nextEvent);
-
-    return time;
+
+static void Remove(uint32_t slot)
+{
+	uint32_t pos = event[slot].heapPos;
+	numEvents--;
+
+	// Put the last one in the heap where this one was & let it find its place
+	if (pos != numEvents)
+	{
+		uint32_t last = heap[numEvents];
+		heap[pos] = last;
+		event[last].heapPos = pos;
+		SiftUp(pos);
+		SiftDown(event[last].heapPos);
+	}
+
+	event[slot].valid = false;
+	event[slot].generation++;
+	event[slot].heapPos = freeSlot;
+	freeSlot = slot;
 }
 
-void HandleNextEvent(void)
+
+static inline bool Earlier(uint32_t a, uint32_t b)
 {
-    double elapsedTime = eventList[nextEvent].eventTime;
-    void (* event)(void) = eventList[nextEvent].timerCallback;
+	return (event[a].time < event[b].time)
+		|| ((event[a].time == event[b].time) && (event[a].order < event[b].order));
+}
+
 
-    for(uint32_t i=0; i<EVENT_LIST_SIZE; i++)
-        if (eventList[i].valid)
-            eventList[i].eventTime -= elapsedTime;
+static void SiftUp(uint32_t pos)
+{
+	uint32_t slot = heap[pos];
 
-    eventList[nextEvent].valid = false;      // Remove event from list...
+	while (pos > 0)
+	{
+		uint32_t parent = (pos - 1) / 2;
 
-    (*event)();
+		if (!Earlier(slot, heap[parent]))
+			break;
+
+		heap[pos] = heap[parent];
+		event[heap[pos]].heapPos = pos;
+		pos = parent;
+	}
+
+	heap[pos] = slot;
+	event[slot].heapPos = pos;
 }
+
+
+static void SiftDown(uint32_t pos)
+{
+	uint32_t slot = heap[pos];
+
+	while (true)
+	{
+		uint32_t child = (pos * 2) + 1;
+
+		if (child >= numEvents)
+			break;
+
+		if (((child + 1) < numEvents) && Earlier(heap[child + 1], heap[child]))
+			child++;
+
+		if (!Earlier(heap[child], slot))
+			break;
+
+		heap[pos] = heap[child];
+		event[heap[pos]].heapPos = pos;
+		pos = child;
+	}
+
+	heap[pos] = slot;
+	event[slot].heapPos = pos;
+}
+
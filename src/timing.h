@@ -21,11 +21,28 @@
 //#define USEC_TO_M68K_CYCLES(u) (uint32_t)(((u) / M68K_CYCLE_IN_USEC) + 0.5)
 #define USEC_TO_M6502_CYCLES(u)  ((uint32_t)(((u) / M6502_CYCLE_IN_USEC) + 0.5))
 
+#define EVENT_NONE				0			// Not a valid event ID
+#define EVENT_NEVER				((uint64_t)-1)
+
+// Events are identified by the ID ScheduleEvent() hands back; an ID goes
+// stale once its event is cancelled or has fired (unless it's periodic), so
+// hanging on to an old one is harmless.
+typedef uint32_t EventID;
+typedef void (* EventCallback)(void * data);
+
+// Exported functions
+
+// N.B.: Times are absolute, in 65C02 cycles (i.e., mainCPU.clock). Events can
+//       be scheduled, moved & cancelled from any thread; the ones that come
+//       due get run by whoever calls HandleEvents() (SyncDevices(), see
+//       machine.cpp), which won't notice anything new before the next time it
+//       gets called unless it's told to with SetDeadline().
 void InitializeEventList(void);
-void SetCallbackTime(void (* callback)(void), double time);
-void RemoveCallback(void (* callback)(void));
-void AdjustCallbackTime(void (* callback)(void), double time);
-double GetTimeToNextEvent(void);
-void HandleNextEvent(void);
+EventID ScheduleEvent(uint64_t time, EventCallback callback, void * data = 0, uint64_t period = 0);
+bool RescheduleEvent(EventID id, uint64_t time);
+bool CancelEvent(EventID id);
+void OffsetEvents(int64_t cycles);
+uint64_t GetNextEventTime(void);
+uint32_t HandleEvents(uint64_t time);
 
 #endif	// __TIMING_H__
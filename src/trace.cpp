@@ -0,0 +1,64 @@
+//
+// Binary execution trace
+//
+// The CPU core (when dumpDis is set), the Disk II sequencer and the SCSI card
+// drop fixed size records into a ring here, instead of formatting text into
+// the log as they go; apple2-tracedump turns a saved trace into something
+// readable.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "log.h"
+
+
+// Global variables (exported)
+
+TraceRecord traceRing[TRACE_SIZE];
+uint32_t traceHead = 0;
+
+
+void ClearTrace(void)
+{
+	__atomic_store_n(&traceHead, 0, __ATOMIC_RELEASE);
+}
+
+
+//
+// Write out what's in the ring, oldest record first. If something is still
+// writing to it, the oldest records can get overwritten while we're at it, so
+// turn tracing off first for a clean trace.
+//
+bool SaveTrace(const char * filename)
+{
+	FILE * file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		WriteLog("Trace: Could not open \"%s\" for writing!\n", filename);
+		return false;
+	}
+
+	uint32_t head = __atomic_load_n(&traceHead, __ATOMIC_ACQUIRE);
+	uint32_t count = (head < TRACE_SIZE ? head : TRACE_SIZE);
+	TraceHeader header;
+
+	memcpy(header.magic, TRACE_MAGIC, 8);
+	header.recordSize = sizeof(TraceRecord);
+	header.count = count;
+	fwrite(&header, sizeof(header), 1, file);
+
+	for(uint32_t i=head-count; i!=head; i++)
+		fwrite(&traceRing[i & (TRACE_SIZE - 1)], sizeof(TraceRecord), 1, file);
+
+	fclose(file);
+	WriteLog("Trace: Wrote %u records to \"%s\".\n", count, filename);
+
+	return true;
+}
+
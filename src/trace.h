@@ -0,0 +1,120 @@
+//
+// trace.h: Binary execution trace
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+#define TRACE_SIZE			0x40000		// # of records kept (must be a power of 2)
+#define TRACE_MAGIC			"A2TRACE2"
+
+// Record types
+enum { TRACE_CPU = 1, TRACE_DISK, TRACE_SCSI, TRACE_WATCH };
+
+// Record flags
+#define TRACE_EA			0x01		// CPU: ea is valid
+#define TRACE_WRITE			0x02		// SCSI: register write (else read)
+
+//
+// Every record is the same size (32 bytes), so the ring is just an array and
+// a trace file is just a header and the records, oldest first. Everything is
+// stamped with the CPU clock so events from different subsystems line up.
+//
+struct TraceRecord
+{
+	uint64_t clock;				// CPU cycle it happened on
+	uint8_t type;				// TRACE_*
+	uint8_t flags;
+	uint16_t pc;				// CPU PC at the time
+
+	union
+	{
+		// Registers are as they were *before* the instruction ran
+		struct
+		{
+			uint8_t bytes[3];	// Opcode & operand
+			uint8_t a, x, y, sp, cc;
+			uint16_t ea;		// Effective address
+			uint16_t banks;		// Bank switch state (see MMU_* in mmu.h)
+		} cpu;
+
+		// One run of the Disk II sequencer
+		struct
+		{
+			uint8_t drive;
+			uint8_t head;		// Head position (in quarter tracks)
+			uint8_t state[2];	// Sequencer state before & after...
+			uint8_t data[2];	// ...and the data register
+			uint8_t bus;		// Last byte the CPU put on the data bus
+			uint8_t switches;	// Bit 0 = S/L, bit 1 = R/W, bit 2 = motor on
+			uint32_t cycles;	// # of sequencer clocks it ran for
+			uint32_t position;	// Bit position on the track at the start
+		} disk;
+
+		// One access to the SCSI card's 5380
+		struct
+		{
+			uint8_t reg;		// 5380 register #
+			uint8_t value;		// What was read or written
+			uint8_t phase;		// Bus phase the device is in
+			uint8_t signals;	// Bus status (as in register 4)
+			uint8_t romBank;
+		} scsi;
+
+		// A watch going off (see watch.h)
+		struct
+		{
+			uint8_t id;
+			uint8_t access;		// WATCH_*
+			uint8_t bank;		// BANK_*
+			uint8_t value;		// What was read or written
+			uint16_t address;
+		} watch;
+	};
+};
+
+struct TraceHeader
+{
+	char magic[8];				// TRACE_MAGIC
+	uint32_t recordSize;		// sizeof(TraceRecord)
+	uint32_t count;				// # of records that follow
+};
+
+// Global variables (exported)
+
+extern TraceRecord traceRing[TRACE_SIZE];
+extern uint32_t traceHead;
+
+// Exported functions
+
+void ClearTrace(void);
+bool SaveTrace(const char * filename);
+
+//
+// There's only ever one writer (whatever thread is running the emulation), so
+// claiming a record is just a matter of looking at the head; the record only
+// becomes visible to readers when TraceCommit() moves the head past it.
+//
+inline TraceRecord * TraceAlloc(uint8_t type, uint64_t clock, uint16_t pc)
+{
+	TraceRecord * record = &traceRing[traceHead & (TRACE_SIZE - 1)];
+	record->clock = clock;
+	record->type = type;
+	record->flags = 0;
+	record->pc = pc;
+
+	return record;
+}
+
+
+inline void TraceCommit(void)
+{
+	__atomic_store_n(&traceHead, traceHead + 1, __ATOMIC_RELEASE);
+}
+
+#endif	// __TRACE_H__
@@ -0,0 +1,192 @@
+//
+// Apple 2 trace dumper
+//
+// Turns a binary trace (see trace.h) into text, one line per record: CPU
+// instructions get disassembled along with the registers, effective address
+// & bank switches they ran with; disk sequencer runs & SCSI register accesses
+// are shown in between, where they happened.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dis65c02.h"
+#include "mmu.h"
+#include "profile.h"
+#include "trace.h"
+#include "watch.h"
+
+
+// Local variables
+
+static const char * scsiReg[16] = {
+	"CSD", "ICR", "MR", "TCR", "CSBS", "BSR", "IDR", "RPI",
+	"DMALO", "DMAHI", "CNTLO", "CNTHI", "$C", "$D", "BANK", "$F" };
+
+// Local functions
+
+static void DumpCPU(const TraceRecord & record);
+static void DumpDisk(const TraceRecord & record);
+static void DumpSCSI(const TraceRecord & record);
+static void DumpWatch(const TraceRecord & record);
+
+
+static void Usage(const char * name)
+{
+	printf("Usage: %s <trace file>\n\n", name);
+	printf("Writes the trace to stdout as text.\n");
+}
+
+
+int main(int argc, char * argv[])
+{
+	if (argc != 2)
+	{
+		Usage(argv[0]);
+		return -1;
+	}
+
+	FILE * file = fopen(argv[1], "rb");
+
+	if (!file)
+	{
+		printf("Could not open \"%s\"!\n", argv[1]);
+		return -1;
+	}
+
+	TraceHeader header;
+
+	if ((fread(&header, sizeof(header), 1, file) != 1)
+		|| (memcmp(header.magic, TRACE_MAGIC, 8) != 0)
+		|| (header.recordSize != sizeof(TraceRecord)))
+	{
+		printf("\"%s\" is not a trace file (or is from a different version)!\n", argv[1]);
+		fclose(file);
+		return -1;
+	}
+
+	TraceRecord record;
+	uint32_t count = 0;
+
+	while ((count < header.count) && (fread(&record, sizeof(record), 1, file) == 1))
+	{
+		switch (record.type)
+		{
+		case TRACE_CPU:  DumpCPU(record); break;
+		case TRACE_DISK: DumpDisk(record); break;
+		case TRACE_SCSI: DumpSCSI(record); break;
+		case TRACE_WATCH: DumpWatch(record); break;
+		default:
+			printf("%12llu  ???? (record type %u)\n", (unsigned long long)record.clock, record.type);
+		}
+
+		count++;
+	}
+
+	fclose(file);
+
+	if (count != header.count)
+	{
+		printf("Trace is short: expected %u records, got %u!\n", header.count, count);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+//
+// <clock>  <disassembly>  A X Y SP  flags  [EA]  bank switches
+//
+static void DumpCPU(const TraceRecord & record)
+{
+	char buf[128], flags[9];
+	const char * flagName = "NV-BDIZC";
+	uint16_t banks = record.cpu.banks;
+
+	Decode65C02(record.cpu.bytes, buf, record.pc);
+
+	for(int i=0; i<8; i++)
+		flags[i] = (record.cpu.cc & (0x80 >> i) ? flagName[i] : '.');
+
+	flags[8] = 0;
+
+	printf("%12llu  %s A=%02X X=%02X Y=%02X SP=%02X %s", (unsigned long long)record.clock, buf, record.cpu.a, record.cpu.x, record.cpu.y, record.cpu.sp, flags);
+
+	if (record.flags & TRACE_EA)
+		printf(" EA=$%04X", record.cpu.ea);
+	else
+		printf("         ");
+
+	printf(" LC=%X%s%s%s%s%s%s%s%s%s\n", banks & MMU_LCSTATE,
+		(banks & MMU_RAMRD ? " RAMRD" : ""),
+		(banks & MMU_RAMWRT ? " RAMWRT" : ""),
+		(banks & MMU_ALTZP ? " ALTZP" : ""),
+		(banks & MMU_80STORE ? " 80STORE" : ""),
+		(banks & MMU_PAGE2 ? " PAGE2" : ""),
+		(banks & MMU_HIRES ? " HIRES" : ""),
+		(banks & MMU_INTCXROM ? " INTCXROM" : ""),
+		(banks & MMU_SLOTC3ROM ? " SLOTC3ROM" : ""),
+		(banks & MMU_INTC8ROM ? " INTC8ROM" : ""));
+}
+
+
+static void DumpDisk(const TraceRecord & record)
+{
+	printf("%12llu  DISK %u: PC=%04X head=%u pos=%u cycles=%u state=%X->%X data=%02X->%02X bus=%02X %s %s%s\n",
+		(unsigned long long)record.clock, record.disk.drive, record.pc,
+		record.disk.head, record.disk.position, record.disk.cycles,
+		record.disk.state[0], record.disk.state[1],
+		record.disk.data[0], record.disk.data[1], record.disk.bus,
+		(record.disk.switches & 0x01 ? "LOAD" : "SHIFT"),
+		(record.disk.switches & 0x02 ? "WRITE" : "READ"),
+		(record.disk.switches & 0x04 ? "" : " (motor off)"));
+}
+
+
+static void DumpSCSI(const TraceRecord & record)
+{
+	const char * phase;
+
+	switch (record.scsi.phase)
+	{
+	case 0:  phase = "DATA OUT"; break;
+	case 1:  phase = "DATA IN"; break;
+	case 2:  phase = "COMMAND"; break;
+	case 3:  phase = "STATUS"; break;
+	case 6:  phase = "MESSAGE OUT"; break;
+	case 7:  phase = "MESSAGE IN"; break;
+	case 8:  phase = "BUS FREE"; break;
+	case 16: phase = "ARBITRATE"; break;
+	case 32: phase = "SELECT"; break;
+	default: phase = "???";
+	}
+
+	uint8_t signals = record.scsi.signals;
+
+	printf("%12llu  SCSI: PC=%04X %s %-5s $%02X  phase=%s bus=%s%s%s%s%s%s%s bank=%u\n",
+		(unsigned long long)record.clock, record.pc,
+		(record.flags & TRACE_WRITE ? "W" : "R"), scsiReg[record.scsi.reg & 0x0F],
+		record.scsi.value, phase,
+		(signals & 0x80 ? " RST" : ""), (signals & 0x40 ? " BSY" : ""),
+		(signals & 0x20 ? " REQ" : ""), (signals & 0x10 ? " MSG" : ""),
+		(signals & 0x08 ? " C/D" : ""), (signals & 0x04 ? " I/O" : ""),
+		(signals & 0x02 ? " SEL" : ""), record.scsi.romBank);
+}
+
+
+static void DumpWatch(const TraceRecord & record)
+{
+	uint8_t access = record.watch.access;
+
+	printf("%12llu  WATCH #%u: PC=%04X %s $%04X (%s) = $%02X\n",
+		(unsigned long long)record.clock, record.watch.id, record.pc,
+		(access == WATCH_EXEC ? "exec" : (access == WATCH_WRITE ? "write" : "read")),
+		record.watch.address,
+		(record.watch.bank < NUM_BANKS ? bankName[record.watch.bank] : "???"),
+		record.watch.value);
+}
+
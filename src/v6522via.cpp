@@ -165,34 +165,59 @@ void V6522VIA::Write(uint8_t regNum, uint8_t byte)
 }
 
 
-bool V6522VIA::Run(uint16_t cycles)
+//
+// Run the timers for the # of cycles passed in; this can be any amount, as
+// Timer 1 gets reloaded as many times as it has to in continuous mode. Since
+// the IRQ line can only be asserted once per run, whoever runs it has to do
+// so by the time CyclesToIRQ() runs out if they want to see each one.
+//
+bool V6522VIA::Run(uint32_t cycles)
 {
+	timer2counter -= cycles;
+
+	// Most of the time, nothing happens
+	if (timer1counter > cycles)
+	{
+		timer1counter -= cycles;
+		return false;
+	}
+
 	// This is to signal to the caller that we hit an IRQ condition
 	bool response = false;
-	bool viaT1HitZero = (timer1counter <= cycles ? true : false);
-
-	timer1counter -= cycles;
-	timer2counter -= cycles;
 
-	if (viaT1HitZero)
+	if (acr & 0x40)
 	{
-		if (acr & 0x40)
-		{
-			timer1counter += timer1latch;
+		// Every time it runs out, it picks up where it left off from the latch
+		uint32_t period = (timer1latch ? timer1latch : 0x10000);
+		timer1counter = period - ((cycles - timer1counter) % period);
 
-			if (ier & 0x40)
-			{
-				ifr |= (0x80 | 0x40);
-				response = true;
-			}
-		}
-		else
+		if (ier & 0x40)
 		{
-			// Disable T1 interrupt
-			ier &= 0x3F;
+			ifr |= (0x80 | 0x40);
+			response = true;
 		}
 	}
+	else
+	{
+		timer1counter -= cycles;
+
+		// Disable T1 interrupt
+		ier &= 0x3F;
+	}
 
 	return response;
 }
 
+
+//
+// # of cycles until Run() will want to assert the IRQ line (or 0xFFFFFFFF if
+// it can't, the way things are set up now)
+//
+uint32_t V6522VIA::CyclesToIRQ(void)
+{
+	if ((acr & 0x40) && (ier & 0x40))
+		return timer1counter;
+
+	return 0xFFFFFFFF;
+}
+
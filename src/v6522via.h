@@ -26,7 +26,8 @@ struct V6522VIA
 	void Reset(void);
 	uint8_t Read(uint8_t);
 	void Write(uint8_t, uint8_t);
-	bool Run(uint16_t);
+	bool Run(uint32_t);
+	uint32_t CyclesToIRQ(void);
 };
 
 #endif	// __V6522VIA_H__
@@ -25,6 +25,8 @@
 #define V65C02_ASSERT_LINE_IRQ		0x0002		// v65C02 IRQ line
 #define V65C02_ASSERT_LINE_NMI		0x0004		// v65C02 NMI line
 #define V65C02_STATE_ILLEGAL_INST	0x0008		// Illegal instruction executed flag
+#define V65C02_STOP_REQUEST		0x0010		// Leave Execute65C02() after this instruction
+#define V65C02_ASSERT_LINES		(V65C02_ASSERT_LINE_RESET | V65C02_ASSERT_LINE_IRQ | V65C02_ASSERT_LINE_NMI)
 //#define V65C02_START_DEBUG_LOG		0x0020		// Debug log go (temporary!)
 
 // Useful structs
@@ -42,16 +44,173 @@ struct V65C02REGS
 	void (* WrMem)(uint16_t, uint8_t);	// Address of BYTE write routine
 	void (* Timer)(uint16_t);	// Address of Timer routine
 	uint16_t cpuFlags;			// v65C02 IRQ/RESET flags
+	uint16_t nz;				// Last result, for N & Z (only while running; see GetCC())
 	uint64_t overflow;			// # of cycles we went over last time through
 };
 
+// Pre-decoded instruction & block cache (see v65c02core.h)
+
+enum { V65C02_MODE_INTERPRET = 0, V65C02_MODE_CACHED, V65C02_MODE_JIT, V65C02_MODE_DIFF };
+
+#define V65C02_BLOCK_MAX		8			// Max # of instructions in a block
+#define V65C02_BLOCK_CACHE_SIZE	0x4000		// # of blocks (must be a power of 2)
+#define V65C02_BLOCK_INDEX(pc)	(((pc) ^ ((pc) >> 14)) & (V65C02_BLOCK_CACHE_SIZE - 1))
+#define V65C02_LINE_SHIFT		6			// Writes are tracked in 64 byte lines
+#define V65C02_CODE_LINES		0x10000		// # of line generations (power of 2)
+#define V65C02_CODE_LINE(p)		(((uintptr_t)(p) >> V65C02_LINE_SHIFT) & (V65C02_CODE_LINES - 1))
+#define V65C02_JIT_HOT			4			// # of runs before a block gets translated
+#define V65C02_JIT_NEVER		0xFF		// Block can't be translated
+#define V65C02_JIT_ARENA		0x400000	// Bytes of host code before starting over
+#define V65C02_JOURNAL_MAX		64			// Max # of bus accesses a block can make
+
+struct V65C02Inst
+{
+	void (* handler)(V65C02REGS *, uint16_t);	// Opcode handler
+	uint16_t operand;			// Operand byte(s), if any
+	uint8_t opcode;
+	uint8_t length;				// Instruction length in bytes
+	uint8_t cycles;				// Base cycle count
+};
+
+struct V65C02Block
+{
+	const uint8_t * code;		// Host memory the block was decoded from
+	uint16_t pc;				// Address of the first instruction
+	uint8_t count;				// # of instructions in the block
+	uint8_t maxCycles;			// Most cycles it can take, penalties & all
+	uint8_t runs;				// # of times run (up to V65C02_JIT_HOT)
+	void * host;				// Translated code, if any (see v65c02jit.h)
+	uint32_t line[2];			// Write tracking lines the block covers...
+	uint32_t gen[2];			// ...and their generations when decoded
+	V65C02Inst inst[V65C02_BLOCK_MAX];
+};
+
+// Where a bus keeps its page table, for translated code to read plain memory
+// straight out of: *base points at the entry for page 0, each entry is stride
+// bytes long, and has a pointer to the page's memory (or NULL if it has to go
+// through the bus) at offset read.
+
+struct V65C02PageMap
+{
+	void * const * base;
+	uint32_t stride;
+	uint32_t read;
+};
+
+// Every bus access a translated block made, in order (differential mode only)
+
+struct V65C02Access
+{
+	uint16_t address;
+	uint8_t byte;
+	bool write;
+};
+
+struct V65C02Journal
+{
+	V65C02Access access[V65C02_JOURNAL_MAX];
+	uint32_t count;				// # of accesses recorded...
+	uint32_t next;				// ...and # played back so far
+	bool bad;					// Overflowed, or played back out of step
+
+	inline void Add(uint16_t address, uint8_t byte, bool write)
+	{
+		if (count == V65C02_JOURNAL_MAX)
+		{
+			bad = true;
+			return;
+		}
+
+		access[count].address = address;
+		access[count].byte = byte;
+		access[count++].write = write;
+	}
+};
+
+// Idle loop detection (see IdleLoop() in v65c02core.h)
+
+#define V65C02_IDLE_MAX			8			// Max # of instructions in an idle loop
+#define V65C02_IDLE_WATCH		0xFE		// Waiting to come back around a loop
+#define V65C02_IDLE_OFF			0xFF		// Not following a loop at all
+
+struct V65C02IdleStep
+{
+	uint8_t opcode;
+	uint16_t operand;
+	uint8_t cycles;				// # of cycles it took
+	uint16_t pc;				// Registers after it ran
+	uint8_t cc, a, x, y, sp;
+};
+
+struct V65C02IdleLoop
+{
+	uint16_t head;				// Address the loop branches back to
+	uint8_t count;				// # of steps so far this pass (or _WATCH/_OFF)
+	uint8_t cc, a, x, y, sp;	// Registers at the top of the pass
+	V65C02IdleStep step[V65C02_IDLE_MAX];
+	uint64_t skipped;			// # of cycles fast-forwarded so far
+};
+
+struct V65C02BlockCache
+{
+	V65C02Block block[V65C02_BLOCK_CACHE_SIZE];
+	uint32_t lineGen[V65C02_CODE_LINES];	// Odd = line has code cached from it
+	bool stop;					// Set to leave the current block early
+	uint8_t mode;				// V65C02_MODE_*
+	bool skipIdle;				// Fast-forward through idle loops
+	V65C02IdleLoop idle;
+	uint8_t * jitCode;			// Arena for translated code...
+	uint32_t jitUsed;			// ...and how much of it is spoken for
+	V65C02Journal journal;
+	uint64_t checked;			// # of blocks run both ways in differential mode...
+	uint32_t mismatches;		// ...and # of them that came out different
+
+	//
+	// Has to be called for every write to plain memory; bumps the generation
+	// of the line written to if there's code cached from it
+	//
+	inline void Written(const uint8_t * address)
+	{
+		uint32_t & gen = lineGen[V65C02_CODE_LINE(address)];
+
+		if (gen & 1)
+		{
+			gen++;
+			stop = true;
+		}
+	}
+
+	void Flush(void);
+};
+
+// Execution profile (see ProfileInst() in v65c02core.h)
+
+#define V65C02_PROFILE_BANKS	8			// Max # of banks a bus can tell apart
+
+struct V65C02Profile
+{
+	uint64_t count[V65C02_PROFILE_BANKS][0x10000];	// # of times each address ran...
+	uint64_t cycles[V65C02_PROFILE_BANKS][0x10000];	// ...the cycles it took...
+	uint8_t opcode[V65C02_PROFILE_BANKS][0x10000];	// ...and what ran there last
+	uint16_t operand[V65C02_PROFILE_BANKS][0x10000];
+	bool changed[V65C02_PROFILE_BANKS][0x10000];	// Something else ran there too
+	uint64_t opCount[256];		// Opcode histogram
+	uint64_t opCycles[256];
+	uint64_t branchesTaken;
+	uint64_t pageCycles;		// # of page crossing penalty cycles
+	uint64_t bcdCycles;			// # of decimal mode penalty cycles
+};
+
 // Global variables (exported)
 
-extern bool dumpDis;
+extern bool dumpDis;				// Trace execution (see trace.h)
 
 // Exported functions
 
+// N.B.: This goes through RdMem/WrMem/Timer; see v65c02core.h if you want a
+//       core with your memory accesses inlined into it.
 void Execute65C02(V65C02REGS *, uint32_t);
+uint32_t Check65C02ALU(void);		// Returns the # of mismatches (see v65c02.cpp)
 
 #endif	// __V65C02_H__
 
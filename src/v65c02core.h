@@ -0,0 +1,3664 @@
+//
+// Virtual 65C02 Emulator v1.1
+//
+// by James Hammons
+// (c) 2005-2018 Underground Software
+//
+// JLH = James Hammons <jlhamm@acm.org>
+//
+// WHO  WHEN        WHAT
+// ---  ----------  -----------------------------------------------------------
+// JLH  01/04/2006  Added changelog ;-)
+// JLH  01/18/2009  Fixed EA_ABS_* macros
+//
+
+//
+// The core is a set of templates over a bus policy class, so that whoever
+// instantiates it can have their memory accesses inlined right into the
+// opcode handlers. A bus policy looks like this:
+//
+// struct Bus
+// {
+//	static uint8_t Read(V65C02REGS *, uint16_t address);
+//	static void Write(V65C02REGS *, uint16_t address, uint8_t byte);
+//	static uint64_t Deadline(V65C02REGS *);
+//	static void Tick(V65C02REGS *, uint32_t cycles);
+//	static const uint8_t * Code(V65C02REGS *, uint16_t address);
+//	static bool Polled(V65C02REGS *, uint16_t address);
+//	static V65C02BlockCache * Cache(V65C02REGS *);
+//	static V65C02Profile * Profile(V65C02REGS *);
+//	static uint8_t Bank(V65C02REGS *, uint16_t address);
+//	static uint16_t Banks(V65C02REGS *);
+//	static const V65C02PageMap * PageMap(V65C02REGS *);
+// };
+//
+// Tick() runs whatever else is on the bus for the # of cycles since the last
+// time it was called. It only gets called once regs->clock reaches
+// Deadline() (which is read after every instruction, so an I/O handler can
+// pull it in), and on the way out of Execute65C02(), so the bus is caught up
+// whenever the core isn't running.
+//
+// Code() returns a host pointer to the byte at address if it's plain memory
+// (and NULL if not), Polled() says if a read of a non-plain address has no
+// side effects and can't change between calls to Tick() (status soft
+// switches, say), and Cache() returns the pre-decoded block cache to use (or
+// NULL to run without one). If there is a cache, the bus has to call its
+// Written() method for every write to plain memory and set its stop flag
+// whenever an access goes to an I/O handler.
+//
+// Profile() returns the execution profile to tally instructions in (or NULL
+// to run the copy of the core that has no profiling code in it), and Bank()
+// says which of the V65C02_PROFILE_BANKS banks the code at address comes
+// from, so code run from different banks at the same address is kept apart.
+// While profiling, every instruction is fetched through the bus and actually
+// run (no block cache, no idle loop skipping), so what gets counted is what
+// the code really did.
+//
+// Setting dumpDis puts a record of every instruction run into the trace ring
+// (see trace.h), with the bus' bank switch state from Banks() in it.
+//
+// With the cache's skipIdle flag set, the core also watches for short loops
+// that don't do anything but wait for something to change (see IdleLoop()
+// below) and fast-forwards through them.
+//
+// The cache's mode picks how code gets run: V65C02_MODE_INTERPRET fetches &
+// decodes every instruction through the bus, V65C02_MODE_CACHED runs out of
+// the block cache, and V65C02_MODE_JIT translates blocks that keep getting
+// run into host code (see v65c02jit.cpp) and runs that instead, whenever the
+// whole block fits before the bus' deadline. PageMap() tells the translated
+// code where the bus' page table is, so it can read plain memory without
+// going through Read(); a bus that returns NULL doesn't get translated.
+// V65C02_MODE_DIFF is the JIT checked against the interpreter: every block
+// that runs translated gets run again by the opcode handlers, from the same
+// registers & with the same bus traffic (see RunTranslated() below), and any
+// difference in the registers, the clock or the accesses themselves gets
+// logged.
+//
+// and the core is run with Execute65C02<Bus>(regs, cycles). All of the CPU's
+// state lives in the V65C02REGS passed in, so the core is re-entrant and can
+// run as many CPUs as you like. Include this in the .cpp that instantiates
+// the core (and *only* there--it defines a lot of macros).
+//
+
+//OK, the wraparound bug exists in both the Apple and Atari versions of Ultima
+//II. However, the Atari version *does* occassionally pick strength while the
+//Apple versions do not--which would seem to indicate a bug either in the RNG
+//algorithm, the 65C02 core, or the Apple hardware. Need to investigate all
+//three!
+//N.B.: There were some lingering bugs in the BCD portions of the ADC and SBC
+//      opcodes; need to test to see if that clears up the problem.
+
+#ifndef __V65C02CORE_H__
+#define __V65C02CORE_H__
+
+// Release builds (-DNDEBUG) leave out the trace & debug logging altogether
+#ifndef NDEBUG
+#define __DEBUG__
+#endif
+//#define __DEBUGMON__
+
+#include <string.h>
+#include "v65c02.h"
+#include "v65c02jit.h"
+#include "log.h"
+
+#ifdef __DEBUG__
+#include "dis65c02.h"
+#include "trace.h"
+#endif
+
+
+// Various helper macros
+
+//
+// N & Z are evaluated lazily: instead of working them out for every result
+// (most of which get overwritten before anything looks at them), the core
+// just keeps the last result in regs->nz, and the N & Z bits in regs->cc are
+// stale while it runs. Z is set when the low byte of nz is zero, N when bit
+// 7 or bit 15 of it is set (BIT & PLP need N & Z both set, which a plain
+// result can't do). Anything that needs the real flags (PHP, BRK & interrupt
+// pushes) uses GetCC(), and anything that loads them (PLP, RTI) uses SetCC();
+// Execute65C02() does the same on the way in & out, so outside of the core
+// regs->cc is always right.
+//
+#define FLAG_ZERO			((regs->nz & 0xFF) == 0)
+#define FLAG_NEGATIVE		((regs->nz | (regs->nz >> 8)) & 0x80)
+
+#define CLR_D				(regs->cc &= ~FLAG_D)
+#define SET_Z(r)			(regs->nz = ((r) != 0) | (FLAG_NEGATIVE << 8))
+#define SET_I				(regs->cc |= FLAG_I)
+#define SET_C(b)			(regs->cc = (regs->cc & ~FLAG_C) | (b))
+
+//Not sure that this code is computing the carry correctly... Investigate! [Seems to be]
+/*
+Not 100% sure (for SET_C_CMP), when we have things like this:
+D0BE: AC 6F D3  LDY  $D36F     [SP=01EC, CC=--.--IZ-, A=AA, X=60, Y=00]
+D0C1: CC 5A D3  CPY  $D35A     [SP=01EC, CC=--.--IZC, A=AA, X=60, Y=00]
+D0C4: F0 0F     BEQ  $D0D5     [SP=01EC, CC=--.--IZC, A=AA, X=60, Y=00]
+D0D5: AD 6E D3  LDA  $D36E     [SP=01EC, CC=--.--I-C, A=0A, X=60, Y=00]
+
+Which shows that $D35A has to be 0 since the Z flag is set.  Why would the carry flag be set on a comparison where the compared items are equal?
+*/
+#define SET_C_CMP(a,b)		SET_C((uint8_t)(b) >= (uint8_t)(a))
+#define SET_ZN(r)			(regs->nz = (uint8_t)(r))
+#define SET_ZNC_CMP(a,b,r)	SET_ZN(r); SET_C_CMP(a,b)
+
+
+//
+// Get the real flags (N & Z included)
+//
+static inline uint8_t GetCC(V65C02REGS * regs)
+{
+	return (regs->cc & ~(FLAG_N | FLAG_Z)) | FLAG_NEGATIVE
+		| (FLAG_ZERO ? FLAG_Z : 0);
+}
+
+
+//
+// Set the flags (N & Z included)
+//
+static inline void SetCC(V65C02REGS * regs, uint8_t cc)
+{
+	regs->cc = cc;
+	regs->nz = (cc & FLAG_Z ? 0 : 0x01) | ((cc & FLAG_N) << 8);
+}
+
+
+// Decimal mode ADC & SBC results (see v65c02.cpp): indexed by carry in, A &
+// the operand (BCD_INDEX), the low byte is the result and the high byte has
+// the C & V flags that go with it
+
+#define BCD_INDEX(c,a,m)	(((uint32_t)(c) << 16) | ((uint32_t)(a) << 8) | (uint8_t)(m))
+
+extern uint16_t bcdADC[0x20000];
+extern uint16_t bcdSBC[0x20000];
+extern bool bcdReady;
+void InitBCDTables(void);
+
+// N.B.: The operand bytes of the current instruction are fetched before its
+//       handler is called (see Execute65C02() below), and PC already points
+//       at the next instruction by then.
+
+#define EA_ZP				(operand & 0xFF)
+#define EA_ZP_X				(operand + regs->x) & 0xFF
+#define EA_ZP_Y				(operand + regs->y) & 0xFF
+#define EA_ABS				operand
+#define EA_ABS_X			operand + regs->x
+#define EA_ABS_Y			operand + regs->y
+#define EA_IND_ZP_X			RdMemWZP<Bus>(regs, (operand + regs->x) & 0xFF)
+#define EA_IND_ZP_Y			RdMemWZP<Bus>(regs, operand) + regs->y
+#define EA_IND_ZP			RdMemWZP<Bus>(regs, operand)
+
+#define READ_IMM			(uint8_t)operand
+#define READ_ZP				Bus::Read(regs, EA_ZP)
+#define READ_ZP_X			Bus::Read(regs, EA_ZP_X)
+#define READ_ZP_Y			Bus::Read(regs, EA_ZP_Y)
+#define READ_ABS			Bus::Read(regs, EA_ABS)
+#define READ_ABS_X			Bus::Read(regs, EA_ABS_X)
+#define READ_ABS_Y			Bus::Read(regs, EA_ABS_Y)
+#define READ_IND_ZP_X		Bus::Read(regs, EA_IND_ZP_X)
+#define READ_IND_ZP_Y		Bus::Read(regs, EA_IND_ZP_Y)
+#define READ_IND_ZP			Bus::Read(regs, EA_IND_ZP)
+
+#define READ_ZP_WB(v)		uint16_t addr = EA_ZP;       v = Bus::Read(regs, addr)
+#define READ_ZP_X_WB(v)		uint16_t addr = EA_ZP_X;     v = Bus::Read(regs, addr)
+#define READ_ABS_WB(v)		uint16_t addr = EA_ABS;      v = Bus::Read(regs, addr)
+#define READ_ABS_X_WB(v)	uint16_t addr = EA_ABS_X;    v = Bus::Read(regs, addr)
+#define READ_ABS_Y_WB(v)	uint16_t addr = EA_ABS_Y;    v = Bus::Read(regs, addr)
+#define READ_IND_ZP_X_WB(v)	uint16_t addr = EA_IND_ZP_X; v = Bus::Read(regs, addr)
+#define READ_IND_ZP_Y_WB(v)	uint16_t addr = EA_IND_ZP_Y; v = Bus::Read(regs, addr)
+#define READ_IND_ZP_WB(v)	uint16_t addr = EA_IND_ZP;   v = Bus::Read(regs, addr)
+
+#define WRITE_BACK(d)		Bus::Write(regs, addr, (d))
+
+
+// Cycle counts should be correct for the the Rockwell version of the 65C02.
+// Extra cycles for page crossing or BCD mode are accounted for in their
+// respective opcode handlers.
+static const uint8_t CPUCycles[256] = {
+	7, 6, 2, 2, 5, 3, 5, 5, 3, 2, 2, 2, 6, 4, 6, 5,
+	2, 5, 5, 2, 5, 4, 6, 5, 2, 4, 2, 2, 6, 4, 6, 5,
+	6, 6, 2, 2, 3, 3, 5, 5, 4, 2, 2, 2, 4, 2, 6, 5,
+	2, 5, 5, 2, 4, 4, 6, 5, 2, 4, 2, 2, 4, 4, 6, 5,
+	6, 6, 2, 2, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 5,
+	2, 5, 5, 2, 4, 4, 6, 5, 2, 4, 3, 2, 8, 4, 6, 5,
+	6, 6, 2, 2, 3, 3, 5, 5, 4, 2, 2, 2, 6, 4, 6, 5,
+	2, 5, 5, 2, 4, 4, 6, 5, 2, 4, 4, 2, 6, 4, 6, 5,
+	2, 6, 2, 2, 3, 3, 3, 5, 2, 2, 2, 2, 4, 4, 4, 5,
+	2, 6, 5, 2, 4, 4, 4, 5, 2, 5, 2, 2, 4, 5, 5, 5,
+	2, 6, 2, 2, 3, 3, 3, 5, 2, 2, 2, 2, 4, 4, 4, 5,
+	2, 5, 5, 2, 4, 4, 4, 5, 2, 4, 2, 2, 4, 4, 4, 5,
+	2, 6, 2, 2, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 5, 5,
+	2, 5, 5, 2, 4, 4, 6, 5, 2, 4, 3, 2, 4, 4, 6, 5,
+	2, 6, 2, 2, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 5,
+	2, 5, 5, 2, 4, 4, 6, 5, 2, 4, 4, 2, 4, 4, 6, 5 };
+
+
+// Instruction lengths (opcode + operand bytes). Unimplemented opcodes are
+// treated as one byte NOPs.
+static const uint8_t CPUBytes[256] = {
+	1, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 3, 1, 1, 3, 3, 3, 3,
+	3, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 3, 1, 1, 3, 3, 3, 3,
+	1, 2, 1, 1, 1, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 1, 2, 2, 2, 1, 3, 1, 1, 1, 3, 3, 3,
+	1, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 3, 1, 1, 3, 3, 3, 3,
+	2, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 3, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 2, 2, 2, 2, 1, 3, 1, 1, 3, 3, 3, 3,
+	2, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 1, 2, 2, 2, 1, 3, 1, 1, 1, 3, 3, 3,
+	2, 2, 1, 1, 2, 2, 2, 2, 1, 2, 1, 1, 3, 3, 3, 3,
+	2, 2, 2, 1, 1, 2, 2, 2, 1, 3, 1, 1, 1, 3, 3, 3 };
+
+
+//
+// Read a uint16_t out of 65C02 memory (little endian format). The low byte is
+// read first, like the real thing does (and so that the order is the same
+// every time; translated code has to match it).
+//
+template <class Bus> static inline uint16_t RdMemW(V65C02REGS * regs, uint16_t address)
+{
+	uint8_t lo = Bus::Read(regs, address + 0);
+	return (uint16_t)(Bus::Read(regs, address + 1) << 8) | lo;
+}
+
+
+//
+// Read a uint16_t out of 65C02 memory (little endian format), wrapping on
+// page 0
+//
+template <class Bus> static inline uint16_t RdMemWZP(V65C02REGS * regs, uint16_t address)
+{
+	uint8_t lo = Bus::Read(regs, address + 0);
+	return (uint16_t)(Bus::Read(regs, (address + 1) & 0xFF) << 8) | lo;
+}
+
+
+//
+// 65C02 OPCODE IMPLEMENTATION
+//
+// NOTE: Lots of macros are used here to save a LOT of typing.  Also
+//       helps speed the debugging process.  :-)  Because of this, combining
+//       certain lines may look like a good idea but would end in disaster.
+//       You have been warned!  ;-)
+//
+
+// Page crossing macros.  These catch the cases where access of a certain type
+// will incur a one cycle penalty when crossing a page boundary.
+
+#define HANDLE_PAGE_CROSSING_IND_Y \
+	uint16_t addressLo = Bus::Read(regs, operand); \
+\
+	if ((addressLo + regs->y) > 0xFF) \
+		regs->clock++;
+
+#define HANDLE_PAGE_CROSSING_ABS_X \
+	uint16_t addressLo = operand & 0xFF; \
+\
+	if ((addressLo + regs->x) > 0xFF) \
+		regs->clock++;
+
+#define HANDLE_PAGE_CROSSING_ABS_Y \
+	uint16_t addressLo = operand & 0xFF; \
+\
+	if ((addressLo + regs->y) > 0xFF) \
+		regs->clock++;
+
+// Branch taken adds a cycle, crossing page adds one more
+
+#define HANDLE_BRANCH_TAKEN(m)       \
+{                                    \
+	uint16_t oldpc = regs->pc;       \
+	regs->pc += m;                   \
+	regs->clock++;                   \
+                                     \
+	if ((oldpc ^ regs->pc) & 0xFF00) \
+		regs->clock++;               \
+}
+
+/*
+Mnemonic	Addressing mode	Form		Opcode	Size	Timing
+
+ADC			Immediate		ADC #Oper	69		2		2
+			Zero Page		ADC Zpg		65		2		3
+			Zero Page,X		ADC Zpg,X	75		2		4
+			Absolute		ADC Abs		6D		3		4
+			Absolute,X		ADC Abs,X	7D		3		4
+			Absolute,Y		ADC Abs,Y	79		3		4
+			(Zero Page,X)	ADC (Zpg,X)	61		2		6
+			(Zero Page),Y	ADC (Zpg),Y	71		2		5
+			(Zero Page)		ADC (Zpg)	72		2		5
+*/
+
+// ADC opcodes
+
+//N.B.: Decimal mode comes out of a table (see ADCDecimal() in v65c02.cpp for
+//      how it's worked out), and incurs a one cycle penalty (for the decimal
+//      correction).
+#define OP_ADC_HANDLER(m) \
+	if (regs->cc & FLAG_D) \
+	{ \
+		if (!bcdReady) \
+			InitBCDTables(); \
+\
+		uint16_t result = bcdADC[BCD_INDEX(regs->cc & FLAG_C, regs->a, m)]; \
+		regs->cc = (regs->cc & ~(FLAG_C | FLAG_V)) | (result >> 8); \
+		regs->a = result & 0xFF; \
+		regs->clock++; \
+	} \
+	else \
+	{ \
+		uint16_t sum = (uint16_t)regs->a + (m) + (uint16_t)(regs->cc & FLAG_C); \
+		regs->cc = (regs->cc & ~(FLAG_C | FLAG_V)) | (sum >> 8) \
+			| ((~(regs->a ^ (m)) & (regs->a ^ sum) & 0x80) >> 1); \
+		regs->a = sum & 0xFF; \
+	} \
+\
+	SET_ZN(regs->a)
+
+template <class Bus> static void Op69(V65C02REGS * regs, uint16_t operand)	// ADC #
+{
+	uint16_t m = READ_IMM;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op65(V65C02REGS * regs, uint16_t operand)	// ADC ZP
+{
+	uint16_t m = READ_ZP;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op75(V65C02REGS * regs, uint16_t operand)	// ADC ZP, X
+{
+	uint16_t m = READ_ZP_X;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op6D(V65C02REGS * regs, uint16_t operand)	// ADC ABS
+{
+	uint16_t m = READ_ABS;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op7D(V65C02REGS * regs, uint16_t operand)	// ADC ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint16_t m = READ_ABS_X;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op79(V65C02REGS * regs, uint16_t operand)	// ADC ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint16_t m = READ_ABS_Y;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op61(V65C02REGS * regs, uint16_t operand)	// ADC (ZP, X)
+{
+	uint16_t m = READ_IND_ZP_X;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op71(V65C02REGS * regs, uint16_t operand)	// ADC (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint16_t m = READ_IND_ZP_Y;
+	OP_ADC_HANDLER(m);
+}
+
+template <class Bus> static void Op72(V65C02REGS * regs, uint16_t operand)	// ADC (ZP)
+{
+	uint16_t m = READ_IND_ZP;
+	OP_ADC_HANDLER(m);
+}
+
+/*
+AND	Immediate	AND #Oper	29	2	2
+Zero Page		AND Zpg		25	2	3
+Zero Page,X		AND Zpg,X	35	2	4
+Absolute		AND Abs		2D	3	4
+Absolute,X		AND Abs,X	3D	3	4
+Absolute,Y		AND Abs,Y	39	3	4
+(Zero Page,X)	AND (Zpg,X)	21	2	6
+(Zero Page),Y	AND (Zpg),Y	31	2	5
+(Zero Page)		AND (Zpg)	32	2	5
+*/
+
+// AND opcodes
+
+#define OP_AND_HANDLER(m) \
+	regs->a &= m; \
+	SET_ZN(regs->a)
+
+template <class Bus> static void Op29(V65C02REGS * regs, uint16_t operand)	// AND #
+{
+	uint8_t m = READ_IMM;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op25(V65C02REGS * regs, uint16_t operand)	// AND ZP
+{
+	uint8_t m = READ_ZP;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op35(V65C02REGS * regs, uint16_t operand)	// AND ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op2D(V65C02REGS * regs, uint16_t operand)	// AND ABS
+{
+	uint8_t m = READ_ABS;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op3D(V65C02REGS * regs, uint16_t operand)	// AND ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op39(V65C02REGS * regs, uint16_t operand)	// AND ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op21(V65C02REGS * regs, uint16_t operand)	// AND (ZP, X)
+{
+	uint8_t m = READ_IND_ZP_X;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op31(V65C02REGS * regs, uint16_t operand)	// AND (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint8_t m = READ_IND_ZP_Y;
+	OP_AND_HANDLER(m);
+}
+
+template <class Bus> static void Op32(V65C02REGS * regs, uint16_t operand)	// AND (ZP)
+{
+	uint8_t m = READ_IND_ZP;
+	OP_AND_HANDLER(m);
+}
+
+/*
+ASL	Accumulator	ASL A		0A	1	2
+Zero Page		ASL Zpg		06	2	5
+Zero Page,X		ASL Zpg,X	16	2	6
+Absolute		ASL Abs		0E	3	6
+Absolute,X		ASL Abs,X	1E	3	7
+*/
+
+// ASL opcodes
+
+#define OP_ASL_HANDLER(m) \
+	SET_C((m) >> 7); \
+	(m) <<= 1; \
+	SET_ZN((m))
+
+template <class Bus> static void Op0A(V65C02REGS * regs, uint16_t operand)	// ASL A
+{
+	OP_ASL_HANDLER(regs->a);
+}
+
+template <class Bus> static void Op06(V65C02REGS * regs, uint16_t operand)	// ASL ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_ASL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op16(V65C02REGS * regs, uint16_t operand)	// ASL ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_ASL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op0E(V65C02REGS * regs, uint16_t operand)	// ASL ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_ASL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op1E(V65C02REGS * regs, uint16_t operand)	// ASL ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_ASL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+BBR0	ZP, Relative	BBR0 Oper	0F	3	5
+BBR1	ZP, Relative	BBR1 Oper	1F	3	5
+BBR2	ZP, Relative	BBR2 Oper	2F	3	5
+BBR3	ZP, Relative	BBR3 Oper	3F	3	5
+BBR4	ZP, Relative	BBR4 Oper	4F	3	5
+BBR5	ZP, Relative	BBR5 Oper	5F	3	5
+BBR6	ZP, Relative	BBR6 Oper	6F	3	5
+BBR7	ZP, Relative	BBR7 Oper	7F	3	5
+BBS0	ZP, Relative	BBS0 Oper	8F	3	5
+BBS1	ZP, Relative	BBS1 Oper	9F	3	5
+BBS2	ZP, Relative	BBS2 Oper	AF	3	5
+BBS3	ZP, Relative	BBS3 Oper	BF	3	5
+BBS4	ZP, Relative	BBS4 Oper	CF	3	5
+BBS5	ZP, Relative	BBS5 Oper	DF	3	5
+BBS6	ZP, Relative	BBS6 Oper	EF	3	5
+BBS7	ZP, Relative	BBS7 Oper	FF	3	5
+*/
+
+// BBR/Sn opcodes
+
+template <class Bus> static void Op0F(V65C02REGS * regs, uint16_t operand)	// BBR0
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x01))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op1F(V65C02REGS * regs, uint16_t operand)	// BBR1
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x02))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op2F(V65C02REGS * regs, uint16_t operand)	// BBR2
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x04))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op3F(V65C02REGS * regs, uint16_t operand)	// BBR3
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x08))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op4F(V65C02REGS * regs, uint16_t operand)	// BBR4
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x10))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op5F(V65C02REGS * regs, uint16_t operand)	// BBR5
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x20))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op6F(V65C02REGS * regs, uint16_t operand)	// BBR6
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x40))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op7F(V65C02REGS * regs, uint16_t operand)	// BBR7
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (!(b & 0x80))
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op8F(V65C02REGS * regs, uint16_t operand)	// BBS0
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x01)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void Op9F(V65C02REGS * regs, uint16_t operand)	// BBS1
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x02)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpAF(V65C02REGS * regs, uint16_t operand)	// BBS2
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x04)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpBF(V65C02REGS * regs, uint16_t operand)	// BBS3
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x08)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpCF(V65C02REGS * regs, uint16_t operand)	// BBS4
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x10)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpDF(V65C02REGS * regs, uint16_t operand)	// BBS5
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x20)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpEF(V65C02REGS * regs, uint16_t operand)	// BBS6
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x40)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+template <class Bus> static void OpFF(V65C02REGS * regs, uint16_t operand)	// BBS7
+{
+	uint8_t b = READ_ZP;
+	int16_t m = (int16_t)(int8_t)(operand >> 8);
+
+	if (b & 0x80)
+		HANDLE_BRANCH_TAKEN(m);
+}
+
+/*
+BCC	Relative	BCC Oper	90	2	2
+BCS	Relative	BCS Oper	B0	2	2
+BEQ	Relative	BEQ Oper	F0	2	2
+*/
+
+// Branch opcodes
+
+template <class Bus> static void Op90(V65C02REGS * regs, uint16_t operand)	// BCC
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (!(regs->cc & FLAG_C))
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void OpB0(V65C02REGS * regs, uint16_t operand)	// BCS
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (regs->cc & FLAG_C)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void OpF0(V65C02REGS * regs, uint16_t operand)	// BEQ
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (FLAG_ZERO)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+/*
+BIT	Immediate	BIT #Oper	89	2	2
+Zero Page		BIT Zpg		24	2	3
+Zero Page,X		BIT Zpg,X	34	2	4
+Absolute		BIT Abs		2C	3	4
+Absolute,X		BIT Abs,X	3C	3	4
+*/
+
+// BIT opcodes
+
+/* 1. The BIT instruction copies bit 6 to the V flag, and bit 7 to the N flag
+      (except in immediate addressing mode where V & N are untouched.) The
+      accumulator and the operand are ANDed and the Z flag is set
+      appropriately. */
+
+#define OP_BIT_HANDLER(m) \
+	uint8_t result = regs->a & (m); \
+	regs->cc = (regs->cc & ~FLAG_V) | ((m) & FLAG_V); \
+	regs->nz = result | (((m) & 0x80) << 8)
+
+template <class Bus> static void Op89(V65C02REGS * regs, uint16_t operand)	// BIT #
+{
+	int8_t m = READ_IMM;
+	int8_t result = regs->a & m;
+	SET_Z(result);
+}
+
+template <class Bus> static void Op24(V65C02REGS * regs, uint16_t operand)	// BIT ZP
+{
+	int8_t m = READ_ZP;
+	OP_BIT_HANDLER(m);
+}
+
+template <class Bus> static void Op34(V65C02REGS * regs, uint16_t operand)	// BIT ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_BIT_HANDLER(m);
+}
+
+template <class Bus> static void Op2C(V65C02REGS * regs, uint16_t operand)	// BIT ABS
+{
+	uint8_t m = READ_ABS;
+	OP_BIT_HANDLER(m);
+}
+
+template <class Bus> static void Op3C(V65C02REGS * regs, uint16_t operand)	// BIT ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_BIT_HANDLER(m);
+}
+
+/*
+BMI	Relative	BMI Oper	30	2	2
+BNE	Relative	BNE Oper	D0	2	2
+BPL	Relative	BPL Oper	10	2	2
+BRA	Relative	BRA Oper	80	2	3
+*/
+
+// More branch opcodes
+
+template <class Bus> static void Op30(V65C02REGS * regs, uint16_t operand)	// BMI
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (FLAG_NEGATIVE)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void OpD0(V65C02REGS * regs, uint16_t operand)	// BNE
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (!FLAG_ZERO)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void Op10(V65C02REGS * regs, uint16_t operand)	// BPL
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (!FLAG_NEGATIVE)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void Op80(V65C02REGS * regs, uint16_t operand)	// BRA
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+	HANDLE_BRANCH_TAKEN(m)
+}
+
+/*
+BRK	Implied		BRK			00	1	7
+*/
+
+template <class Bus> static void Op00(V65C02REGS * regs, uint16_t operand)	// BRK
+{
+#ifdef __DEBUG__
+WriteLog("\n*** BRK ***\n\n");
+WriteLog(" [PC=%04X, SP=%04X, CC=%s%s.%s%s%s%s%s, A=%02X, X=%02X, Y=%02X]\n",
+	regs->pc, 0x0100 + regs->sp,
+	(FLAG_NEGATIVE ? "N" : "-"), (regs->cc & FLAG_V ? "V" : "-"),
+	(regs->cc & FLAG_B ? "B" : "-"), (regs->cc & FLAG_D ? "D" : "-"),
+	(regs->cc & FLAG_I ? "I" : "-"), (FLAG_ZERO ? "Z" : "-"),
+	(regs->cc & FLAG_C ? "C" : "-"), regs->a, regs->x, regs->y);
+#endif
+	regs->cc |= FLAG_B;							// Set B
+	regs->pc++;									// RTI comes back to the instruction one byte after the BRK
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->pc >> 8);	// Save PC and CC
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->pc & 0xFF);
+	Bus::Write(regs, 0x0100 + regs->sp--, GetCC(regs));
+	regs->cc |= FLAG_I;							// Set I
+	regs->cc &= ~FLAG_D;							// & clear D
+	regs->pc = RdMemW<Bus>(regs, 0xFFFE);					// Grab the IRQ vector & go...
+}
+
+/*
+BVC	Relative	BVC Oper	50	2	2
+BVS	Relative	BVS Oper	70	2	2
+*/
+
+// Even more branch opcodes
+
+template <class Bus> static void Op50(V65C02REGS * regs, uint16_t operand)	// BVC
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (!(regs->cc & FLAG_V))
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+template <class Bus> static void Op70(V65C02REGS * regs, uint16_t operand)	// BVS
+{
+	int16_t m = (int16_t)(int8_t)READ_IMM;
+
+	if (regs->cc & FLAG_V)
+		HANDLE_BRANCH_TAKEN(m)
+}
+
+/*
+CLC	Implied		CLC			18	1	2
+*/
+
+template <class Bus> static void Op18(V65C02REGS * regs, uint16_t operand)	// CLC
+{
+	regs->cc &= ~FLAG_C;
+}
+
+/*
+CLD	Implied		CLD			D8	1	2
+*/
+
+template <class Bus> static void OpD8(V65C02REGS * regs, uint16_t operand)	// CLD
+{
+	CLR_D;
+}
+
+/*
+CLI	Implied		CLI			58	1	2
+*/
+
+template <class Bus> static void Op58(V65C02REGS * regs, uint16_t operand)	// CLI
+{
+	regs->cc &= ~FLAG_I;
+}
+
+/*
+CLV	Implied		CLV			B8	1	2
+*/
+
+template <class Bus> static void OpB8(V65C02REGS * regs, uint16_t operand)	// CLV
+{
+	regs->cc &= ~FLAG_V;
+}
+
+/*
+CMP	Immediate	CMP #Oper	C9	2	2
+Zero Page		CMP Zpg		C5	2	3
+Zero Page,X		CMP Zpg		D5	2	4
+Absolute		CMP Abs		CD	3	4
+Absolute,X		CMP Abs,X	DD	3	4
+Absolute,Y		CMP Abs,Y	D9	3	4
+(Zero Page,X)	CMP (Zpg,X)	C1	2	6
+(Zero Page),Y	CMP (Zpg),Y	D1	2	5
+(Zero Page)		CMP (Zpg)	D2	2	5
+*/
+
+// CMP opcodes
+
+#define OP_CMP_HANDLER(m) \
+	uint8_t result = regs->a - (m); \
+	SET_ZNC_CMP(m, regs->a, result)
+
+template <class Bus> static void OpC9(V65C02REGS * regs, uint16_t operand)	// CMP #
+{
+	uint8_t m = READ_IMM;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpC5(V65C02REGS * regs, uint16_t operand)	// CMP ZP
+{
+	uint8_t m = READ_ZP;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpD5(V65C02REGS * regs, uint16_t operand)	// CMP ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpCD(V65C02REGS * regs, uint16_t operand)	// CMP ABS
+{
+	uint8_t m = READ_ABS;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpDD(V65C02REGS * regs, uint16_t operand)	// CMP ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpD9(V65C02REGS * regs, uint16_t operand)	// CMP ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpC1(V65C02REGS * regs, uint16_t operand)	// CMP (ZP, X)
+{
+	uint8_t m = READ_IND_ZP_X;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpD1(V65C02REGS * regs, uint16_t operand)	// CMP (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint8_t m = READ_IND_ZP_Y;
+	OP_CMP_HANDLER(m);
+}
+
+template <class Bus> static void OpD2(V65C02REGS * regs, uint16_t operand)	// CMP (ZP)
+{
+	uint8_t m = READ_IND_ZP;
+	OP_CMP_HANDLER(m);
+}
+
+/*
+CPX	Immediate	CPX #Oper	E0	2	2
+Zero Page		CPX Zpg		E4	2	3
+Absolute		CPX Abs		EC	3	4
+*/
+
+// CPX opcodes
+
+#define OP_CPX_HANDLER(m) \
+	uint8_t result = regs->x - (m); \
+	SET_ZNC_CMP(m, regs->x, result)
+
+template <class Bus> static void OpE0(V65C02REGS * regs, uint16_t operand)	// CPX #
+{
+	uint8_t m = READ_IMM;
+	OP_CPX_HANDLER(m);
+}
+
+template <class Bus> static void OpE4(V65C02REGS * regs, uint16_t operand)	// CPX ZP
+{
+	uint8_t m = READ_ZP;
+	OP_CPX_HANDLER(m);
+}
+
+template <class Bus> static void OpEC(V65C02REGS * regs, uint16_t operand)	// CPX ABS
+{
+	uint8_t m = READ_ABS;
+	OP_CPX_HANDLER(m);
+}
+
+/*
+CPY	Immediate	CPY #Oper	C0	2	2
+Zero Page		CPY Zpg		C4	2	3
+Absolute		CPY Abs		CC	3	4
+*/
+
+// CPY opcodes
+
+#define OP_CPY_HANDLER(m) \
+	uint8_t result = regs->y - (m); \
+	SET_ZNC_CMP(m, regs->y, result)
+
+template <class Bus> static void OpC0(V65C02REGS * regs, uint16_t operand)	// CPY #
+{
+	uint8_t m = READ_IMM;
+	OP_CPY_HANDLER(m);
+}
+
+template <class Bus> static void OpC4(V65C02REGS * regs, uint16_t operand)	// CPY ZP
+{
+	uint8_t m = READ_ZP;
+	OP_CPY_HANDLER(m);
+}
+
+template <class Bus> static void OpCC(V65C02REGS * regs, uint16_t operand)	// CPY ABS
+{
+	uint8_t m = READ_ABS;
+	OP_CPY_HANDLER(m);
+}
+
+/*
+DEA	Accumulator	DEA			3A	1	2
+*/
+
+template <class Bus> static void Op3A(V65C02REGS * regs, uint16_t operand)	// DEA
+{
+	regs->a--;
+	SET_ZN(regs->a);
+}
+
+/*
+DEC	Zero Page	DEC Zpg		C6	2	5
+Zero Page,X		DEC Zpg,X	D6	2	6
+Absolute		DEC Abs		CE	3	6
+Absolute,X		DEC Abs,X	DE	3	7
+*/
+
+// DEC opcodes
+
+#define OP_DEC_HANDLER(m) \
+	m--; \
+	SET_ZN(m)
+
+template <class Bus> static void OpC6(V65C02REGS * regs, uint16_t operand)	// DEC ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_DEC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpD6(V65C02REGS * regs, uint16_t operand)	// DEC ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_DEC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpCE(V65C02REGS * regs, uint16_t operand)	// DEC ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_DEC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpDE(V65C02REGS * regs, uint16_t operand)	// DEC ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_DEC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+DEX	Implied		DEX			CA	1	2
+*/
+
+template <class Bus> static void OpCA(V65C02REGS * regs, uint16_t operand)	// DEX
+{
+	regs->x--;
+	SET_ZN(regs->x);
+}
+
+/*
+DEY	Implied		DEY			88	1	2
+*/
+
+template <class Bus> static void Op88(V65C02REGS * regs, uint16_t operand)	// DEY
+{
+	regs->y--;
+	SET_ZN(regs->y);
+}
+
+/*
+EOR	Immediate	EOR #Oper	49	2	2
+Zero Page		EOR Zpg		45	2	3
+Zero Page,X		EOR Zpg,X	55	2	4
+Absolute		EOR Abs		4D	3	4
+Absolute,X		EOR Abs,X	5D	3	4
+Absolute,Y		EOR Abs,Y	59	3	4
+(Zero Page,X)	EOR (Zpg,X)	41	2	6
+(Zero Page),Y	EOR (Zpg),Y	51	2	5
+(Zero Page)		EOR (Zpg)	52	2	5
+*/
+
+// EOR opcodes
+
+#define OP_EOR_HANDLER(m) \
+	regs->a ^= m; \
+	SET_ZN(regs->a)
+
+template <class Bus> static void Op49(V65C02REGS * regs, uint16_t operand)	// EOR #
+{
+	uint8_t m = READ_IMM;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op45(V65C02REGS * regs, uint16_t operand)	// EOR ZP
+{
+	uint8_t m = READ_ZP;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op55(V65C02REGS * regs, uint16_t operand)	// EOR ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op4D(V65C02REGS * regs, uint16_t operand)	// EOR ABS
+{
+	uint8_t m = READ_ABS;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op5D(V65C02REGS * regs, uint16_t operand)	// EOR ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op59(V65C02REGS * regs, uint16_t operand)	// EOR ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op41(V65C02REGS * regs, uint16_t operand)	// EOR (ZP, X)
+{
+	uint8_t m = READ_IND_ZP_X;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op51(V65C02REGS * regs, uint16_t operand)	// EOR (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint8_t m = READ_IND_ZP_Y;
+	OP_EOR_HANDLER(m);
+}
+
+template <class Bus> static void Op52(V65C02REGS * regs, uint16_t operand)	// EOR (ZP)
+{
+	uint8_t m = READ_IND_ZP;
+	OP_EOR_HANDLER(m);
+}
+
+/*
+INA	Accumulator	INA			1A	1	2
+*/
+
+template <class Bus> static void Op1A(V65C02REGS * regs, uint16_t operand)	// INA
+{
+	regs->a++;
+	SET_ZN(regs->a);
+}
+
+/*
+INC	Zero Page	INC Zpg		E6	2	5
+Zero Page,X		INC Zpg,X	F6	2	6
+Absolute		INC Abs		EE	3	6
+Absolute,X		INC Abs,X	FE	3	7
+*/
+
+// INC opcodes
+
+#define OP_INC_HANDLER(m) \
+	m++; \
+	SET_ZN(m)
+
+template <class Bus> static void OpE6(V65C02REGS * regs, uint16_t operand)	// INC ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_INC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpF6(V65C02REGS * regs, uint16_t operand)	// INC ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_INC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpEE(V65C02REGS * regs, uint16_t operand)	// INC ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_INC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpFE(V65C02REGS * regs, uint16_t operand)	// INC ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_INC_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+INX	Implied		INX			E8	1	2
+*/
+
+template <class Bus> static void OpE8(V65C02REGS * regs, uint16_t operand)	// INX
+{
+	regs->x++;
+	SET_ZN(regs->x);
+}
+
+/*
+INY	Implied		INY			C8	1	2
+*/
+
+template <class Bus> static void OpC8(V65C02REGS * regs, uint16_t operand)	// INY
+{
+	regs->y++;
+	SET_ZN(regs->y);
+}
+
+/*
+JMP	Absolute	JMP Abs		4C	3	3
+(Absolute)		JMP (Abs)	6C	3	5
+(Absolute,X)	JMP (Abs,X)	7C	3	6
+*/
+
+// JMP opcodes
+
+template <class Bus> static void Op4C(V65C02REGS * regs, uint16_t operand)	// JMP ABS
+{
+	regs->pc = operand;
+}
+
+template <class Bus> static void Op6C(V65C02REGS * regs, uint16_t operand)	// JMP (ABS)
+{
+	// Check for page crossing
+	if ((operand & 0xFF) == 0xFF)
+		regs->clock++;
+
+	regs->pc = RdMemW<Bus>(regs, operand);
+}
+
+template <class Bus> static void Op7C(V65C02REGS * regs, uint16_t operand)	// JMP (ABS, X)
+{
+	regs->pc = RdMemW<Bus>(regs, operand + regs->x);
+}
+
+/*
+JSR	Absolute	JSR Abs		20	3	6
+*/
+
+template <class Bus> static void Op20(V65C02REGS * regs, uint16_t operand)	// JSR
+{
+	regs->pc--;									// Since it pushes return address - 1...
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->pc >> 8);
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->pc & 0xFF);
+	regs->pc = operand;
+}
+
+/*
+LDA	Immediate	LDA #Oper	A9	2	2
+Zero Page		LDA Zpg		A5	2	3
+Zero Page,X		LDA Zpg,X	B5	2	4
+Absolute		LDA Abs		AD	3	4
+Absolute,X		LDA Abs,X	BD	3	4
+Absolute,Y		LDA Abs,Y	B9	3	4
+(Zero Page,X)	LDA (Zpg,X)	A1	2	6
+(Zero Page),Y	LDA (Zpg),Y	B1	2	5
+(Zero Page)		LDA (Zpg)	B2	2	5
+*/
+
+// LDA opcodes
+
+#define OP_LDA_HANDLER(m) \
+	regs->a = m; \
+	SET_ZN(regs->a)
+
+template <class Bus> static void OpA9(V65C02REGS * regs, uint16_t operand)	// LDA #
+{
+	uint8_t m = READ_IMM;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpA5(V65C02REGS * regs, uint16_t operand)	// LDA ZP
+{
+	uint8_t m = READ_ZP;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpB5(V65C02REGS * regs, uint16_t operand)	// LDA ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpAD(V65C02REGS * regs, uint16_t operand)	// LDA ABS
+{
+	uint8_t m = READ_ABS;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpBD(V65C02REGS * regs, uint16_t operand)	// LDA ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpB9(V65C02REGS * regs, uint16_t operand)	// LDA ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpA1(V65C02REGS * regs, uint16_t operand)	// LDA (ZP, X)
+{
+	uint8_t m = READ_IND_ZP_X;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpB1(V65C02REGS * regs, uint16_t operand)	// LDA (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint8_t m = READ_IND_ZP_Y;
+	OP_LDA_HANDLER(m);
+}
+
+template <class Bus> static void OpB2(V65C02REGS * regs, uint16_t operand)	// LDA (ZP)
+{
+	uint8_t m = READ_IND_ZP;
+	OP_LDA_HANDLER(m);
+}
+
+/*
+LDX	Immediate	LDX #Oper	A2	2	2
+Zero Page		LDX Zpg		A6	2	3
+Zero Page,Y		LDX Zpg,Y	B6	2	4
+Absolute		LDX Abs		AE	3	4
+Absolute,Y		LDX Abs,Y	BE	3	4
+*/
+
+// LDX opcodes
+
+#define OP_LDX_HANDLER(m) \
+	regs->x = m; \
+	SET_ZN(regs->x)
+
+template <class Bus> static void OpA2(V65C02REGS * regs, uint16_t operand)	// LDX #
+{
+	uint8_t m = READ_IMM;
+	OP_LDX_HANDLER(m);
+}
+
+template <class Bus> static void OpA6(V65C02REGS * regs, uint16_t operand)	// LDX ZP
+{
+	uint8_t m = READ_ZP;
+	OP_LDX_HANDLER(m);
+}
+
+template <class Bus> static void OpB6(V65C02REGS * regs, uint16_t operand)	// LDX ZP, Y
+{
+	uint8_t m = READ_ZP_Y;
+	OP_LDX_HANDLER(m);
+}
+
+template <class Bus> static void OpAE(V65C02REGS * regs, uint16_t operand)	// LDX ABS
+{
+	uint8_t m = READ_ABS;
+	OP_LDX_HANDLER(m);
+}
+
+template <class Bus> static void OpBE(V65C02REGS * regs, uint16_t operand)	// LDX ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_LDX_HANDLER(m);
+}
+
+/*
+LDY	Immediate	LDY #Oper	A0	2	2
+Zero Page		LDY Zpg		A4	2	3
+Zero Page,X		LDY Zpg,X	B4	2	4
+Absolute		LDY Abs		AC	3	4
+Absolute,X		LDY Abs,X	BC	3	4
+*/
+
+// LDY opcodes
+
+#define OP_LDY_HANDLER(m) \
+	regs->y = m; \
+	SET_ZN(regs->y)
+
+template <class Bus> static void OpA0(V65C02REGS * regs, uint16_t operand)	// LDY #
+{
+	uint8_t m = READ_IMM;
+	OP_LDY_HANDLER(m);
+}
+
+template <class Bus> static void OpA4(V65C02REGS * regs, uint16_t operand)	// LDY ZP
+{
+	uint8_t m = READ_ZP;
+	OP_LDY_HANDLER(m);
+}
+
+template <class Bus> static void OpB4(V65C02REGS * regs, uint16_t operand)	// LDY ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_LDY_HANDLER(m);
+}
+
+template <class Bus> static void OpAC(V65C02REGS * regs, uint16_t operand)	// LDY ABS
+{
+	uint8_t m = READ_ABS;
+	OP_LDY_HANDLER(m);
+}
+
+template <class Bus> static void OpBC(V65C02REGS * regs, uint16_t operand)	// LDY ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_LDY_HANDLER(m);
+}
+
+/*
+LSR	Accumulator	LSR A		4A	1	2
+Zero Page		LSR Zpg		46	2	5
+Zero Page,X		LSR Zpg,X	56	2	6
+Absolute		LSR Abs		4E	3	6
+Absolute,X		LSR Abs,X	5E	3	7
+*/
+
+// LSR opcodes
+
+#define OP_LSR_HANDLER(m) \
+	SET_C((m) & 0x01); \
+	(m) >>= 1; \
+	SET_ZN((m))
+
+template <class Bus> static void Op4A(V65C02REGS * regs, uint16_t operand)	// LSR A
+{
+	OP_LSR_HANDLER(regs->a);
+}
+
+template <class Bus> static void Op46(V65C02REGS * regs, uint16_t operand)	// LSR ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_LSR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op56(V65C02REGS * regs, uint16_t operand)	// LSR ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_LSR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op4E(V65C02REGS * regs, uint16_t operand)	// LSR ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_LSR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op5E(V65C02REGS * regs, uint16_t operand)	// LSR ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_LSR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+NOP	Implied		NOP			EA	1	2
+*/
+
+template <class Bus> static void OpEA(V65C02REGS * regs, uint16_t operand)	// NOP
+{
+}
+
+/*
+ORA	Immediate	ORA #Oper	09	2	2
+Zero Page		ORA Zpg		05	2	3
+Zero Page,X		ORA Zpg,X	15	2	4
+Absolute		ORA Abs		0D	3	4
+Absolute,X		ORA Abs,X	1D	3	4
+Absolute,Y		ORA Abs,Y	19	3	4
+(Zero Page,X)	ORA (Zpg,X)	01	2	6
+(Zero Page),Y	ORA (Zpg),Y	11	2	5
+(Zero Page)		ORA (Zpg)	12	2	5
+*/
+
+// ORA opcodes
+
+#define OP_ORA_HANDLER(m) \
+	regs->a |= m; \
+	SET_ZN(regs->a)
+
+template <class Bus> static void Op09(V65C02REGS * regs, uint16_t operand)	// ORA #
+{
+	uint8_t m = READ_IMM;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op05(V65C02REGS * regs, uint16_t operand)	// ORA ZP
+{
+	uint8_t m = READ_ZP;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op15(V65C02REGS * regs, uint16_t operand)	// ORA ZP, X
+{
+	uint8_t m = READ_ZP_X;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op0D(V65C02REGS * regs, uint16_t operand)	// ORA ABS
+{
+	uint8_t m = READ_ABS;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op1D(V65C02REGS * regs, uint16_t operand)	// ORA ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m = READ_ABS_X;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op19(V65C02REGS * regs, uint16_t operand)	// ORA ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint8_t m = READ_ABS_Y;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op01(V65C02REGS * regs, uint16_t operand)	// ORA (ZP, X)
+{
+	uint8_t m = READ_IND_ZP_X;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op11(V65C02REGS * regs, uint16_t operand)	// ORA (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint8_t m = READ_IND_ZP_Y;
+	OP_ORA_HANDLER(m);
+}
+
+template <class Bus> static void Op12(V65C02REGS * regs, uint16_t operand)	// ORA (ZP)
+{
+	uint8_t m = READ_IND_ZP;
+	OP_ORA_HANDLER(m);
+}
+
+/*
+PHA	Implied		PHA			48	1	3
+*/
+
+template <class Bus> static void Op48(V65C02REGS * regs, uint16_t operand)	// PHA
+{
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->a);
+}
+
+template <class Bus> static void Op08(V65C02REGS * regs, uint16_t operand)	// PHP
+{
+	regs->cc |= FLAG_UNK;						// Make sure that the unused bit is always set
+	Bus::Write(regs, 0x0100 + regs->sp--, GetCC(regs));
+}
+
+/*
+PHX	Implied		PHX			DA	1	3
+*/
+
+template <class Bus> static void OpDA(V65C02REGS * regs, uint16_t operand)	// PHX
+{
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->x);
+}
+
+/*
+PHY	Implied		PHY			5A	1	3
+*/
+
+template <class Bus> static void Op5A(V65C02REGS * regs, uint16_t operand)	// PHY
+{
+	Bus::Write(regs, 0x0100 + regs->sp--, regs->y);
+}
+
+/*
+PLA	Implied		PLA			68	1	4
+*/
+
+template <class Bus> static void Op68(V65C02REGS * regs, uint16_t operand)	// PLA
+{
+	regs->a = Bus::Read(regs, 0x0100 + ++regs->sp);
+	SET_ZN(regs->a);
+}
+
+template <class Bus> static void Op28(V65C02REGS * regs, uint16_t operand)	// PLP
+{
+	SetCC(regs, Bus::Read(regs, 0x0100 + ++regs->sp));
+}
+
+/*
+PLX	Implied		PLX			FA	1	4
+*/
+
+template <class Bus> static void OpFA(V65C02REGS * regs, uint16_t operand)	// PLX
+{
+	regs->x = Bus::Read(regs, 0x0100 + ++regs->sp);
+	SET_ZN(regs->x);
+}
+
+/*
+PLY	Implied		PLY			7A	1	4
+*/
+
+template <class Bus> static void Op7A(V65C02REGS * regs, uint16_t operand)	// PLY
+{
+	regs->y = Bus::Read(regs, 0x0100 + ++regs->sp);
+	SET_ZN(regs->y);
+}
+
+/*
+The bit set and clear instructions have the form xyyy0111, where x is 0 to clear a bit or 1 to set it, and yyy is which bit at the memory location to set or clear.
+   RMB0  RMB1  RMB2  RMB3  RMB4  RMB5  RMB6  RMB7
+  zp  07  17  27  37  47  57  67  77
+     SMB0  SMB1  SMB2  SMB3  SMB4  SMB5  SMB6  SMB7
+  zp  87  97  A7  B7  C7  D7  E7  F7
+*/
+
+// RMB opcodes
+
+template <class Bus> static void Op07(V65C02REGS * regs, uint16_t operand)	// RMB0 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xFE;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op17(V65C02REGS * regs, uint16_t operand)	// RMB1 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xFD;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op27(V65C02REGS * regs, uint16_t operand)	// RMB2 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xFB;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op37(V65C02REGS * regs, uint16_t operand)	// RMB3 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xF7;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op47(V65C02REGS * regs, uint16_t operand)	// RMB4 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xEF;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op57(V65C02REGS * regs, uint16_t operand)	// RMB5 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xDF;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op67(V65C02REGS * regs, uint16_t operand)	// RMB6 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0xBF;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op77(V65C02REGS * regs, uint16_t operand)	// RMB7 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m &= 0x7F;
+	WRITE_BACK(m);
+}
+
+/*
+ROL	Accumulator	ROL A		2A	1	2
+Zero Page		ROL Zpg		26	2	5
+Zero Page,X		ROL Zpg,X	36	2	6
+Absolute		ROL Abs		2E	3	6
+Absolute,X		ROL Abs,X	3E	3	7
+*/
+
+// ROL opcodes
+
+#define OP_ROL_HANDLER(m) \
+	uint8_t tmp = regs->cc & 0x01; \
+	SET_C((m) >> 7); \
+	(m) = ((m) << 1) | tmp; \
+	SET_ZN((m))
+
+template <class Bus> static void Op2A(V65C02REGS * regs, uint16_t operand)	// ROL A
+{
+	OP_ROL_HANDLER(regs->a);
+}
+
+template <class Bus> static void Op26(V65C02REGS * regs, uint16_t operand)	// ROL ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_ROL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op36(V65C02REGS * regs, uint16_t operand)	// ROL ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_ROL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op2E(V65C02REGS * regs, uint16_t operand)	// ROL ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_ROL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op3E(V65C02REGS * regs, uint16_t operand)	// ROL ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_ROL_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+ROR	Accumulator	ROR A		6A	1	2
+Zero Page		ROR Zpg		66	2	5
+Zero Page,X		ROR Zpg,X	76	2	6
+Absolute		ROR Abs		6E	3	6
+Absolute,X		ROR Abs,X	7E	3	7
+*/
+
+// ROR opcodes
+
+#define OP_ROR_HANDLER(m) \
+	uint8_t tmp = (regs->cc & 0x01) << 7; \
+	SET_C((m) & 0x01); \
+	(m) = ((m) >> 1) | tmp; \
+	SET_ZN((m))
+
+template <class Bus> static void Op6A(V65C02REGS * regs, uint16_t operand)	// ROR A
+{
+	OP_ROR_HANDLER(regs->a);
+}
+
+template <class Bus> static void Op66(V65C02REGS * regs, uint16_t operand)	// ROR ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_ROR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op76(V65C02REGS * regs, uint16_t operand)	// ROR ZP, X
+{
+	uint8_t m;
+	READ_ZP_X_WB(m);
+	OP_ROR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op6E(V65C02REGS * regs, uint16_t operand)	// ROR ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_ROR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op7E(V65C02REGS * regs, uint16_t operand)	// ROR ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint8_t m;
+	READ_ABS_X_WB(m);
+	OP_ROR_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+RTI	Implied		RTI			40	1	6
+*/
+
+template <class Bus> static void Op40(V65C02REGS * regs, uint16_t operand)	// RTI
+{
+	SetCC(regs, Bus::Read(regs, 0x0100 + ++regs->sp));
+	regs->pc = Bus::Read(regs, 0x0100 + ++regs->sp);
+	regs->pc |= (uint16_t)(Bus::Read(regs, 0x0100 + ++regs->sp)) << 8;
+}
+
+/*
+RTS	Implied		RTS			60	1	6
+*/
+
+template <class Bus> static void Op60(V65C02REGS * regs, uint16_t operand)	// RTS
+{
+	regs->pc = Bus::Read(regs, 0x0100 + ++regs->sp);
+	regs->pc |= (uint16_t)(Bus::Read(regs, 0x0100 + ++regs->sp)) << 8;
+	regs->pc++;									// Since it pushes return address - 1...
+}
+
+/*
+SBC	Immediate	SBC #Oper	E9	2	2
+Zero Page		SBC Zpg		E5	2	3
+Zero Page,X		SBC Zpg,X	F5	2	4
+Absolute		SBC Abs		ED	3	4
+Absolute,X		SBC Abs,X	FD	3	4
+Absolute,Y		SBC Abs,Y	F9	3	4
+(Zero Page,X)	SBC (Zpg,X)	E1	2	6
+(Zero Page),Y	SBC (Zpg),Y	F1	2	5
+(Zero Page)		SBC (Zpg)	F2	2	5
+*/
+
+// SBC opcodes
+
+// Decimal mode comes out of a table (see SBCDecimal() in v65c02.cpp for how
+// it's worked out), and incurs a one cycle penalty (for the decimal
+// correction).
+#define OP_SBC_HANDLER(m) \
+	if (regs->cc & FLAG_D) \
+	{ \
+		if (!bcdReady) \
+			InitBCDTables(); \
+\
+		uint16_t result = bcdSBC[BCD_INDEX(regs->cc & FLAG_C, regs->a, m)]; \
+		regs->cc = (regs->cc & ~(FLAG_C | FLAG_V)) | (result >> 8); \
+		regs->a = result & 0xFF; \
+		regs->clock++; \
+	} \
+	else \
+	{ \
+		uint16_t sum = (uint16_t)regs->a - (m) - (uint16_t)((regs->cc & FLAG_C) ^ 0x01); \
+		regs->cc = (regs->cc & ~(FLAG_C | FLAG_V)) | (((sum >> 8) ^ 0x01) & FLAG_C) \
+			| (((regs->a ^ (m)) & (regs->a ^ sum) & 0x80) >> 1); \
+		regs->a = sum & 0xFF; \
+	} \
+\
+	SET_ZN(regs->a)
+
+template <class Bus> static void OpE9(V65C02REGS * regs, uint16_t operand)	// SBC #
+{
+	uint16_t m = READ_IMM;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpE5(V65C02REGS * regs, uint16_t operand)	// SBC ZP
+{
+	uint16_t m = READ_ZP;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpF5(V65C02REGS * regs, uint16_t operand)	// SBC ZP, X
+{
+	uint16_t m = READ_ZP_X;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpED(V65C02REGS * regs, uint16_t operand)	// SBC ABS
+{
+	uint16_t m = READ_ABS;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpFD(V65C02REGS * regs, uint16_t operand)	// SBC ABS, X
+{
+	HANDLE_PAGE_CROSSING_ABS_X;
+	uint16_t m = READ_ABS_X;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpF9(V65C02REGS * regs, uint16_t operand)	// SBC ABS, Y
+{
+	HANDLE_PAGE_CROSSING_ABS_Y;
+	uint16_t m = READ_ABS_Y;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpE1(V65C02REGS * regs, uint16_t operand)	// SBC (ZP, X)
+{
+	uint16_t m = READ_IND_ZP_X;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpF1(V65C02REGS * regs, uint16_t operand)	// SBC (ZP), Y
+{
+	HANDLE_PAGE_CROSSING_IND_Y;
+	uint16_t m = READ_IND_ZP_Y;
+	OP_SBC_HANDLER(m);
+}
+
+template <class Bus> static void OpF2(V65C02REGS * regs, uint16_t operand)	// SBC (ZP)
+{
+	uint16_t m = READ_IND_ZP;
+	OP_SBC_HANDLER(m);
+}
+
+/*
+SEC	Implied		SEC			38	1	2
+*/
+
+template <class Bus> static void Op38(V65C02REGS * regs, uint16_t operand)	// SEC
+{
+	regs->cc |= FLAG_C;
+}
+
+/*
+SED	Implied		SED			F8	1	2
+*/
+
+template <class Bus> static void OpF8(V65C02REGS * regs, uint16_t operand)	// SED
+{
+	regs->cc |= FLAG_D;
+}
+
+/*
+SEI	Implied		SEI			78	1	2
+*/
+
+template <class Bus> static void Op78(V65C02REGS * regs, uint16_t operand)	// SEI
+{
+	SET_I;
+}
+
+/*
+The bit set and clear instructions have the form xyyy0111, where x is 0 to clear a bit or 1 to set it, and yyy is which bit at the memory location to set or clear.
+   RMB0  RMB1  RMB2  RMB3  RMB4  RMB5  RMB6  RMB7
+  zp  07  17  27  37  47  57  67  77
+     SMB0  SMB1  SMB2  SMB3  SMB4  SMB5  SMB6  SMB7
+  zp  87  97  A7  B7  C7  D7  E7  F7
+*/
+
+// SMB opcodes
+
+template <class Bus> static void Op87(V65C02REGS * regs, uint16_t operand)	// SMB0 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x01;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op97(V65C02REGS * regs, uint16_t operand)	// SMB1 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x02;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpA7(V65C02REGS * regs, uint16_t operand)	// SMB2 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x04;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpB7(V65C02REGS * regs, uint16_t operand)	// SMB3 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x08;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpC7(V65C02REGS * regs, uint16_t operand)	// SMB4 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x10;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpD7(V65C02REGS * regs, uint16_t operand)	// SMB5 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x20;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpE7(V65C02REGS * regs, uint16_t operand)	// SMB6 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x40;
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void OpF7(V65C02REGS * regs, uint16_t operand)	// SMB7 ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	m |= 0x80;
+	WRITE_BACK(m);
+}
+
+/*
+STA	Zero Page	STA Zpg		85	2	3
+Zero Page,X		STA Zpg,X	95	2	4
+Absolute		STA Abs		8D	3	4
+Absolute,X		STA Abs,X	9D	3	5
+Absolute,Y		STA Abs,Y	99	3	5
+(Zero Page,X)	STA (Zpg,X)	81	2	6
+(Zero Page),Y	STA (Zpg),Y	91	2	6
+(Zero Page)		STA (Zpg)	92	2	5
+*/
+
+// STA opcodes
+
+template <class Bus> static void Op85(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP, regs->a);
+}
+
+template <class Bus> static void Op95(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP_X, regs->a);
+}
+
+template <class Bus> static void Op8D(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS, regs->a);
+}
+
+template <class Bus> static void Op9D(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS_X, regs->a);
+}
+
+template <class Bus> static void Op99(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS_Y, regs->a);
+}
+
+template <class Bus> static void Op81(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_IND_ZP_X, regs->a);
+}
+
+template <class Bus> static void Op91(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_IND_ZP_Y, regs->a);
+}
+
+template <class Bus> static void Op92(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_IND_ZP, regs->a);
+}
+
+/*
+STX	Zero Page	STX Zpg		86	2	3
+Zero Page,Y		STX Zpg,Y	96	2	4
+Absolute		STX Abs		8E	3	4
+*/
+
+// STX opcodes
+
+template <class Bus> static void Op86(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP, regs->x);
+}
+
+template <class Bus> static void Op96(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP_Y, regs->x);
+}
+
+template <class Bus> static void Op8E(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS, regs->x);
+}
+
+/*
+STY	Zero Page	STY Zpg		84	2	3
+Zero Page,X		STY Zpg,X	94	2	4
+Absolute		STY Abs		8C	3	4
+*/
+
+// STY opcodes
+
+template <class Bus> static void Op84(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP, regs->y);
+}
+
+template <class Bus> static void Op94(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP_X, regs->y);
+}
+
+template <class Bus> static void Op8C(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS, regs->y);
+}
+
+/*
+STZ	Zero Page	STZ Zpg		64	2	3
+Zero Page,X		STZ Zpg,X	74	2	4
+Absolute		STZ Abs		9C	3	4
+Absolute,X		STZ Abs,X	9E	3	5
+*/
+
+// STZ opcodes
+
+template <class Bus> static void Op64(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP, 0x00);
+}
+
+template <class Bus> static void Op74(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ZP_X, 0x00);
+}
+
+template <class Bus> static void Op9C(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS, 0x00);
+}
+
+template <class Bus> static void Op9E(V65C02REGS * regs, uint16_t operand)
+{
+	Bus::Write(regs, EA_ABS_X, 0x00);
+}
+
+/*
+TAX	Implied		TAX			AA	1	2
+*/
+
+template <class Bus> static void OpAA(V65C02REGS * regs, uint16_t operand)	// TAX
+{
+	regs->x = regs->a;
+	SET_ZN(regs->x);
+}
+
+/*
+TAY	Implied		TAY			A8	1	2
+*/
+
+template <class Bus> static void OpA8(V65C02REGS * regs, uint16_t operand)	// TAY
+{
+	regs->y = regs->a;
+	SET_ZN(regs->y);
+}
+
+/*
+TRB	Zero Page	TRB Zpg		14	2	5
+Absolute		TRB Abs		1C	3	6
+*/
+
+// TRB opcodes
+
+#define OP_TRB_HANDLER(m) \
+	SET_Z(m & regs->a); \
+	m &= ~regs->a
+
+template <class Bus> static void Op14(V65C02REGS * regs, uint16_t operand)	// TRB ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_TRB_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op1C(V65C02REGS * regs, uint16_t operand)	// TRB ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_TRB_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+TSB	Zero Page	TSB Zpg		04	2	5
+Absolute		TSB Abs		0C	3	6
+*/
+
+// TSB opcodes
+
+#define OP_TSB_HANDLER(m) \
+	SET_Z(m & regs->a); \
+	m |= regs->a
+
+template <class Bus> static void Op04(V65C02REGS * regs, uint16_t operand)	// TSB ZP
+{
+	uint8_t m;
+	READ_ZP_WB(m);
+	OP_TSB_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+template <class Bus> static void Op0C(V65C02REGS * regs, uint16_t operand)	// TSB ABS
+{
+	uint8_t m;
+	READ_ABS_WB(m);
+	OP_TSB_HANDLER(m);
+	WRITE_BACK(m);
+}
+
+/*
+TSX	Implied		TSX			BA	1	2
+*/
+
+template <class Bus> static void OpBA(V65C02REGS * regs, uint16_t operand)	// TSX
+{
+	regs->x = regs->sp;
+	SET_ZN(regs->x);
+}
+
+/*
+TXA	Implied		TXA			8A	1	2
+*/
+
+template <class Bus> static void Op8A(V65C02REGS * regs, uint16_t operand)	// TXA
+{
+	regs->a = regs->x;
+	SET_ZN(regs->a);
+}
+
+/*
+TXS	Implied		TXS			9A	1	2
+*/
+
+template <class Bus> static void Op9A(V65C02REGS * regs, uint16_t operand)	// TXS
+{
+	regs->sp = regs->x;
+}
+
+/*
+TYA	Implied		TYA			98	1	2
+*/
+template <class Bus> static void Op98(V65C02REGS * regs, uint16_t operand)	// TYA
+{
+	regs->a = regs->y;
+	SET_ZN(regs->a);
+}
+
+template <class Bus> static void Op__(V65C02REGS * regs, uint16_t operand)
+{
+	regs->cpuFlags |= V65C02_STATE_ILLEGAL_INST;
+}
+
+
+//
+// Every opcode & its handler, for building the dispatch table & the dispatch
+// in Run65C02() from
+//
+#define V65C02_OPCODES(X) \
+	X(00, Op00) X(01, Op01) X(02, Op__) X(03, Op__) X(04, Op04) X(05, Op05) X(06, Op06) X(07, Op07) \
+	X(08, Op08) X(09, Op09) X(0A, Op0A) X(0B, Op__) X(0C, Op0C) X(0D, Op0D) X(0E, Op0E) X(0F, Op0F) \
+	X(10, Op10) X(11, Op11) X(12, Op12) X(13, Op__) X(14, Op14) X(15, Op15) X(16, Op16) X(17, Op17) \
+	X(18, Op18) X(19, Op19) X(1A, Op1A) X(1B, Op__) X(1C, Op1C) X(1D, Op1D) X(1E, Op1E) X(1F, Op1F) \
+	X(20, Op20) X(21, Op21) X(22, Op__) X(23, Op__) X(24, Op24) X(25, Op25) X(26, Op26) X(27, Op27) \
+	X(28, Op28) X(29, Op29) X(2A, Op2A) X(2B, Op__) X(2C, Op2C) X(2D, Op2D) X(2E, Op2E) X(2F, Op2F) \
+	X(30, Op30) X(31, Op31) X(32, Op32) X(33, Op__) X(34, Op34) X(35, Op35) X(36, Op36) X(37, Op37) \
+	X(38, Op38) X(39, Op39) X(3A, Op3A) X(3B, Op__) X(3C, Op3C) X(3D, Op3D) X(3E, Op3E) X(3F, Op3F) \
+	X(40, Op40) X(41, Op41) X(42, Op__) X(43, Op__) X(44, Op__) X(45, Op45) X(46, Op46) X(47, Op47) \
+	X(48, Op48) X(49, Op49) X(4A, Op4A) X(4B, Op__) X(4C, Op4C) X(4D, Op4D) X(4E, Op4E) X(4F, Op4F) \
+	X(50, Op50) X(51, Op51) X(52, Op52) X(53, Op__) X(54, Op__) X(55, Op55) X(56, Op56) X(57, Op57) \
+	X(58, Op58) X(59, Op59) X(5A, Op5A) X(5B, Op__) X(5C, Op__) X(5D, Op5D) X(5E, Op5E) X(5F, Op5F) \
+	X(60, Op60) X(61, Op61) X(62, Op__) X(63, Op__) X(64, Op64) X(65, Op65) X(66, Op66) X(67, Op67) \
+	X(68, Op68) X(69, Op69) X(6A, Op6A) X(6B, Op__) X(6C, Op6C) X(6D, Op6D) X(6E, Op6E) X(6F, Op6F) \
+	X(70, Op70) X(71, Op71) X(72, Op72) X(73, Op__) X(74, Op74) X(75, Op75) X(76, Op76) X(77, Op77) \
+	X(78, Op78) X(79, Op79) X(7A, Op7A) X(7B, Op__) X(7C, Op7C) X(7D, Op7D) X(7E, Op7E) X(7F, Op7F) \
+	X(80, Op80) X(81, Op81) X(82, Op__) X(83, Op__) X(84, Op84) X(85, Op85) X(86, Op86) X(87, Op87) \
+	X(88, Op88) X(89, Op89) X(8A, Op8A) X(8B, Op__) X(8C, Op8C) X(8D, Op8D) X(8E, Op8E) X(8F, Op8F) \
+	X(90, Op90) X(91, Op91) X(92, Op92) X(93, Op__) X(94, Op94) X(95, Op95) X(96, Op96) X(97, Op97) \
+	X(98, Op98) X(99, Op99) X(9A, Op9A) X(9B, Op__) X(9C, Op9C) X(9D, Op9D) X(9E, Op9E) X(9F, Op9F) \
+	X(A0, OpA0) X(A1, OpA1) X(A2, OpA2) X(A3, Op__) X(A4, OpA4) X(A5, OpA5) X(A6, OpA6) X(A7, OpA7) \
+	X(A8, OpA8) X(A9, OpA9) X(AA, OpAA) X(AB, Op__) X(AC, OpAC) X(AD, OpAD) X(AE, OpAE) X(AF, OpAF) \
+	X(B0, OpB0) X(B1, OpB1) X(B2, OpB2) X(B3, Op__) X(B4, OpB4) X(B5, OpB5) X(B6, OpB6) X(B7, OpB7) \
+	X(B8, OpB8) X(B9, OpB9) X(BA, OpBA) X(BB, Op__) X(BC, OpBC) X(BD, OpBD) X(BE, OpBE) X(BF, OpBF) \
+	X(C0, OpC0) X(C1, OpC1) X(C2, Op__) X(C3, Op__) X(C4, OpC4) X(C5, OpC5) X(C6, OpC6) X(C7, OpC7) \
+	X(C8, OpC8) X(C9, OpC9) X(CA, OpCA) X(CB, Op__) X(CC, OpCC) X(CD, OpCD) X(CE, OpCE) X(CF, OpCF) \
+	X(D0, OpD0) X(D1, OpD1) X(D2, OpD2) X(D3, Op__) X(D4, Op__) X(D5, OpD5) X(D6, OpD6) X(D7, OpD7) \
+	X(D8, OpD8) X(D9, OpD9) X(DA, OpDA) X(DB, Op__) X(DC, Op__) X(DD, OpDD) X(DE, OpDE) X(DF, OpDF) \
+	X(E0, OpE0) X(E1, OpE1) X(E2, Op__) X(E3, Op__) X(E4, OpE4) X(E5, OpE5) X(E6, OpE6) X(E7, OpE7) \
+	X(E8, OpE8) X(E9, OpE9) X(EA, OpEA) X(EB, Op__) X(EC, OpEC) X(ED, OpED) X(EE, OpEE) X(EF, OpEF) \
+	X(F0, OpF0) X(F1, OpF1) X(F2, OpF2) X(F3, Op__) X(F4, Op__) X(F5, OpF5) X(F6, OpF6) X(F7, OpF7) \
+	X(F8, OpF8) X(F9, OpF9) X(FA, OpFA) X(FB, Op__) X(FC, Op__) X(FD, OpFD) X(FE, OpFE) X(FF, OpFF)
+
+
+//
+// Ok, the exec_op[] array is globally defined here basically to save
+// a LOT of unnecessary typing.  Sure it's ugly, but hey, it works!
+//
+template <class Bus> struct V65C02Ops
+{
+	static void (* const exec_op[256])(V65C02REGS *, uint16_t);
+};
+
+#define EXEC_OP(n, f)		f<Bus>,
+#define SWITCH_CASE(n, f)	case 0x##n: f<Bus>(regs, inst->operand); break;
+
+template <class Bus> void (* const V65C02Ops<Bus>::exec_op[256])(V65C02REGS *, uint16_t) = {
+	V65C02_OPCODES(EXEC_OP)
+};
+
+
+//
+// Fetch & decode the instruction at PC through the bus. This is what's used
+// for code that can't be cached (I/O & slot ROM space, or buses that don't
+// have a cache at all).
+//
+template <class Bus> static inline void FetchInst(V65C02REGS * regs, uint16_t pc, V65C02Inst * inst)
+{
+	uint8_t opcode = Bus::Read(regs, pc);
+	inst->handler = V65C02Ops<Bus>::exec_op[opcode];
+	inst->opcode = opcode;
+	inst->length = CPUBytes[opcode];
+	inst->cycles = CPUCycles[opcode];
+
+	if (inst->length == 3)
+		inst->operand = RdMemW<Bus>(regs, pc + 1);
+	else if (inst->length == 2)
+		inst->operand = Bus::Read(regs, pc + 1);
+	else
+		inst->operand = 0;
+}
+
+
+//
+// Anything that can change the flow of control ends a block: branches,
+// BBR/BBS, JMP, JSR, RTS, RTI & BRK
+//
+static inline bool EndsBlock(uint8_t opcode)
+{
+	return ((opcode & 0x1F) == 0x10) || ((opcode & 0x0F) == 0x0F)
+		|| (opcode == 0x00) || (opcode == 0x20) || (opcode == 0x40)
+		|| (opcode == 0x60) || (opcode == 0x4C) || (opcode == 0x6C)
+		|| (opcode == 0x7C) || (opcode == 0x80);
+}
+
+
+//
+// Find (or decode) the block starting at PC. The key is PC plus the host
+// memory that PC is mapped to, so flipping a bank switch naturally picks a
+// different block. Returns NULL if the code at PC can't be cached.
+//
+template <class Bus> static V65C02Block * FetchBlock(V65C02REGS * regs, V65C02BlockCache * cache)
+{
+	uint16_t pc = regs->pc;
+	const uint8_t * code = Bus::Code(regs, pc);
+
+	if (!code)
+		return 0;
+
+	V65C02Block * block = &cache->block[V65C02_BLOCK_INDEX(pc)];
+
+	if ((block->code == code) && (block->pc == pc)
+		&& (cache->lineGen[block->line[0]] == block->gen[0])
+		&& (cache->lineGen[block->line[1]] == block->gen[1]))
+		return block;
+
+	// Not there (or stale), so decode it. A block can't run off the end of
+	// its page (the next one could be mapped anywhere), and can't cover more
+	// than two write tracking lines.
+	uintptr_t firstLine = (uintptr_t)code >> V65C02_LINE_SHIFT;
+	uint16_t offset = pc & 0xFF;
+	const uint8_t * p = code;
+	uint8_t count = 0, maxCycles = 0;
+
+	while (count < V65C02_BLOCK_MAX)
+	{
+		uint8_t opcode = p[0];
+		uint8_t length = CPUBytes[opcode];
+
+		if (((offset + length) > 0x100)
+			|| ((((uintptr_t)(p + length - 1) >> V65C02_LINE_SHIFT) - firstLine) > 1))
+			break;
+
+		V65C02Inst * inst = &block->inst[count++];
+		inst->handler = V65C02Ops<Bus>::exec_op[opcode];
+		inst->opcode = opcode;
+		inst->length = length;
+		inst->cycles = CPUCycles[opcode];
+		inst->operand = (length == 3 ? p[1] | (p[2] << 8) : (length == 2 ? p[1] : 0));
+		p += length;
+		offset += length;
+
+		// No instruction takes more than two cycles over its count
+		maxCycles += inst->cycles + 2;
+
+		if (EndsBlock(opcode))
+			break;
+	}
+
+	if (count == 0)
+		return 0;
+
+	block->code = code;
+	block->pc = pc;
+	block->count = count;
+	block->maxCycles = maxCycles;
+	block->runs = 0;
+	block->host = 0;
+	block->line[0] = V65C02_CODE_LINE(code);
+	block->line[1] = V65C02_CODE_LINE(p - 1);
+
+	for(int i=0; i<2; i++)
+	{
+		// An odd generation marks a line as having code cached from it
+		if (!(cache->lineGen[block->line[i]] & 1))
+			cache->lineGen[block->line[i]]++;
+
+		block->gen[i] = cache->lineGen[block->line[i]];
+	}
+
+	return block;
+}
+
+
+//
+// Bus accesses out of translated code. Both sides of differential mode go
+// through the journal: the translated block's accesses get recorded as they
+// happen, and when the handlers run the block again they get played back
+// instead of going to the bus a second time (so a read of I/O doesn't get
+// done twice, and neither does a write).
+//
+template <class Bus> static uint8_t JitRead(V65C02REGS * regs, uint16_t address)
+{
+	return Bus::Read(regs, address);
+}
+
+
+template <class Bus> static void JitWrite(V65C02REGS * regs, uint16_t address, uint8_t byte)
+{
+	Bus::Write(regs, address, byte);
+}
+
+
+template <class Bus> static uint8_t JitNote(V65C02REGS * regs, uint16_t address, uint8_t byte)
+{
+	Bus::Cache(regs)->journal.Add(address, byte, false);
+	return byte;
+}
+
+
+template <class Bus> struct V65C02RecordBus
+{
+	static inline uint8_t Read(V65C02REGS * regs, uint16_t address)
+	{
+		uint8_t byte = Bus::Read(regs, address);
+		Bus::Cache(regs)->journal.Add(address, byte, false);
+		return byte;
+	}
+
+	static inline void Write(V65C02REGS * regs, uint16_t address, uint8_t byte)
+	{
+		Bus::Cache(regs)->journal.Add(address, byte, true);
+		Bus::Write(regs, address, byte);
+	}
+};
+
+
+template <class Bus> struct V65C02ReplayBus
+{
+	static inline uint8_t Read(V65C02REGS * regs, uint16_t address)
+	{
+		V65C02Journal * journal = &Bus::Cache(regs)->journal;
+
+		if ((journal->next == journal->count)
+			|| journal->access[journal->next].write
+			|| (journal->access[journal->next].address != address))
+		{
+			journal->bad = true;
+			return 0;
+		}
+
+		return journal->access[journal->next++].byte;
+	}
+
+	static inline void Write(V65C02REGS * regs, uint16_t address, uint8_t byte)
+	{
+		V65C02Journal * journal = &Bus::Cache(regs)->journal;
+
+		if ((journal->next == journal->count)
+			|| !journal->access[journal->next].write
+			|| (journal->access[journal->next].address != address)
+			|| (journal->access[journal->next].byte != byte))
+		{
+			journal->bad = true;
+			return;
+		}
+
+		journal->next++;
+	}
+};
+
+
+//
+// Translate a block (in differential mode, with everything it does going
+// into the journal)
+//
+template <class Bus> static void * TranslateBlock(V65C02REGS * regs, V65C02BlockCache * cache, V65C02Block * block)
+{
+	static const V65C02JitHelpers direct = {
+		JitRead<Bus>, JitWrite<Bus>, 0, V65C02Ops<Bus>::exec_op };
+	static const V65C02JitHelpers recorded = {
+		JitRead<V65C02RecordBus<Bus> >, JitWrite<V65C02RecordBus<Bus> >,
+		JitNote<Bus>, V65C02Ops<V65C02RecordBus<Bus> >::exec_op };
+
+	return V65C02JitTranslate(cache, block, Bus::PageMap(regs),
+		(cache->mode == V65C02_MODE_DIFF ? &recorded : &direct));
+}
+
+
+//
+// Run the block's translated code, if it has (or has earned) some & it can't
+// run past endCycles or the bus' deadline; the bus only gets looked at
+// between blocks. Nothing gets translated while tracing, or while an idle
+// loop is being recorded (that wants to see every instruction). Returns the
+// # of instructions run, or 0 if the block has to be run by the handlers.
+//
+// In differential mode, the block then gets run again by the handlers, from
+// the registers it started with & against the journal of what the translated
+// code read & wrote, and the two have to come out the same. A block that
+// doesn't never gets translated again.
+//
+template <class Bus> static uint32_t RunTranslated(V65C02REGS * regs, V65C02BlockCache * cache, V65C02Block * block, uint64_t endCycles)
+{
+	if ((cache->mode < V65C02_MODE_JIT) || (block->runs == V65C02_JIT_NEVER)
+#ifdef __DEBUG__
+		|| dumpDis
+#endif
+		|| (cache->idle.count < V65C02_IDLE_MAX))
+		return 0;
+
+	uint64_t deadline = Bus::Deadline(regs);
+
+	if ((regs->clock + block->maxCycles > endCycles)
+		|| (regs->clock + block->maxCycles > deadline))
+		return 0;
+
+	if (!block->host)
+	{
+		if (++block->runs < V65C02_JIT_HOT)
+			return 0;
+
+		block->host = TranslateBlock<Bus>(regs, cache, block);
+
+		if (!block->host)
+		{
+			block->runs = V65C02_JIT_NEVER;
+			return 0;
+		}
+	}
+
+	V65C02REGS before = *regs;
+	cache->stop = false;
+	cache->journal.count = cache->journal.next = 0;
+	cache->journal.bad = false;
+	uint32_t ran = ((V65C02JitCode)block->host)(regs, cache);
+
+	if (cache->mode != V65C02_MODE_DIFF)
+		return ran;
+
+	V65C02REGS after = before;
+
+	for(uint32_t i=0; i<ran; i++)
+	{
+		V65C02Inst * inst = &block->inst[i];
+		after.pc += inst->length;
+		V65C02Ops<V65C02ReplayBus<Bus> >::exec_op[inst->opcode](&after, inst->operand);
+		after.clock += inst->cycles;
+	}
+
+	cache->checked++;
+
+	// (Only the bus can assert lines or ask for a stop, and the replay never
+	// gets to it)
+
+	if ((after.pc != regs->pc) || (after.a != regs->a) || (after.x != regs->x)
+		|| (after.y != regs->y) || (after.sp != regs->sp)
+		|| (GetCC(&after) != GetCC(regs)) || (after.clock != regs->clock)
+		|| ((after.cpuFlags ^ regs->cpuFlags) & V65C02_STATE_ILLEGAL_INST)
+		|| (cache->journal.next != cache->journal.count) || cache->journal.bad)
+	{
+		WriteLog("V65C02: Translated block at $%04X differs after %u instructions (PC $%04X/$%04X A $%02X/$%02X X $%02X/$%02X Y $%02X/$%02X SP $%02X/$%02X CC $%02X/$%02X clock +%u/+%u, %u/%u accesses%s)\n",
+			block->pc, ran, regs->pc, after.pc, regs->a, after.a, regs->x,
+			after.x, regs->y, after.y, regs->sp, after.sp, GetCC(regs),
+			GetCC(&after), (uint32_t)(regs->clock - before.clock),
+			(uint32_t)(after.clock - before.clock), cache->journal.count,
+			cache->journal.next, (cache->journal.bad ? ", out of step" : ""));
+		cache->mismatches++;
+		block->host = 0;
+		block->runs = V65C02_JIT_NEVER;
+	}
+
+	return ran;
+}
+
+
+//
+// What an instruction does to memory, as far as idle loop detection cares.
+// Anything that writes (other than INC/DEC, which can be a loop counter),
+// touches the stack or uses a computed address is IA_NO.
+//
+enum { IA_NONE, IA_ZP, IA_ABS, IA_RMW_ZP, IA_RMW_ABS, IA_NO };
+
+static int IdleAccess(uint8_t opcode)
+{
+	switch (opcode)
+	{
+	// Implied, accumulator & immediate
+	case 0x09: case 0x0A: case 0x18: case 0x1A: case 0x29: case 0x2A:
+	case 0x38: case 0x3A: case 0x49: case 0x4A: case 0x58: case 0x69:
+	case 0x6A: case 0x78: case 0x88: case 0x89: case 0x8A: case 0x98:
+	case 0xA0: case 0xA2: case 0xA8: case 0xA9: case 0xAA: case 0xB8:
+	case 0xC0: case 0xC8: case 0xC9: case 0xCA: case 0xD8: case 0xE0:
+	case 0xE8: case 0xE9: case 0xEA: case 0xF8:
+	// Branches & JMP
+	case 0x10: case 0x30: case 0x50: case 0x70: case 0x80: case 0x90:
+	case 0xB0: case 0xD0: case 0xF0: case 0x4C:
+		return IA_NONE;
+	case 0x05: case 0x24: case 0x25: case 0x45: case 0x65: case 0xA4:
+	case 0xA5: case 0xA6: case 0xC4: case 0xC5: case 0xE4: case 0xE5:
+		return IA_ZP;
+	case 0x0D: case 0x2C: case 0x2D: case 0x4D: case 0x6D: case 0xAC:
+	case 0xAD: case 0xAE: case 0xCC: case 0xCD: case 0xEC: case 0xED:
+		return IA_ABS;
+	case 0xC6: case 0xE6:
+		return IA_RMW_ZP;
+	case 0xCE: case 0xEE:
+		return IA_RMW_ABS;
+	}
+
+	return IA_NO;
+}
+
+
+//
+// Can the bus give us the byte at address without anything happening?
+//
+template <class Bus> static inline bool IdleReadable(V65C02REGS * regs, uint16_t address)
+{
+	return (Bus::Code(regs, address) != 0) || Bus::Polled(regs, address);
+}
+
+
+//
+// A pass through a loop (from the target of a short backward branch or JMP
+// back around to it again) has just finished with the registers the same as
+// they went in; see if it can be repeated without running it. That's the
+// case if everything it read came from plain memory or side effect free I/O,
+// and the only thing it wrote to was a counter that nothing else in the loop
+// looks at. Since nothing but the loop itself (and the loop doesn't write
+// anything it reads) runs until the core returns or an interrupt comes in,
+// every pass after this one has to go exactly the same way.
+//
+template <class Bus> static bool IdleCheck(V65C02REGS * regs, V65C02BlockCache * cache)
+{
+	V65C02IdleLoop * loop = &cache->idle;
+	uint16_t read[V65C02_IDLE_MAX], written[V65C02_IDLE_MAX];
+	uint16_t code[V65C02_IDLE_MAX][2];
+	int numRead = 0, numWritten = 0;
+	uint16_t pc = loop->head;
+
+	for(int i=0; i<loop->count; i++)
+	{
+		V65C02IdleStep * step = &loop->step[i];
+		uint16_t last = pc + CPUBytes[step->opcode] - 1;
+
+		if (!IdleReadable<Bus>(regs, pc) || !IdleReadable<Bus>(regs, last))
+			return false;
+
+		code[i][0] = pc;
+		code[i][1] = last;
+
+		switch (IdleAccess(step->opcode))
+		{
+		case IA_NONE:
+			break;
+		case IA_ZP:
+		case IA_ABS:
+			read[numRead] = (IdleAccess(step->opcode) == IA_ZP ? step->operand & 0xFF : step->operand);
+
+			if (!IdleReadable<Bus>(regs, read[numRead]))
+				return false;
+
+			numRead++;
+			break;
+		case IA_RMW_ZP:
+		case IA_RMW_ABS:
+			written[numWritten] = (IdleAccess(step->opcode) == IA_RMW_ZP ? step->operand & 0xFF : step->operand);
+
+			// Counters have to be in RAM--INC $C030 is not idle!
+			if (Bus::Code(regs, written[numWritten]) == 0)
+				return false;
+
+			numWritten++;
+			break;
+		default:
+			return false;
+		}
+
+		pc = step->pc;
+	}
+
+	// Nothing can look at a counter, or the passes won't be the same
+	for(int i=0; i<numWritten; i++)
+	{
+		for(int j=0; j<numRead; j++)
+			if (read[j] == written[i])
+				return false;
+
+		for(int j=0; j<loop->count; j++)
+			if ((written[i] >= code[j][0]) && (written[i] <= code[j][1]))
+				return false;
+	}
+
+	return true;
+}
+
+
+//
+// Watch for idle loops; this is called after every instruction. Nothing gets
+// recorded until control comes back around to the target of a short backward
+// branch with the registers the same as the last time it got there; the pass
+// after that is the one that gets recorded & checked. Returns true if a pass
+// through an idle loop just finished and the rest of it can be skipped.
+//
+template <class Bus> static bool IdleLoop(V65C02REGS * regs, V65C02BlockCache * cache, V65C02Inst * inst, uint16_t pc, uint8_t cycles)
+{
+	V65C02IdleLoop * loop = &cache->idle;
+
+	if (loop->count < V65C02_IDLE_MAX)
+	{
+		V65C02IdleStep * step = &loop->step[loop->count++];
+		step->opcode = inst->opcode;
+		step->operand = inst->operand;
+		step->cycles = cycles;
+		step->pc = regs->pc;
+		step->cc = GetCC(regs);
+		step->a = regs->a;
+		step->x = regs->x;
+		step->y = regs->y;
+		step->sp = regs->sp;
+	}
+	else if (loop->count == V65C02_IDLE_MAX)
+		loop->count = V65C02_IDLE_OFF;
+
+	// Only a short branch (or JMP) backwards can close a loop
+	if ((regs->pc > pc) || ((pc - regs->pc) > 0x7F)
+		|| (((inst->opcode & 0x1F) != 0x10) && (inst->opcode != 0x80)
+		&& (inst->opcode != 0x4C)))
+		return false;
+
+	bool same = ((loop->count != V65C02_IDLE_OFF) && (regs->pc == loop->head)
+		&& (regs->a == loop->a) && (regs->x == loop->x) && (regs->y == loop->y)
+		&& (regs->sp == loop->sp) && (GetCC(regs) == loop->cc));
+
+	if (same && (loop->count == V65C02_IDLE_WATCH))
+	{
+		loop->count = 0;
+		return false;
+	}
+
+	if (same && IdleCheck<Bus>(regs, cache))
+		return true;
+
+	// Not (yet) an idle loop, so start watching this one
+	loop->head = regs->pc;
+	loop->count = V65C02_IDLE_WATCH;
+	loop->cc = GetCC(regs);
+	loop->a = regs->a;
+	loop->x = regs->x;
+	loop->y = regs->y;
+	loop->sp = regs->sp;
+
+	return false;
+}
+
+
+//
+// Tally one instruction in the profile. Cycles is what it actually took, so
+// anything over CPUCycles[] is a penalty its handler added: one for decimal
+// mode ADC/SBC, one for a taken branch, and one for crossing a page (which
+// can happen on top of either of the others).
+//
+static void ProfileInst(V65C02Profile * profile, uint8_t bank, uint16_t pc, uint8_t opcode, uint16_t operand, uint8_t cc, uint32_t cycles)
+{
+	// Self modifying code (or a bank the bus can't tell apart) can run more
+	// than one thing at the same address
+	if (profile->count[bank][pc] && ((profile->opcode[bank][pc] != opcode)
+		|| (profile->operand[bank][pc] != operand)))
+		profile->changed[bank][pc] = true;
+
+	profile->count[bank][pc]++;
+	profile->cycles[bank][pc] += cycles;
+	profile->opcode[bank][pc] = opcode;
+	profile->operand[bank][pc] = operand;
+	profile->opCount[opcode]++;
+	profile->opCycles[opcode] += cycles;
+
+	uint32_t extra = cycles - CPUCycles[opcode];
+
+	if (extra == 0)
+		return;
+
+	switch (opcode)
+	{
+	case 0x61: case 0x65: case 0x69: case 0x6D:		// ADC
+	case 0x71: case 0x72: case 0x75: case 0x79: case 0x7D:
+	case 0xE1: case 0xE5: case 0xE9: case 0xED:		// SBC
+	case 0xF1: case 0xF2: case 0xF5: case 0xF9: case 0xFD:
+		if (cc & FLAG_D)
+		{
+			profile->bcdCycles++;
+			extra--;
+		}
+
+		break;
+	case 0x10: case 0x30: case 0x50: case 0x70:		// Bxx
+	case 0x80: case 0x90: case 0xB0: case 0xD0: case 0xF0:
+	case 0x0F: case 0x1F: case 0x2F: case 0x3F:		// BBRx/BBSx
+	case 0x4F: case 0x5F: case 0x6F: case 0x7F:
+	case 0x8F: case 0x9F: case 0xAF: case 0xBF:
+	case 0xCF: case 0xDF: case 0xEF: case 0xFF:
+		profile->branchesTaken++;
+		extra--;
+		break;
+	}
+
+	profile->pageCycles += extra;
+}
+
+
+//
+// Run the idle loop IdleCheck() just vetted until we run out of cycles, the
+// bus gets ticked or an interrupt comes in. All that's needed for the reads & branches is to move
+// the clock by the same amounts they took the first time around; counter
+// updates are done by running their opcode handlers. If a counter update
+// sets different flags than it did before (it rolled over, say), we stop
+// right there and let the loop take its other path. A loop with no counters
+// in it can't change anything, so it goes straight to the bus' deadline in
+// whole passes.
+//
+template <class Bus> static void IdleSkip(V65C02REGS * regs, V65C02BlockCache * cache, uint64_t endCycles, uint64_t & tickClock)
+{
+	V65C02IdleLoop * loop = &cache->idle;
+	V65C02IdleStep * last = &loop->step[loop->count - 1];
+	uint64_t clockSave = regs->clock;
+	uint32_t passCycles = 0;
+	int i = 0;
+
+	for(int j=0; j<loop->count; j++)
+	{
+		if (IdleAccess(loop->step[j].opcode) >= IA_RMW_ZP)
+		{
+			passCycles = 0;
+			break;
+		}
+
+		passCycles += loop->step[j].cycles;
+	}
+
+	while (regs->clock < endCycles)
+	{
+		V65C02IdleStep * step = &loop->step[i];
+
+		if (passCycles && (i == 0))
+		{
+			uint64_t deadline = Bus::Deadline(regs);
+			uint64_t target = (deadline < endCycles ? deadline : endCycles);
+
+			if (target > regs->clock)
+				regs->clock += ((target - regs->clock) / passCycles) * passCycles;
+		}
+
+		if (IdleAccess(step->opcode) >= IA_RMW_ZP)
+		{
+			regs->pc = step->pc;
+			SetCC(regs, last->cc);
+			regs->a = last->a;
+			regs->x = last->x;
+			regs->y = last->y;
+			regs->sp = last->sp;
+			V65C02Ops<Bus>::exec_op[step->opcode](regs, step->operand);
+
+			if (GetCC(regs) != step->cc)
+			{
+				regs->clock += step->cycles;
+				loop->skipped += regs->clock - clockSave;
+				loop->count = V65C02_IDLE_OFF;
+				return;
+			}
+		}
+
+		regs->clock += step->cycles;
+
+		last = step;
+		i = (i + 1) % loop->count;
+
+		// Whatever the bus ran could have changed what the loop is polling,
+		// so let it see for itself
+		if (regs->clock >= Bus::Deadline(regs))
+		{
+			Bus::Tick(regs, regs->clock - tickClock);
+			tickClock = regs->clock;
+			break;
+		}
+
+		if ((regs->cpuFlags & (V65C02_ASSERT_LINE_RESET | V65C02_ASSERT_LINE_NMI))
+			|| ((regs->cpuFlags & V65C02_ASSERT_LINE_IRQ) && !(last->cc & FLAG_I)))
+			break;
+	}
+
+	regs->pc = last->pc;
+	SetCC(regs, last->cc);
+	regs->a = last->a;
+	regs->x = last->x;
+	regs->y = last->y;
+	regs->sp = last->sp;
+	loop->skipped += regs->clock - clockSave;
+	loop->count = V65C02_IDLE_OFF;
+}
+
+
+/*
+FCA8: 38        698  WAIT     SEC
+FCA9: 48        699  WAIT2    PHA
+FCAA: E9 01     700  WAIT3    SBC   #$01
+FCAC: D0 FC     701           BNE   WAIT3      ;1.0204 USEC
+FCAE: 68        702           PLA              ;(13+27/2*A+5/2*A*A)
+FCAF: E9 01     703           SBC   #$01
+FCB1: D0 F6     704           BNE   WAIT2
+FCB3: 60        705           RTS
+
+FBD9: C9 87     592  BELL1    CMP   #$87       ;BELL CHAR? (CNTRL-G)
+FBDB: D0 12     593           BNE   RTS2B      ;  NO, RETURN
+FBDD: A9 40     594           LDA   #$40       ;DELAY .01 SECONDS
+FBDF: 20 A8 FC  595           JSR   WAIT
+FBE2: A0 C0     596           LDY   #$C0
+FBE4: A9 0C     597  BELL2    LDA   #$0C       ;TOGGLE SPEAKER AT
+FBE6: 20 A8 FC  598           JSR   WAIT       ;  1 KHZ FOR .1 SEC.
+FBE9: AD 30 C0  599           LDA   SPKR
+FBEC: 88        600           DEY
+FBED: D0 F5     601           BNE   BELL2
+FBEF: 60        602  RTS2B    RTS
+*/
+//int instCount[256];
+
+/*
+On //e, $FCAA is the delay routine. (seems to not have changed from ][+)
+*/
+
+#ifdef __DEBUG__
+//
+// Put the instruction that's about to run (and the state it's going to run
+// in) into the trace ring
+//
+template <class Bus> static void TraceInst(V65C02REGS * regs, V65C02Inst * inst)
+{
+	TraceRecord * record = TraceAlloc(TRACE_CPU, regs->clock, regs->pc);
+	record->cpu.bytes[0] = inst->opcode;
+	record->cpu.bytes[1] = inst->operand & 0xFF;
+	record->cpu.bytes[2] = inst->operand >> 8;
+	record->cpu.a = regs->a;
+	record->cpu.x = regs->x;
+	record->cpu.y = regs->y;
+	record->cpu.sp = regs->sp;
+	record->cpu.cc = GetCC(regs);
+	record->cpu.banks = Bus::Banks(regs);
+
+	if (EffectiveAddress65C02(regs, inst->opcode, inst->operand, &record->cpu.ea))
+		record->flags |= TRACE_EA;
+
+	TraceCommit();
+}
+#endif
+
+
+//
+// Function to execute 65C02 for "cycles" cycles. There's a copy of this for
+// running with a profile & one for without, so the profiling code doesn't
+// cost anything when it's not being used. (The profiling copy doesn't touch
+// the cache; leaving FetchBlock() & friends with just the one caller keeps
+// them inlined into the other.)
+//
+//static bool first = true;
+template <class Bus, bool PROFILE> static inline void Run65C02(V65C02REGS * regs, uint32_t cycles)
+{
+	V65C02BlockCache * cache = (PROFILE ? 0 : Bus::Cache(regs));
+	V65C02Profile * profile = (PROFILE ? Bus::Profile(regs) : 0);
+	V65C02Inst single, * inst = 0;
+	uint32_t instLeft = 0;
+
+	// Calculate number of clock cycles to run for
+	uint64_t endCycles = regs->clock + (uint64_t)cycles - regs->overflow;
+
+	// The bus was caught up to here the last time out
+	uint64_t tickClock = regs->clock;
+
+	// The I/O that idle loops poll can change between runs, so a pass through
+	// one only counts if it happens entirely inside this one
+	if (cache)
+		cache->idle.count = V65C02_IDLE_OFF;
+
+	while (regs->clock < endCycles)
+	{
+// Hard disk debugging
+#if 0
+if (first && (regs->pc == 0x801))
+{
+//	Bus::Write(regs, 0x42, 1); // v3.0 does this now...
+	Bus::Write(regs, 0x44, 0); // who writes non-zero to here??? (AHSSC does)
+	first = false;
+//	dumpDis = true;
+//WriteLog("V65C02: Executing $801...\n");
+}
+else if (regs->pc == 0x869)
+{
+/*	Bus::Write(regs, 0x42, 1);
+	first = false;//*/
+/*	static char disbuf[80];
+	uint16_t pc=0x801;
+	while (pc < 0xA00)
+	{
+		pc += Decode65C02(regs, disbuf, pc);
+		WriteLog("%s\n", disbuf);
+	}*/
+/*	dumpDis = true;
+	WriteLog("\n>>> $42-7: %02X %02X %02X %02X %02X %02X\n\n", Bus::Read(regs, 0x42), Bus::Read(regs, 0x43), Bus::Read(regs, 0x44), Bus::Read(regs, 0x45), Bus::Read(regs, 0x46), Bus::Read(regs, 0x47));//*/
+}
+#endif
+#if 0
+//Epoch
+if (regs->pc == 0x0518)
+{
+	dumpDis = true;
+}
+else if (regs->pc == 0x051E)
+{
+	uint16_t c1 = Bus::Read(regs, 0xFF);
+	uint16_t c2 = Bus::Read(regs, 0x00);
+	WriteLog("$FF/$00 = $%02X $%02X\n", c1, c2);
+	WriteLog("--> $%02X\n", Bus::Read(regs, (c2 << 8) | c1));
+}
+else if (regs->pc == 0x0522)
+{
+	uint16_t c1 = Bus::Read(regs, 0xFF);
+	uint16_t c2 = Bus::Read(regs, 0x00);
+	WriteLog("$FF/$00 = $%02X $%02X\n", c1, c2);
+	WriteLog("--> $%02X\n", Bus::Read(regs, ((c2 << 8) | c1) + 1));
+}
+#endif
+#if 0
+// Up N Down testing
+// Now Ankh testing...
+static bool inDelay = false;
+static bool inBell = false;
+static bool inReadSector = false;
+if (regs->pc == 0xFCA8 && !inBell && !inReadSector)
+{
+	dumpDis = false;
+	inDelay = true;
+	WriteLog("*** DELAY\n");
+}
+else if (regs->pc == 0xFCB3 && inDelay && !inBell && !inReadSector)
+{
+	dumpDis = true;
+	inDelay = false;
+}
+if (regs->pc == 0xFBD9)
+{
+	dumpDis = false;
+	inBell = true;
+	WriteLog("*** BELL1\n");
+}
+else if (regs->pc == 0xFBEF && inBell)
+{
+	dumpDis = true;
+	inBell = false;
+}
+else if (regs->pc == 0xC600)
+{
+	dumpDis = false;
+	WriteLog("*** DISK @ $C600\n");
+}
+else if (regs->pc == 0x801)
+{
+	WriteLog("*** DISK @ $801\n");
+	dumpDis = true;
+}
+else if (regs->pc == 0xC119)
+{
+	dumpDis = false;
+	WriteLog("*** BIOS @ $C119\n");
+}
+else if (regs->pc == 0xC117)
+{
+	dumpDis = true;
+}
+else if (regs->pc == 0x843)
+{
+	dumpDis = false;
+	inReadSector = true;
+	uint16_t lo = Bus::Read(regs, 0x26);
+	uint16_t hi = Bus::Read(regs, 0x27);
+	WriteLog("\n*** DISK Read sector ($26=$%04X)...\n\n", (hi << 8) | lo);
+}
+else if (regs->pc == 0x8FC)
+{
+	dumpDis = true;
+	inReadSector = false;
+}
+else if (regs->pc == 0xA8A8 || regs->pc == 0xC100)
+{
+	dumpDis = false;
+}
+else if (regs->pc == 0x8FD)
+{
+//	Bus::Write(regs, 0x827, 3);
+//	Bus::Write(regs, 0x82A, 0);
+//1 doesn't work, but 2 does (only with WOZ, not with DSK; DSK needs 4)...
+//	Bus::Write(regs, 0x0D, 4);
+}
+
+#endif
+#if 0
+static bool inDelay = false;
+static bool inMLI = false;
+static uint16_t mliReturnAddr = 0;
+static uint8_t mliCmd = 0;
+if (regs->pc == 0x160B && dumpDis)
+{
+	inDelay = true;
+	dumpDis = false;
+	WriteLog("*** DELAY\n");
+}
+else if (regs->pc == 0x1616 && inDelay)
+{
+	inDelay = false;
+	dumpDis = true;
+}
+else if (regs->pc == 0xD385 && dumpDis)
+{
+	inDelay = true;
+	dumpDis = false;
+	WriteLog("*** DELAY\n");
+}
+else if (regs->pc == 0xD397 && inDelay)
+{
+	inDelay = false;
+	dumpDis = true;
+}
+else if (regs->pc == 0xBF00 && dumpDis)
+{
+	uint16_t lo = Bus::Read(regs, regs->sp + 0x101);
+	uint16_t hi = Bus::Read(regs, regs->sp + 0x102);
+	mliReturnAddr = ((hi << 8) | lo) + 1;
+	mliCmd = Bus::Read(regs, mliReturnAddr);
+	WriteLog("*** Calling ProDOS MLI with params: %02X %04X\n", mliCmd, RdMemW<Bus>(regs, mliReturnAddr + 1));
+	mliReturnAddr += 3;
+	inMLI = true;
+
+	// We want to see what's going on in the WRITE BLOCK command... :-P
+//	if (mliCmd != 0x81)
+//		dumpDis = false;
+}
+else if (regs->pc == mliReturnAddr && inMLI)
+{
+//extern bool stopWriting;
+//Stop writing to disk after the first block is done
+//	if (mliCmd == 0x81)
+//		stopWriting = true;
+
+	inMLI = false;
+	dumpDis = true;
+}
+else if (regs->pc == 0xAB3A && dumpDis && !inDelay)
+{
+	dumpDis = false;
+	inDelay = true;
+	WriteLog("\n*** DELAY (A=$%02X)\n\n", regs->a);
+}
+else if (regs->pc == 0xAB4A && inDelay)
+{
+	dumpDis = true;
+	inDelay = false;
+}
+
+if (regs->pc == 0xA80B)
+	dumpDis = true;
+
+#endif
+#if 0
+static bool weGo = false;
+static bool inDelay = false;
+if (regs->pc == 0x92BA)
+{
+	dumpDis = true;
+	weGo = true;
+}
+else if (regs->pc == 0xAB3A && weGo && !inDelay)
+{
+	dumpDis = false;
+	inDelay = true;
+	WriteLog("\n*** DELAY (A=$%02X)\n\n", regs->a);
+}
+else if (regs->pc == 0xAB4A && weGo)
+{
+	dumpDis = true;
+	inDelay = false;
+}
+else if (regs->pc == 0xA8B5 && weGo)
+{
+	WriteLog("\n$D4=%02X, $AC1F=%02X, $AC20=%02X\n\n", Bus::Read(regs, 0xD4), Bus::Read(regs, 0xAC1F), Bus::Read(regs, 0xAC20));
+}
+/*else if (regs->pc == 0xA8C4 && weGo)
+{
+	WriteLog("Cheating... (clearing Carry flag)\n");
+	regs->cc &= ~FLAG_C;
+}*/
+#endif
+#if 0
+static bool weGo = false;
+if (regs->pc == 0x80AE)
+{
+	dumpDis = true;
+	weGo = true;
+}
+else if (regs->pc == 0xFCA8 && weGo)
+{
+	dumpDis = false;
+	WriteLog("\n*** DELAY (A=$%02X)\n\n", regs->a);
+}
+else if (regs->pc == 0xFCB3 && weGo)
+{
+	dumpDis = true;
+}
+#endif
+#if 0
+/*if (regs->pc == 0x4007)
+{
+	dumpDis = true;
+}//*/
+if (regs->pc == 0x444B)
+{
+	WriteLog("\n*** End of wait...\n\n");
+	dumpDis = true;
+}//*/
+if (regs->pc == 0x444E)
+{
+	WriteLog("\n*** Start of wait...\n\n");
+	dumpDis = false;
+}//*/
+#endif
+/*if (regs->pc >= 0xC600 && regs->pc <=0xC6FF)
+{
+	dumpDis = true;
+}
+else
+	dumpDis = false;//*/
+/*if (regs->pc == 0xE039)
+{
+	dumpDis = true;
+}//*/
+
+#if 0
+/*if (regs->pc == 0x0801)
+{
+	WriteLog("\n*** DISK BOOT subroutine...\n\n");
+	dumpDis = true;
+}//*/
+if (regs->pc == 0xE000)
+{
+#if 0
+	WriteLog("\n*** Dump of $E000 routine ***\n\n");
+
+	for(uint32_t addr=0xE000; addr<0xF000;)
+	{
+		addr += Decode65C02(addr);
+		WriteLog("\n");
+	}
+#endif
+	WriteLog("\n*** DISK part II subroutine...\n\n");
+	dumpDis = true;
+}//*/
+if (regs->pc == 0xD000)
+{
+	WriteLog("\n*** CUSTOM DISK READ subroutine...\n\n");
+	dumpDis = false;
+}//*/
+if (regs->pc == 0xD1BE)
+{
+//	WriteLog("\n*** DISK part II subroutine...\n\n");
+	dumpDis = true;
+}//*/
+if (regs->pc == 0xD200)
+{
+	WriteLog("\n*** CUSTOM SCREEN subroutine...\n\n");
+	dumpDis = false;
+}//*/
+if (regs->pc == 0xD269)
+{
+//	WriteLog("\n*** DISK part II subroutine...\n\n");
+	dumpDis = true;
+}//*/
+#endif
+//if (regs->pc == 0xE08E)
+/*if (regs->pc == 0xAD33)
+{
+	WriteLog("\n*** After loader ***\n\n");
+	dumpDis = true;
+}//*/
+/*if (regs->pc == 0x0418)
+{
+	WriteLog("\n*** CUSTOM DISK READ subroutine...\n\n");
+	dumpDis = false;
+}
+if (regs->pc == 0x0)
+{
+	dumpDis = true;
+}//*/
+#ifdef __DEBUGMON__
+//WAIT is commented out here because it's called by BELL1...
+if (regs->pc == 0xFCA8)
+{
+	WriteLog("\n*** WAIT subroutine...\n\n");
+	dumpDis = false;
+}//*/
+if (regs->pc == 0xFBD9)
+{
+	WriteLog("\n*** BELL1 subroutine...\n\n");
+//	dumpDis = false;
+}//*/
+if (regs->pc == 0xFC58)
+{
+	WriteLog("\n*** HOME subroutine...\n\n");
+//	dumpDis = false;
+}//*/
+if (regs->pc == 0xFDED)
+{
+	WriteLog("\n*** COUT subroutine...\n\n");
+	dumpDis = false;
+}
+#endif
+#if 0
+// ProDOS debugging
+if (regs->pc == 0x2000)
+	dumpDis = true;
+#endif
+
+		uint16_t instPC = regs->pc;
+		uint32_t ran = 0;
+
+		if (instLeft == 0)
+		{
+			V65C02Block * block = 0;
+
+			if (cache && (cache->mode != V65C02_MODE_INTERPRET))
+				block = FetchBlock<Bus>(regs, cache);
+
+			if (block)
+				ran = RunTranslated<Bus>(regs, cache, block, endCycles);
+
+			if (ran)
+			{
+				// Everything below just looks at the last instruction it ran
+				inst = block->inst + ran;
+
+				for(uint32_t i=0; i<ran-1; i++)
+					instPC += block->inst[i].length;
+			}
+			else if (block)
+			{
+				inst = block->inst;
+				instLeft = block->count;
+				cache->stop = false;
+			}
+			else
+			{
+				FetchInst<Bus>(regs, regs->pc, &single);
+				inst = &single;
+				instLeft = 1;
+			}
+		}
+
+		// We need this because the opcode function could add 1 or 2 cycles
+		// which aren't accounted for in CPUCycles[]. (Translated code only
+		// runs when the cycles per instruction aren't needed, so there it's
+		// just what the last one takes without any.)
+		uint64_t clockSave = regs->clock - (ran ? inst[-1].cycles : 0);
+		uint8_t bank = 0;
+
+		if (!ran)
+		{
+#ifdef __DEBUG__
+			if (dumpDis)
+				TraceInst<Bus>(regs, inst);
+#endif
+#if 0
+// Hang on to how we got to a BRK
+if (inst->opcode == 0)
+{
+	dumpDis = false;
+	SaveTrace("./apple2-brk.trace");
+}
+#endif
+
+			regs->pc += inst->length;
+//if (!(regs->cpuFlags & V65C02_STATE_ILLEGAL_INST))
+//instCount[inst->opcode]++;
+
+			// The instruction could switch banks, so see where it came from first
+			bank = (profile ? Bus::Bank(regs, instPC) : 0);
+
+			// Execute that opcode...
+			switch (inst->opcode)
+			{
+			V65C02_OPCODES(SWITCH_CASE)
+			}
+
+			regs->clock += inst->cycles;
+			inst++;
+			instLeft--;
+		}
+
+		// Tell the bus how many PHI2s have elapsed, if it needs to know now...
+		if (regs->clock >= Bus::Deadline(regs))
+		{
+			Bus::Tick(regs, regs->clock - tickClock);
+			tickClock = regs->clock;
+		}
+
+		if (profile)
+			ProfileInst(profile, bank, instPC, inst[-1].opcode, inst[-1].operand,
+				regs->cc, regs->clock - clockSave);
+
+		// If the last instruction wrote over cached code or went through an
+		// I/O handler (which could have switched banks), the rest of the
+		// block can't be trusted
+		if (cache && cache->stop)
+			instLeft = 0;
+
+		// If that closed a loop that's just waiting for something to happen,
+		// skip ahead
+		if (cache && cache->skipIdle
+			&& ((cache->idle.count < V65C02_IDLE_MAX) || (regs->pc <= instPC))
+			&& IdleLoop<Bus>(regs, cache, inst - 1, instPC, regs->clock - clockSave))
+		{
+			IdleSkip<Bus>(regs, cache, endCycles, tickClock);
+			instLeft = 0;
+		}
+
+#ifdef __DEBUGMON__
+if (regs->pc == 0xFCB3)	// WAIT exit point
+{
+	dumpDis = true;
+}//*/
+/*if (regs->pc == 0xFBEF)	// BELL1 exit point
+{
+	dumpDis = true;
+}//*/
+/*if (regs->pc == 0xFC22)	// HOME exit point
+{
+	dumpDis = true;
+}//*/
+if (regs->pc == 0xFDFF)	// COUT exit point
+{
+	dumpDis = true;
+}
+if (regs->pc == 0xFBD8)
+{
+	WriteLog("\n*** BASCALC set BASL/H = $%04X\n\n", RdMemW<Bus>(regs, 0x0028));
+}//*/
+#endif
+
+		// Only go looking at which line it is if any of them are asserted (or
+		// something wants us to stop)
+		if (regs->cpuFlags & (V65C02_ASSERT_LINES | V65C02_STOP_REQUEST))
+		{
+			// Cut the run short; whatever else is asserted gets seen to the
+			// next time through
+			if (regs->cpuFlags & V65C02_STOP_REQUEST)
+			{
+				regs->cpuFlags &= ~V65C02_STOP_REQUEST;
+				endCycles = regs->clock;
+				continue;
+			}
+
+//These should be correct now...
+			if (regs->cpuFlags & V65C02_ASSERT_LINE_RESET)
+			{
+				// Not sure about this...
+				regs->sp = 0xFF;
+				SetCC(regs, FLAG_I);			// Reset the CC register
+				regs->pc = RdMemW<Bus>(regs, 0xFFFC);		// And load PC with RESET vector
+
+				regs->cpuFlags = 0;				// Clear CPU flags...
+				instLeft = 0;
+
+				if (cache)
+					cache->idle.count = V65C02_IDLE_OFF;
+#ifdef __DEBUG__
+WriteLog("\n*** RESET *** (PC = $%04X)\n\n", regs->pc);
+#endif
+			}
+			else if (regs->cpuFlags & V65C02_ASSERT_LINE_NMI)
+			{
+#ifdef __DEBUG__
+WriteLog("\n*** NMI ***\n\n");
+#endif
+				Bus::Write(regs, 0x0100 + regs->sp--, regs->pc >> 8);	// Save PC & CC
+				Bus::Write(regs, 0x0100 + regs->sp--, regs->pc & 0xFF);
+				Bus::Write(regs, 0x0100 + regs->sp--, GetCC(regs));
+				SET_I;
+				CLR_D;
+				regs->pc = RdMemW<Bus>(regs, 0xFFFA);		// Jump to NMI vector
+
+				regs->clock += 7;
+				regs->cpuFlags &= ~V65C02_ASSERT_LINE_NMI;	// Reset NMI line
+				instLeft = 0;
+
+				if (cache)
+					cache->idle.count = V65C02_IDLE_OFF;
+			}
+			else if ((regs->cpuFlags & V65C02_ASSERT_LINE_IRQ)
+				// IRQs are maskable, so check if the I flag is clear
+				&& (!(regs->cc & FLAG_I)))
+			{
+#ifdef __DEBUG__
+WriteLog("\n*** IRQ ***\n\n");
+WriteLog("Clock=$%X\n", regs->clock);
+//dumpDis = true;
+#endif
+				Bus::Write(regs, 0x0100 + regs->sp--, regs->pc >> 8);	// Save PC & CC
+				Bus::Write(regs, 0x0100 + regs->sp--, regs->pc & 0xFF);
+				Bus::Write(regs, 0x0100 + regs->sp--, GetCC(regs));
+				SET_I;
+				CLR_D;
+				regs->pc = RdMemW<Bus>(regs, 0xFFFE);		// Jump to IRQ vector
+
+				regs->clock += 7;
+				regs->cpuFlags &= ~V65C02_ASSERT_LINE_IRQ;	// Reset IRQ line
+				instLeft = 0;
+
+				if (cache)
+					cache->idle.count = V65C02_IDLE_OFF;
+			}
+		}
+	}
+
+	// Catch the bus up before handing it back
+	if (regs->clock != tickClock)
+		Bus::Tick(regs, regs->clock - tickClock);
+
+	// If we went longer than the passed in cycles, make a note of it so we can
+	// subtract it out from a subsequent run.  It's guaranteed to be non-
+	// negative, because the condition that exits the main loop above is
+	// written such that regs->clock has to be equal or larger than endCycles
+	// to exit from it.
+	regs->overflow = regs->clock - endCycles;
+}
+
+
+template <class Bus> void Execute65C02(V65C02REGS * regs, uint32_t cycles)
+{
+	SetCC(regs, regs->cc);
+
+	if (Bus::Profile(regs))
+		Run65C02<Bus, true>(regs, cycles);
+	else
+		Run65C02<Bus, false>(regs, cycles);
+
+	regs->cc = GetCC(regs);
+}
+
+#endif	// __V65C02CORE_H__
+
@@ -0,0 +1,1145 @@
+//
+// 65C02 block translator (x86-64)
+//
+// Turns a block out of the pre-decoded block cache (see FetchBlock() in
+// v65c02core.h) into host code that does what the opcode handlers would have
+// done. The 65C02's registers stay in the V65C02REGS passed in, so anything
+// the translator doesn't handle itself can just call the opcode handler, and
+// everything outside of here sees the same state it always does.
+//
+// Reads of plain memory come straight out of the bus' page map (see
+// V65C02PageMap); everything else, and every write, goes through the bus'
+// Read() & Write(), with PC & the clock where the handlers would have had
+// them. Cycles are added in the same places the handlers add them, so I/O
+// that looks at the clock sees the same thing. Translated code leaves as soon
+// as an access sets the cache's stop flag (I/O, or a write to cached code),
+// and after CLI & PLP if anything's asserted, so the core gets to look at it.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "v65c02jit.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "log.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Host registers. RBX has the 65C02's registers, R12 the block cache, R13 the
+// page map's base pointer, R14 the address being worked on & R15 the low
+// byte of a pointer being read in; all of those survive calls out.
+enum { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13,
+	R14, R15 };
+
+// Condition codes for Jcc & SETcc
+enum { CC_AE = 3, CC_Z = 4, CC_NZ = 5, CC_BE = 6 };
+
+// ALU ops (the /digit of the immediate forms)
+enum { ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6,
+	ALU_CMP = 7 };
+
+// Shifts (likewise)
+enum { SH_SHL = 4, SH_SHR = 5 };
+
+// Operand size & register flags for the encoder
+#define OP_64		0x01		// REX.W
+#define OP_8		0x02		// Byte registers (SPL-DIL, not AH-BH)
+#define OP_16		0x04		// 0x66 prefix
+
+#define R_PC		offsetof(V65C02REGS, pc)
+#define R_CC		offsetof(V65C02REGS, cc)
+#define R_SP		offsetof(V65C02REGS, sp)
+#define R_A			offsetof(V65C02REGS, a)
+#define R_X			offsetof(V65C02REGS, x)
+#define R_Y			offsetof(V65C02REGS, y)
+#define R_CLOCK		offsetof(V65C02REGS, clock)
+#define R_FLAGS		offsetof(V65C02REGS, cpuFlags)
+#define R_NZ		offsetof(V65C02REGS, nz)
+
+// What an opcode does (J_CALL: run its handler, J_FLOW: same, but it changes
+// PC so it ends the block)...
+enum { J_CALL = 0, J_FLOW, J_LDA, J_LDX, J_LDY, J_STA, J_STX, J_STY, J_STZ,
+	J_ADC, J_SBC, J_AND, J_ORA, J_EOR, J_CMP, J_CPX, J_CPY, J_BIT, J_ASL,
+	J_LSR, J_ROL, J_ROR, J_INC, J_DEC, J_INX, J_INY, J_DEX, J_DEY, J_TAX,
+	J_TAY, J_TXA, J_TYA, J_TSX, J_TXS, J_CLC, J_SEC, J_CLD, J_SED, J_CLI,
+	J_SEI, J_CLV, J_NOP, J_PHA, J_PHX, J_PHY, J_PLA, J_PLX, J_PLY, J_JMP,
+	J_JSR, J_RTS, J_BRANCH };
+
+// ...and how it gets at its operand
+enum { M_IMP = 0, M_ACC, M_IMM, M_ZP, M_ZPX, M_ZPY, M_ABS, M_ABSX, M_ABSY,
+	M_INDX, M_INDY, M_IND };
+
+struct JitOp
+{
+	uint8_t opcode, kind, mode;
+};
+
+static const JitOp jitOps[] = {
+	{ 0x69, J_ADC, M_IMM }, { 0x65, J_ADC, M_ZP }, { 0x75, J_ADC, M_ZPX },
+	{ 0x6D, J_ADC, M_ABS }, { 0x7D, J_ADC, M_ABSX }, { 0x79, J_ADC, M_ABSY },
+	{ 0x61, J_ADC, M_INDX }, { 0x71, J_ADC, M_INDY }, { 0x72, J_ADC, M_IND },
+	{ 0x29, J_AND, M_IMM }, { 0x25, J_AND, M_ZP }, { 0x35, J_AND, M_ZPX },
+	{ 0x2D, J_AND, M_ABS }, { 0x3D, J_AND, M_ABSX }, { 0x39, J_AND, M_ABSY },
+	{ 0x21, J_AND, M_INDX }, { 0x31, J_AND, M_INDY }, { 0x32, J_AND, M_IND },
+	{ 0x0A, J_ASL, M_ACC }, { 0x06, J_ASL, M_ZP }, { 0x16, J_ASL, M_ZPX },
+	{ 0x0E, J_ASL, M_ABS }, { 0x1E, J_ASL, M_ABSX },
+	{ 0x89, J_BIT, M_IMM }, { 0x24, J_BIT, M_ZP }, { 0x34, J_BIT, M_ZPX },
+	{ 0x2C, J_BIT, M_ABS }, { 0x3C, J_BIT, M_ABSX },
+	{ 0x10, J_BRANCH, M_IMM }, { 0x30, J_BRANCH, M_IMM }, { 0x50, J_BRANCH, M_IMM },
+	{ 0x70, J_BRANCH, M_IMM }, { 0x80, J_BRANCH, M_IMM }, { 0x90, J_BRANCH, M_IMM },
+	{ 0xB0, J_BRANCH, M_IMM }, { 0xD0, J_BRANCH, M_IMM }, { 0xF0, J_BRANCH, M_IMM },
+	{ 0x18, J_CLC, M_IMP }, { 0xD8, J_CLD, M_IMP }, { 0x58, J_CLI, M_IMP },
+	{ 0xB8, J_CLV, M_IMP },
+	{ 0xC9, J_CMP, M_IMM }, { 0xC5, J_CMP, M_ZP }, { 0xD5, J_CMP, M_ZPX },
+	{ 0xCD, J_CMP, M_ABS }, { 0xDD, J_CMP, M_ABSX }, { 0xD9, J_CMP, M_ABSY },
+	{ 0xC1, J_CMP, M_INDX }, { 0xD1, J_CMP, M_INDY }, { 0xD2, J_CMP, M_IND },
+	{ 0xE0, J_CPX, M_IMM }, { 0xE4, J_CPX, M_ZP }, { 0xEC, J_CPX, M_ABS },
+	{ 0xC0, J_CPY, M_IMM }, { 0xC4, J_CPY, M_ZP }, { 0xCC, J_CPY, M_ABS },
+	{ 0x3A, J_DEC, M_ACC }, { 0xC6, J_DEC, M_ZP }, { 0xD6, J_DEC, M_ZPX },
+	{ 0xCE, J_DEC, M_ABS }, { 0xDE, J_DEC, M_ABSX },
+	{ 0xCA, J_DEX, M_IMP }, { 0x88, J_DEY, M_IMP },
+	{ 0x49, J_EOR, M_IMM }, { 0x45, J_EOR, M_ZP }, { 0x55, J_EOR, M_ZPX },
+	{ 0x4D, J_EOR, M_ABS }, { 0x5D, J_EOR, M_ABSX }, { 0x59, J_EOR, M_ABSY },
+	{ 0x41, J_EOR, M_INDX }, { 0x51, J_EOR, M_INDY }, { 0x52, J_EOR, M_IND },
+	{ 0x1A, J_INC, M_ACC }, { 0xE6, J_INC, M_ZP }, { 0xF6, J_INC, M_ZPX },
+	{ 0xEE, J_INC, M_ABS }, { 0xFE, J_INC, M_ABSX },
+	{ 0xE8, J_INX, M_IMP }, { 0xC8, J_INY, M_IMP },
+	{ 0x4C, J_JMP, M_ABS }, { 0x20, J_JSR, M_ABS },
+	{ 0xA9, J_LDA, M_IMM }, { 0xA5, J_LDA, M_ZP }, { 0xB5, J_LDA, M_ZPX },
+	{ 0xAD, J_LDA, M_ABS }, { 0xBD, J_LDA, M_ABSX }, { 0xB9, J_LDA, M_ABSY },
+	{ 0xA1, J_LDA, M_INDX }, { 0xB1, J_LDA, M_INDY }, { 0xB2, J_LDA, M_IND },
+	{ 0xA2, J_LDX, M_IMM }, { 0xA6, J_LDX, M_ZP }, { 0xB6, J_LDX, M_ZPY },
+	{ 0xAE, J_LDX, M_ABS }, { 0xBE, J_LDX, M_ABSY },
+	{ 0xA0, J_LDY, M_IMM }, { 0xA4, J_LDY, M_ZP }, { 0xB4, J_LDY, M_ZPX },
+	{ 0xAC, J_LDY, M_ABS }, { 0xBC, J_LDY, M_ABSX },
+	{ 0x4A, J_LSR, M_ACC }, { 0x46, J_LSR, M_ZP }, { 0x56, J_LSR, M_ZPX },
+	{ 0x4E, J_LSR, M_ABS }, { 0x5E, J_LSR, M_ABSX },
+	{ 0xEA, J_NOP, M_IMP },
+	{ 0x09, J_ORA, M_IMM }, { 0x05, J_ORA, M_ZP }, { 0x15, J_ORA, M_ZPX },
+	{ 0x0D, J_ORA, M_ABS }, { 0x1D, J_ORA, M_ABSX }, { 0x19, J_ORA, M_ABSY },
+	{ 0x01, J_ORA, M_INDX }, { 0x11, J_ORA, M_INDY }, { 0x12, J_ORA, M_IND },
+	{ 0x48, J_PHA, M_IMP }, { 0xDA, J_PHX, M_IMP }, { 0x5A, J_PHY, M_IMP },
+	{ 0x68, J_PLA, M_IMP }, { 0xFA, J_PLX, M_IMP }, { 0x7A, J_PLY, M_IMP },
+	{ 0x2A, J_ROL, M_ACC }, { 0x26, J_ROL, M_ZP }, { 0x36, J_ROL, M_ZPX },
+	{ 0x2E, J_ROL, M_ABS }, { 0x3E, J_ROL, M_ABSX },
+	{ 0x6A, J_ROR, M_ACC }, { 0x66, J_ROR, M_ZP }, { 0x76, J_ROR, M_ZPX },
+	{ 0x6E, J_ROR, M_ABS }, { 0x7E, J_ROR, M_ABSX },
+	{ 0x60, J_RTS, M_IMP },
+	{ 0xE9, J_SBC, M_IMM }, { 0xE5, J_SBC, M_ZP }, { 0xF5, J_SBC, M_ZPX },
+	{ 0xED, J_SBC, M_ABS }, { 0xFD, J_SBC, M_ABSX }, { 0xF9, J_SBC, M_ABSY },
+	{ 0xE1, J_SBC, M_INDX }, { 0xF1, J_SBC, M_INDY }, { 0xF2, J_SBC, M_IND },
+	{ 0x38, J_SEC, M_IMP }, { 0xF8, J_SED, M_IMP }, { 0x78, J_SEI, M_IMP },
+	{ 0x85, J_STA, M_ZP }, { 0x95, J_STA, M_ZPX }, { 0x8D, J_STA, M_ABS },
+	{ 0x9D, J_STA, M_ABSX }, { 0x99, J_STA, M_ABSY }, { 0x81, J_STA, M_INDX },
+	{ 0x91, J_STA, M_INDY }, { 0x92, J_STA, M_IND },
+	{ 0x86, J_STX, M_ZP }, { 0x96, J_STX, M_ZPY }, { 0x8E, J_STX, M_ABS },
+	{ 0x84, J_STY, M_ZP }, { 0x94, J_STY, M_ZPX }, { 0x8C, J_STY, M_ABS },
+	{ 0x64, J_STZ, M_ZP }, { 0x74, J_STZ, M_ZPX }, { 0x9C, J_STZ, M_ABS },
+	{ 0x9E, J_STZ, M_ABSX },
+	{ 0xAA, J_TAX, M_IMP }, { 0xA8, J_TAY, M_IMP }, { 0xBA, J_TSX, M_IMP },
+	{ 0x8A, J_TXA, M_IMP }, { 0x9A, J_TXS, M_IMP }, { 0x98, J_TYA, M_IMP },
+	// These go to their handlers, but change PC
+	{ 0x00, J_FLOW, M_IMP }, { 0x40, J_FLOW, M_IMP }, { 0x6C, J_FLOW, M_IMP },
+	{ 0x7C, J_FLOW, M_IMP },
+	{ 0x0F, J_FLOW, M_IMP }, { 0x1F, J_FLOW, M_IMP }, { 0x2F, J_FLOW, M_IMP },
+	{ 0x3F, J_FLOW, M_IMP }, { 0x4F, J_FLOW, M_IMP }, { 0x5F, J_FLOW, M_IMP },
+	{ 0x6F, J_FLOW, M_IMP }, { 0x7F, J_FLOW, M_IMP }, { 0x8F, J_FLOW, M_IMP },
+	{ 0x9F, J_FLOW, M_IMP }, { 0xAF, J_FLOW, M_IMP }, { 0xBF, J_FLOW, M_IMP },
+	{ 0xCF, J_FLOW, M_IMP }, { 0xDF, J_FLOW, M_IMP }, { 0xEF, J_FLOW, M_IMP },
+	{ 0xFF, J_FLOW, M_IMP }
+};
+
+// Local variables
+
+static uint8_t opKind[256];			// Filled in from jitOps[]; anything not
+static uint8_t opMode[256];			// in there is J_CALL
+static bool opsReady = false;
+static uintptr_t pageSize = 0x1000;
+
+// Local functions
+
+static bool SetArena(V65C02BlockCache * cache, uint32_t offset, uint32_t size, int prot);
+
+
+//
+// Just enough of an x86-64 assembler
+//
+struct Assembler
+{
+	uint8_t * p;
+
+	inline void B(uint8_t b) { *p++ = b; }
+	inline void W(uint16_t w) { memcpy(p, &w, 2); p += 2; }
+	inline void D(uint32_t d) { memcpy(p, &d, 4); p += 4; }
+	inline void Q(uint64_t q) { memcpy(p, &q, 8); p += 8; }
+
+	void Prefix(int flags, int reg, int index, int base)
+	{
+		if (flags & OP_16)
+			B(0x66);
+
+		uint8_t rex = 0x40 | (flags & OP_64 ? 0x08 : 0) | ((reg & 8) >> 1)
+			| ((index & 8) >> 2) | ((base & 8) >> 3);
+
+		if ((rex != 0x40) || (flags & OP_8))
+			B(rex);
+	}
+
+	void Op(uint32_t op)
+	{
+		if (op > 0xFF)
+			B(op >> 8);
+
+		B(op & 0xFF);
+	}
+
+	// op reg, [base + index + disp] (index < 0 for none)
+	void Mem(uint32_t op, int reg, int base, int index, int32_t disp, int flags = 0)
+	{
+		Prefix(flags, reg, (index < 0 ? 0 : index), base);
+		Op(op);
+		int mod = ((disp == 0) && ((base & 7) != RBP) ? 0
+			: ((disp >= -128) && (disp <= 127) ? 1 : 2));
+
+		if ((index < 0) && ((base & 7) != RSP))
+			B((mod << 6) | ((reg & 7) << 3) | (base & 7));
+		else
+		{
+			B((mod << 6) | ((reg & 7) << 3) | 4);
+			B(((index < 0 ? 4 : index & 7) << 3) | (base & 7));
+		}
+
+		if (mod == 1)
+			B(disp);
+		else if (mod == 2)
+			D(disp);
+	}
+
+	// op reg, rm
+	void Reg(uint32_t op, int reg, int rm, int flags = 0)
+	{
+		Prefix(flags, reg, 0, rm);
+		Op(op);
+		B(0xC0 | ((reg & 7) << 3) | (rm & 7));
+	}
+
+	void MovRR(int dst, int src, int flags = 0) { Reg(0x89, src, dst, flags); }
+	void AluRR(int alu, int dst, int src) { Reg((alu << 3) | 0x01, src, dst); }
+	void AluRI(int alu, int dst, uint32_t imm) { Reg(0x81, alu, dst); D(imm); }
+	void Shift(int sh, int dst, uint8_t n) { Reg(0xC1, sh, dst); B(n); }
+	void MovzxRR8(int dst, int src) { Reg(0x0FB6, dst, src, OP_8); }
+	void SetCC(int cc, int dst) { Reg(0x0F90 | cc, 0, dst, OP_8); }
+
+	void MovRI(int dst, uint32_t imm)
+	{
+		Prefix(0, 0, 0, dst);
+		B(0xB8 | (dst & 7));
+		D(imm);
+	}
+
+	void MovRI64(int dst, uint64_t imm)
+	{
+		Prefix(OP_64, 0, 0, dst);
+		B(0xB8 | (dst & 7));
+		Q(imm);
+	}
+
+	void Push(int r)
+	{
+		Prefix(0, 0, 0, r);
+		B(0x50 | (r & 7));
+	}
+
+	void Pop(int r)
+	{
+		Prefix(0, 0, 0, r);
+		B(0x58 | (r & 7));
+	}
+
+	// Forward jumps: these return where to patch the target in
+	uint8_t * Jcc(int cc)
+	{
+		B(0x0F);
+		B(0x80 | cc);
+		D(0);
+		return p;
+	}
+
+	uint8_t * Jmp(void)
+	{
+		B(0xE9);
+		D(0);
+		return p;
+	}
+
+	void Land(uint8_t * from)
+	{
+		int32_t rel = (int32_t)(p - from);
+		memcpy(from - 4, &rel, 4);
+	}
+};
+
+
+// Where an instruction's operand is: at address, or at the one in R14
+struct Address
+{
+	bool dynamic;
+	uint16_t address;
+};
+
+
+//
+// Translates one block
+//
+struct Translator
+{
+	Assembler a;
+	const V65C02PageMap * map;
+	const V65C02JitHelpers * help;
+	uint32_t pending;			// Cycles that haven't been added to the clock yet
+
+	void Call(const void * function)
+	{
+		a.MovRI64(RAX, (uint64_t)(uintptr_t)function);
+		a.Reg(0xFF, 2, RAX);
+	}
+
+	void LoadReg(int dst, uint32_t offset) { a.Mem(0x0FB6, dst, RBX, -1, offset); }
+	void StoreReg(uint32_t offset, int src) { a.Mem(0x88, src, RBX, -1, offset, OP_8); }
+	void SetNZ(int src) { a.Mem(0x89, src, RBX, -1, R_NZ, OP_16); }
+	void AndCC(uint8_t mask) { a.Mem(0x80, ALU_AND, RBX, -1, R_CC); a.B(mask); }
+	void OrCC(uint8_t bits) { a.Mem(0x80, ALU_OR, RBX, -1, R_CC); a.B(bits); }
+	void OrCCR(int src) { a.Mem(0x08, src, RBX, -1, R_CC, OP_8); }
+
+	void StorePC(uint16_t pc)
+	{
+		a.Mem(0xC7, 0, RBX, -1, R_PC, OP_16);
+		a.W(pc);
+	}
+
+	void AddClock(uint32_t cycles)
+	{
+		if (cycles == 0)
+			return;
+
+		a.Mem(0x81, ALU_ADD, RBX, -1, R_CLOCK, OP_64);
+		a.D(cycles);
+	}
+
+	// Anything that calls out has to see the clock where the handler would
+	// have had it
+	void FlushClock(void)
+	{
+		AddClock(pending);
+		pending = 0;
+	}
+
+	void Prologue(void)
+	{
+		a.Push(RBX);
+		a.Push(R12);
+		a.Push(R13);
+		a.Push(R14);
+		a.Push(R15);
+		a.MovRR(RBX, RDI, OP_64);
+		a.MovRR(R12, RSI, OP_64);
+		a.MovRI64(R13, (uint64_t)(uintptr_t)map->base);
+	}
+
+	// Leave, with n instructions run & the clock caught up (PC has to be
+	// right already)
+	void Exit(uint32_t n, uint32_t extra = 0)
+	{
+		AddClock(pending + extra);
+		a.MovRI(RAX, n);
+		a.Pop(R15);
+		a.Pop(R14);
+		a.Pop(R13);
+		a.Pop(R12);
+		a.Pop(RBX);
+		a.B(0xC3);
+	}
+
+	// Leave after n instructions if an access set the cache's stop flag
+	void StopCheck(uint32_t n)
+	{
+		a.Mem(0x80, ALU_CMP, R12, -1, offsetof(V65C02BlockCache, stop));
+		a.B(0);
+		uint8_t * go = a.Jcc(CC_Z);
+		Exit(n);
+		a.Land(go);
+	}
+
+	// Leave after n instructions if an interrupt (or a stop) is pending, now
+	// that it might not be masked
+	void LineCheck(uint32_t n, uint16_t next)
+	{
+		a.Mem(0xF7, 0, RBX, -1, R_FLAGS, OP_16);
+		a.W(V65C02_ASSERT_LINES | V65C02_STOP_REQUEST);
+		uint8_t * go = a.Jcc(CC_Z);
+		StorePC(next);
+		Exit(n);
+		a.Land(go);
+	}
+
+	// Hand a byte that came out of the page map to the note helper (the
+	// address is in ESI, the byte in EAX)
+	void Note(void)
+	{
+		a.MovRR(RDX, RAX);
+		a.MovRR(RDI, RBX, OP_64);
+		Call((const void *)help->note);
+		a.MovzxRR8(RAX, RAX);
+	}
+
+	// EAX = byte at address
+	void ReadConst(uint16_t address)
+	{
+		a.Mem(0x8B, RAX, R13, -1, 0, OP_64);
+		a.Mem(0x8B, RAX, RAX, -1, (address >> 8) * map->stride + map->read, OP_64);
+		a.Reg(0x85, RAX, RAX, OP_64);
+		uint8_t * slow = a.Jcc(CC_Z);
+		a.Mem(0x0FB6, RAX, RAX, -1, address & 0xFF);
+
+		if (help->note)
+		{
+			a.MovRI(RSI, address);
+			Note();
+		}
+
+		uint8_t * done = a.Jmp();
+		a.Land(slow);
+		a.MovRR(RDI, RBX, OP_64);
+		a.MovRI(RSI, address);
+		Call((const void *)help->read);
+		a.MovzxRR8(RAX, RAX);
+		a.Land(done);
+	}
+
+	// EAX = byte at the address in R14
+	void ReadDynamic(void)
+	{
+		a.MovRR(RAX, R14);
+		a.Shift(SH_SHR, RAX, 8);
+		a.Reg(0x69, RAX, RAX);
+		a.D(map->stride);
+		a.Mem(0x8B, RCX, R13, -1, 0, OP_64);
+		a.Mem(0x8B, RCX, RCX, RAX, map->read, OP_64);
+		a.Reg(0x85, RCX, RCX, OP_64);
+		uint8_t * slow = a.Jcc(CC_Z);
+		a.MovzxRR8(RAX, R14);
+		a.Mem(0x0FB6, RAX, RCX, RAX, 0);
+
+		if (help->note)
+		{
+			a.MovRR(RSI, R14);
+			Note();
+		}
+
+		uint8_t * done = a.Jmp();
+		a.Land(slow);
+		a.MovRR(RDI, RBX, OP_64);
+		a.MovRR(RSI, R14);
+		Call((const void *)help->read);
+		a.MovzxRR8(RAX, RAX);
+		a.Land(done);
+	}
+
+	void Read(Address ea)
+	{
+		if (ea.dynamic)
+			ReadDynamic();
+		else
+			ReadConst(ea.address);
+	}
+
+	// Write EDX to ea
+	void Write(Address ea)
+	{
+		a.MovRR(RDI, RBX, OP_64);
+
+		if (ea.dynamic)
+			a.MovRR(RSI, R14);
+		else
+			a.MovRI(RSI, ea.address);
+
+		Call((const void *)help->write);
+	}
+
+	// R14 = 0x0100 + SP, then SP moves on
+	void StackPush(void)
+	{
+		LoadReg(R14, R_SP);
+		a.Mem(0xFE, 1, RBX, -1, R_SP);
+		a.AluRI(ALU_OR, R14, 0x0100);
+	}
+
+	void StackPull(void)
+	{
+		a.Mem(0xFE, 0, RBX, -1, R_SP);
+		LoadReg(R14, R_SP);
+		a.AluRI(ALU_OR, R14, 0x0100);
+		ReadDynamic();
+	}
+
+	// Clock++ if the low byte in EAX went past $FF
+	void CrossCheck(void)
+	{
+		a.AluRI(ALU_CMP, RAX, 0xFF);
+		uint8_t * same = a.Jcc(CC_BE);
+		AddClock(1);
+		a.Land(same);
+	}
+
+	// R14 = ($zp+1):($zp), low byte first (see RdMemWZP())
+	void ZeroPagePointer(Address zp)
+	{
+		Read(zp);
+		a.MovRR(R15, RAX);
+
+		if (zp.dynamic)
+		{
+			a.AluRI(ALU_ADD, R14, 1);
+			a.AluRI(ALU_AND, R14, 0xFF);
+		}
+		else
+			zp.address = (zp.address + 1) & 0xFF;
+
+		Read(zp);
+		a.Shift(SH_SHL, RAX, 8);
+		a.AluRR(ALU_OR, RAX, R15);
+		a.MovRR(R14, RAX);
+	}
+
+	// Work out the effective address, doing the same reads (and adding the
+	// page crossing cycle at the same point) that the handlers do
+	Address EffectiveAddress(uint8_t mode, uint16_t operand, bool penalty)
+	{
+		Address ea = { false, operand };
+		Address zp = { false, (uint16_t)(operand & 0xFF) };
+
+		switch (mode)
+		{
+		case M_ZP:
+			ea.address = operand & 0xFF;
+			break;
+		case M_ZPX:
+		case M_ZPY:
+			LoadReg(R14, (mode == M_ZPX ? R_X : R_Y));
+			a.AluRI(ALU_ADD, R14, operand & 0xFF);
+			a.AluRI(ALU_AND, R14, 0xFF);
+			ea.dynamic = true;
+			break;
+		case M_ABSX:
+		case M_ABSY:
+			if (penalty)
+			{
+				LoadReg(RAX, (mode == M_ABSX ? R_X : R_Y));
+				a.AluRI(ALU_ADD, RAX, operand & 0xFF);
+				CrossCheck();
+			}
+
+			LoadReg(R14, (mode == M_ABSX ? R_X : R_Y));
+			a.AluRI(ALU_ADD, R14, operand);
+			a.AluRI(ALU_AND, R14, 0xFFFF);
+			ea.dynamic = true;
+			break;
+		case M_INDX:
+			LoadReg(R14, R_X);
+			a.AluRI(ALU_ADD, R14, operand & 0xFF);
+			a.AluRI(ALU_AND, R14, 0xFF);
+			zp.dynamic = true;
+			ZeroPagePointer(zp);
+			ea.dynamic = true;
+			break;
+		case M_INDY:
+			if (penalty)
+			{
+				ReadConst(operand & 0xFF);
+				LoadReg(RCX, R_Y);
+				a.AluRR(ALU_ADD, RAX, RCX);
+				CrossCheck();
+			}
+
+			ZeroPagePointer(zp);
+			LoadReg(RCX, R_Y);
+			a.AluRR(ALU_ADD, R14, RCX);
+			a.AluRI(ALU_AND, R14, 0xFFFF);
+			ea.dynamic = true;
+			break;
+		case M_IND:
+			ZeroPagePointer(zp);
+			ea.dynamic = true;
+			break;
+		}
+
+		return ea;
+	}
+
+	// Loads, ALU ops & compares, with the operand in EAX
+	void Operate(uint8_t kind, uint8_t mode)
+	{
+		switch (kind)
+		{
+		case J_LDA:
+		case J_LDX:
+		case J_LDY:
+			StoreReg((kind == J_LDA ? R_A : (kind == J_LDX ? R_X : R_Y)), RAX);
+			SetNZ(RAX);
+			break;
+		case J_AND:
+		case J_ORA:
+		case J_EOR:
+			LoadReg(RCX, R_A);
+			a.AluRR((kind == J_AND ? ALU_AND : (kind == J_ORA ? ALU_OR : ALU_XOR)), RCX, RAX);
+			StoreReg(R_A, RCX);
+			SetNZ(RCX);
+			break;
+		case J_CMP:
+		case J_CPX:
+		case J_CPY:
+			LoadReg(RCX, (kind == J_CMP ? R_A : (kind == J_CPX ? R_X : R_Y)));
+			a.MovRR(RDX, RCX);
+			a.AluRR(ALU_SUB, RDX, RAX);
+			a.MovzxRR8(RDX, RDX);
+			SetNZ(RDX);
+			a.AluRR(ALU_CMP, RCX, RAX);
+			a.SetCC(CC_AE, RDX);
+			AndCC(~FLAG_C);
+			OrCCR(RDX);
+			break;
+		case J_BIT:
+			if (mode == M_IMM)
+			{
+				// Z only; N stays what it was
+				a.Mem(0x0FB7, RCX, RBX, -1, R_NZ);
+				a.MovRR(RDX, RCX);
+				a.Shift(SH_SHR, RDX, 8);
+				a.AluRR(ALU_OR, RCX, RDX);
+				a.AluRI(ALU_AND, RCX, 0x80);
+				a.Shift(SH_SHL, RCX, 8);
+				LoadReg(RDX, R_A);
+				a.AluRR(ALU_AND, RDX, RAX);
+				a.SetCC(CC_NZ, RDX);
+				a.MovzxRR8(RDX, RDX);
+				a.AluRR(ALU_OR, RCX, RDX);
+				SetNZ(RCX);
+				break;
+			}
+
+			LoadReg(RCX, R_A);
+			a.AluRR(ALU_AND, RCX, RAX);
+			a.MovRR(RDX, RAX);
+			a.AluRI(ALU_AND, RDX, 0x80);
+			a.Shift(SH_SHL, RDX, 8);
+			a.AluRR(ALU_OR, RCX, RDX);
+			SetNZ(RCX);
+			AndCC(~FLAG_V);
+			a.AluRI(ALU_AND, RAX, FLAG_V);
+			OrCCR(RAX);
+			break;
+		case J_ADC:
+			LoadReg(RCX, R_A);
+			LoadReg(RDX, R_CC);
+			a.AluRI(ALU_AND, RDX, FLAG_C);
+			a.AluRR(ALU_ADD, RDX, RCX);
+			a.AluRR(ALU_ADD, RDX, RAX);				// EDX = sum
+			a.MovRR(R8, RCX);
+			a.AluRR(ALU_XOR, R8, RAX);
+			a.Reg(0xF7, 2, R8);						// NOT
+			a.MovRR(R9, RCX);
+			a.AluRR(ALU_XOR, R9, RDX);
+			a.AluRR(ALU_AND, R8, R9);
+			a.AluRI(ALU_AND, R8, 0x80);
+			a.Shift(SH_SHR, R8, 1);					// V...
+			a.MovRR(R9, RDX);
+			a.Shift(SH_SHR, R9, 8);
+			a.AluRR(ALU_OR, R8, R9);				// ...& C
+			AndCC(~(FLAG_C | FLAG_V));
+			OrCCR(R8);
+			a.MovzxRR8(RDX, RDX);
+			StoreReg(R_A, RDX);
+			SetNZ(RDX);
+			break;
+		case J_SBC:
+			LoadReg(RCX, R_A);
+			LoadReg(RDX, R_CC);
+			a.AluRI(ALU_AND, RDX, FLAG_C);
+			a.AluRI(ALU_XOR, RDX, FLAG_C);
+			a.MovRR(R10, RCX);
+			a.AluRR(ALU_SUB, R10, RAX);
+			a.AluRR(ALU_SUB, R10, RDX);
+			a.AluRI(ALU_AND, R10, 0xFFFF);			// R10 = sum
+			a.MovRR(R9, R10);
+			a.Shift(SH_SHR, R9, 8);
+			a.AluRI(ALU_XOR, R9, 0x01);
+			a.AluRI(ALU_AND, R9, FLAG_C);			// C...
+			a.MovRR(R8, RCX);
+			a.AluRR(ALU_XOR, R8, RAX);
+			a.MovRR(R11, RCX);
+			a.AluRR(ALU_XOR, R11, R10);
+			a.AluRR(ALU_AND, R8, R11);
+			a.AluRI(ALU_AND, R8, 0x80);
+			a.Shift(SH_SHR, R8, 1);
+			a.AluRR(ALU_OR, R8, R9);				// ...& V
+			AndCC(~(FLAG_C | FLAG_V));
+			OrCCR(R8);
+			a.MovzxRR8(RDX, R10);
+			StoreReg(R_A, RDX);
+			SetNZ(RDX);
+			break;
+		}
+	}
+
+	// Shifts, rotates, INC & DEC of EAX
+	void Modify(uint8_t kind)
+	{
+		switch (kind)
+		{
+		case J_ASL:
+			a.MovRR(RCX, RAX);
+			a.Shift(SH_SHR, RCX, 7);
+			a.Shift(SH_SHL, RAX, 1);
+			a.AluRI(ALU_AND, RAX, 0xFF);
+			break;
+		case J_LSR:
+			a.MovRR(RCX, RAX);
+			a.AluRI(ALU_AND, RCX, 0x01);
+			a.Shift(SH_SHR, RAX, 1);
+			break;
+		case J_ROL:
+			LoadReg(RDX, R_CC);
+			a.AluRI(ALU_AND, RDX, FLAG_C);
+			a.MovRR(RCX, RAX);
+			a.Shift(SH_SHR, RCX, 7);
+			a.Shift(SH_SHL, RAX, 1);
+			a.AluRR(ALU_OR, RAX, RDX);
+			a.AluRI(ALU_AND, RAX, 0xFF);
+			break;
+		case J_ROR:
+			LoadReg(RDX, R_CC);
+			a.AluRI(ALU_AND, RDX, FLAG_C);
+			a.Shift(SH_SHL, RDX, 7);
+			a.MovRR(RCX, RAX);
+			a.AluRI(ALU_AND, RCX, 0x01);
+			a.Shift(SH_SHR, RAX, 1);
+			a.AluRR(ALU_OR, RAX, RDX);
+			break;
+		case J_INC:
+		case J_DEC:
+			a.AluRI((kind == J_INC ? ALU_ADD : ALU_SUB), RAX, 1);
+			a.AluRI(ALU_AND, RAX, 0xFF);
+			SetNZ(RAX);
+			return;
+		}
+
+		AndCC(~FLAG_C);
+		OrCCR(RCX);
+		SetNZ(RAX);
+	}
+
+	// Call the opcode's handler (PC & the clock have to be right already)
+	void Handler(uint8_t opcode, uint16_t operand)
+	{
+		a.MovRR(RDI, RBX, OP_64);
+		a.MovRI(RSI, operand);
+		Call((const void *)help->handler[opcode]);
+	}
+
+	// Branches end blocks, and we know where both ways go
+	void Branch(const V65C02Inst * inst, uint16_t next, uint32_t n)
+	{
+		uint16_t target = next + (int8_t)inst->operand;
+		uint32_t taken = inst->cycles + 1 + ((next ^ target) & 0xFF00 ? 1 : 0);
+		int cc = CC_NZ;
+
+		switch (inst->opcode)
+		{
+		case 0x80:									// BRA
+			StorePC(target);
+			Exit(n, taken);
+			return;
+		case 0x10: case 0x30:						// BPL, BMI
+			a.Mem(0xF7, 0, RBX, -1, R_NZ, OP_16);
+			a.W(0x8080);
+			cc = (inst->opcode == 0x10 ? CC_Z : CC_NZ);
+			break;
+		case 0x50: case 0x70:						// BVC, BVS
+			a.Mem(0xF6, 0, RBX, -1, R_CC);
+			a.B(FLAG_V);
+			cc = (inst->opcode == 0x50 ? CC_Z : CC_NZ);
+			break;
+		case 0x90: case 0xB0:						// BCC, BCS
+			a.Mem(0xF6, 0, RBX, -1, R_CC);
+			a.B(FLAG_C);
+			cc = (inst->opcode == 0x90 ? CC_Z : CC_NZ);
+			break;
+		case 0xD0: case 0xF0:						// BNE, BEQ
+			a.Mem(0xF6, 0, RBX, -1, R_NZ);
+			a.B(0xFF);
+			cc = (inst->opcode == 0xD0 ? CC_NZ : CC_Z);
+			break;
+		}
+
+		uint8_t * go = a.Jcc(cc);
+		StorePC(next);
+		Exit(n, inst->cycles);
+		a.Land(go);
+		StorePC(target);
+		Exit(n, taken);
+	}
+
+	// Translate the nth instruction in the block; returns true if that's the
+	// end of it
+	bool Instruction(const V65C02Inst * inst, uint16_t next, uint32_t n)
+	{
+		uint8_t kind = opKind[inst->opcode];
+		uint8_t mode = opMode[inst->opcode];
+		uint16_t operand = inst->operand;
+		static const uint32_t regOffset[3] = { R_A, R_X, R_Y };
+		const Address stack = { true, 0 };			// (Address is in R14)
+
+		// Nothing here goes near the bus
+		switch (kind)
+		{
+		case J_BRANCH:
+			Branch(inst, next, n);
+			return true;
+		case J_JMP:
+			StorePC(operand);
+			Exit(n, inst->cycles);
+			return true;
+		case J_INX: case J_INY: case J_DEX: case J_DEY:
+		{
+			uint32_t reg = (kind == J_INX || kind == J_DEX ? R_X : R_Y);
+			LoadReg(RAX, reg);
+			a.AluRI((kind == J_INX || kind == J_INY ? ALU_ADD : ALU_SUB), RAX, 1);
+			a.AluRI(ALU_AND, RAX, 0xFF);
+			StoreReg(reg, RAX);
+			SetNZ(RAX);
+			pending += inst->cycles;
+			return false;
+		}
+		case J_TAX: case J_TAY: case J_TXA: case J_TYA: case J_TSX: case J_TXS:
+		{
+			static const uint32_t from[6] = { R_A, R_A, R_X, R_Y, R_SP, R_X };
+			static const uint32_t to[6] = { R_X, R_Y, R_A, R_A, R_X, R_SP };
+			LoadReg(RAX, from[kind - J_TAX]);
+			StoreReg(to[kind - J_TAX], RAX);
+
+			if (kind != J_TXS)
+				SetNZ(RAX);
+
+			pending += inst->cycles;
+			return false;
+		}
+		case J_CLC: AndCC(~FLAG_C); break;
+		case J_SEC: OrCC(FLAG_C); break;
+		case J_CLD: AndCC(~FLAG_D); break;
+		case J_SED: OrCC(FLAG_D); break;
+		case J_CLI: AndCC(~FLAG_I); break;
+		case J_SEI: OrCC(FLAG_I); break;
+		case J_CLV: AndCC(~FLAG_V); break;
+		case J_NOP: break;
+		default:
+			if (mode == M_ACC)
+			{
+				LoadReg(RAX, R_A);
+				Modify(kind);
+				StoreReg(R_A, RAX);
+				pending += inst->cycles;
+				return false;
+			}
+			else if ((mode == M_IMM) && (kind != J_ADC) && (kind != J_SBC))
+			{
+				a.MovRI(RAX, operand & 0xFF);
+				Operate(kind, mode);
+				pending += inst->cycles;
+				return false;
+			}
+
+			goto bus;
+		}
+
+		pending += inst->cycles;
+
+		if (kind == J_CLI)
+			LineCheck(n, next);
+
+		return false;
+
+bus:
+		// The rest can call out, so the clock & PC have to be where the
+		// handler would have had them
+		if (mode != M_IMM)
+			FlushClock();
+
+		StorePC(next);
+
+		switch (kind)
+		{
+		case J_CALL:
+		case J_FLOW:
+			Handler(inst->opcode, operand);
+			break;
+		case J_ADC:
+		case J_SBC:
+		{
+			// Decimal mode is left to the handler
+			a.Mem(0xF6, 0, RBX, -1, R_CC);
+			a.B(FLAG_D);
+			uint8_t * binary = a.Jcc(CC_Z);
+			Handler(inst->opcode, operand);
+			uint8_t * done = a.Jmp();
+			a.Land(binary);
+
+			if (mode == M_IMM)
+				a.MovRI(RAX, operand & 0xFF);
+			else
+				Read(EffectiveAddress(mode, operand, true));
+
+			Operate(kind, mode);
+			a.Land(done);
+			break;
+		}
+		case J_LDA: case J_LDX: case J_LDY: case J_AND: case J_ORA:
+		case J_EOR: case J_CMP: case J_CPX: case J_CPY: case J_BIT:
+			Read(EffectiveAddress(mode, operand, true));
+			Operate(kind, mode);
+			break;
+		case J_STA: case J_STX: case J_STY: case J_STZ:
+		{
+			Address ea = EffectiveAddress(mode, operand, false);
+
+			if (kind == J_STZ)
+				a.AluRR(ALU_XOR, RDX, RDX);
+			else
+				LoadReg(RDX, regOffset[kind - J_STA]);
+
+			Write(ea);
+			break;
+		}
+		case J_ASL: case J_LSR: case J_ROL: case J_ROR: case J_INC:
+		case J_DEC:
+		{
+			Address ea = EffectiveAddress(mode, operand, true);
+			Read(ea);
+			Modify(kind);
+			a.MovRR(RDX, RAX);
+			Write(ea);
+			break;
+		}
+		case J_PHA: case J_PHX: case J_PHY:
+			StackPush();
+			LoadReg(RDX, regOffset[kind - J_PHA]);
+			Write(stack);
+			break;
+		case J_PLA: case J_PLX: case J_PLY:
+			StackPull();
+			StoreReg(regOffset[kind - J_PLA], RAX);
+			SetNZ(RAX);
+			break;
+		case J_JSR:
+			// Pushes the return address - 1
+			StorePC(next - 1);
+			StackPush();
+			a.MovRI(RDX, (uint16_t)(next - 1) >> 8);
+			Write(stack);
+			StackPush();
+			a.MovRI(RDX, (next - 1) & 0xFF);
+			Write(stack);
+			StorePC(operand);
+			break;
+		case J_RTS:
+			StackPull();
+			a.Mem(0x89, RAX, RBX, -1, R_PC, OP_16);
+			StackPull();
+			a.Shift(SH_SHL, RAX, 8);
+			a.Mem(0x0FB7, RCX, RBX, -1, R_PC);
+			a.AluRR(ALU_OR, RAX, RCX);
+			a.AluRI(ALU_ADD, RAX, 1);
+			a.Mem(0x89, RAX, RBX, -1, R_PC, OP_16);
+			break;
+		}
+
+		pending += inst->cycles;
+
+		if ((kind == J_FLOW) || (kind == J_JSR) || (kind == J_RTS))
+		{
+			Exit(n);
+			return true;
+		}
+
+		StopCheck(n);
+
+		if (inst->opcode == 0x28)					// PLP
+			LineCheck(n, next);
+
+		return false;
+	}
+};
+
+
+//
+// Get an arena to put translated code in
+//
+bool V65C02JitInit(V65C02BlockCache * cache)
+{
+	if (cache->jitCode)
+		return true;
+
+	// The arena is never writable & executable at the same time: it stays
+	// read/execute, and only the pages a block is going into get opened up
+	// while it's being put there (see V65C02JitTranslate()).
+	void * code = mmap(0, V65C02_JIT_ARENA, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (code == MAP_FAILED)
+	{
+		WriteLog("V65C02: Couldn't get memory for translated code!\n");
+		return false;
+	}
+
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (page > 0)
+		pageSize = (uintptr_t)page;
+
+	cache->jitCode = (uint8_t *)code;
+	cache->jitUsed = 0;
+
+	if (!SetArena(cache, 0, V65C02_JIT_ARENA, PROT_READ | PROT_EXEC))
+		return false;
+
+	if (!opsReady)
+	{
+		for(size_t i=0; i<sizeof(jitOps)/sizeof(jitOps[0]); i++)
+		{
+			opKind[jitOps[i].opcode] = jitOps[i].kind;
+			opMode[jitOps[i].opcode] = jitOps[i].mode;
+		}
+
+		opsReady = true;
+	}
+
+	return true;
+}
+
+
+//
+// Translate a block; returns its host code (see V65C02JitCode), or NULL if it
+// can't be done. When the arena fills up, everything in it gets thrown away.
+//
+void * V65C02JitTranslate(V65C02BlockCache * cache, V65C02Block * block, const V65C02PageMap * map, const V65C02JitHelpers * help)
+{
+	// Worst case is a bit over 600 bytes per instruction (ADC (zp),Y with
+	// every read noted)
+	const uint32_t room = (V65C02_BLOCK_MAX + 1) * 1024;
+
+	if (!cache->jitCode || !map)
+		return 0;
+
+	if ((V65C02_JIT_ARENA - cache->jitUsed) < room)
+	{
+		for(int i=0; i<V65C02_BLOCK_CACHE_SIZE; i++)
+		{
+			cache->block[i].host = 0;
+
+			if (cache->block[i].runs != V65C02_JIT_NEVER)
+				cache->block[i].runs = 0;
+		}
+
+		cache->jitUsed = 0;
+	}
+
+	if (!SetArena(cache, cache->jitUsed, room, PROT_READ | PROT_WRITE))
+		return 0;
+
+	Translator t;
+	uint8_t * start = cache->jitCode + cache->jitUsed;
+	t.a.p = start;
+	t.map = map;
+	t.help = help;
+	t.pending = 0;
+	t.Prologue();
+	uint16_t pc = block->pc;
+	bool done = false;
+
+	for(int i=0; (i<block->count) && !done; i++)
+	{
+		pc += block->inst[i].length;
+		done = t.Instruction(&block->inst[i], pc, i + 1);
+	}
+
+	if (!done)
+	{
+		t.FlushClock();
+		t.StorePC(pc);
+		t.Exit(block->count);
+	}
+
+	uint32_t offset = cache->jitUsed;
+	cache->jitUsed += (uint32_t)(t.a.p - start);
+	cache->jitUsed = (cache->jitUsed + 15) & ~15;
+
+	if (!SetArena(cache, offset, room, PROT_READ | PROT_EXEC))
+		return 0;
+
+	return start;
+}
+
+
+//
+// Change the protection of the arena's pages that [offset, offset + size)
+// touches. If that can't be done, the arena goes away & the core goes back to
+// the block cache, same as when there's no arena to begin with.
+//
+static bool SetArena(V65C02BlockCache * cache, uint32_t offset, uint32_t size, int prot)
+{
+	uintptr_t base = (uintptr_t)cache->jitCode;
+	uintptr_t first = (base + offset) & ~(pageSize - 1);
+	uintptr_t last = (base + offset + size + pageSize - 1) & ~(pageSize - 1);
+
+	if (last > base + V65C02_JIT_ARENA)
+		last = base + V65C02_JIT_ARENA;
+
+	if (mprotect((void *)first, last - first, prot) == 0)
+		return true;
+
+	WriteLog("V65C02: Couldn't change the protection of translated code, using the block cache instead.\n");
+	munmap(cache->jitCode, V65C02_JIT_ARENA);
+
+	for(int i=0; i<V65C02_BLOCK_CACHE_SIZE; i++)
+		cache->block[i].host = 0;
+
+	cache->jitCode = 0;
+	cache->jitUsed = 0;
+
+	if (cache->mode >= V65C02_MODE_JIT)
+		cache->mode = V65C02_MODE_CACHED;
+
+	return false;
+}
+
+#else
+
+//
+// No translator for this host; the core sticks to the block cache
+//
+bool V65C02JitInit(V65C02BlockCache *)
+{
+	WriteLog("V65C02: No block translator for this host.\n");
+	return false;
+}
+
+
+void * V65C02JitTranslate(V65C02BlockCache *, V65C02Block *, const V65C02PageMap *, const V65C02JitHelpers *)
+{
+	return 0;
+}
+
+#endif
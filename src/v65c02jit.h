@@ -0,0 +1,33 @@
+//
+// v65c02jit.h: Translates 65C02 blocks into x86-64 code
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __V65C02JIT_H__
+#define __V65C02JIT_H__
+
+#include <stdint.h>
+#include "v65c02.h"
+
+// What translated code calls back into for anything it doesn't do itself
+struct V65C02JitHelpers
+{
+	uint8_t (* read)(V65C02REGS *, uint16_t);			// Bus::Read()
+	void (* write)(V65C02REGS *, uint16_t, uint8_t);	// Bus::Write()
+	uint8_t (* note)(V65C02REGS *, uint16_t, uint8_t);	// Sees every read the
+														// page map satisfied
+														// (NULL for none)
+	void (* const * handler)(V65C02REGS *, uint16_t);	// exec_op[]
+};
+
+// Runs the block, returns the # of instructions it got through
+typedef uint32_t (* V65C02JitCode)(V65C02REGS *, V65C02BlockCache *);
+
+// Exported functions
+
+bool V65C02JitInit(V65C02BlockCache *);
+void * V65C02JitTranslate(V65C02BlockCache *, V65C02Block *, const V65C02PageMap *, const V65C02JitHelpers *);
+
+#endif	// __V65C02JIT_H__
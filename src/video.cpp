@@ -28,14 +28,17 @@
 
 #include <string.h>					// for memset()
 #include <stdio.h>
-#include <stdarg.h>					// for va_* stuff
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VIDEO_AVX2							// See SetupBlurTable()
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "apple2.h"
-#include "apple2-icon-64x64.h"
 #include "charset.h"
 #include "log.h"
-#include "settings.h"
-#include "gui/font14pt.h"
-#include "gui/gui.h"
+#include "machine.h"
+#include "mmu.h"
 
 /* Reference: Technote tn-iigs-063 "Master Color Values"
 
@@ -63,24 +66,9 @@
 
    N.B.: These colors look like shit */
 
-// Global variables
-
-bool flash = false;
-bool textMode = true;
-bool mixedMode = false;
-bool displayPage2 = false;
-bool hiRes = false;
-bool alternateCharset = false;
-bool col80Mode = false;
-SDL_Renderer * sdlRenderer = NULL;
-SDL_Window * sdlWindow = NULL;
-
 // Local variables
 
-static SDL_Texture * sdlTexture = NULL;
 static uint32_t * scrBuffer;
-static int scrPitch;
-static bool showFrameTicks = false;
 
 // We set up the colors this way so that they'll be endian safe
 // when we cast them to a uint32_t. Note that the format is RGBA.
@@ -327,17 +315,95 @@ static uint32_t * palette = (uint32_t *)altColors;
 enum { ST_FIRST_ENTRY = 0, ST_COLOR_TV = 0, ST_WHITE_MONO, ST_GREEN_MONO, ST_LAST_ENTRY };
 static uint8_t screenType = ST_COLOR_TV;
 
+// Wide lookup tables for the graphics modes, which all boil down to rows of
+// dots (see ExpandDots()): the 4 pixels a color TV shows for each group of 4
+// dots & the 3 dots before it, and the 8 pixels a monitor shows for 8 dots.
+// They hold the actual pixels, so they get rebuilt whenever the palette or
+// screen type changes (see SetupPixelTables()).
+static uint32_t colorQuad[0x80][4];
+static uint32_t monoOctet[0x100][8];
+static uint32_t * tablePalette = NULL;
+static uint8_t tableScreenType = 0xFF;
+
+// Every row of every glyph the text modes can show, ready to copy to the
+// screen (see SetupGlyphCache()); only changes with the screen type
+#define GLYPHS		0x180
+static uint32_t glyph40[GLYPHS][8][14];
+static uint32_t glyph80[GLYPHS][8][7];
+static uint8_t glyphScreenType = 0xFF;
+
+// What the last frame was drawn with (see RenderVideoFrame()); each line
+// remembers the switches & screen type it was drawn in
+static uint32_t lineMode[VIRTUAL_SCREEN_HEIGHT / 2];
+static uint32_t * lastPalette = NULL;
+static bool lastFlash = false;
+static bool redrawAll;					// Ignore what changed, redraw it all
+static bool flashChanged;				// Flashing characters have to be redrawn
+static uint8_t lineRedrawn[VIRTUAL_SCREEN_HEIGHT / 2];
+static uint8_t lineBehind[VIRTUAL_SCREEN_HEIGHT / 2];	// Shows what RAM had before
+
+// The machine as of the frame being drawn (see VideoSnapshot in mmu.h);
+// RenderVideoFrame() takes its own
+static const VideoSnapshot * snapshot;
+static VideoSnapshot liveSnapshot;
+
+// The screen as the beam saw it when it drew the line being rendered: the
+// display switches, and display memory with whatever was changed after that
+// wound back out of it (see WindBack()). Only the 128 byte blocks something
+// got wound back in are copied to the shadow; everything else is read
+// straight out of the snapshot (see ScreenMemory()).
+static uint8_t switches;
+static uint8_t shadow[2][0x6000];
+static uint8_t shadowed[2][VIDEO_BLOCKS];
+static bool anyShadowed = false;
+static uint64_t unwound;				// Changes from here on are undone
+
+// How many changes in the log since the last frame land in each block, less
+// the ones that have been wound back (see WindBack())
+static uint64_t renderedTo = 0;			// Changes up to here were drawn
+static uint64_t countedFrom;
+static uint16_t changes[2][VIDEO_BLOCKS];
+
+// The 8 (or 4) scanlines of a row of text (or lo-res blocks) all come from
+// the same bytes, so the last row worked out gets kept: the glyphs of a row
+// of text, or where a row of lo-res dots was expanded to in the buffer
+enum { ROW_TEXT40 = 0x100, ROW_TEXT80 = 0x200, ROW_LORES = 0x300, ROW_DLORES = 0x400 };
+static uint32_t cachedRow = 0;			// ROW_* | row (0 = nothing cached)
+static uint32_t rowGlyph[80];
+static uint32_t * rowPixels;
+
 // Local functions
 
-static void Render40ColumnTextLine(uint8_t line);
-static void Render80ColumnTextLine(uint8_t line);
-static void Render40ColumnText(void);
-static void Render80ColumnText(void);
-static void RenderLoRes(uint16_t toLine = 24);
-static void RenderDLoRes(uint16_t toLine = 24);
-static void RenderHiRes(uint16_t toLine = 192);
-static void RenderDHiRes(uint16_t toLine = 192);
-static void RenderVideoFrame(/*uint32_t *, int*/);
+static void SetupGlyphCache(void);
+static inline uint32_t Glyph(uint8_t chr);
+static void Render40ColumnText(uint8_t y);
+static void Render80ColumnText(uint8_t y);
+static void RenderLoRes(uint8_t y);
+static void RenderDLoRes(uint8_t y);
+static void RenderHiRes(uint8_t y);
+static void RenderDHiRes(uint8_t y);
+static void RenderScanline(uint8_t y);
+static void SetupPixelTables(void);
+static inline void Copy4(uint32_t * dst, const uint32_t * src);
+static inline void Copy8(uint32_t * dst, const uint32_t * src);
+static void CopyRow(uint32_t * dst, const uint32_t * src);
+static void ExpandMono(uint32_t * dst, const uint32_t * dots);
+#ifdef VIDEO_AVX2
+static void CopyRowAVX2(uint32_t * dst, const uint32_t * src);
+static void ExpandMonoAVX2(uint32_t * dst, const uint32_t * dots);
+#endif
+static inline void BlankRow(uint32_t * dst);
+static void ExpandDots(uint32_t * dst, const uint32_t * dots, uint32_t delay);
+static inline bool LineStale(uint16_t address, bool aux, uint8_t y, bool force = false);
+static bool LineFlashes(const uint8_t * chars);
+static inline const uint8_t * ScreenMemory(uint16_t address, uint8_t aux);
+static void WindBack(uint64_t clock);
+
+// The row copiers, as wide as the host can do them (see SetupBlurTable()),
+// and a row for BlankRow() to copy
+static void (* copyRow)(uint32_t * dst, const uint32_t * src) = CopyRow;
+static void (* expandMono)(uint32_t * dst, const uint32_t * dots) = ExpandMono;
+static uint32_t blackRow[VIRTUAL_SCREEN_WIDTH];
 
 
 void SetupBlurTable(void)
@@ -377,6 +443,19 @@ void SetupBlurTable(void)
 			| ((i & 0x40) >> 5)
 			| ((i & 0x80) >> 7);
 	}
+
+	// The pixel tables are built from this one
+	tablePalette = NULL;
+
+	// Builds don't assume AVX2 is there (most don't pass -mavx2), so the
+	// 32 byte versions get picked here if the CPU has it
+#ifdef VIDEO_AVX2
+	if (__builtin_cpu_supports("avx2"))
+	{
+		copyRow = CopyRowAVX2;
+		expandMono = ExpandMonoAVX2;
+	}
+#endif
 }
 
 
@@ -418,289 +497,269 @@ void CycleScreenTypes(void)
 }
 
 
-void ToggleTickDisplay(void)
+//
+// Draw every glyph the text modes can show, a row at a time, in the color the
+// screen type in use shows text in, both doubled (for 40 columns) & not (for
+// 80). The first 256 are straight out of the character ROM; after them come
+// the normal character set's flashing characters, steady & then inverted (see
+// Glyph()).
+//
+static void SetupGlyphCache(void)
 {
-	showFrameTicks = !showFrameTicks;
-}
-
-
-static uint32_t msgTicks = 0;
-static char message[4096];
+	uint32_t pixelOn = (screenType == ST_GREEN_MONO ? 0xFF61FF61 : 0xFFFFFFFF);
 
-void SpawnMessage(const char * text, ...)
-{
-	va_list arg;
+	for(uint32_t glyph=0; glyph<GLYPHS; glyph++)
+	{
+		uint32_t chr = (glyph < 0x100 ? glyph : glyph & 0x3F);
+		bool inverse = (glyph >= 0x140);
 
-	va_start(arg, text);
-	vsprintf(message, text, arg);
-	va_end(arg);
+		for(uint32_t cy=0; cy<8; cy++)
+		{
+			for(uint32_t cx=0; cx<7; cx++)
+			{
+				bool on = (textChar2e[(chr * 56) + cx + (cy * 7)] != 0) ^ inverse;
+				uint32_t pixel = (on ? pixelOn : 0xFF000000);
+				glyph40[glyph][cy][(cx * 2) + 0] = pixel;
+				glyph40[glyph][cy][(cx * 2) + 1] = pixel;
+				glyph80[glyph][cy][cx] = pixel;
+			}
+		}
+	}
 
-	msgTicks = 120;
-//WriteLog("\n%s\n", message);
+	glyphScreenType = screenType;
 }
 
 
-static void DrawString2(uint32_t x, uint32_t y, uint32_t color, char * msg);
-static void DrawString(void)
+//
+// Which of the cached glyphs a character is showing as right now
+//
+static inline uint32_t Glyph(uint8_t chr)
 {
-//This approach works, and seems to be fast enough... Though it probably would
-//be better to make the oversized font to match this one...
-	for(uint32_t x=7; x<=9; x++)
-		for(uint32_t y=7; y<=9; y++)
-			DrawString2(x, y, 0x00000000, message);
+	if ((switches & VS_ALTCHAR) || ((chr & 0xC0) != 0x40))
+		return chr;
 
-	DrawString2(8, 8, 0x0020FF20, message);
+	return 0x100 + (flash ? 0x40 : 0x00) + (chr & 0x3F);
 }
 
 
-static void DrawString(uint32_t x, uint32_t y, uint32_t color, char * msg)
+//
+// Draw scanline y of the 40 column text screen (which is also what the mixed
+// modes show at the bottom)
+//
+static void Render40ColumnText(uint8_t y)
 {
-//This approach works, and seems to be fast enough... Though it probably would
-//be better to make the oversized font to match this one...
-	for(uint32_t xx=x-1; xx<=x+1; xx++)
-		for(uint32_t yy=y-1; yy<=y+1; yy++)
-			DrawString2(xx, yy, 0x00000000, msg);
+	uint8_t line = y >> 3;
+	uint16_t address = lineAddrLoRes[line] + (switches & VS_PAGE2 ? 0x0400 : 0x0000);
+	const uint8_t * chars = ScreenMemory(address, 0);
+	bool flashing = flashChanged && LineFlashes(chars);
 
-	DrawString2(x, y, color, msg);
-}
+	if (!LineStale(address, false, y, flashing))
+		return;
 
+	if (cachedRow != (ROW_TEXT40 | line))
+	{
+		for(int x=0; x<40; x++)
+			rowGlyph[x] = Glyph(chars[x]);
 
-static void DrawString2(uint32_t x, uint32_t y, uint32_t color, char * msg)
-{
-	uint32_t length = strlen(msg), address = x + (y * VIRTUAL_SCREEN_WIDTH);
-	uint8_t nBlue = (color >> 16) & 0xFF, nGreen = (color >> 8) & 0xFF, nRed = color & 0xFF;
+		cachedRow = ROW_TEXT40 | line;
+	}
 
-	for(uint32_t i=0; i<length; i++)
-	{
-		uint8_t c = msg[i];
-		c = (c < 32 ? 0 : c - 32);
-		uint32_t fontAddr = (uint32_t)c * FONT_WIDTH * FONT_HEIGHT;
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
 
-		for(uint32_t yy=0; yy<FONT_HEIGHT; yy++)
-		{
-			for(uint32_t xx=0; xx<FONT_WIDTH; xx++)
-			{
-				uint8_t trans = font2[fontAddr++];
+	for(int x=0; x<40; x++)
+		memcpy(row + (x * 14), glyph40[rowGlyph[x]][y & 0x07], sizeof(glyph40[0][0]));
 
-				if (trans)
-				{
-					uint32_t existingColor = *(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH));
+	// QnD method to get blank alternate lines in text mode
+	if (screenType == ST_GREEN_MONO)
+		BlankRow(row + VIRTUAL_SCREEN_WIDTH);
+	else
+		(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
+}
 
-					uint8_t eBlue = (existingColor >> 16) & 0xFF,
-						eGreen = (existingColor >> 8) & 0xFF,
-						eRed = existingColor & 0xFF;
 
-//This could be sped up by using a table of 5 + 5 + 5 bits (32 levels transparency -> 32768 entries)
-//Here we've modified it to have 33 levels of transparency (could have any # we want!)
-//because dividing by 32 is faster than dividing by 31...!
-					uint8_t invTrans = 255 - trans;
+static void Render80ColumnText(uint8_t y)
+{
+	uint8_t line = y >> 3;
+	uint16_t address = lineAddrLoRes[line];
+	const uint8_t * mainChars = ScreenMemory(address, 0);
+	const uint8_t * auxChars = ScreenMemory(address, 1);
+	bool flashing = flashChanged
+		&& (LineFlashes(mainChars) || LineFlashes(auxChars));
 
-					uint32_t bRed   = (eRed   * invTrans + nRed   * trans) / 255;
-					uint32_t bGreen = (eGreen * invTrans + nGreen * trans) / 255;
-					uint32_t bBlue  = (eBlue  * invTrans + nBlue  * trans) / 255;
+	if (!LineStale(address, true, y, flashing))
+		return;
 
-//THIS IS NOT ENDIAN SAFE
-//NB: Setting the alpha channel here does nothing.
-					*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = 0x7F000000 | (bBlue << 16) | (bGreen << 8) | bRed;
-				}
-			}
-		}
+	if (cachedRow != (ROW_TEXT80 | line))
+	{
+		// Aux memory has the even columns, main the odd ones
+		for(int x=0; x<80; x++)
+			rowGlyph[x] = Glyph(x & 0x01 ? mainChars[x >> 1] : auxChars[x >> 1]);
 
-		address += FONT_WIDTH;
+		cachedRow = ROW_TEXT80 | line;
 	}
+
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
+
+	for(int x=0; x<80; x++)
+		memcpy(row + (x * 7), glyph80[rowGlyph[x]][y & 0x07], sizeof(glyph80[0][0]));
+
+	// QnD method to get blank alternate lines in text mode
+	if (screenType == ST_GREEN_MONO)
+		BlankRow(row + VIRTUAL_SCREEN_WIDTH);
+	else
+		(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
 }
 
 
-static void DrawFrameTicks(void)
+//
+// Build the wide lookup tables (see colorQuad[]) for the palette & screen
+// type in use
+//
+static void SetupPixelTables(void)
 {
-	uint32_t color = 0x00FF2020;
-	uint32_t address = 8 + (24 * VIRTUAL_SCREEN_WIDTH);
+	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? 0xFFFFFFFF : 0xFF61FF61);
 
-	for(uint32_t i=0; i<17; i++)
+	for(uint32_t bitPat=0; bitPat<0x80; bitPat++)
 	{
-		for(uint32_t yy=0; yy<5; yy++)
-		{
-			for(uint32_t xx=0; xx<9; xx++)
-			{
-//THIS IS NOT ENDIAN SAFE
-//NB: Setting the alpha channel here does nothing.
-				*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = 0x7F000000;
-			}
-		}
+		for(uint32_t j=0; j<4; j++)
+			colorQuad[bitPat][j] = palette[blurTable[bitPat][j]];
+	}
 
-		address += (5 * VIRTUAL_SCREEN_WIDTH);
+	for(uint32_t dots=0; dots<0x100; dots++)
+	{
+		for(uint32_t j=0; j<8; j++)
+			monoOctet[dots][j] = (dots & (0x80 >> j) ? pixelOn : 0xFF000000);
 	}
 
-	address = 8 + (24 * VIRTUAL_SCREEN_WIDTH);
+	for(uint32_t x=0; x<VIRTUAL_SCREEN_WIDTH; x++)
+		blackRow[x] = 0xFF000000;
 
-	// frameTicks is the amount of time remaining; so to show the amount
-	// consumed, we subtract it from 17.
-	uint32_t bars = 17 - frameTicks;
+	tablePalette = palette;
+	tableScreenType = screenType;
+}
 
-	if (bars & 0x80000000)
-		bars = 0;
 
-	for(uint32_t i=0; i<17; i++)
-	{
-		for(uint32_t yy=1; yy<4; yy++)
-		{
-			for(uint32_t xx=1; xx<8; xx++)
-			{
-//THIS IS NOT ENDIAN SAFE
-//NB: Setting the alpha channel here does nothing.
-				*(scrBuffer + address + xx + (yy * VIRTUAL_SCREEN_WIDTH)) = (i < bars ? color : 0x003F0000);
-			}
-		}
+//
+// Copy 4 or 8 pixels, 16 bytes at a time (the AVX2 versions of the functions
+// that use these do 32)
+//
+static inline void Copy4(uint32_t * dst, const uint32_t * src)
+{
+#if defined(__SSE2__)
+	_mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+#else
+	memcpy(dst, src, 4 * sizeof(uint32_t));
+#endif
+}
 
-		address += (5 * VIRTUAL_SCREEN_WIDTH);
-	}
 
-	static char msg[32];
+static inline void Copy8(uint32_t * dst, const uint32_t * src)
+{
+	Copy4(dst, src);
+	Copy4(dst + 4, src + 4);
+}
 
-	if ((frameTimePtr % 15) == 0)
-	{
-//		uint32_t prevClock = (frameTimePtr + 1) % 60;
-		uint64_t prevClock = (frameTimePtr + 1) % 60;
-//		float fps = 59.0f / (((float)frameTime[frameTimePtr] - (float)frameTime[prevClock]) / 1000.0f);
-		double fps = 59.0 / ((double)(frameTime[frameTimePtr] - frameTime[prevClock]) / (double)SDL_GetPerformanceFrequency());
-		sprintf(msg, "%.1lf FPS", fps);
-	}
 
-	DrawString(20, 24, color, msg);
+//
+// Double a line: copy a finished row of the buffer to the one (or ones) below
+// it
+//
+static void CopyRow(uint32_t * dst, const uint32_t * src)
+{
+	for(uint32_t x=0; x<VIRTUAL_SCREEN_WIDTH; x+=8)
+		Copy8(dst + x, src + x);
 }
 
 
-static void Render40ColumnTextLine(uint8_t line)
+//
+// Turn a row of dots into pixels on a monitor (see ExpandDots())
+//
+static void ExpandMono(uint32_t * dst, const uint32_t * dots)
 {
-	uint32_t pixelOn = (screenType == ST_GREEN_MONO ? 0xFF61FF61 : 0xFFFFFFFF);
-
-	for(int x=0; x<40; x++)
+	for(uint32_t x=0; x<20; x++, dst+=28)
 	{
-		uint8_t chr = ram[lineAddrLoRes[line] + (displayPage2 ? 0x0400 : 0x0000) + x];
-
-		// Render character at (x, y)
-
-		for(int cy=0; cy<8; cy++)
-		{
-			for(int cx=0; cx<7; cx++)
-			{
-				uint32_t pixel = 0xFF000000;
-
-				if (alternateCharset)
-				{
-					if (textChar2e[(chr * 56) + cx + (cy * 7)])
-						pixel = pixelOn;
-				}
-				else
-				{
-					if ((chr & 0xC0) == 0x40)
-					{
-						if (textChar2e[((chr & 0x3F) * 56) + cx + (cy * 7)])
-							pixel = pixelOn;
-
-						if (flash)
-							pixel = pixel ^ (screenType == ST_GREEN_MONO ? 0x0061FF61 : 0x00FFFFFF);
-					}
-					else
-					{
-						if (textChar2e[(chr * 56) + cx + (cy * 7)])
-							pixel = pixelOn;
-					}
-				}
-
-				scrBuffer[(x * 7 * 2) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + (cx * 2) + 0 + (cy * VIRTUAL_SCREEN_WIDTH * 2)] = pixel;
-				scrBuffer[(x * 7 * 2) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + (cx * 2) + 1 + (cy * VIRTUAL_SCREEN_WIDTH * 2)] = pixel;
-
-				// QnD method to get blank alternate lines in text mode
-				if (screenType == ST_GREEN_MONO)
-					pixel = 0xFF000000;
-
-				{
-					scrBuffer[(x * 7 * 2) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + (cx * 2) + 0 + (((cy * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = pixel;
-					scrBuffer[(x * 7 * 2) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + (cx * 2) + 1 + (((cy * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = pixel;
-				}
-			}
-		}
+		uint32_t word = dots[x];
+		Copy8(dst + 0, monoOctet[(word >> 20) & 0xFF]);
+		Copy8(dst + 8, monoOctet[(word >> 12) & 0xFF]);
+		Copy8(dst + 16, monoOctet[(word >> 4) & 0xFF]);
+		Copy4(dst + 24, monoOctet[(word << 4) & 0xF0]);
 	}
 }
 
 
-static void Render80ColumnTextLine(uint8_t line)
+#ifdef VIDEO_AVX2
+__attribute__((target("avx2")))
+static inline void Copy8AVX2(uint32_t * dst, const uint32_t * src)
 {
-	uint32_t pixelOn = (screenType == ST_GREEN_MONO ? 0xFF61FF61 : 0xFFFFFFFF);
+	_mm256_storeu_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+}
 
-	for(int x=0; x<80; x++)
-	{
-		uint8_t chr;
 
-		if (x & 0x01)
-			chr = ram[lineAddrLoRes[line] + (x >> 1)];
-		else
-			chr = ram2[lineAddrLoRes[line] + (x >> 1)];
+__attribute__((target("avx2")))
+static void CopyRowAVX2(uint32_t * dst, const uint32_t * src)
+{
+	for(uint32_t x=0; x<VIRTUAL_SCREEN_WIDTH; x+=8)
+		Copy8AVX2(dst + x, src + x);
+}
 
-		// Render character at (x, y)
 
-		for(int cy=0; cy<8; cy++)
-		{
-			for(int cx=0; cx<7; cx++)
-			{
-				uint32_t pixel = 0xFF000000;
-
-				if (alternateCharset)
-				{
-					if (textChar2e[(chr * 56) + cx + (cy * 7)])
-						pixel = pixelOn;
-				}
-				else
-				{
-					if ((chr & 0xC0) == 0x40)
-					{
-						if (textChar2e[((chr & 0x3F) * 56) + cx + (cy * 7)])
-							pixel = pixelOn;
-
-						if (flash)
-							pixel = pixel ^ (screenType == ST_GREEN_MONO ? 0x0061FF61 : 0x00FFFFFF);
-					}
-					else
-					{
-						if (textChar2e[(chr * 56) + cx + (cy * 7)])
-							pixel = pixelOn;
-					}
-				}
-
-				scrBuffer[(x * 7) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + cx + (cy * 2 * VIRTUAL_SCREEN_WIDTH)] = pixel;
-
-				// QnD method to get blank alternate lines in text mode
-				if (screenType == ST_GREEN_MONO)
-					pixel = 0xFF000000;
-
-				scrBuffer[(x * 7) + (line * VIRTUAL_SCREEN_WIDTH * 8 * 2) + cx + (((cy * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = pixel;
-			}
-		}
+__attribute__((target("avx2")))
+static void ExpandMonoAVX2(uint32_t * dst, const uint32_t * dots)
+{
+	for(uint32_t x=0; x<20; x++, dst+=28)
+	{
+		uint32_t word = dots[x];
+		Copy8AVX2(dst + 0, monoOctet[(word >> 20) & 0xFF]);
+		Copy8AVX2(dst + 8, monoOctet[(word >> 12) & 0xFF]);
+		Copy8AVX2(dst + 16, monoOctet[(word >> 4) & 0xFF]);
+		_mm_storeu_si128((__m128i *)(dst + 24),
+			_mm_loadu_si128((const __m128i *)monoOctet[(word << 4) & 0xF0]));
 	}
 }
+#endif
 
 
-static void Render40ColumnText(void)
+//
+// Green monochrome leaves every other row of the graphics modes black
+//
+static inline void BlankRow(uint32_t * dst)
 {
-	for(uint8_t line=0; line<24; line++)
-		Render40ColumnTextLine(line);
+	(*copyRow)(dst, blackRow);
 }
 
 
-static void Render80ColumnText(void)
+//
+// Turn one row's worth of dots (20 words of 28, first dot in bit 27 of the
+// first one) into 560 pixels. On a monitor, that's just the dots; on a color
+// TV, each group of 4 dots gets its colors from the 4 dots & the 3 before
+// them. Double hi-res is one dot behind everything else, so it passes a delay
+// of 1.
+//
+static void ExpandDots(uint32_t * dst, const uint32_t * dots, uint32_t delay)
 {
-	for(uint8_t line=0; line<24; line++)
-		Render80ColumnTextLine(line);
+	if (screenType != ST_COLOR_TV)
+	{
+		(*expandMono)(dst, dots);
+		return;
+	}
+
+	uint32_t previous = 0;
+
+	for(uint32_t x=0; x<20; x++, dst+=28)
+	{
+		uint32_t word = (previous << 28) | dots[x];
+		uint32_t shift = 24 + delay;
+
+		for(uint32_t i=0; i<7; i++, shift-=4)
+			Copy4(dst + (i * 4), colorQuad[(word >> shift) & 0x7F]);
+
+		previous = dots[x] & 0x0F;
+	}
 }
 
 
-static void RenderLoRes(uint16_t toLine/*= 24*/)
+static void RenderLoRes(uint8_t y)
 {
-// NOTE: The green mono rendering doesn't skip every other line... !!! FIX !!!
-//       Also, we could set up three different Render functions depending on
-//       which render type was set and call it with a function pointer. Would
-//       be faster than the nested ifs we have now.
 /*
 Note that these colors correspond to the bit patterns generated by the numbers 0-F in order:
 Color #s correspond to the bit patterns in reverse... Interesting!
@@ -723,133 +782,49 @@ be ae fb ->  7 [1110] -> 7?		LIGHT BLUE (CYAN)
 fb fb fb -> 15 [1111] -> 15		WHITE
 */
 	uint8_t mirrorNybble[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+	uint32_t dots[20];
+	uint8_t line = y >> 3;
+	uint16_t address = lineAddrLoRes[line] + (switches & VS_PAGE2 ? 0x0400 : 0x0000);
 
-	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? 0xFFFFFFFF : 0xFF61FF61);
+	if (!LineStale(address, false, y))
+		return;
 
-	for(uint16_t y=0; y<toLine; y++)
-	{
-		// Do top half of lores screen bytes...
+	// NOTE: The green mono rendering doesn't skip every other line...
+	//       !!! FIX !!!
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
+	// Top half of the blocks is the low nybbles, bottom half the high
+	uint32_t half = (y >> 2) & 0x01;
 
-		uint32_t previous3Bits = 0;
+	if (cachedRow == (ROW_LORES | (line * 2) | half))
+		(*copyRow)(row, rowPixels);
+	else
+	{
+		const uint8_t * bytes = ScreenMemory(address, 0);
 
 		for(uint16_t x=0; x<40; x+=2)
 		{
-			uint8_t scrByte1 = ram[lineAddrLoRes[y] + (displayPage2 ? 0x0400 : 0x0000) + x + 0] & 0x0F;
-			uint8_t scrByte2 = ram[lineAddrLoRes[y] + (displayPage2 ? 0x0400 : 0x0000) + x + 1] & 0x0F;
-			scrByte1 = mirrorNybble[scrByte1];
-			scrByte2 = mirrorNybble[scrByte2];
+			uint8_t scrByte1 = mirrorNybble[(bytes[x + 0] >> (half * 4)) & 0x0F];
+			uint8_t scrByte2 = mirrorNybble[(bytes[x + 1] >> (half * 4)) & 0x0F];
 			// This is just a guess, but it'll have to do for now...
-			uint32_t pixels = previous3Bits | (scrByte1 << 24) | (scrByte1 << 20) | (scrByte1 << 16)
+			dots[x >> 1] = (scrByte1 << 24) | (scrByte1 << 20) | (scrByte1 << 16)
 				| ((scrByte1 & 0x0C) << 12) | ((scrByte2 & 0x03) << 12)
 				| (scrByte2 << 8) | (scrByte2 << 4) | scrByte2;
-
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 11|11 1111 1111 1111
-			// 31   27   23   19   15    11   7    3  0
-
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0x7F000000) >> 24;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
-						uint8_t color = blurTable[bitPat][j];
-
-						for(uint32_t cy=0; cy<8; cy++)
-						{
-							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-//							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-						}
-					}
-				}
-
-				previous3Bits = pixels & 0x70000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					for(uint32_t cy=0; cy<8; cy++)
-					{
-						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-//						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					}
-
-					pixels <<= 1;
-				}
-			}
 		}
 
-		// Now do bottom half...
-
-		previous3Bits = 0;
-
-		for(uint16_t x=0; x<40; x+=2)
-		{
-			uint8_t scrByte1 = ram[lineAddrLoRes[y] + (displayPage2 ? 0x0400 : 0x0000) + x + 0] >> 4;
-			uint8_t scrByte2 = ram[lineAddrLoRes[y] + (displayPage2 ? 0x0400 : 0x0000) + x + 1] >> 4;
-			scrByte1 = mirrorNybble[scrByte1];
-			scrByte2 = mirrorNybble[scrByte2];
-			// This is just a guess, but it'll have to do for now...
-			uint32_t pixels = previous3Bits | (scrByte1 << 24) | (scrByte1 << 20) | (scrByte1 << 16)
-				| ((scrByte1 & 0x0C) << 12) | ((scrByte2 & 0x03) << 12)
-				| (scrByte2 << 8) | (scrByte2 << 4) | scrByte2;
-
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 11|11 1111 1111 1111
-			// 31   27   23   19   15    11   7    3  0
-
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0x7F000000) >> 24;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
-						uint8_t color = blurTable[bitPat][j];
-
-						for(uint32_t cy=8; cy<16; cy++)
-						{
-							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-//							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-						}
-					}
-				}
-
-				previous3Bits = pixels & 0x70000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					for(uint32_t cy=8; cy<16; cy++)
-					{
-						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-//						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					}
-
-					pixels <<= 1;
-				}
-			}
-		}
+		ExpandDots(row, dots, 0);
+		cachedRow = ROW_LORES | (line * 2) | half;
+		rowPixels = row;
 	}
+
+	(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
 }
 
 
 //
 // Render the Double Lo Res screen (HIRES off, DHIRES on)
 //
-static void RenderDLoRes(uint16_t toLine/*= 24*/)
+static void RenderDLoRes(uint8_t y)
 {
-// NOTE: The green mono rendering doesn't skip every other line... !!! FIX !!!
-//       Also, we could set up three different Render functions depending on
-//       which render type was set and call it with a function pointer. Would be
-//       faster then the nested ifs we have now.
 /*
 Note that these colors correspond to the bit patterns generated by the numbers 0-F in order:
 Color #s correspond to the bit patterns in reverse... Interesting! [It's because
@@ -877,425 +852,357 @@ FB FB FB -> 15 [1111] -> 15		WHITE
 	// Rotated one bit right (in the nybble)--right instead of left because
 	// these are backwards after all :-P
 	uint8_t mirrorNybble2[16] = { 0, 4, 2, 6, 1, 5, 3, 7, 8, 12, 10, 14, 9, 13, 11, 15 };
-	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? 0xFFFFFFFF : 0xFF61FF61);
+	uint32_t dots[20];
+	uint8_t line = y >> 3;
+	uint16_t address = lineAddrLoRes[line];
 
-	for(uint16_t y=0; y<toLine; y++)
-	{
-		// Do top half of double lores screen bytes...
-
-		uint32_t previous3Bits = 0;
-
-		for(uint16_t x=0; x<40; x+=2)
-		{
-			uint8_t scrByte3 = ram2[lineAddrLoRes[y] + x + 0] & 0x0F;
-			uint8_t scrByte4 = ram2[lineAddrLoRes[y] + x + 1] & 0x0F;
-			uint8_t scrByte1 = ram[lineAddrLoRes[y] + x + 0] & 0x0F;
-			uint8_t scrByte2 = ram[lineAddrLoRes[y] + x + 1] & 0x0F;
-			scrByte1 = mirrorNybble[scrByte1];
-			scrByte2 = mirrorNybble[scrByte2];
-			scrByte3 = mirrorNybble2[scrByte3];
-			scrByte4 = mirrorNybble2[scrByte4];
-			// This is just a guess, but it'll have to do for now...
-			uint32_t pixels = previous3Bits | (scrByte3 << 24)
-				| (scrByte3 << 20) | (scrByte1 << 16)
-				| ((scrByte1 & 0x0C) << 12) | ((scrByte4 & 0x03) << 12)
-				| (scrByte4 << 8) | (scrByte2 << 4) | scrByte2;
-
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 11|11 1111 1111 1111
-			// 31   27   23   19   15    11   7    3  0
-
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0x7F000000) >> 24;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
-						uint8_t color = blurTable[bitPat][j];
-
-						for(uint32_t cy=0; cy<8; cy++)
-						{
-							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-//							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-						}
-					}
-				}
-
-				previous3Bits = pixels & 0x70000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					for(uint32_t cy=0; cy<8; cy++)
-					{
-						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					}
-
-					pixels <<= 1;
-				}
-			}
-		}
+	if (!LineStale(address, true, y))
+		return;
 
-		// Now do bottom half...
+	// NOTE: The green mono rendering doesn't skip every other line...
+	//       !!! FIX !!!
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
+	// Top half of the blocks is the low nybbles, bottom half the high
+	uint32_t half = (y >> 2) & 0x01;
 
-		previous3Bits = 0;
+	if (cachedRow == (ROW_DLORES | (line * 2) | half))
+		(*copyRow)(row, rowPixels);
+	else
+	{
+		const uint8_t * mainBytes = ScreenMemory(address, 0);
+		const uint8_t * auxBytes = ScreenMemory(address, 1);
 
 		for(uint16_t x=0; x<40; x+=2)
 		{
-			uint8_t scrByte3 = ram2[lineAddrLoRes[y] + x + 0] >> 4;
-			uint8_t scrByte4 = ram2[lineAddrLoRes[y] + x + 1] >> 4;
-			uint8_t scrByte1 = ram[lineAddrLoRes[y] + x + 0] >> 4;
-			uint8_t scrByte2 = ram[lineAddrLoRes[y] + x + 1] >> 4;
-			scrByte1 = mirrorNybble[scrByte1];
-			scrByte2 = mirrorNybble[scrByte2];
-			scrByte3 = mirrorNybble2[scrByte3];
-			scrByte4 = mirrorNybble2[scrByte4];
+			uint8_t scrByte3 = mirrorNybble2[(auxBytes[x + 0] >> (half * 4)) & 0x0F];
+			uint8_t scrByte4 = mirrorNybble2[(auxBytes[x + 1] >> (half * 4)) & 0x0F];
+			uint8_t scrByte1 = mirrorNybble[(mainBytes[x + 0] >> (half * 4)) & 0x0F];
+			uint8_t scrByte2 = mirrorNybble[(mainBytes[x + 1] >> (half * 4)) & 0x0F];
 			// This is just a guess, but it'll have to do for now...
-//			uint32_t pixels = previous3Bits | (scrByte1 << 24) | (scrByte1 << 20) | (scrByte1 << 16)
-//				| ((scrByte1 & 0x0C) << 12) | ((scrByte2 & 0x03) << 12)
-//				| (scrByte2 << 8) | (scrByte2 << 4) | scrByte2;
-			uint32_t pixels = previous3Bits | (scrByte3 << 24)
-				| (scrByte3 << 20) | (scrByte1 << 16)
+			dots[x >> 1] = (scrByte3 << 24) | (scrByte3 << 20) | (scrByte1 << 16)
 				| ((scrByte1 & 0x0C) << 12) | ((scrByte4 & 0x03) << 12)
 				| (scrByte4 << 8) | (scrByte2 << 4) | scrByte2;
-
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 11|11 1111 1111 1111
-			// 31   27   23   19   15    11   7    3  0
-
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0x7F000000) >> 24;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
-						uint8_t color = blurTable[bitPat][j];
-
-						for(uint32_t cy=8; cy<16; cy++)
-						{
-							scrBuffer[((x * 14) + (i * 4) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-						}
-					}
-				}
-
-				previous3Bits = pixels & 0x70000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					for(uint32_t cy=8; cy<16; cy++)
-					{
-						scrBuffer[((x * 14) + j) + (((y * 16) + cy) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					}
-
-					pixels <<= 1;
-				}
-			}
 		}
+
+		ExpandDots(row, dots, 0);
+		cachedRow = ROW_DLORES | (line * 2) | half;
+		rowPixels = row;
 	}
+
+	(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
 }
 
 
-static void RenderHiRes(uint16_t toLine/*= 192*/)
+static void RenderHiRes(uint8_t y)
 {
-#if 0
-	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? 0xFFFFFFFF : 0xFF61FF61);
-#else
-// Now it is. Now roll this fix into all the other places... !!! FIX !!!
-// The colors are set in the 8-bit array as R G B A
-	uint8_t monoColors[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x61, 0xFF, 0x61, 0xFF };
-	uint32_t * colorPtr = (uint32_t *)monoColors;
-	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? colorPtr[0] : colorPtr[1]);
-#endif
+	uint32_t dots[20];
+	uint16_t address = lineAddrHiRes[y] + (switches & VS_PAGE2 ? 0x2000 : 0x0000);
 
-	for(uint16_t y=0; y<toLine; y++)
-	{
-		uint16_t previousLoPixel = 0;
-		uint32_t previous3bits = 0;
+	if (!LineStale(address, false, y))
+		return;
 
-		for(uint16_t x=0; x<40; x+=2)
-		{
-			uint8_t screenByte = ram[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x];
-			uint32_t pixels = appleHiresToMono[previousLoPixel | screenByte];
-			previousLoPixel = (screenByte << 2) & 0x0100;
-
-			screenByte = ram[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x + 1];
-			uint32_t pixels2 = appleHiresToMono[previousLoPixel | screenByte];
-			previousLoPixel = (screenByte << 2) & 0x0100;
+	const uint8_t * bytes = ScreenMemory(address, 0);
+	// Each byte is 7 dots, doubled & shifted half a dot by its high bit; a
+	// shifted byte's first dot overlaps the last one of the byte before
+	uint16_t previousLoPixel = 0;
 
-			pixels = previous3bits | (pixels << 14) | pixels2;
+	for(uint16_t x=0; x<40; x+=2)
+	{
+		uint8_t screenByte = bytes[x];
+		uint32_t pixels = appleHiresToMono[previousLoPixel | screenByte];
+		previousLoPixel = (screenByte << 2) & 0x0100;
 
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 1111 1111 1111 1111
-			// 31   27   23   19   15   11   7    3  0
+		screenByte = bytes[x + 1];
+		uint32_t pixels2 = appleHiresToMono[previousLoPixel | screenByte];
+		previousLoPixel = (screenByte << 2) & 0x0100;
 
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0x7F000000) >> 24;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
-						uint8_t color = blurTable[bitPat][j];
-#if 0
-//This doesn't seem to make things go any faster...
-//It's the OpenGL render that's faster... Hmm...
-						scrBuffer[(x * 14) + (i * 4) + j + (y * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-#else
-						scrBuffer[(x * 14) + (i * 4) + j + (((y * 2) + 0) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-						scrBuffer[(x * 14) + (i * 4) + j + (((y * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = palette[color];
-#endif
-					}
-				}
-
-				previous3bits = pixels & 0x70000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					scrBuffer[(x * 14) + j + (((y * 2) + 0) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
+		dots[x >> 1] = (pixels << 14) | pixels2;
+	}
 
-					if (screenType == ST_GREEN_MONO)
-						pixels &= 0x07FFFFFF;
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
+	ExpandDots(row, dots, 0);
 
-					scrBuffer[(x * 14) + j + (((y * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					pixels <<= 1;
-				}
-			}
-		}
-	}
+	if (screenType == ST_GREEN_MONO)
+		BlankRow(row + VIRTUAL_SCREEN_WIDTH);
+	else
+		(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
 }
 
 
-static void RenderDHiRes(uint16_t toLine/*= 192*/)
+static void RenderDHiRes(uint8_t y)
 {
-// Now it is. Now roll this fix into all the other places... !!! FIX !!!
-// The colors are set in the 8-bit array as R G B A
-	uint8_t monoColors[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x61, 0xFF, 0x61, 0xFF };
-	uint32_t * colorPtr = (uint32_t *)monoColors;
-	uint32_t pixelOn = (screenType == ST_WHITE_MONO ? colorPtr[0] : colorPtr[1]);
+	uint32_t dots[20];
+	uint16_t address = lineAddrHiRes[y] + (switches & VS_PAGE2 ? 0x2000 : 0x0000);
 
-	for(uint16_t y=0; y<toLine; y++)
-	{
-		uint32_t previous4bits = 0;
+	if (!LineStale(address, true, y))
+		return;
 
-		for(uint16_t x=0; x<40; x+=2)
-		{
-			uint8_t screenByte = ram[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x];
-			uint32_t pixels = (mirrorTable[screenByte & 0x7F]) << 14;
-			screenByte = ram[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x + 1];
-			pixels = pixels | (mirrorTable[screenByte & 0x7F]);
-			screenByte = ram2[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x];
-			pixels = pixels | ((mirrorTable[screenByte & 0x7F]) << 21);
-			screenByte = ram2[lineAddrHiRes[y] + (displayPage2 ? 0x2000 : 0x0000) + x + 1];
-			pixels = pixels | ((mirrorTable[screenByte & 0x7F]) << 7);
-			pixels = previous4bits | (pixels >> 1);
-
-			// We now have 28 pixels (expanded from 14) in word: mask is $0F FF FF FF
-			// 0ppp 1111 1111 1111 1111 1111 1111 1111
-			// 31   27   23   19   15   11   7    3  0
-
-			if (screenType == ST_COLOR_TV)
-			{
-				for(uint8_t i=0; i<7; i++)
-				{
-					uint8_t bitPat = (pixels & 0xFE000000) >> 25;
-					pixels <<= 4;
-
-					for(uint8_t j=0; j<4; j++)
-					{
- 						uint32_t color = palette[blurTable[bitPat][j]];
-						scrBuffer[(x * 14) + (i * 4) + j + (((y * 2) + 0) * VIRTUAL_SCREEN_WIDTH)] = color;
-						scrBuffer[(x * 14) + (i * 4) + j + (((y * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = color;
-					}
-				}
-
-				previous4bits = pixels & 0xF0000000;
-			}
-			else
-			{
-				for(int j=0; j<28; j++)
-				{
-					scrBuffer[(x * 14) + j + (((y * 2) + 0) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
+	const uint8_t * mainBytes = ScreenMemory(address, 0);
+	const uint8_t * auxBytes = ScreenMemory(address, 1);
 
-					if (screenType == ST_GREEN_MONO)
-						pixels &= 0x07FFFFFF;
-
-					scrBuffer[(x * 14) + j + (((y * 2) + 1) * VIRTUAL_SCREEN_WIDTH)] = (pixels & 0x08000000 ? pixelOn : 0xFF000000);
-					pixels <<= 1;
-				}
-			}
-		}
+	// Aux & main bytes take turns, 7 dots each, low bit first
+	for(uint16_t x=0; x<40; x+=2)
+	{
+		uint32_t pixels = (mirrorTable[mainBytes[x] & 0x7F] << 14)
+			| mirrorTable[mainBytes[x + 1] & 0x7F]
+			| (mirrorTable[auxBytes[x] & 0x7F] << 21)
+			| (mirrorTable[auxBytes[x + 1] & 0x7F] << 7);
+		dots[x >> 1] = pixels >> 1;
 	}
+
+	uint32_t * row = scrBuffer + (y * 2 * VIRTUAL_SCREEN_WIDTH);
+	ExpandDots(row, dots, 1);
+
+	if (screenType == ST_GREEN_MONO)
+		BlankRow(row + VIRTUAL_SCREEN_WIDTH);
+	else
+		(*copyRow)(row + VIRTUAL_SCREEN_WIDTH, row);
 }
 
 
-void RenderVideoFrame(void)
+//
+// Draw scanline y in whatever mode the switches say
+//
+static void RenderScanline(uint8_t y)
 {
-	if (GUI::powerOnState == true)
+	if ((switches & VS_TEXT) || ((switches & VS_MIXED) && (y >= 160)))
 	{
-		if (textMode)
-		{
-			if (!col80Mode)
-				Render40ColumnText();
-			else
-				Render80ColumnText();
-		}
+		if ((switches & (VS_TEXT | VS_80COL)) == (VS_TEXT | VS_80COL))
+			Render80ColumnText(y);
 		else
-		{
-			if (mixedMode)
-			{
-				if (dhires)
-				{
-					if (hiRes)
-						RenderDHiRes(160);
-					else
-						RenderDLoRes(20);
-				}
-				else if (hiRes)
-					RenderHiRes(160);
-				else
-					RenderLoRes(20);
-
-				Render40ColumnTextLine(20);
-				Render40ColumnTextLine(21);
-				Render40ColumnTextLine(22);
-				Render40ColumnTextLine(23);
-			}
-			else
-			{
-				if (dhires)
-				{
-					if (hiRes)
-						RenderDHiRes();
-					else
-						RenderDLoRes();
-				}
-				else if (hiRes)
-					RenderHiRes();
-				else
-					RenderLoRes();
-			}
-		}
+			Render40ColumnText(y);
 	}
-	else
+	else if (switches & VS_DHIRES)
 	{
-		memset(scrBuffer, 0, VIRTUAL_SCREEN_WIDTH * VIRTUAL_SCREEN_HEIGHT * sizeof(uint32_t));
+		if (switches & VS_HIRES)
+			RenderDHiRes(y);
+		else
+			RenderDLoRes(y);
 	}
+	else if (switches & VS_HIRES)
+		RenderHiRes(y);
+	else
+		RenderLoRes(y);
+}
 
-	if (msgTicks)
-	{
-		DrawString();
-		msgTicks--;
-	}
 
-	if (showFrameTicks)
-		DrawFrameTicks();
+//
+// Does scanline y, which shows the line of the screen at address (in main
+// memory, and in aux too if it's a double width mode), have to be redrawn?
+// It does if it was drawn in a different mode last time, or its memory has
+// changed since (as of when the beam got to it), or what it showed last time
+// was wound back from what's in RAM now; if so (or if force is set), it gets
+// marked as redrawn.
+//
+static inline bool LineStale(uint16_t address, bool aux, uint8_t y, bool force/*= false*/)
+{
+	uint16_t block = address >> 7;
+	uint32_t mode = switches | (screenType << 8);
+	bool behind = lineBehind[y];
+	lineBehind[y] = shadowed[0][block] | (aux ? shadowed[1][block] : 0);
+
+	if (!force && !redrawAll && !behind && (lineMode[y] == mode)
+		&& !changes[0][block] && !(aux && changes[1][block]))
+		return false;
+
+	lineMode[y] = mode;
+	lineRedrawn[y] = 1;
+	return true;
 }
 
 
 //
-// Prime SDL and create surfaces
+// Are there any flashing characters in the 40 bytes of text at chars? (There
+// aren't any in the alternate character set.)
 //
-bool InitVideo(void)
+static bool LineFlashes(const uint8_t * chars)
 {
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_NOPARACHUTE) != 0)
-	{
-		WriteLog("Video: Could not initialize the SDL library: %s\n", SDL_GetError());
+	if (switches & VS_ALTCHAR)
 		return false;
-	}
-
-	sdlWindow = SDL_CreateWindow("Apple2", settings.winX, settings.winY, VIRTUAL_SCREEN_WIDTH * 2, VIRTUAL_SCREEN_HEIGHT * 2, 0);
 
-	if (sdlWindow == NULL)
+	for(int x=0; x<40; x++)
 	{
-		WriteLog("Video: Could not create window: %s\n", SDL_GetError());
-		return false;
+		if ((chars[x] & 0xC0) == 0x40)
+			return true;
 	}
 
-	sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	return false;
+}
 
-	if (sdlRenderer == NULL)
-	{
-		WriteLog("Video: Could not create renderer: %s\n", SDL_GetError());
-		return false;
-	}
 
-	// Make sure what we put there is what we get:
-	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(sdlRenderer, VIRTUAL_SCREEN_WIDTH, VIRTUAL_SCREEN_HEIGHT);
+//
+// Where the bytes at address (in main or aux memory) are, as of the line
+// being rendered
+//
+static inline const uint8_t * ScreenMemory(uint16_t address, uint8_t aux)
+{
+	if (shadowed[aux][address >> 7])
+		return &shadow[aux][address];
+
+	return &snapshot->mem[aux][address];
+}
+
 
-	// Set the application's icon & title...
-	SDL_Surface * iconSurface = SDL_CreateRGBSurfaceFrom(icon, 64, 64, 32, 64*4, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000);
-	SDL_SetWindowIcon(sdlWindow, iconSurface);
-	SDL_FreeSurface(iconSurface);
-	SDL_SetWindowTitle(sdlWindow, "Apple2 Emulator");
+//
+// Undo everything in the log (see VideoChange in mmu.h) that happened at or
+// after clock, newest first, so the screen is back to what it was then. If
+// the log wrapped around since, it only goes back as far as it can.
+//
+static void WindBack(uint64_t clock)
+{
+	while ((unwound > snapshot->first)
+		&& (snapshot->log[unwound - 1 - snapshot->first].clock >= clock))
+	{
+		const VideoChange * change = &snapshot->log[--unwound - snapshot->first];
+		cachedRow = 0;
 
-	sdlTexture = SDL_CreateTexture(sdlRenderer,
-		SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
-		VIRTUAL_SCREEN_WIDTH, VIRTUAL_SCREEN_HEIGHT);
+		if (change->address == VIDEO_SWITCHES)
+		{
+			switches = change->old;
+			continue;
+		}
 
-	// Start in fullscreen, if user requested it via config file
-	int response = SDL_SetWindowFullscreen(sdlWindow, (settings.fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
+		uint8_t aux = change->aux;
+		uint16_t block = change->address >> 7;
 
-	if (response != 0)
-		WriteLog("Video::FullScreen: SDL error = %s\n", SDL_GetError());
+		if (unwound >= countedFrom)
+			changes[aux][block]--;
 
-	SetupBlurTable();
+		if (!shadowed[aux][block])
+		{
+			memcpy(&shadow[aux][block << 7], &snapshot->mem[aux][block << 7], 0x80);
+			shadowed[aux][block] = 1;
+			anyShadowed = true;
+		}
 
-	WriteLog("Video: Successfully initialized.\n");
-	return true;
+		shadow[aux][change->address] = change->old;
+	}
 }
 
 
 //
-// Free various SDL components
+// Make the next frame get redrawn from scratch (for when something else has
+// been drawn over the buffer)
 //
-void VideoDone(void)
+void InvalidateVideo(void)
 {
-	WriteLog("Video: Shutting down SDL...\n");
-	SDL_DestroyTexture(sdlTexture);
-	SDL_DestroyRenderer(sdlRenderer);
-	SDL_DestroyWindow(sdlWindow);
-	SDL_Quit();
-	WriteLog("Video: Done.\n");
+	memset(lineMode, 0xFF, sizeof(lineMode));
 }
 
 
 //
-// Render the Apple video screen to the primary texture
+// Render the Apple's screen as it is right now into the passed in buffer
+// (see RenderVideoSnapshot())
 //
-void RenderAppleScreen(SDL_Renderer * renderer)
+uint32_t RenderVideoFrame(uint32_t * buffer, uint8_t * redrawn/*= NULL*/)
 {
-	SDL_LockTexture(sdlTexture, NULL, (void **)&scrBuffer, &scrPitch);
-	RenderVideoFrame();
-	SDL_UnlockTexture(sdlTexture);
-	SDL_RenderClear(renderer);		// Without this, full screen has trash on the sides
-	SDL_RenderCopy(renderer, sdlTexture, NULL, NULL);
+	TakeVideoSnapshot(&liveSnapshot);
+	return RenderVideoSnapshot(&liveSnapshot, buffer, redrawn);
 }
 
 
 //
-// Fullscreen <-> window switching
+// Render the Apple's screen as of the snapshot into the passed in buffer,
+// which is VIRTUAL_SCREEN_WIDTH x VIRTUAL_SCREEN_HEIGHT 32-bit RGBA pixels.
+// What gets shown is the last frame the beam drew all the way through, with
+// each line the way it was when the beam got to it: the log of changes to
+// the screen (see VideoChange in mmu.h) gets wound back from the bottom line
+// up, so a program that flips modes or writes to the screen partway down
+// gets a split screen, just like on the real thing. (It only goes to the
+// nearest line; a change in the middle of one shows up on the next.)
+//
+// Only the lines that were drawn differently last time, or whose display
+// memory has changed since, get redrawn (unless it's a different buffer, or
+// snapshots were skipped); if redrawn isn't NULL, it gets a flag for each of
+// the 192 Apple scanlines saying whether it was. Returns the # of scanlines
+// redrawn.
 //
-void ToggleFullScreen(void)
+uint32_t RenderVideoSnapshot(const VideoSnapshot * frame, uint32_t * buffer, uint8_t * redrawn/*= NULL*/)
 {
-	settings.fullscreen = !settings.fullscreen;
+	redrawAll = (buffer != scrBuffer) || (palette != lastPalette);
+	flashChanged = (flash != lastFlash);
+	scrBuffer = buffer;
+	lastPalette = palette;
+	lastFlash = flash;
+	memset(lineRedrawn, 0, sizeof(lineRedrawn));
+
+	if ((palette != tablePalette) || (screenType != tableScreenType))
+		SetupPixelTables();
+
+	if (screenType != glyphScreenType)
+		SetupGlyphCache();
+
+	// If the beam was still drawing that frame's lines, it's the last frame
+	// that gets shown
+	uint32_t cycle = frame->frameCycle;
+	uint64_t lineClock = frame->clock - cycle + VBL_START + HBL_CYCLES;
+
+	if (cycle < VBL_END)
+		lineClock -= CYCLES_PER_FRAME;
+
+	snapshot = frame;
+	switches = frame->switches;
+	unwound = frame->logged;
+	cachedRow = 0;
+
+	// If the log was cleared since the last frame (see MarkVideoDirty()), or
+	// this one doesn't go back as far as that, there's no telling what
+	// changed
+	countedFrom = renderedTo;
+
+	if ((renderedTo < frame->cleared) || (renderedTo < frame->first)
+		|| (renderedTo > frame->logged))
+	{
+		redrawAll = true;
+		countedFrom = frame->first;
+	}
+
+	memset(changes, 0, sizeof(changes));
+
+	for(uint64_t i=countedFrom; i<frame->logged; i++)
+	{
+		const VideoChange * change = &frame->log[i - frame->first];
+
+		if (change->address != VIDEO_SWITCHES)
+			changes[change->aux][change->address >> 7]++;
+	}
+
+	// Anything done after the last line doesn't show until the next frame
+	WindBack(lineClock + (VBL_END - VBL_START));
+
+	// If nothing changed while the beam was drawing, every line gets drawn
+	// the same way, in order; otherwise, it has to go from the bottom up
+	if ((unwound == frame->first)
+		|| (frame->log[unwound - 1 - frame->first].clock < lineClock))
+	{
+		for(uint32_t y=0; y<VIRTUAL_SCREEN_HEIGHT/2; y++)
+			RenderScanline(y);
+	}
+	else
+	{
+		for(int y=(VIRTUAL_SCREEN_HEIGHT/2)-1; y>=0; y--)
+		{
+			WindBack(lineClock + (y * CYCLES_PER_LINE));
+			RenderScanline(y);
+		}
+	}
+
+	renderedTo = frame->logged;
+
+	if (anyShadowed)
+	{
+		memset(shadowed, 0, sizeof(shadowed));
+		anyShadowed = false;
+	}
+
+	uint32_t count = 0;
+
+	for(uint32_t i=0; i<sizeof(lineRedrawn); i++)
+		count += lineRedrawn[i];
 
-	int retVal = SDL_SetWindowFullscreen(sdlWindow, (settings.fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
+	if (redrawn)
+		memcpy(redrawn, lineRedrawn, sizeof(lineRedrawn));
 
-	if (retVal != 0)
-		WriteLog("Video::ToggleFullScreen: SDL error = %s\n", SDL_GetError());
+	return count;
 }
 
@@ -5,7 +5,13 @@
 #ifndef __VIDEO_H__
 #define __VIDEO_H__
 
-#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Keep SDL out of here so the core can include this without it
+struct SDL_Renderer;
+struct SDL_Window;
+struct VideoSnapshot;
 
 // These are double the normal width because we use sub-pixel rendering.
 #define VIRTUAL_SCREEN_WIDTH	(280 * 2)
@@ -16,21 +22,18 @@
 void TogglePalette(void);
 void CycleScreenTypes(void);
 void SpawnMessage(const char * text, ...);
+void SetupBlurTable(void);
+uint32_t RenderVideoFrame(uint32_t * buffer, uint8_t * redrawn = NULL);
+uint32_t RenderVideoSnapshot(const VideoSnapshot * frame, uint32_t * buffer, uint8_t * redrawn = NULL);
+void InvalidateVideo(void);
 bool InitVideo(void);
 void VideoDone(void);
-void RenderAppleScreen(SDL_Renderer *);
+void RenderAppleScreen(SDL_Renderer *, const VideoSnapshot * snapshot = NULL);
 void ToggleFullScreen(void);
 void ToggleTickDisplay(void);
 
 // Exported variables
 
-extern bool flash;
-extern bool textMode;
-extern bool mixedMode;
-extern bool displayPage2;
-extern bool hiRes;
-extern bool alternateCharset;
-extern bool col80Mode;
 extern SDL_Renderer * sdlRenderer;
 extern SDL_Window * sdlWindow;
 
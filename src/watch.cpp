@@ -0,0 +1,201 @@
+//
+// Memory watchpoints & execution breakpoints
+//
+// Nothing here gets looked at unless the CPU touches a page that has a watch
+// on it: the MMU sends those pages (and only those) through its trap handlers,
+// which call WatchAccess() for every access to them. Everything else runs
+// straight out of the page table, same as always.
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#include "watch.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "apple2.h"
+#include "log.h"
+#include "mmu.h"
+#include "profile.h"
+#include "trace.h"
+
+
+struct Watch
+{
+	uint16_t start, end;		// Inclusive
+	uint8_t type;				// WATCH_* (any combination)
+	uint8_t bank;				// BANK_* or WATCH_ANY_BANK
+	uint8_t action;				// WATCH_BREAK or WATCH_TRACE
+	bool valid;
+};
+
+// Local variables
+
+static Watch watch[WATCH_MAX];
+static WatchHit lastHit;
+static bool hitPending = false;
+
+// Local functions
+
+static void UpdateTraps(void);
+
+
+//
+// Watch start thru end (inclusive) for the access types in type, in the given
+// bank. Returns the watch's ID, or -1 if there's no room for it.
+//
+int AddWatch(uint16_t start, uint16_t end, uint8_t type, uint8_t bank/*= WATCH_ANY_BANK*/, uint8_t action/*= WATCH_BREAK*/)
+{
+	if (end < start)
+	{
+		uint16_t temp = start;
+		start = end;
+		end = temp;
+	}
+
+	for(int i=0; i<WATCH_MAX; i++)
+	{
+		if (watch[i].valid)
+			continue;
+
+		watch[i].start = start;
+		watch[i].end = end;
+		watch[i].type = type & (WATCH_READ | WATCH_WRITE | WATCH_EXEC);
+		watch[i].bank = bank;
+		watch[i].action = action;
+		watch[i].valid = true;
+		UpdateTraps();
+		WriteLog("Watch: #%d on $%04X-$%04X (type %X, bank %u)\n", i, start, end, type, bank);
+
+		return i;
+	}
+
+	WriteLog("Watch: No room for any more watches!\n");
+	return -1;
+}
+
+
+bool RemoveWatch(int id)
+{
+	if ((id < 0) || (id >= WATCH_MAX) || !watch[id].valid)
+		return false;
+
+	watch[id].valid = false;
+	UpdateTraps();
+
+	return true;
+}
+
+
+void ClearWatches(void)
+{
+	for(int i=0; i<WATCH_MAX; i++)
+		watch[i].valid = false;
+
+	hitPending = false;
+	UpdateTraps();
+}
+
+
+//
+// If a WATCH_BREAK went off since the last time we looked, say which one
+//
+bool GetWatchHit(WatchHit * hit)
+{
+	if (!hitPending)
+		return false;
+
+	*hit = lastHit;
+	hitPending = false;
+
+	return true;
+}
+
+
+//
+// One line of text for the front ends to show
+//
+const char * DescribeWatchHit(const WatchHit & hit, char * buf)
+{
+	const V65C02REGS & r = hit.regs;
+	const char * type = (hit.type == WATCH_EXEC ? "exec"
+		: (hit.type == WATCH_WRITE ? "write" : "read"));
+
+	sprintf(buf, "Watch #%d: %s $%04X (%s) = $%02X @ %llu, PC=$%04X A=$%02X X=$%02X Y=$%02X SP=$%02X P=$%02X",
+		hit.id, type, hit.address, bankName[hit.bank], hit.value,
+		(unsigned long long)r.clock, r.pc, r.a, r.x, r.y, r.sp, r.cc);
+
+	return buf;
+}
+
+
+//
+// Called by the MMU's trap handlers for every access to a page with a watch
+// on it. Reads of the byte at PC are opcode fetches.
+//
+void WatchAccess(uint16_t address, uint8_t type, uint8_t bank, uint8_t value)
+{
+	if ((type == WATCH_READ) && (address == mainCPU.pc))
+		type = WATCH_EXEC;
+
+	for(int i=0; i<WATCH_MAX; i++)
+	{
+		Watch * w = &watch[i];
+
+		if (!w->valid || !(w->type & type) || (address < w->start)
+			|| (address > w->end)
+			|| ((w->bank != WATCH_ANY_BANK) && (w->bank != bank)))
+			continue;
+
+		TraceRecord * record = TraceAlloc(TRACE_WATCH, mainCPU.clock, mainCPU.pc);
+		record->flags = (type == WATCH_WRITE ? TRACE_WRITE : 0);
+		record->watch.id = i;
+		record->watch.access = type;
+		record->watch.bank = bank;
+		record->watch.value = value;
+		record->watch.address = address;
+		TraceCommit();
+
+		// Only the first break counts until somebody looks at it
+		if ((w->action == WATCH_BREAK) && !hitPending)
+		{
+			lastHit.id = i;
+			lastHit.address = address;
+			lastHit.type = type;
+			lastHit.bank = bank;
+			lastHit.value = value;
+			lastHit.regs = mainCPU;
+
+			// N & Z are kept lazily while the CPU's running (see GetCC() in
+			// v65c02core.h)
+			uint16_t nz = mainCPU.nz;
+			lastHit.regs.cc = (mainCPU.cc & ~(FLAG_N | FLAG_Z))
+				| ((nz | (nz >> 8)) & FLAG_N) | ((nz & 0xFF) == 0 ? FLAG_Z : 0);
+			hitPending = true;
+			mainCPU.cpuFlags |= V65C02_STOP_REQUEST;
+		}
+	}
+}
+
+
+//
+// Tell the MMU which pages have to be trapped, and for what
+//
+static void UpdateTraps(void)
+{
+	uint8_t mask[0x100];
+	memset(mask, 0, sizeof(mask));
+
+	for(int i=0; i<WATCH_MAX; i++)
+	{
+		if (!watch[i].valid)
+			continue;
+
+		for(uint32_t page=(watch[i].start >> 8); page<=(uint32_t)(watch[i].end >> 8); page++)
+			mask[page] |= watch[i].type;
+	}
+
+	TrapPages(mask);
+}
+
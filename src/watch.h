@@ -0,0 +1,53 @@
+//
+// watch.h: Memory watchpoints & execution breakpoints
+//
+// by James Hammons
+// (C) 2018 Underground Software
+//
+
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include <stdint.h>
+#include "v65c02.h"
+
+#define WATCH_MAX			32			// # of watches there can be at once
+
+// What a watch looks for
+#define WATCH_READ			0x01
+#define WATCH_WRITE			0x02
+#define WATCH_EXEC			0x04		// Opcode fetches
+
+#define WATCH_ANY_BANK		0xFF		// Else one of BANK_* (see mmu.h)
+
+// What happens when one goes off
+enum { WATCH_BREAK = 0, WATCH_TRACE };
+
+struct WatchHit
+{
+	int id;						// Which watch it was
+	uint16_t address;
+	uint8_t type;				// WATCH_*
+	uint8_t bank;				// BANK_*
+	uint8_t value;				// What was read or written
+	V65C02REGS regs;			// CPU at the time (see N.B. below)
+};
+
+// Exported functions
+
+// N.B.: Watches work by sending the pages they cover through trap handlers
+//       (see TrapPages() in mmu.cpp), so only add & remove them while the CPU
+//       isn't running. A WATCH_BREAK stops the CPU at the end of the
+//       instruction that set it off (GetWatchHit() says what it was); both
+//       kinds put a record in the trace ring. The registers in the hit are
+//       the ones at the time of the access, so for reads & writes PC can
+//       already be past the instruction that did it.
+int AddWatch(uint16_t start, uint16_t end, uint8_t type, uint8_t bank = WATCH_ANY_BANK, uint8_t action = WATCH_BREAK);
+bool RemoveWatch(int id);
+void ClearWatches(void);
+bool GetWatchHit(WatchHit * hit);
+const char * DescribeWatchHit(const WatchHit & hit, char * buf);
+void WatchAccess(uint16_t address, uint8_t type, uint8_t bank, uint8_t value);
+
+#endif	// __WATCH_H__
+